@@ -0,0 +1,279 @@
+#include "Benchmark.hpp"
+
+#include "World.hpp"
+#include "Maths.hpp"
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+constexpr int ArcSamplesPerSegment = 32;
+
+FlythroughPath::FlythroughPath(std::string const &file): file(file) {
+  std::ifstream f(file);
+  if(!f)
+    throw std::runtime_error("Unable to open path file " + file);
+
+  std::string line;
+  while(getline(f, line)) {
+    std::stringstream ss(line);
+    std::string name;
+    if(!(ss >> name) || name[0] == '#')
+      continue;
+
+    if(name == "point") {
+      glm::vec3 p;
+      if(ss >> p.x >> p.y >> p.z)
+        points.push_back(p);
+    }
+    else if(name == "seed")
+      ss >> seed;
+    else if(name == "speed")
+      ss >> speed;
+    else if(name == "settle")
+      ss >> settleTimeout;
+    else if(name == "output")
+      ss >> output;
+    else if(name == "target")
+      ss >> targetFrameMs;
+    else
+      std::cerr << "Unknown path option: " << name << " in file " << file << "\n";
+  }
+
+  if(points.size() < 2)
+    throw std::runtime_error("Path file " + file + " needs at least two points");
+  if(speed <= .0f)
+    throw std::runtime_error("Path file " + file + " needs a positive speed");
+
+  buildArcLengths();
+}
+
+glm::vec3 FlythroughPath::spline(float const t) const {
+  auto const last = static_cast<int>(points.size()) - 1;
+  auto const seg  = std::clamp(static_cast<int>(t), 0, last - 1);
+  auto const u    = t - seg;
+
+  auto const &p0 = points[std::max(seg - 1, 0)];
+  auto const &p1 = points[seg];
+  auto const &p2 = points[seg + 1];
+  auto const &p3 = points[std::min(seg + 2, last)];
+
+  auto const u2 = u * u, u3 = u2 * u;
+  return ((p1 * 2.f) + (p2 - p0) * u + (p0 * 2.f - p1 * 5.f + p2 * 4.f - p3) * u2 + (p1 * 3.f - p0 - p2 * 3.f + p3) * u3) * .5f;
+}
+
+void FlythroughPath::buildArcLengths() {
+  auto const samples = (points.size() - 1) * ArcSamplesPerSegment;
+  arcLengths.assign(1, .0f);
+  auto prev = spline(.0f);
+  for(size_t i = 1; i <= samples; ++i) {
+    auto const curr = spline(static_cast<float>(i) / ArcSamplesPerSegment);
+    arcLengths.push_back(arcLengths.back() + Length(curr - prev));
+    prev = curr;
+  }
+}
+
+glm::vec3 FlythroughPath::at(float const distance) const {
+  if(distance <= .0f)
+    return points.front();
+  if(distance >= length())
+    return points.back();
+
+  auto const it   = std::upper_bound(arcLengths.begin(), arcLengths.end(), distance);
+  auto const i    = static_cast<size_t>(it - arcLengths.begin());
+  auto const frac = (distance - arcLengths[i - 1]) / std::max(arcLengths[i] - arcLengths[i - 1], 1e-6f);
+  return spline((i - 1 + frac) / ArcSamplesPerSegment);
+}
+
+void FlythroughPath::write(std::ostream &os) const {
+  os << "seed " << seed << "\n";
+  os << "speed " << speed << "\n";
+  os << "settle " << settleTimeout << "\n";
+  if(targetFrameMs > .0f)
+    os << "target " << targetFrameMs << "\n";
+  if(!output.empty())
+    os << "output " << output << "\n";
+  for(auto const &p: points)
+    os << "point " << p.x << " " << p.y << " " << p.z << "\n";
+}
+
+float FrameStats::percentile(float const p) const {
+  if(frameTimes.empty())
+    return .0f;
+  if(sorted.size() != frameTimes.size()) {
+    sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+  }
+  auto const rank = static_cast<size_t>(std::ceil(p / 100.f * sorted.size()));
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+float FrameStats::mean() const {
+  if(frameTimes.empty())
+    return .0f;
+  return std::accumulate(frameTimes.begin(), frameTimes.end(), .0f) / frameTimes.size();
+}
+
+std::size_t FrameStats::countOver(float const frameTimeMs) const {
+  return static_cast<std::size_t>(std::count_if(frameTimes.begin(), frameTimes.end(), [&](float const t) { return t > frameTimeMs; }));
+}
+
+std::size_t PeakMemoryKb() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc{};
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.PeakWorkingSetSize / 1024;
+  return 0;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+#else
+  return static_cast<std::size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+Benchmark::Benchmark(FlythroughPath path): path(std::move(path)) { }
+
+bool Benchmark::frame(World &world, glm::vec3 &position, float &lookX, float &lookZ) {
+  auto const now = Clock::now();
+  std::chrono::duration<float> const sincePhaseStart = now - phaseStart;
+
+  switch(phase) {
+  case Phase::Settling:
+    if(world.isSettled() || sincePhaseStart.count() > path.settleTimeout) {
+      timedOut      = !world.isSettled();
+      settleTime    = sincePhaseStart.count();
+      chunksAtStart = world.numChunksLoaded();
+      phase         = Phase::Running;
+      phaseStart    = lastFrame = now;
+    }
+    break;
+
+  case Phase::Running: {
+    std::chrono::duration<float, std::milli> const frameTime = now - lastFrame;
+    stats.add(frameTime.count());
+    lastFrame = now;
+    travelled = sincePhaseStart.count() * path.speed;
+
+    if(travelled >= path.length()) {
+      runTime        = sincePhaseStart.count();
+      chunksStreamed = world.numChunksLoaded() - chunksAtStart;
+      lodRings       = world.lodRings();
+      pipeline       = world.pipelineStats();
+      chunkPool      = world.chunkPool->stats();
+      meshBuffers    = world.meshBuffers.stats();
+      farTiles       = world.farTerrain.numTiles();
+      farTriangles   = world.farTerrain.numTriangles();
+      phase          = Phase::Done;
+
+      if(path.output.empty())
+        report(std::cout);
+      else {
+        std::ofstream of(path.output);
+        report(of);
+      }
+      return false;
+    }
+    break;
+  }
+
+  case Phase::Done:
+    return false;
+  }
+
+  position = path.at(travelled);
+
+  auto const dir = path.at(travelled + 1.f) - path.at(std::max(travelled - 1.f, .0f));
+  if(auto const len = Length(dir); len > 1e-4f) {
+    lookX = std::atan2(dir.y, dir.x);
+    lookZ = std::asin(std::clamp(dir.z / len, -1.f, 1.f));
+  }
+
+  return true;
+}
+
+void Benchmark::report(std::ostream &os) const {
+  os << "{\n";
+  os << "  \"path\": \"" << path.file << "\",\n";
+  os << "  \"seed\": " << path.seed << ",\n";
+  os << "  \"path_length\": " << path.length() << ",\n";
+  os << "  \"speed\": " << path.speed << ",\n";
+  os << "  \"settle_s\": " << settleTime << ",\n";
+  os << "  \"settle_timed_out\": " << (timedOut ? "true" : "false") << ",\n";
+  os << "  \"duration_s\": " << runTime << ",\n";
+  os << "  \"frames\": " << stats.size() << ",\n";
+  if(governor)
+    os << "  \"frames_over_target\": " << stats.countOver(governor->targetMs()) << ",\n";
+  os << "  \"frame_time_ms\": {\n";
+  os << "    \"mean\": " << stats.mean() << ",\n";
+  os << "    \"p50\": " << stats.percentile(50.f) << ",\n";
+  os << "    \"p95\": " << stats.percentile(95.f) << ",\n";
+  os << "    \"p99\": " << stats.percentile(99.f) << ",\n";
+  os << "    \"max\": " << stats.percentile(100.f) << "\n";
+  os << "  },\n";
+  os << "  \"chunks_streamed\": " << chunksStreamed << ",\n";
+  os << "  \"chunks_per_s\": " << (runTime > .0f ? chunksStreamed / runTime : .0f) << ",\n";
+  os << "  \"lod_rings\": [\n";
+  for(size_t i = 0; i < lodRings.size(); ++i) {
+    auto const &ring = lodRings[i];
+    os << "    {\"lod\": " << ring.lod << ", \"chunks\": " << ring.chunks << ", \"triangles\": " << ring.triangles
+       << ", \"meshes\": " << ring.meshes << ", \"mesh_ms_total\": " << ring.meshMsTotal
+       << ", \"mesh_ms_avg\": " << (ring.meshes ? ring.meshMsTotal / ring.meshes : .0f) << "}"
+       << (i + 1 < lodRings.size() ? "," : "") << "\n";
+  }
+  os << "  ],\n";
+  os << "  \"pipeline\": [\n";
+  for(size_t i = 0; i < pipeline.size(); ++i) {
+    auto const &stage = pipeline[i];
+    os << "    {\"stage\": \"" << StageName(stage.stage) << "\", \"chunks\": " << stage.chunks << ", \"queued\": " << stage.queued
+       << ", \"entered\": " << stage.entered << ", \"stalls\": " << stage.stalls << ", \"ms_total\": " << stage.msTotal << "}"
+       << (i + 1 < pipeline.size() ? "," : "") << "\n";
+  }
+  os << "  ],\n";
+  for(auto const &[name, pool]: {std::make_pair("chunk_pool", chunkPool), std::make_pair("mesh_buffers", meshBuffers)})
+    os << "  \"" << name << "\": {\"live\": " << pool.live << ", \"high_water\": " << pool.highWater << ", \"capacity\": "
+       << pool.capacity << ", \"heap_allocations\": " << pool.heapAllocations << "},\n";
+  if(governor) {
+    os << "  \"quality\": ";
+    governor->report(os);
+    os << ",\n";
+  }
+  os << "  \"far_terrain\": {\"tiles\": " << farTiles << ", \"triangles\": " << farTriangles << "},\n";
+  os << "  \"peak_memory_kb\": " << PeakMemoryKb() << "\n";
+  os << "}\n";
+}
+
+void PathRecorder::frame(glm::vec3 const &position) {
+  if(points.empty() || Length(position - points.back()) >= spacing)
+    points.push_back(position);
+}
+
+void PathRecorder::save(std::string const &file, long long const seed) const {
+  if(points.size() < 2) {
+    std::cerr << "Not enough points recorded to save path " << file << "\n";
+    return;
+  }
+
+  FlythroughPath path;
+  path.seed   = seed;
+  path.points = points;
+  std::ofstream of(file);
+  path.write(of);
+  std::cerr << "Saved " << points.size() << " point path to " << file << "\n";
+}
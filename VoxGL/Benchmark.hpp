@@ -0,0 +1,104 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "World.hpp"
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct QualityGovernor;
+
+// A camera path read from a path file. Each line is "name values", like Config.txt:
+//   seed 1337
+//   speed 30        (blocks per second along the path)
+//   settle 120      (max seconds to wait for worldgen before starting)
+//   output out.json (defaults to stdout)
+//   target 16.7     (frame time in ms for the quality governor to hold, 0 to leave quality alone)
+//   point x y z     (spline control points, at least two)
+struct FlythroughPath {
+  explicit FlythroughPath(std::string const &file);
+  FlythroughPath() = default;
+
+  // Position on the Catmull-Rom spline through the points, distance blocks from the start
+  glm::vec3 at(float distance) const;
+  float length() const { return arcLengths.empty() ? .0f : arcLengths.back(); }
+  void write(std::ostream &os) const;
+
+  std::string file;
+  std::vector<glm::vec3> points;
+  long long seed      = 0;
+  float speed         = 20.f;
+  float settleTimeout = 60.f;
+  float targetFrameMs = .0f;
+  std::string output;
+
+private:
+  void buildArcLengths();
+  glm::vec3 spline(float t) const;
+
+  std::vector<float> arcLengths;
+};
+
+struct FrameStats {
+  void add(float frameTimeMs) { frameTimes.push_back(frameTimeMs); }
+  // Nearest-rank percentile, p in [0, 100]
+  float percentile(float p) const;
+  float mean() const;
+  std::size_t countOver(float frameTimeMs) const;
+  std::size_t size() const { return frameTimes.size(); }
+
+private:
+  std::vector<float> frameTimes;
+  mutable std::vector<float> sorted;
+};
+
+// Peak resident set size of the process, in kilobytes
+std::size_t PeakMemoryKb();
+
+// Drives the camera along a FlythroughPath and collects frame statistics.
+struct Benchmark {
+  explicit Benchmark(FlythroughPath path);
+
+  // Updates the camera for this frame. Returns false once the path is done and the report has been written.
+  bool frame(World &world, glm::vec3 &position, float &lookX, float &lookZ);
+  void report(std::ostream &os) const;
+
+  FlythroughPath const path;
+  // Reported with the frames when the game runs one
+  QualityGovernor const *governor = nullptr;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  enum struct Phase {
+    Settling,
+    Running,
+    Done,
+  };
+
+  Phase phase = Phase::Settling;
+  FrameStats stats;
+  Clock::time_point phaseStart = Clock::now(), lastFrame;
+  float settleTime = .0f, runTime = .0f, travelled = .0f;
+  std::size_t chunksAtStart = 0, chunksStreamed = 0;
+  std::vector<LodRingStats> lodRings;
+  std::vector<StageStats> pipeline;
+  PoolStats chunkPool{}, meshBuffers{};
+  std::size_t farTiles = 0, farTriangles = 0;
+  bool timedOut = false;
+};
+
+// Records the camera position while flying around, for later replay with --benchmark
+struct PathRecorder {
+  void frame(glm::vec3 const &position);
+  void save(std::string const &file, long long seed) const;
+
+  std::vector<glm::vec3> points;
+  float spacing = 16.f;
+};
+
+// Headless microbenchmarks, run with --bench <name>, reporting JSON on stdout. Returns the process exit code.
+int RunMicrobenchmark(std::string const &name);
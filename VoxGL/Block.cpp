@@ -9,6 +9,8 @@
 #include "World.hpp"
 #include "Chunk.hpp"
 #include "Item.hpp"
+#include "BlockTicks.hpp"
+#include "Lighting.hpp"
 
 std::unordered_map<std::string, BlockHandle> StringToHandle;
 std::vector<BlockFactory> BlockFactoryHandles;
@@ -27,6 +29,24 @@ BlockHandle StoneHandle = RegisterBlockFactory("stone", [](BlockCoord x, BlockCo
 BlockHandle SandHandle = RegisterBlockFactory("sand", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
   return SandBlock{};
 });
+BlockHandle TorchHandle = RegisterBlockFactory("torch", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return TorchBlock{};
+});
+BlockHandle LogHandle = RegisterBlockFactory("log", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return LogBlock{};
+});
+BlockHandle LeavesHandle = RegisterBlockFactory("leaves", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return LeavesBlock{};
+});
+BlockHandle CoalOreHandle = RegisterBlockFactory("coal_ore", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return CoalOreBlock{};
+});
+BlockHandle WaterHandle = RegisterBlockFactory("water", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return WaterBlock{};
+});
+BlockHandle LavaHandle = RegisterBlockFactory("lava", [](BlockCoord x, BlockCoord y, BlockCoord z, World *w) {
+  return LavaBlock{};
+});
 
 namespace Textures {
   Texture NoTexture = Texture{ 0 };
@@ -35,6 +55,13 @@ namespace Textures {
   Texture Dirt      = Texture{ 3 };
   Texture Stone     = Texture{ 4 };
   Texture Sand      = Texture{ 5 };
+  Texture Water     = Texture{ 6 };
+  Texture Lava      = Texture{ 7 };
+  Texture Torch     = Texture{ 8 };
+  Texture LogSide   = Texture{ 9 };
+  Texture LogTop    = Texture{ 10 };
+  Texture Leaves    = Texture{ 11 };
+  Texture CoalOre   = Texture{ 12 };
 }
 
 template<BlockType Type>
@@ -47,7 +74,10 @@ template<BlockType Type>
 bool BasicBlock<Type>::isSolid() { return true; }
 
 template<BlockType Type>
-MeshData BasicBlock<Type>::getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) {
+std::uint8_t BasicBlock<Type>::lightEmission() { return Type == BlockType::Torch ? 14 : 0; }
+
+template<BlockType Type>
+FaceMesh BasicBlock<Type>::getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) {
   const auto texture = [&]() {
     if constexpr(Type == BlockType::Dirt)
       return BlockTexture{Textures::Dirt};
@@ -57,6 +87,14 @@ MeshData BasicBlock<Type>::getMesh(BlockCoord x, BlockCoord y, BlockCoord z, Blo
       return BlockTexture{Textures::Stone};
     else if constexpr(Type == BlockType::Sand)
       return BlockTexture{Textures::Sand};
+    else if constexpr(Type == BlockType::Torch)
+      return BlockTexture{Textures::Torch};
+    else if constexpr(Type == BlockType::Log)
+      return BlockTexture{Textures::LogTop, Textures::LogSide};
+    else if constexpr(Type == BlockType::Leaves)
+      return BlockTexture{Textures::Leaves};
+    else if constexpr(Type == BlockType::CoalOre)
+      return BlockTexture{Textures::CoalOre};
   }();
 
   auto textId = 0;
@@ -89,19 +127,98 @@ MeshData BasicBlock<Type>::getMesh(BlockCoord x, BlockCoord y, BlockCoord z, Blo
 
 template<BlockType Type>
 void BasicBlock<Type>::onBreak(World &game, BlockCoord x, BlockCoord y, BlockCoord z) {
-  game.addItem(std::make_unique<BlockItem<BasicBlock<Type>>>(), x, y, z);
+  auto const handle = [] {
+    if constexpr(Type == BlockType::Dirt)
+      return DirtHandle;
+    else if constexpr(Type == BlockType::Grass)
+      return GrassHandle;
+    else if constexpr(Type == BlockType::Stone)
+      return StoneHandle;
+    else if constexpr(Type == BlockType::Sand)
+      return SandHandle;
+    else if constexpr(Type == BlockType::Torch)
+      return TorchHandle;
+    else if constexpr(Type == BlockType::Log)
+      return LogHandle;
+    else if constexpr(Type == BlockType::Leaves)
+      return LeavesHandle;
+    else if constexpr(Type == BlockType::CoalOre)
+      return CoalOreHandle;
+  }();
+  game.addItem({handle, 1}, x, y, z);
+}
+
+template<BlockType Type>
+void BasicBlock<Type>::onTick(BlockTickContext &ctx, BlockCoord x, BlockCoord y, BlockCoord z) {
+  // Sand falls a block per tick, landing blocks wake up the one above so whole columns come down
+  if constexpr(Type == BlockType::Sand) {
+    if(ctx.isAir(x, y, z - 1)) {
+      ctx.setBlock(x, y, z, InvalidHandle);
+      ctx.setBlock(x, y, z - 1, SandHandle);
+    }
+  }
 }
 
+template<BlockType Type>
+void BasicBlock<Type>::onRandomTick(BlockTickContext &ctx, BlockCoord x, BlockCoord y, BlockCoord z) {
+  // Grass dies under solid blocks, and otherwise spreads to dirt around it with air above
+  if constexpr(Type == BlockType::Grass) {
+    if(auto const above = ctx.blockAt(x, y, z + 1); above && above->isSolid()) {
+      ctx.setBlock(x, y, z, DirtHandle);
+      return;
+    }
+    auto const r  = ctx.random();
+    auto const tx = x + static_cast<BlockCoord>(r % 3) - 1;
+    auto const ty = y + static_cast<BlockCoord>(r / 3 % 3) - 1;
+    auto const tz = z + static_cast<BlockCoord>(r / 9 % 3) - 1;
+    if(dynamic_cast<DirtBlock *>(ctx.blockAt(tx, ty, tz)) && ctx.isAir(tx, ty, tz + 1))
+      ctx.setBlock(tx, ty, tz, GrassHandle);
+  }
+}
+
+template<BlockType Type>
+FluidBlock<Type>::FluidBlock(std::uint8_t const level, bool const falling): level(level), falling(falling) { }
+
+template<BlockType Type>
+bool FluidBlock<Type>::isFluid() { return true; }
+
+template<BlockType Type>
+std::uint8_t FluidBlock<Type>::lightEmission() { return Type == BlockType::Lava ? MaxLight : 0; }
+
+template<BlockType Type>
+FaceMesh FluidBlock<Type>::getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) {
+  auto const texture = Type == BlockType::Lava ? Textures::Lava : Textures::Water;
+  auto meshData      = BasicBlockFaceMesh({x, y, z}, texture.id, blockSides);
+
+  // The surface drops with the distance from the source
+  auto const height = falling ? 1.f : 1.f - (level + 1.f) / (maxLevel + 2.f);
+  for(auto &vert: meshData.vertices)
+    if(vert.loc.z > z + .5f)
+      vert.loc.z = z + height;
+  return meshData;
+}
+
+template<BlockType Type>
+void FluidBlock<Type>::onBreak(World &, BlockCoord, BlockCoord, BlockCoord) { }
+
 void Block::remove(BlockCoord x, BlockCoord y, BlockCoord z, World &w) {
-  std::lock_guard<std::mutex> l(w.chunkMutex);
-  auto [bx, cx] = Chunk::decomposeBlockPos(x);
-  auto [by, cy] = Chunk::decomposeBlockPos(y);
-  auto [bz, cz] = Chunk::decomposeBlockPos(z);
-  auto c        = w.getChunk<true>(cx, cy, cz);
-  c->blocks[Chunk::blockPos(bx, by, bz)] = std::unique_ptr<Block>{};
+  if(auto const c = w.getChunkAtBlock<false>(x, y, z))
+    c->setBlockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                  Chunk::decomposeLocalBlockFromBlock(z), nullptr);
 }
 
 void Block::destroy(BlockCoord x, BlockCoord y, BlockCoord z, World &w) {
   // Remove block and spawn block item
   remove(x, y, z, w);
 }
+
+template struct BasicBlock<BlockType::Dirt>;
+template struct BasicBlock<BlockType::Grass>;
+template struct BasicBlock<BlockType::Stone>;
+template struct BasicBlock<BlockType::Sand>;
+template struct BasicBlock<BlockType::Torch>;
+template struct BasicBlock<BlockType::Log>;
+template struct BasicBlock<BlockType::Leaves>;
+template struct BasicBlock<BlockType::CoalOre>;
+template struct FluidBlock<BlockType::Water>;
+template struct FluidBlock<BlockType::Lava>;
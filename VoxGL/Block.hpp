@@ -3,6 +3,7 @@
 struct Game;
 struct World;
 struct BlockTexture;
+struct BlockTickContext;
 
 using BlockHandle = int;
 using BlockCoord = int;
@@ -12,23 +13,44 @@ extern BlockHandle DirtHandle;
 extern BlockHandle GrassHandle;
 extern BlockHandle StoneHandle;
 extern BlockHandle SandHandle;
+extern BlockHandle WaterHandle;
+extern BlockHandle LavaHandle;
+extern BlockHandle TorchHandle;
+extern BlockHandle LogHandle;
+extern BlockHandle LeavesHandle;
+extern BlockHandle CoalOreHandle;
 
 #include "BlockFaceMesh.hpp"
 #include "Mesh.hpp"
 
+#include <cstdint>
+
 enum struct BlockType {
   Dirt,
   Grass,
   Stone,
   Sand,
+  Water,
+  Lava,
+  Torch,
+  Log,
+  Leaves,
+  CoalOre,
 };
 
 struct Block {
   virtual bool isSolid() { return false; }
+  virtual bool isFluid() { return false; }
+  // Block light level the block gives off
+  virtual std::uint8_t lightEmission() { return 0; }
   virtual void remove(BlockCoord x, BlockCoord y, BlockCoord z, World &w);
   virtual void destroy(BlockCoord x, BlockCoord y, BlockCoord z, World &w);
-  virtual MeshData getMesh(int x, int y, int z, BlockSide blockSides) = 0;
+  virtual FaceMesh getMesh(int x, int y, int z, BlockSide blockSides) = 0;
   virtual void onBreak(World &, BlockCoord x, BlockCoord y, BlockCoord z) = 0;
+  // Scheduled ticks, after the block or one next to it changed or the block asked for one
+  virtual void onTick(BlockTickContext &, BlockCoord x, BlockCoord y, BlockCoord z) { }
+  // Blocks picked at random in every loaded chunk, a few per tick
+  virtual void onRandomTick(BlockTickContext &, BlockCoord x, BlockCoord y, BlockCoord z) { }
   virtual ~Block() = default;
 };
 
@@ -37,11 +59,38 @@ struct BasicBlock: public Block {
   BasicBlock();
   ~BasicBlock() final;
   bool isSolid() final;
-  MeshData getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) final;
+  std::uint8_t lightEmission() final;
+  FaceMesh getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) final;
   void onBreak(World &, BlockCoord x, BlockCoord y, BlockCoord z) final;
+  void onTick(BlockTickContext &, BlockCoord x, BlockCoord y, BlockCoord z) final;
+  void onRandomTick(BlockTickContext &, BlockCoord x, BlockCoord y, BlockCoord z) final;
 };
 
 using DirtBlock = BasicBlock<BlockType::Dirt>;
 using GrassBlock = BasicBlock<BlockType::Grass>;
 using StoneBlock = BasicBlock<BlockType::Stone>;
 using SandBlock = BasicBlock<BlockType::Sand>;
+using TorchBlock = BasicBlock<BlockType::Torch>;
+using LogBlock = BasicBlock<BlockType::Log>;
+using LeavesBlock = BasicBlock<BlockType::Leaves>;
+using CoalOreBlock = BasicBlock<BlockType::CoalOre>;
+
+// Water and lava, moved around by the fluid simulation. Level 0 is a source block, flowing fluid counts up
+// with the distance from where it came down, up to maxLevel.
+template<BlockType Type>
+struct FluidBlock: public Block {
+  static constexpr std::uint8_t maxLevel = Type == BlockType::Lava ? 3 : 7;
+
+  explicit FluidBlock(std::uint8_t level = 0, bool falling = false);
+  bool isFluid() final;
+  std::uint8_t lightEmission() final;
+  FaceMesh getMesh(BlockCoord x, BlockCoord y, BlockCoord z, BlockSide blockSides) final;
+  void onBreak(World &, BlockCoord x, BlockCoord y, BlockCoord z) final;
+
+  std::uint8_t level;
+  // Fluid pouring down from above, drawn full height
+  bool falling;
+};
+
+using WaterBlock = FluidBlock<BlockType::Water>;
+using LavaBlock = FluidBlock<BlockType::Lava>;
@@ -9,24 +9,20 @@ static MeshPoint::WorldPos const BackBottomRight{1, 1, 0};
 static MeshPoint::WorldPos const BackTopLeft{0, 1, 1};
 static MeshPoint::WorldPos const BackTopRight{1, 1, 1};
 
-static std::vector<MeshPoint::TextPos> const TexturePoints{
+static std::array<MeshPoint::TextPos, 4> const TexturePoints{{
   {1.0f / TextureLength, 1.0f / TextureLength}, {1.0f / TextureLength, 0}, {0, 0}, {0, 1.0f / TextureLength}
-};
-static std::vector<unsigned> const Indices{1, 2, 3, 3, 0, 1};
+}};
+static std::array<unsigned, 6> const Indices{1, 2, 3, 3, 0, 1};
 
-MeshData BasicBlockFaceMesh(glm::vec3 const at, int const textId, BlockSide const side) {
-  MeshData ret{{}, Indices};
+FaceMesh BasicBlockFaceMesh(glm::vec3 const at, int const textId, BlockSide const side) {
+  FaceMesh ret{{}, Indices};
   auto const idX = textId % TextureLength;
   auto const idY = textId / TextureLength;
 
   MeshPoint::TextPos const textOffset{static_cast<float>(idX) / TextureLength, static_cast<float>(idY) / TextureLength};
 
-  ret.vertices = {
-    {{}, TexturePoints[0] + textOffset},
-    {{}, TexturePoints[1] + textOffset},
-    {{}, TexturePoints[2] + textOffset},
-    {{}, TexturePoints[3] + textOffset}
-  };
+  for(std::size_t i = 0; i < ret.vertices.size(); ++i)
+    ret.vertices[i].textPoint = TexturePoints[i] + textOffset;
 
   switch(side) {
   case BlockSide::Front:
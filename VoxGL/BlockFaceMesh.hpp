@@ -3,6 +3,8 @@
 #include "Textures.hpp"
 #include "Mesh.hpp"
 
+#include <array>
+
 enum struct BlockSide {
 	None,
 	Top,
@@ -13,4 +15,10 @@ enum struct BlockSide {
 	Right
 };
 
-MeshData BasicBlockFaceMesh(glm::vec3 blockPosition, int textureID, BlockSide side);
+// One face of a block, a quad. Fixed size, so the mesher doesn't allocate for every face it adds.
+struct FaceMesh {
+  std::array<MeshPoint, 4> vertices;
+  std::array<unsigned, 6> indices;
+};
+
+FaceMesh BasicBlockFaceMesh(glm::vec3 blockPosition, int textureID, BlockSide side);
@@ -0,0 +1,250 @@
+#include "BlockTicks.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <tuple>
+
+void TickWheel::schedule(std::uint16_t const blockPos, std::uint64_t const due, std::uint64_t const now) {
+  place({std::max(due, now + 1), blockPos}, now);
+  ++count;
+}
+
+void TickWheel::place(Entry const &entry, std::uint64_t const now) {
+  if(entry.due - now < NumSlots)
+    near[entry.due & SlotMask].push_back(entry);
+  else if((entry.due >> SlotBits) - (now >> SlotBits) < NumSlots)
+    far[(entry.due >> SlotBits) & SlotMask].push_back(entry);
+  else
+    overflow.push_back(entry);
+}
+
+void TickWheel::advance(std::uint64_t const now, std::vector<std::uint16_t> &due) {
+  if(!count)
+    return;
+
+  if(!(now & SlotMask)) {
+    // Every full turn of the far wheel, whatever in the overflow now fits moves into the wheels
+    if(!((now >> SlotBits) & SlotMask) && !overflow.empty()) {
+      auto const waiting = std::move(overflow);
+      overflow.clear();
+      for(auto const &e: waiting)
+        place(e, now);
+    }
+
+    // The far slot for the 64 ticks starting now spreads over the near wheel
+    auto &slot = far[(now >> SlotBits) & SlotMask];
+    for(auto const &e: slot)
+      near[e.due & SlotMask].push_back(e);
+    slot.clear();
+  }
+
+  auto &slot = near[now & SlotMask];
+  for(auto const &e: slot)
+    due.push_back(e.blockPos);
+  count -= slot.size();
+  slot.clear();
+}
+
+static std::uint64_t SplitMix(std::uint64_t &state) {
+  auto z = (state += 0x9e3779b97f4a7c15ull);
+  z      = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z      = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+Chunk *BlockTickContext::chunkAt(BlockCoord const x, BlockCoord const y, BlockCoord const z, std::shared_ptr<Chunk> &keepAlive) {
+  if(z < 0)
+    return nullptr;
+
+  auto const dx = Chunk::decomposeChunkFromBlock(x) - chunk->cx;
+  auto const dy = Chunk::decomposeChunkFromBlock(y) - chunk->cy;
+  auto const dz = Chunk::decomposeChunkFromBlock(z) - chunk->cz;
+  if(!dx && !dy && !dz)
+    return chunk;
+
+  // Most ticks only look one block over, into a face neighbour, which is just a handle away
+  if(std::abs(dx) + std::abs(dy) + std::abs(dz) == 1)
+    return chunk->adjacent(dx ? (dx > 0 ? 0 : 1) : dy ? (dy > 0 ? 2 : 3) : (dz > 0 ? 4 : 5));
+  keepAlive = world->getChunkAtBlock<false>(x, y, z);
+  return keepAlive.get();
+}
+
+Block *BlockTickContext::blockAt(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  std::shared_ptr<Chunk> keepAlive;
+  auto const c = chunkAt(x, y, z, keepAlive);
+  if(!c)
+    return nullptr;
+  return c->blockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                    Chunk::decomposeLocalBlockFromBlock(z));
+}
+
+bool BlockTickContext::isLoaded(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  std::shared_ptr<Chunk> keepAlive;
+  return chunkAt(x, y, z, keepAlive) != nullptr;
+}
+
+void BlockTickContext::setBlock(BlockCoord const x, BlockCoord const y, BlockCoord const z, BlockHandle const block) {
+  writes.push_back({x, y, z, block, 0});
+}
+
+void BlockTickContext::schedule(BlockCoord const x, BlockCoord const y, BlockCoord const z, int const delay) {
+  writes.push_back({x, y, z, InvalidHandle, std::max(delay, 1)});
+}
+
+std::uint32_t BlockTickContext::random() { return static_cast<std::uint32_t>(SplitMix(rngState)); }
+
+void BlockTicks::update(World &world, float const dt) {
+  accumulator = std::min(accumulator + dt, MaxTicksPerUpdate / BlockTickRate);
+  while(accumulator >= 1.f / BlockTickRate) {
+    accumulator -= 1.f / BlockTickRate;
+    step(world);
+  }
+}
+
+void BlockTicks::schedule(World &world, BlockCoord const x, BlockCoord const y, BlockCoord const z, int const delay) {
+  auto const c = world.getChunkAtBlock<false>(x, y, z);
+  if(!c)
+    return;
+
+  auto const pos = Chunk::blockPos(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                                   Chunk::decomposeLocalBlockFromBlock(z));
+  std::lock_guard<std::mutex> lck(c->tickMutex);
+  c->tickWheel.schedule(static_cast<std::uint16_t>(pos), tick + std::max(delay, 1), tick);
+}
+
+void BlockTicks::step(World &world) {
+  auto const now = tick + 1;
+  // Ticks reach into neighbours through their handles
+  EpochGuard guard(world.slab);
+
+  // Chunks sorted by region, then position, fix the order writes are applied in
+  std::vector<std::pair<std::tuple<BlockCoord, BlockCoord, BlockCoord, BlockCoord, BlockCoord, BlockCoord>, std::shared_ptr<Chunk>>> sorted;
+  {
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    sorted.reserve(world.chunks.size());
+    world.chunks.forEach([&](std::shared_ptr<Chunk> const &c) {
+      auto const key = std::make_tuple(c->cz >> TickRegionBits, c->cy >> TickRegionBits, c->cx >> TickRegionBits, c->cz, c->cy, c->cx);
+      sorted.emplace_back(key, c);
+    });
+  }
+  std::sort(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+
+  // [begin, end) ranges of sorted, one per region
+  std::vector<std::pair<std::size_t, std::size_t>> regions;
+  for(std::size_t i = 0; i < sorted.size(); ++i) {
+    auto const sameRegion = !regions.empty() && std::get<0>(sorted[i].first) == std::get<0>(sorted[i - 1].first) &&
+                            std::get<1>(sorted[i].first) == std::get<1>(sorted[i - 1].first) &&
+                            std::get<2>(sorted[i].first) == std::get<2>(sorted[i - 1].first);
+    if(sameRegion)
+      regions.back().second = i + 1;
+    else
+      regions.emplace_back(i, i + 1);
+  }
+
+  std::vector<BlockTickContext> contexts(regions.size());
+  std::atomic<std::size_t> scheduledTicks = 0, randomTicks = 0;
+
+  auto const tickRegions = [&](std::size_t begin, std::size_t end) {
+    std::vector<std::uint16_t> due;
+    std::size_t scheduled = 0, random = 0;
+    for(auto r = begin; r < end; ++r) {
+      auto &ctx = contexts[r];
+      ctx.world = &world;
+      for(auto i = regions[r].first; i < regions[r].second; ++i) {
+        auto &c   = *sorted[i].second;
+        ctx.chunk = &c;
+        ctx.rngState = static_cast<std::uint64_t>(world.getSeed()) ^ (now * 0x2545f4914f6cdd1dull) ^ static_cast<std::uint64_t>(ChunkIndex(c.cx, c.cy, c.cz).repr);
+
+        due.clear();
+        {
+          std::lock_guard<std::mutex> lck(c.tickMutex);
+          c.tickWheel.advance(now, due);
+        }
+        // A block can be scheduled more than once for the same tick, it only ticks once
+        std::sort(due.begin(), due.end());
+        due.erase(std::unique(due.begin(), due.end()), due.end());
+
+        auto const tickAt = [&](std::uint16_t const pos, bool const isRandom) {
+          auto const bx = pos & ChunkBlockMask, by = (pos >> ChunkCoordBits) & ChunkBlockMask, bz = pos >> ChunkCoordBits * 2;
+          if(auto const b = c.blockAt(bx, by, bz)) {
+            if(isRandom)
+              b->onRandomTick(ctx, c.x + bx, c.y + by, c.z + bz);
+            else
+              b->onTick(ctx, c.x + bx, c.y + by, c.z + bz);
+          }
+        };
+
+        for(auto const pos: due)
+          tickAt(pos, false);
+        scheduled += due.size();
+
+        // Compressed chunks are out of the player's way, they sit still until something expands them
+        if(c.isEmpty() || c.isCompressed())
+          continue;
+        for(int n = 0; n < RandomTicksPerChunk; ++n)
+          tickAt(static_cast<std::uint16_t>(ctx.random() % (ChunkSize * ChunkSize * ChunkSize)), true);
+        random += RandomTicksPerChunk;
+      }
+    }
+    scheduledTicks += scheduled;
+    randomTicks += random;
+  };
+
+  auto const hardware = workers ? workers : static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency()));
+  auto const numWorkers = std::min(hardware, regions.size());
+  if(numWorkers <= 1)
+    tickRegions(0, regions.size());
+  else {
+    std::vector<std::future<void>> futs;
+    auto const perWorker = (regions.size() + numWorkers - 1) / numWorkers;
+    for(std::size_t begin = 0; begin < regions.size(); begin += perWorker)
+      futs.push_back(std::async(std::launch::async, tickRegions, begin, std::min(begin + perWorker, regions.size())));
+    for(auto &f: futs)
+      f.get();
+  }
+
+  // Everything scheduled from here on counts from this tick
+  tick = now;
+
+  std::vector<std::shared_ptr<Chunk>> remesh;
+  std::size_t writes = 0;
+  for(auto const &ctx: contexts)
+    for(auto const &w: ctx.writes) {
+      if(w.delay) {
+        schedule(world, w.x, w.y, w.z, w.delay);
+        continue;
+      }
+
+      auto c = world.getChunkAtBlock<false>(w.x, w.y, w.z);
+      if(!c)
+        continue;
+      auto const lx = Chunk::decomposeLocalBlockFromBlock(w.x), ly = Chunk::decomposeLocalBlockFromBlock(w.y),
+                 lz = Chunk::decomposeLocalBlockFromBlock(w.z);
+      c->setBlockAt(lx, ly, lz, CreateBlock(w.block, w.x, w.y, w.z, &world));
+      world.onBlockChanged(w.x, w.y, w.z);
+
+      for(auto &adjacent: c->adjacentTouching(lx, ly, lz))
+        remesh.push_back(std::move(adjacent));
+      remesh.push_back(std::move(c));
+
+      std::uint64_t h = totals.checksum ^ (static_cast<std::uint64_t>(w.x) << 40) ^ (static_cast<std::uint64_t>(w.y) << 20) ^
+                        static_cast<std::uint64_t>(w.z) ^ (static_cast<std::uint64_t>(w.block) << 60);
+      totals.checksum = SplitMix(h);
+      ++writes;
+    }
+
+  // Each touched chunk is remeshed once, however many of its blocks changed
+  for(auto &c: world.light.propagate(world))
+    remesh.push_back(std::move(c));
+  world.remesh(std::move(remesh));
+
+  ++totals.ticks;
+  totals.chunks = sorted.size();
+  totals.scheduledTicks += scheduledTicks;
+  totals.randomTicks += randomTicks;
+  totals.writes += writes;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Block.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct Chunk;
+struct World;
+
+constexpr float BlockTickRate = 20.f;
+// Ticks run at most this many times per update, so a slow frame can't snowball
+constexpr int MaxTicksPerUpdate = 4;
+// Random blocks ticked in each loaded chunk every tick
+constexpr int RandomTicksPerChunk = 3;
+// Chunks are handed to workers in cubes of 1 << TickRegionBits chunks on a side
+constexpr BlockCoord TickRegionBits = 2;
+
+// The scheduled ticks of one chunk, in a two level timing wheel. The near wheel has a slot per tick for the next
+// 64 ticks, the far wheel a slot per 64 ticks after that, and anything later waits in an overflow list.
+// Scheduling is O(1), and advancing only touches the slot due now plus a cascade every 64 ticks.
+struct TickWheel {
+  void schedule(std::uint16_t blockPos, std::uint64_t due, std::uint64_t now);
+  // Moves to tick now, which has to be one past the previous call, and appends the block positions due at it
+  void advance(std::uint64_t now, std::vector<std::uint16_t> &due);
+  std::size_t size() const { return count; }
+
+private:
+  static constexpr int SlotBits           = 6;
+  static constexpr std::uint64_t NumSlots = 1 << SlotBits;
+  static constexpr std::uint64_t SlotMask = NumSlots - 1;
+
+  struct Entry {
+    std::uint64_t due;
+    std::uint16_t blockPos;
+  };
+
+  void place(Entry const &entry, std::uint64_t now);
+
+  std::array<std::vector<Entry>, NumSlots> near, far;
+  std::vector<Entry> overflow;
+  std::size_t count = 0;
+};
+
+// What a block sees while ticking. Ticks only read the world and record what they want changed. The writes are
+// applied in a fixed order once every chunk has ticked, so the outcome doesn't depend on how chunks were spread
+// over threads. Coordinates are world block coordinates.
+struct BlockTickContext {
+  // The block at x, y, z, nullptr for air and unloaded blocks
+  Block *blockAt(BlockCoord x, BlockCoord y, BlockCoord z);
+  bool isLoaded(BlockCoord x, BlockCoord y, BlockCoord z);
+  bool isAir(BlockCoord x, BlockCoord y, BlockCoord z) { return isLoaded(x, y, z) && !blockAt(x, y, z); }
+
+  // Puts block at x, y, z once the tick is over, InvalidHandle clears it
+  void setBlock(BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle block);
+  // Ticks the block at x, y, z again delay ticks from now
+  void schedule(BlockCoord x, BlockCoord y, BlockCoord z, int delay);
+  // Deterministic for a given world seed, tick and chunk
+  std::uint32_t random();
+
+private:
+  friend struct BlockTicks;
+
+  // delay is 0 for block writes
+  struct Write {
+    BlockCoord x, y, z;
+    BlockHandle block;
+    int delay;
+  };
+
+  Chunk *chunkAt(BlockCoord x, BlockCoord y, BlockCoord z, std::shared_ptr<Chunk> &keepAlive);
+
+  World *world = nullptr;
+  Chunk *chunk = nullptr;
+  std::uint64_t rngState = 0;
+  std::vector<Write> writes;
+};
+
+struct BlockTickStats {
+  std::uint64_t ticks;
+  std::size_t chunks, scheduledTicks, randomTicks, writes;
+  // Hash of every write applied so far, equal between runs that changed the world the same way
+  std::uint64_t checksum;
+};
+
+// Runs scheduled and random block ticks over every loaded chunk at BlockTickRate
+struct BlockTicks {
+  // Runs the ticks that fall into dt seconds of real time
+  void update(World &world, float dt);
+  // Runs a single tick
+  void step(World &world);
+  // Ticks the block at x, y, z delay ticks from now. Call from the thread that runs the ticks.
+  void schedule(World &world, BlockCoord x, BlockCoord y, BlockCoord z, int delay);
+
+  BlockTickStats stats() const { return totals; }
+
+  // Worker threads per tick, 0 for one per hardware thread
+  std::size_t workers = 0;
+
+private:
+  std::uint64_t tick = 0;
+  float accumulator  = .0f;
+  BlockTickStats totals{};
+};
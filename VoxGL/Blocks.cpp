@@ -33,3 +33,14 @@ BlockHandle GetBlockHandle(std::string const &blockName) {
 
   return -1;
 }
+
+BlockHandle GetBlockHandle(BlockStorage const &block) {
+  // Every factory makes one type of block, the handle of each type is that of the factory making it
+  static auto const handles = [] {
+    std::vector<BlockHandle> byIndex(std::variant_size_v<BlockStorage>, InvalidHandle);
+    for(BlockHandle h = static_cast<BlockHandle>(BlockFactoryHandles.size()); h-- > 0;)
+      byIndex[CreateBlock(h, 0, 0, 0, nullptr).index()] = h;
+    return byIndex;
+  }();
+  return handles[block.index()];
+}
@@ -19,6 +19,12 @@ using BlockStorage = std::variant<
   , GrassBlock
   , StoneBlock
   , SandBlock
+  , TorchBlock
+  , LogBlock
+  , LeavesBlock
+  , CoalOreBlock
+  , WaterBlock
+  , LavaBlock
 >;
 
 using BlockFactory = std::function<BlockStorage(BlockCoord, BlockCoord, BlockCoord, World *)>;
@@ -35,3 +41,5 @@ BlockHandle RegisterBlockFactory(std::string const &&name, BlockFactory factory)
 BlockStorage CreateBlock(int factoryHandle, int x, int y, int z, World *);
 std::string const &GetBlockName(int blockHandle);
 BlockHandle GetBlockHandle(std::string const &blockName);
+// The handle of the factory that makes blocks like block, InvalidHandle for air
+BlockHandle GetBlockHandle(BlockStorage const &block);
@@ -2,13 +2,19 @@
 
 #include "BlockFaceMesh.hpp"
 #include "Blocks.hpp"
+#include "ChunkPool.hpp"
+#include "ChunkResidency.hpp"
 #include "Game.hpp"
 #include "World.hpp"
+#include "Worldgen.hpp"
 
 #include "Maths.hpp"
 #include "Util.hpp"
 
+#include <cassert>
 #include <future>
+#include <thread>
+#include <utility>
 
 float Chunk::getBlerpWorldgenVal(BlockCoord x, BlockCoord y, World *world, PerlinInstance instance) {
   auto const num = getPrecision(instance).first;
@@ -40,25 +46,173 @@ auto const BlockgenAt = [](BlockCoord x, BlockCoord y, BlockCoord z, World *worl
   return InvalidHandle;
 };
 
+static ChunkVoxels *NewVoxels(ChunkPool &pool) { return new(pool.allocate(sizeof(ChunkVoxels))) ChunkVoxels{}; }
+
+static void DeleteVoxels(ChunkPool &pool, ChunkVoxels *const voxels) {
+  voxels->~ChunkVoxels();
+  pool.deallocate(voxels, sizeof(ChunkVoxels));
+}
+
 Chunk::Chunk(BlockCoord const _x, BlockCoord const _y, BlockCoord const _z, World *world) : x(_x * ChunkSize), y(_y * ChunkSize), z(_z * ChunkSize), cx(_x),
-                                                                          cy(_y), cz(_z), w(*world) {
+                                                                          cy(_y), cz(_z), w(*world), voxelPool(world->voxelPool),
+                                                                          expanded(NewVoxels(*voxelPool)) {
+  auto &v        = *expanded.load();
+  expandedAt     = SteadyMillis();
+  auto const gen = w.columnGen(cx, cy);
+  std::array<float, ChunkSize> density;
+
   for(BlockCoord bx          = 0; bx < ChunkSize; ++bx) {
     for(BlockCoord by        = 0; by < ChunkSize; ++by) {
-      auto const height      = blockHeight(getBlerpWorldgenVal(x + bx, y + by, world, PerlinInstance::Height));
-      auto const temperature = getBlerpWorldgenVal(x + bx, y + by, world, PerlinInstance::Temperature);
+      auto const height      = gen->heights[bx + by * ChunkSize];
+      auto const temperature = gen->temperatures[bx + by * ChunkSize];
+      density.fill(1.f);
+      auto const caves = gen->caveDensity(bx, by, z, density);
 
       for(BlockCoord bz = 0; bz < ChunkSize; ++bz) {
         BlockHandle h   = BlockgenAt(x + bx, y + by, z + bz, &w, height, temperature);
-        if(h)
-          blocks[blockPos(bx, by, bz)] =
+        if(caves && density[bz] < CaveThreshold)
+          h = InvalidHandle;
+        // Caves stay below the surface, so everything above it sees the sky
+        if(z + bz > height)
+          v.light[blockPos(bx, by, bz)] = SetLight(0, LightChannel::Sky, MaxLight);
+        if(h) {
+          v.blocks[blockPos(bx, by, bz)] =
               CreateBlock(h, x + bx, y + by, z + bz, &w);
+          ++numBlocks;
+        }
       }
     }
   }
+  w.heights.addChunkColumn(cx, cy, gen->heights);
+}
+
+Chunk::Chunk(BlockCoord const _x, BlockCoord const _y, BlockCoord const _z, World *world, PackedVoxels packed) :
+  x(_x * ChunkSize), y(_y * ChunkSize), z(_z * ChunkSize), cx(_x), cy(_y), cz(_z), w(*world), voxelPool(world->voxelPool),
+  packed(std::move(packed)) {
+  numBlocks = static_cast<int>(PackedBlockCount(this->packed));
+  w.heights.addChunkColumn(cx, cy, w.columnGen(cx, cy)->heights);
+}
+
+Chunk::~Chunk() {
+  // Snapshots are gone with the chunk, nothing else holds a reference
+  if(auto const v = expanded.load(); v && !--v->refs)
+    DeleteVoxels(*voxelPool, v);
+}
+
+// Copies the voxels for a write, as the next version
+static void CopyVoxels(ChunkVoxels const &from, ChunkVoxels &to) {
+  for(std::size_t i = 0; i < ChunkVolume; ++i)
+    to.blocks[i] = std::visit(Overloaded{
+        [](std::unique_ptr<Block> const &ptr) -> BlockStorage {
+          assert(!ptr && "Blocks on the heap can't be copied");
+          return std::unique_ptr<Block>{};
+        }
+      , [](auto const &inlineBlock) -> BlockStorage { return inlineBlock; }
+    }, from.blocks[i]);
+  to.light   = from.light;
+  to.version = from.version + 1;
+}
+
+VoxelWrite::VoxelWrite(Chunk &chunk): chunk(chunk), lck(chunk.writeMutex), voxels(&chunk.voxels()) {
+  // Set before refs is looked at, so a snapshot counted after that sees it and tries again
+  chunk.writing = true;
+  if(voxels->refs.load() == 1) {
+    ++voxels->version;
+    return;
+  }
+
+  auto const copy = NewVoxels(*chunk.voxelPool);
+  CopyVoxels(*voxels, *copy);
+  chunk.expanded.store(copy);
+  chunk.releaseVoxels(voxels);
+  voxels = copy;
+  ++chunk.w.voxelCopies;
+}
+
+VoxelSnapshot::VoxelSnapshot(VoxelSnapshot &&other) noexcept
+    : chunk(std::exchange(other.chunk, nullptr)), voxels(std::exchange(other.voxels, nullptr)) { }
+
+VoxelSnapshot &VoxelSnapshot::operator=(VoxelSnapshot &&other) noexcept {
+  std::swap(chunk, other.chunk);
+  std::swap(voxels, other.voxels);
+  return *this;
+}
+
+VoxelSnapshot::~VoxelSnapshot() {
+  if(voxels)
+    chunk->releaseVoxels(voxels);
+}
+
+VoxelSnapshot Chunk::snapshot() {
+  // Keeps voxels replaced and released in the meantime from being freed before they're counted
+  EpochGuard guard(w.slab);
+  for(;;) {
+    auto &v   = voxels();
+    auto refs = v.refs.load();
+    // Voxels nothing refers to anymore are on their way out, they don't get a reference back
+    while(refs && !v.refs.compare_exchange_weak(refs, refs + 1))
+      ;
+    if(refs) {
+      // Counted before writing is looked at, so a write either saw the reference and copied, or is seen here
+      if(!writing && expanded.load() == &v)
+        return VoxelSnapshot(*this, v);
+      releaseVoxels(&v);
+    }
+    std::this_thread::yield();
+  }
+}
+
+void Chunk::releaseVoxels(ChunkVoxels *const v) {
+  // Readers of the live voxels may still be looking at them
+  if(!--v->refs)
+    w.slab.defer([pool = voxelPool, v] { DeleteVoxels(*pool, v); });
+}
+
+bool Chunk::compress() {
+  std::lock_guard<std::mutex> write(writeMutex);
+  std::lock_guard<std::mutex> lck(residencyMutex);
+  auto const v = expanded.load();
+  if(!v)
+    return false;
+
+  PackedVoxels p;
+  if(!PackVoxels(*v, p))
+    return false;
+  p.version = v->version;
+  packed    = std::move(p);
+  // Snapshots keep their reference to v
+  expanded.store(nullptr);
+  releaseVoxels(v);
+  return true;
+}
+
+ChunkVoxels &Chunk::expand() {
+  std::lock_guard<std::mutex> lck(residencyMutex);
+  if(auto const v = expanded.load())
+    return *v;
+
+  float elapsed;
+  ChunkVoxels *v;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    v = NewVoxels(*voxelPool);
+    UnpackVoxels(packed, *v);
+  }
+  v->version = packed.version;
+  packed     = {};
+  expandedAt = SteadyMillis();
+  expanded.store(v, std::memory_order_release);
+  w.residency.onExpanded(elapsed);
+  return *v;
+}
+
+std::size_t Chunk::packedBytes() {
+  std::lock_guard<std::mutex> lck(residencyMutex);
+  return packed.bytes();
 }
 
 Block *Chunk::blockAt(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
-  auto &blockVar = blocks[blockPos(x, y, z)];
+  auto &blockVar = voxels().blocks[blockPos(x, y, z)];
   return std::visit(Overloaded{
       [](std::unique_ptr<Block> &uptr) -> Block * { return uptr.get(); }
     , [](auto &inlineBlock)            -> Block * { return &inlineBlock; }
@@ -71,125 +225,325 @@ Block *Chunk::blockAtSafe(BlockCoord const x, BlockCoord const y, BlockCoord con
   return nullptr;
 }
 
-Block *Chunk::blockAtAdjacent(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
-  if(0 <= x && x < ChunkSize && 0 <= y && y < ChunkSize && 0 <= z &&
-     z < ChunkSize)
-    return blockAtSafe(x, y, z);
-  if(ChunkSize <= x) {
-    if(auto c = std::get<0>(adjacentChunks).lock())
-      return c->blockAtSafe(x - ChunkSize, y, z);
+const static auto AddFace = [](BlockCoord bx, BlockCoord by, BlockCoord bz, BlockSide face, Block *b, MeshData &meshData,
+                               BlockCoord scale = 1, float light = 1.f) {
+  auto md                 = b->getMesh(bx, by, bz, face);
+  auto const origin       = MeshPoint::WorldPos(bx, by, bz);
+
+  for(auto &ind: md.indices)
+    meshData.indices.push_back(static_cast<GLuint>(ind + meshData.vertices.size()));
+  for(auto &vert: md.vertices) {
+    if(scale != 1)
+      vert.loc = origin + (vert.loc - origin) * static_cast<float>(scale);
+    vert.light = light;
+    meshData.vertices.push_back(vert);
   }
-  else if(x < 0) {
-    if(auto c = std::get<1>(adjacentChunks).lock())
-      return c->blockAtSafe(x + ChunkSize, y, z);
+};
+
+// Faces are hidden behind solid blocks, and between fluids so a pool is drawn as one body
+static bool ShowsFace(Block *const b, Block *const neighbour) {
+  return !neighbour || !(neighbour->isSolid() || (b->isFluid() && neighbour->isFluid()));
+}
+
+// The block in storage. Snapshots are never written, but querying a block isn't const.
+static Block *BlockIn(BlockStorage const &storage) {
+  return std::visit(Overloaded{
+      [](std::unique_ptr<Block> const &uptr) -> Block * { return uptr.get(); }
+    , [](auto const &inlineBlock)            -> Block * { return const_cast<std::decay_t<decltype(inlineBlock)> *>(&inlineBlock); }
+  }, storage);
+}
+
+// What the mesher reads: snapshots of the chunk and its face neighbours, taken up front so edits made while it
+// meshes can't tear the mesh
+struct MeshSource {
+  explicit MeshSource(Chunk &chunk): chunk(chunk) {
+    for(std::size_t side = 0; side < 6; ++side)
+      if(auto const c = chunk.adjacent(side))
+        adjacent[side] = c->snapshot();
+    self = chunk.snapshot();
   }
-  else if(ChunkSize <= y) {
-    if(auto c = std::get<2>(adjacentChunks).lock())
-      return c->blockAtSafe(x, y - ChunkSize, z);
+
+  Block *blockAt(BlockCoord const x, BlockCoord const y, BlockCoord const z) const {
+    return BlockIn(self->blocks[Chunk::blockPos(x, y, z)]);
   }
-  else if(y < 0) {
-    if(auto c = std::get<3>(adjacentChunks).lock())
-      return c->blockAtSafe(x, y + ChunkSize, z);
+
+  // x, y, z relative to the chunk, in it or a face neighbour, nullptr where no neighbour is loaded
+  Block *blockAtAdjacent(BlockCoord const x, BlockCoord const y, BlockCoord const z) const {
+    if(0 <= x && x < ChunkSize && 0 <= y && y < ChunkSize && 0 <= z && z < ChunkSize)
+      return blockAt(x, y, z);
+    // Only face neighbours, the mesher never looks further
+    if((x < 0 || ChunkSize <= x) + (y < 0 || ChunkSize <= y) + (z < 0 || ChunkSize <= z) > 1)
+      return nullptr;
+    if(auto const &c = adjacent[sideOf(x, y, z)])
+      return BlockIn(c->blocks[Chunk::blockPos(x & ChunkBlockMask, y & ChunkBlockMask, z & ChunkBlockMask)]);
+    return nullptr;
   }
-  else if(ChunkSize <= z) {
-    if(auto c = std::get<4>(adjacentChunks).lock())
-      return c->blockAtSafe(x, y, z - ChunkSize);
+
+  // Packed light like blockAtAdjacent. Where no chunk is loaded, sky lit above the column's height.
+  std::uint8_t lightAtAdjacent(BlockCoord const x, BlockCoord const y, BlockCoord const z) const {
+    if(0 <= x && x < ChunkSize && 0 <= y && y < ChunkSize && 0 <= z && z < ChunkSize)
+      return self->light[Chunk::blockPos(x, y, z)];
+    if(auto const &c = adjacent[sideOf(x, y, z)])
+      return c->light[Chunk::blockPos(x & ChunkBlockMask, y & ChunkBlockMask, z & ChunkBlockMask)];
+    // Unloaded blocks are sky lit down to the top of their column, and everywhere in columns never loaded
+    auto const height = chunk.w.heights.heightAt(chunk.x + x, chunk.y + y);
+    return height == UnknownHeight || chunk.z + z > height ? SetLight(0, LightChannel::Sky, MaxLight) : 0;
   }
-  else if(z < 0 && this->cz) {
-    if(auto c = std::get<5>(adjacentChunks).lock())
-      return c->blockAtSafe(x, y, z + ChunkSize);
+
+  // Hashes everything the mesh at level depends on for the mesh cache: the chunk's blocks and those of its
+  // neighbours, and at full detail, which is lit, their light and the light the mesher makes up where there's no
+  // neighbour. A neighbour counts as a whole, whatever of it changes changes the key. False if there's a block
+  // that can't be packed.
+  bool key(int const level, std::uint64_t &hash) const {
+    std::uint64_t content[7];
+    if(!ContentHash(*self, content[6]))
+      return false;
+    for(std::size_t side = 0; side < 6; ++side)
+      if(adjacent[side] && !ContentHash(*adjacent[side], content[side]))
+        return false;
+      else if(!adjacent[side])
+        content[side] = 0;
+
+    std::uint32_t const header[] = {MeshCache::MesherVersion, static_cast<std::uint32_t>(level)};
+    hash = HashWords(content, sizeof(content), HashWords(header, sizeof(header)));
+    if(level)
+      return true;
+
+    std::array<std::uint8_t, ChunkSize * ChunkSize> light;
+    for(std::size_t side = 0; side < 6; ++side) {
+      if(adjacent[side])
+        continue;
+      auto const [dx, dy, dz] = Vdxyz[side];
+      // The layer just past the face, the face's other two axes across it
+      auto const along = [](BlockCoord const d, BlockCoord const a) { return d ? d > 0 ? ChunkSize : -1 : a; };
+      auto out         = light.begin();
+      for(BlockCoord a = 0; a < ChunkSize; ++a)
+        for(BlockCoord b = 0; b < ChunkSize; ++b)
+          *out++ = lightAtAdjacent(along(dx, a), along(dy, dx ? a : b), along(dz, b));
+      hash = HashWords(light.data(), sizeof(light), hash);
+    }
+    return true;
   }
 
-  return nullptr;
-}
+private:
+  // Hash of the blocks and light, worked out the first time it's needed for their version
+  static bool ContentHash(ChunkVoxels const &voxels, std::uint64_t &hash) {
+    if(voxels.hashedVersion.load(std::memory_order_acquire) == voxels.version) {
+      hash = voxels.contentHash.load(std::memory_order_relaxed);
+      return true;
+    }
 
-const static auto AddFace = [](BlockCoord bx, BlockCoord by, BlockCoord bz, BlockSide face, Block *b, MeshData &meshData) {
-  auto md                 = b->getMesh(bx, by, bz, face);
+    std::array<std::uint8_t, ChunkVolume> cells;
+    for(std::size_t i = 0; i < ChunkVolume; ++i)
+      if(std::uint32_t cell; PackCell(voxels.blocks[i], cell))
+        cells[i] = static_cast<std::uint8_t>(cell);
+      else
+        return false;
+    hash = HashWords(voxels.light.data(), sizeof(voxels.light), HashWords(cells.data(), sizeof(cells)));
 
-  for(auto &ind: md.indices)
-    meshData.indices.push_back(static_cast<GLuint>(ind + meshData.vertices.size()));
-  for(auto &vert: md.vertices)
-    meshData.vertices.push_back(vert);
+    // Snapshotted voxels aren't written, so everyone hashing them at once stores the same
+    voxels.contentHash.store(hash, std::memory_order_relaxed);
+    voxels.hashedVersion.store(voxels.version, std::memory_order_release);
+    return true;
+  }
+
+  static std::size_t sideOf(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+    return ChunkSize <= x ? 0 : x < 0 ? 1 : ChunkSize <= y ? 2 : y < 0 ? 3 : ChunkSize <= z ? 4 : 5;
+  }
+
+  Chunk &chunk;
+  VoxelSnapshot self;
+  std::array<VoxelSnapshot, 6> adjacent;
 };
 
 void Chunk::regenerateChunkMesh() {
-  auto meshData = std::make_unique<MeshData>();
+  if(!w.isMeshing())
+    return;
+  // Neighbours are looked at through their handles for the whole mesh
+  EpochGuard guard(w.slab);
+  MeshSource const source(*this);
+  auto const level = lod.load();
+
+  std::uint64_t key;
+  auto const cached = w.meshCache.isEnabled() && source.key(level, key);
+  auto meshData     = cached ? w.meshCache.load(cx, cy, cz, key, w.meshBuffers) : nullptr;
+  if(!meshData) {
+    meshData = buildMesh(source, level);
+    if(cached)
+      w.meshCache.store(cx, cy, cz, key, *meshData);
+  }
+  numTriangles = meshData->indices.size() / 3;
 
-  ForEachBlock([&](BlockCoord bx, BlockCoord by, BlockCoord bz) {
-    auto b = blockAtSafe(bx, by, bz);
+  // A mesh that never got uploaded before this one replaced it
+  std::unique_ptr<MeshData> replaced;
+  {
+    std::lock_guard<std::mutex> meshLock(chunkMeshMutex);
+    replaced = std::exchange(chunkMeshData, std::move(meshData));
+  }
+  w.meshBuffers.release(std::move(replaced));
+}
 
-    if(b) {
-      auto block = blockAtAdjacent(bx + 1, by, bz);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Right, b, *meshData);
+std::unique_ptr<MeshData> Chunk::buildMesh(MeshSource const &source, int const level) {
+  // Built in the largest buffers around, then copied into ones just big enough
+  auto scratch        = w.meshBuffers.acquireLargest();
+  auto const reserved = scratch->vertices.capacity();
+  float elapsed;
 
-      block = blockAtAdjacent(bx - 1, by, bz);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Left, b, *meshData);
+  {
+    TimedBlock<std::micro> timer(elapsed);
 
-      block = blockAtAdjacent(bx, by + 1, bz);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Back, b, *meshData);
+    if(level)
+      addDownsampledFaces(source, 1 << level, *scratch);
+    else ForEachBlock([&](BlockCoord bx, BlockCoord by, BlockCoord bz) {
+      auto b = source.blockAt(bx, by, bz);
 
-      block = blockAtAdjacent(bx, by - 1, bz);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Front, b, *meshData);
+      if(b) {
+        auto block = source.blockAtAdjacent(bx + 1, by, bz);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Right, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx + 1, by, bz)));
 
-      block = blockAtAdjacent(bx, by, bz + 1);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Top, b, *meshData);
+        block = source.blockAtAdjacent(bx - 1, by, bz);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Left, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx - 1, by, bz)));
 
-      block = blockAtAdjacent(bx, by, bz - 1);
-      if(!block || !block->isSolid())
-        AddFace(bx + x, by + y, bz + z, BlockSide::Bottom, b, *meshData);
-    }
-  });
+        block = source.blockAtAdjacent(bx, by + 1, bz);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Back, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx, by + 1, bz)));
+
+        block = source.blockAtAdjacent(bx, by - 1, bz);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Front, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx, by - 1, bz)));
+
+        block = source.blockAtAdjacent(bx, by, bz + 1);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Top, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx, by, bz + 1)));
+
+        block = source.blockAtAdjacent(bx, by, bz - 1);
+        if(ShowsFace(b, block))
+          AddFace(bx + x, by + y, bz + z, BlockSide::Bottom, b, *scratch, 1, LightBrightness(source.lightAtAdjacent(bx, by, bz - 1)));
+      }
+    });
+  }
 
-  std::lock_guard<std::mutex> meshLock(chunkMeshMutex);
-  chunkMeshData = std::move(meshData);
+  if(scratch->vertices.capacity() != reserved)
+    w.meshBuffers.onGrown();
+  auto meshData = w.meshBuffers.acquire(scratch->vertices.size());
+  meshData->vertices.assign(scratch->vertices.begin(), scratch->vertices.end());
+  meshData->indices.assign(scratch->indices.begin(), scratch->indices.end());
+  w.meshBuffers.release(std::move(scratch));
+
+  w.onChunkMeshed(level, elapsed);
+  return meshData;
+}
+
+// Meshes the chunk from scale^3 cells. A cell is drawn if any block in it is solid, so the coarse surface
+// never sits below the real one. Faces towards a neighbouring chunk are only culled if the neighbour's blocks
+// covering that cell are all solid, which leaves skirts that hide the cracks to neighbours at other LODs.
+void Chunk::addDownsampledFaces(MeshSource const &source, BlockCoord const scale, MeshData &meshData) {
+  auto const cells = ChunkSize / scale;
+
+  // Topmost solid block of the cell, or nullptr for an empty cell. Cells are at least 2 blocks wide.
+  std::array<Block *, ChunkSize * ChunkSize * ChunkSize / 8> cellBlocks{};
+  auto const cellPos = [cells](BlockCoord cx, BlockCoord cy, BlockCoord cz) { return cx + cells * (cy + cells * cz); };
+
+  for(BlockCoord cz = 0; cz < cells; ++cz)
+    for(BlockCoord cy = 0; cy < cells; ++cy)
+      for(BlockCoord cx = 0; cx < cells; ++cx) {
+        auto &cell = cellBlocks[cellPos(cx, cy, cz)];
+        for(BlockCoord bz = scale; bz-- && !cell;)
+          for(BlockCoord by = 0; by < scale && !cell; ++by)
+            for(BlockCoord bx = 0; bx < scale && !cell; ++bx)
+              if(auto b = source.blockAt(cx * scale + bx, cy * scale + by, cz * scale + bz); b && b->isSolid())
+                cell = b;
+      }
+
+  auto const occludes = [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(0 <= cx && cx < cells && 0 <= cy && cy < cells && 0 <= cz && cz < cells)
+      return cellBlocks[cellPos(cx, cy, cz)] != nullptr;
+
+    for(BlockCoord bz = 0; bz < scale; ++bz)
+      for(BlockCoord by = 0; by < scale; ++by)
+        for(BlockCoord bx = 0; bx < scale; ++bx)
+          if(auto b = source.blockAtAdjacent(cx * scale + bx, cy * scale + by, cz * scale + bz); !b || !b->isSolid())
+            return false;
+    return true;
+  };
+
+  for(BlockCoord cz = 0; cz < cells; ++cz)
+    for(BlockCoord cy = 0; cy < cells; ++cy)
+      for(BlockCoord cx = 0; cx < cells; ++cx) {
+        auto const b = cellBlocks[cellPos(cx, cy, cz)];
+        if(!b)
+          continue;
+
+        auto const bx = x + cx * scale, by = y + cy * scale, bz = z + cz * scale;
+        if(!occludes(cx + 1, cy, cz))
+          AddFace(bx, by, bz, BlockSide::Right, b, meshData, scale);
+        if(!occludes(cx - 1, cy, cz))
+          AddFace(bx, by, bz, BlockSide::Left, b, meshData, scale);
+        if(!occludes(cx, cy + 1, cz))
+          AddFace(bx, by, bz, BlockSide::Back, b, meshData, scale);
+        if(!occludes(cx, cy - 1, cz))
+          AddFace(bx, by, bz, BlockSide::Front, b, meshData, scale);
+        if(!occludes(cx, cy, cz + 1))
+          AddFace(bx, by, bz, BlockSide::Top, b, meshData, scale);
+        if(!occludes(cx, cy, cz - 1))
+          AddFace(bx, by, bz, BlockSide::Bottom, b, meshData, scale);
+      }
 }
 
 void Chunk::draw(float deltaT, const glm::vec3 &worldPos) {
   if(chunkMeshData) {
     std::lock_guard<std::mutex> lck(chunkMeshMutex);
     chunkMesh = std::make_unique<Mesh>(chunkMeshData->vertices, chunkMeshData->indices);
-    chunkMeshData.reset();
+    w.meshBuffers.release(std::move(chunkMeshData));
   }
 
   if(chunkMesh)
     chunkMesh->draw();
 }
 
-void Chunk::onAdjacentChunkLoad(BlockCoord const relX, BlockCoord const relY, BlockCoord const relZ, std::weak_ptr<Chunk> const &wp) {
+void Chunk::releaseMesh() {
+  std::lock_guard<std::mutex> lck(chunkMeshMutex);
+  chunkMesh.reset();
+  w.meshBuffers.release(std::move(chunkMeshData));
+}
+
+void Chunk::onAdjacentChunkLoad(BlockCoord const relX, BlockCoord const relY, BlockCoord const relZ, ChunkHandle const chunk) {
   if(relX == 1)
-    std::get<0>(adjacentChunks) = wp;
+    std::get<0>(adjacentChunks) = chunk;
   else if(relX == -1)
-    std::get<1>(adjacentChunks) = wp;
+    std::get<1>(adjacentChunks) = chunk;
   else if(relY == 1)
-    std::get<2>(adjacentChunks) = wp;
+    std::get<2>(adjacentChunks) = chunk;
   else if(relY == -1)
-    std::get<3>(adjacentChunks) = wp;
+    std::get<3>(adjacentChunks) = chunk;
   else if(relZ == 1)
-    std::get<4>(adjacentChunks) = wp;
+    std::get<4>(adjacentChunks) = chunk;
   else if(relZ == -1)
-    std::get<5>(adjacentChunks) = wp;
-
-  if (auto const nAdjacent =
-      std::count_if(std::begin(adjacentChunks),
-                    std::end  (adjacentChunks),
-                    [](auto ptr) {
-                      return !ptr.expired();
-                    });
-      nAdjacent == 6ull - !z)
+    std::get<5>(adjacentChunks) = chunk;
+
+  // Only chunks the pipeline already meshed, the rest are meshed once their neighbours are lit
+  if(isMeshed() && hasAllAdjacent())
     regenerateChunkMesh();
 }
 
+bool Chunk::hasAllAdjacent() const {
+  auto const nAdjacent = std::count_if(std::begin(adjacentChunks),
+                                       std::end  (adjacentChunks),
+                                       [&](ChunkHandle const &handle) {
+                                         return w.slab.get(handle) != nullptr;
+                                       });
+  return nAdjacent == 6ll - !z;
+}
+
 std::vector<std::shared_ptr<Chunk>> Chunk::getAdjacentChunks() {
   std::vector<std::shared_ptr<Chunk>> result;
 
-  for(auto &chunk: adjacentChunks)
-    if(auto sharedChunk = chunk.lock())
-      result.push_back(std::move(sharedChunk));
+  EpochGuard guard(w.slab);
+  for(std::size_t side = 0; side < adjacentChunks.size(); ++side)
+    if(auto chunk = adjacent(side))
+      result.push_back(chunk->shared_from_this());
 
   return result;
 }
@@ -198,43 +552,62 @@ int Chunk::blockPos(BlockCoord const x, BlockCoord const y, BlockCoord const z)
   return x + (y << ChunkCoordBits) + (z << ChunkCoordBits * 2);
 }
 
-void Chunk::reloadAdjacent(BlockCoord x, BlockCoord y, BlockCoord z) {
-  if (x == ChunkSize - 1) {
-    if (auto c = std::get<0>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
-  if (x == 0) {
-    if (auto c = std::get<1>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
-  if (y == ChunkSize - 1) {
-    if (auto c = std::get<2>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
-  if (y == 0) {
-    if (auto c = std::get<3>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
-  if (z == ChunkSize - 1) {
-    if (auto c = std::get<4>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
-  if (z == 0) {
-    if (auto c = std::get<5>(adjacentChunks).lock())
-      c->regenerateChunkMesh();
-  }
+std::vector<std::shared_ptr<Chunk>> Chunk::adjacentTouching(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  std::vector<std::shared_ptr<Chunk>> result;
+  EpochGuard guard(w.slab);
+  auto const add = [&](bool const touching, std::size_t const side) {
+    if(touching)
+      if(auto c = adjacent(side))
+        result.push_back(c->shared_from_this());
+  };
+  add(x == ChunkSize - 1, 0);
+  add(x == 0, 1);
+  add(y == ChunkSize - 1, 2);
+  add(y == 0, 3);
+  add(z == ChunkSize - 1, 4);
+  add(z == 0, 5);
+  return result;
+}
+
+void Chunk::reloadAdjacent(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  for(auto &c: adjacentTouching(x, y, z))
+    c->regenerateChunkMesh();
 }
 
 void Chunk::removeBlockAt(BlockCoord const _x, BlockCoord const _y, BlockCoord const _z) {
-  blockAt(_x, _y, _z)->remove(x + _x, y + _y, z + _z, w);
-  blocks[blockPos(_x, _y, _z)] = nullptr;
-  regenerateChunkMesh();
-  reloadAdjacent(x, y, z);
+  if(!blockAt(_x, _y, _z))
+    return;
+  w.journal.append({x + _x, y + _y, z + _z, GetBlockHandle(voxels().blocks[blockPos(_x, _y, _z)]), InvalidHandle});
+  setBlockAt(_x, _y, _z, nullptr);
+  w.onBlockChanged(x + _x, y + _y, z + _z);
+
+  // This chunk, the neighbours showing the block and wherever the light changed, each remeshed once
+  auto remesh = w.light.propagate(w);
+  remesh.push_back(w.getChunk<false>(cx, cy, cz));
+  for(auto &c: adjacentTouching(_x, _y, _z))
+    remesh.push_back(std::move(c));
+  w.remesh(std::move(remesh));
+}
+
+void Chunk::addBlockAt(BlockCoord const _x, BlockCoord const _y, BlockCoord const _z, BlockStorage block) {
+  w.journal.append({x + _x, y + _y, z + _z, GetBlockHandle(voxels().blocks[blockPos(_x, _y, _z)]), GetBlockHandle(block)});
+  setBlockAt(_x, _y, _z, std::move(block));
+  w.onBlockChanged(x + _x, y + _y, z + _z);
+
+  // This chunk, the neighbours showing the block and wherever the light changed, each remeshed once
+  auto remesh = w.light.propagate(w);
+  remesh.push_back(w.getChunk<false>(cx, cy, cz));
+  for(auto &c: adjacentTouching(_x, _y, _z))
+    remesh.push_back(std::move(c));
+  w.remesh(std::move(remesh));
 }
 
-void Chunk::addBlockAt(BlockCoord x, BlockCoord y, BlockCoord z, BlockStorage block) {
-  auto const bp = blockPos(x, y, z);
-  blocks[bp] = std::move(block);
-  regenerateChunkMesh();
-  reloadAdjacent(x, y, z);
+void Chunk::setBlockAt(BlockCoord const _x, BlockCoord const _y, BlockCoord const _z, BlockStorage block) {
+  auto const had = blockAt(_x, _y, _z) != nullptr;
+  VoxelWrite(*this)->blocks[blockPos(_x, _y, _z)] = std::move(block);
+  auto const has = blockAt(_x, _y, _z) != nullptr;
+  numBlocks += has - had;
+  if(has != had)
+    w.heights.onBlockSet(w, x + _x, y + _y, z + _z, has);
+  w.onBlockSet(*this, x + _x, y + _y, z + _z);
 }
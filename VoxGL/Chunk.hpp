@@ -1,17 +1,73 @@
 #pragma once
 
 #include "Blocks.hpp"
+#include "BlockTicks.hpp"
+#include "ChunkChangeLog.hpp"
+#include "ChunkPipeline.hpp"
+#include "ChunkSlab.hpp"
+#include "Decoration.hpp"
+#include "Lighting.hpp"
 
 #include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 constexpr BlockCoord ChunkCoordBits = 4;
 constexpr BlockCoord ChunkSize      = 1 << ChunkCoordBits;
 constexpr BlockCoord ChunkBlockMask = ChunkSize - 1;
 constexpr BlockCoord ChunkLocMask   = ~ChunkBlockMask;
+constexpr std::size_t ChunkVolume   = ChunkSize * ChunkSize * ChunkSize;
+
+// Blocks and light of a chunk, allocated apart from it so a cold chunk can let go of them. A version of them
+// that snapshots refer to is never written again, writes go to a copy that becomes the chunk's current one.
+struct ChunkVoxels {
+  std::array<BlockStorage, ChunkVolume> blocks;
+  // Sky and block light of every block, packed into a byte by SetLight, indexed like blocks
+  std::array<std::uint8_t, ChunkVolume> light{};
+  // One for the chunk while these are its current voxels, and one per snapshot
+  std::atomic<int> refs{1};
+  // Counts the writes to the chunk, carried over into copies
+  std::uint32_t version = 0;
+  // Hash of the blocks and light for the mesh cache, worked out once per version by whoever snapshots them first
+  mutable std::atomic<std::uint64_t> contentHash{0};
+  mutable std::atomic<std::uint32_t> hashedVersion{~0u};
+};
+
+// A cold chunk's voxels as runs in blockPos order, the value in the low byte of a run and its length above it
+struct PackedVoxels {
+  std::vector<std::uint32_t> blocks, light;
+  std::uint32_t version = 0;
+  std::size_t bytes() const { return (blocks.size() + light.size()) * sizeof(std::uint32_t); }
+};
+
+struct Chunk;
+
+// A chunk's voxels as they were when it was taken. Writes made meanwhile go to a copy, so the snapshot never
+// changes under its reader and can be read without locks from any thread. The chunk has to outlive it.
+struct VoxelSnapshot {
+  VoxelSnapshot() = default;
+  VoxelSnapshot(VoxelSnapshot &&other) noexcept;
+  VoxelSnapshot &operator=(VoxelSnapshot &&other) noexcept;
+  ~VoxelSnapshot();
+
+  explicit operator bool() const { return voxels; }
+  ChunkVoxels const &operator*() const { return *voxels; }
+  ChunkVoxels const *operator->() const { return voxels; }
+
+private:
+  friend struct Chunk;
+  VoxelSnapshot(Chunk &chunk, ChunkVoxels &voxels): chunk(&chunk), voxels(&voxels) { }
+
+  Chunk *chunk         = nullptr;
+  ChunkVoxels *voxels  = nullptr;
+};
+
+struct MeshSource;
 
 struct World;
+struct ChunkPool;
 enum struct PerlinInstance;
 
 auto const static ForEachBlock = [](auto callable) {
@@ -21,10 +77,12 @@ auto const static ForEachBlock = [](auto callable) {
         callable(x, y, z);
 };
 
-struct Chunk {
+struct Chunk : std::enable_shared_from_this<Chunk> {
   // Construct a chunk with the chunk coordinates x, y, z
   Chunk(BlockCoord x, BlockCoord y, BlockCoord z, World *);
-  Chunk(BlockCoord x, BlockCoord y, BlockCoord z, World *, std::istream &is);
+  // A stored chunk, starting out compressed
+  Chunk(BlockCoord x, BlockCoord y, BlockCoord z, World *, PackedVoxels packed);
+  ~Chunk();
 
   // x, y, z, relative to chunk, Returns block inside the chunk. No chunk bounds check, use for fast access and that only.
   Block *blockAt(BlockCoord x, BlockCoord y, BlockCoord z);
@@ -35,16 +93,21 @@ struct Chunk {
   // x, y, z, relative to the chunk. If not inside the chunk, it will use World * and ask it for the block.
   template<bool AlreadyHasMutex>
   Block *blockAtExternal(BlockCoord x, BlockCoord y, BlockCoord z);
-  Block *blockAtAdjacent(BlockCoord x, BlockCoord y, BlockCoord z);
 
-  // Regenerates the mesh for the chunk. x, y, z are chunk coordinates (not block coordinates)
+  // Regenerates the mesh for the chunk at its current level of detail, from snapshots of it and its neighbours
   void regenerateChunkMesh();
 
   // Draws the chunk mesh
   void draw(float deltaT, glm::vec3 const &pos);
+  // Frees the mesh once the chunk is unloaded, on the render thread
+  void releaseMesh();
 
-  void onAdjacentChunkLoad(BlockCoord relX, BlockCoord relY, BlockCoord relZ, std::weak_ptr<Chunk> const &chunk);
+  void onAdjacentChunkLoad(BlockCoord relX, BlockCoord relY, BlockCoord relZ, ChunkHandle chunk);
+  // The face neighbour on side, in Vdxyz order, or nullptr if it isn't loaded. Call under an EpochGuard.
+  Chunk *adjacent(std::size_t side) const;
   std::vector<std::shared_ptr<Chunk>> getAdjacentChunks();
+  // Whether every neighbour the mesher looks at is loaded
+  bool hasAllAdjacent() const;
 
   static constexpr BlockCoord decomposeLocalBlockFromBlock(BlockCoord bc);
   static constexpr BlockCoord decomposeChunkFromBlock(BlockCoord bc);
@@ -54,25 +117,110 @@ struct Chunk {
   static float getBlerpWorldgenVal(BlockCoord x, BlockCoord y, World *world, PerlinInstance instance);
   static constexpr BlockCoord blockHeight(float height);
 
+  // Loaded neighbours whose mesh shows the block at x, y, z relative to the chunk
+  std::vector<std::shared_ptr<Chunk>> adjacentTouching(BlockCoord x, BlockCoord y, BlockCoord z);
   void reloadAdjacent(BlockCoord x, BlockCoord y, BlockCoord z);
 
   void removeBlockAt(BlockCoord x, BlockCoord y, BlockCoord z);
   void addBlockAt(BlockCoord x, BlockCoord y, BlockCoord z, BlockStorage block);
+  // Replaces the block without remeshing or waking up neighbours, for batched edits
+  void setBlockAt(BlockCoord x, BlockCoord y, BlockCoord z, BlockStorage block);
 
   std::ostream &operator<<(std::ostream &os);
 
-  std::array<BlockStorage, ChunkSize * ChunkSize * ChunkSize> blocks;
-  std::array<std::weak_ptr<Chunk>, 6> adjacentChunks;
+  // Blocks and light, expanded again first if the chunk is compressed. This is the live version, which writes can
+  // change under a reader on another thread; references into it stay valid while an EpochGuard is held, or for as
+  // long as the chunk stays hot. Write through a VoxelWrite.
+  ChunkVoxels &voxels() {
+    auto const v = expanded.load(std::memory_order_acquire);
+    return v ? *v : expand();
+  }
+  bool isCompressed() const { return !expanded.load(std::memory_order_relaxed); }
+  // A consistent view of the voxels for a background reader, one that writers don't wait for
+  VoxelSnapshot snapshot();
+  // Packs the voxels and lets go of them once no reader or snapshot can still see them. False if there's a
+  // block that can't be packed.
+  bool compress();
+  // Size of the packed voxels, 0 while expanded
+  std::size_t packedBytes();
+  // When the voxels were last expanded, in steady clock milliseconds
+  std::atomic<long long> expandedAt{0};
+
+  // Handles of the face neighbours in Vdxyz order, stale once they unload
+  std::array<ChunkHandle, 6> adjacentChunks;
+  // This chunk's own handle, while it's in the world
+  ChunkHandle handle;
 
   std::mutex chunkMeshMutex;
 
+  // Number of non-empty blocks, so queries can skip empty chunks without looking at them
+  std::atomic<int> numBlocks = 0;
+  bool isEmpty() const { return !numBlocks; }
+
+  // Level of detail the chunk is meshed at, mesh cells are 1 << lod blocks wide
+  std::atomic<int> lod = 0;
+  std::atomic<std::size_t> numTriangles = 0;
+
+  // Moved along by the world's ChunkPipeline
+  std::atomic<ChunkStage> stage{ChunkStage::Terrain};
+  // Whether the pipeline meshed the chunk, so edits should remesh it
+  bool isMeshed() const {
+    auto const s = stage.load();
+    return s == ChunkStage::Meshed || s == ChunkStage::Uploaded;
+  }
+
+  // Ticks blocks in this chunk asked for
+  TickWheel tickWheel;
+  std::mutex tickMutex;
+
+  // Cells set since the chunk was lit, in worlds that track changes
+  ChunkChangeLog changes;
+
+  // Cells placed by decoration features, indexed like blocks
+  std::unordered_map<std::uint16_t, DecoratedCell> decoratedCells;
+  std::mutex decorationMutex;
+
   BlockCoord x, y, z, cx, cy, cz;
   World &w;
 private:
+  friend struct VoxelWrite;
+  friend struct VoxelSnapshot;
+
+  // Meshes the chunk at level in buffers from the world's pool
+  std::unique_ptr<MeshData> buildMesh(MeshSource const &source, int level);
+  void addDownsampledFaces(MeshSource const &source, BlockCoord scale, MeshData &meshData);
+  ChunkVoxels &expand();
+  // Drops a reference to voxels, freeing them once no reader can see them anymore if it was the last
+  void releaseVoxels(ChunkVoxels *voxels);
+
+  std::shared_ptr<ChunkPool> voxelPool;
+  std::atomic<ChunkVoxels *> expanded{nullptr};
+  PackedVoxels packed;
+  std::mutex residencyMutex;
+  // Writers take turns, and tell snapshots taken meanwhile to try again
+  std::mutex writeMutex;
+  std::atomic<bool> writing{false};
+
   std::unique_ptr<Mesh> chunkMesh;
   std::unique_ptr<MeshData> chunkMeshData;
 };
 
+// Writes to a chunk's voxels, in place unless a snapshot refers to them, in which case to a copy the chunk moves
+// on to. Other writes to the chunk wait for it, compressions too; snapshots don't hold it up.
+struct VoxelWrite {
+  explicit VoxelWrite(Chunk &chunk);
+  ~VoxelWrite() { chunk.writing = false; }
+  VoxelWrite(VoxelWrite const &) = delete;
+  VoxelWrite &operator=(VoxelWrite const &) = delete;
+
+  ChunkVoxels *operator->() const { return voxels; }
+
+private:
+  Chunk &chunk;
+  std::lock_guard<std::mutex> lck;
+  ChunkVoxels *voxels;
+};
+
 #include "World.hpp"
 
 template<bool AlreadyHasMutex>
@@ -82,6 +230,8 @@ Block *Chunk::blockAtExternal(BlockCoord _x, BlockCoord _y, BlockCoord _z) {
   return w.blockAt<AlreadyHasMutex>(_x + x, _y + y, _z + z);
 }
 
+inline Chunk *Chunk::adjacent(std::size_t const side) const { return w.slab.get(adjacentChunks[side]); }
+
 constexpr BlockCoord Chunk::decomposeLocalBlockFromBlock(BlockCoord const bc) { return bc & ChunkBlockMask; }
 
 constexpr BlockCoord Chunk::decomposeChunkFromBlock(BlockCoord const bc) { return (bc & ChunkLocMask) >> ChunkCoordBits; }
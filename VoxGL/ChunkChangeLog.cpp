@@ -0,0 +1,36 @@
+#include "ChunkChangeLog.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+static std::atomic<std::uint32_t> Incarnations{0};
+
+ChunkChangeLog::ChunkChangeLog(): incarnation(++Incarnations) { }
+
+void ChunkChangeLog::record(std::uint16_t const cell) {
+  std::lock_guard<std::mutex> lck(mutex);
+  // Drops the older half at once, so a busy chunk doesn't shift the log on every change
+  if(cells.size() == Capacity) {
+    cells.erase(cells.begin(), cells.begin() + Capacity / 2);
+    dropped += Capacity / 2;
+  }
+  cells.push_back(cell);
+}
+
+std::uint64_t ChunkChangeLog::version() const {
+  std::lock_guard<std::mutex> lck(mutex);
+  return static_cast<std::uint64_t>(incarnation) << 32 | (dropped + static_cast<std::uint32_t>(cells.size()));
+}
+
+bool ChunkChangeLog::since(std::uint64_t const from, std::vector<std::uint16_t> &out, std::uint64_t &to) const {
+  out.clear();
+  std::lock_guard<std::mutex> lck(mutex);
+  auto const count = static_cast<std::uint32_t>(from);
+  if(from >> 32 != incarnation || count < dropped || count > dropped + cells.size())
+    return false;
+  out.assign(cells.begin() + (count - dropped), cells.end());
+  to = static_cast<std::uint64_t>(incarnation) << 32 | (dropped + static_cast<std::uint32_t>(cells.size()));
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// The cells of a chunk that had their block or light set, in order, so a peer that has the chunk as of some version
+// can be sent only what changed since. A version is the log's incarnation in the high half, unique to this run of
+// the chunk so a chunk unloaded and loaded again never takes a version for one of the old chunk's, and the number
+// of changes logged in the low half.
+//
+// Only the last Capacity changes are kept; a peer older than that gets the whole chunk again.
+struct ChunkChangeLog {
+  static constexpr std::size_t Capacity = 8192;
+
+  ChunkChangeLog();
+
+  void record(std::uint16_t cell);
+  std::uint64_t version() const;
+  // The cells changed after version from, each once in ascending order, and the version that brings a peer to.
+  // False if from isn't a version of this log or is older than what it keeps.
+  bool since(std::uint64_t from, std::vector<std::uint16_t> &cells, std::uint64_t &to) const;
+
+private:
+  mutable std::mutex mutex;
+  std::uint32_t const incarnation;
+  // Changes, the first of which made version dropped + 1
+  std::vector<std::uint16_t> cells;
+  std::uint32_t dropped = 0;
+};
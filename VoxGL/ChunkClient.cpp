@@ -0,0 +1,184 @@
+#include "ChunkClient.hpp"
+
+#include <algorithm>
+
+static long long KeyOf(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) { return ChunkIndex(cx, cy, cz).repr; }
+
+static std::uint64_t BlockKey(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  return static_cast<std::uint64_t>(static_cast<std::uint32_t>(x) & 0x1fffff) | static_cast<std::uint64_t>(static_cast<std::uint32_t>(y) & 0x1fffff) << 21 |
+         static_cast<std::uint64_t>(static_cast<std::uint32_t>(z) & 0x1fffff) << 42;
+}
+
+template<std::size_t N>
+static void FillRuns(std::vector<std::uint32_t> const &runs, std::array<std::uint8_t, N> &values) {
+  std::size_t i = 0;
+  for(auto const run: runs) {
+    std::fill_n(values.begin() + static_cast<std::ptrdiff_t>(i), run >> 8, static_cast<std::uint8_t>(run & 0xff));
+    i += run >> 8;
+  }
+}
+
+void ApplyDelta(ChunkDelta const &delta, ClientChunk &chunk) {
+  for(std::size_t i = 0; i < delta.cells.size(); ++i) {
+    chunk.cells[delta.cells[i]] = delta.blocks[i];
+    chunk.light[delta.cells[i]] = delta.light[i];
+  }
+  chunk.version = delta.to;
+}
+
+bool ChunkClient::connect(std::string const &host, unsigned short const port, float const radius, int const timeoutMs) {
+  auto socket = std::make_unique<sf::TcpSocket>();
+  if(socket->connect(sf::IpAddress(host), port, sf::milliseconds(timeoutMs)) != sf::Socket::Done)
+    return false;
+  connection = std::make_unique<NetConnection>(std::move(socket));
+  welcomed   = false;
+  NetWriter hello;
+  hello.u32(NetProtocolVersion);
+  hello.f32(radius);
+  connection->send(NetMessage::Hello, hello);
+  return connection->flush();
+}
+
+bool ChunkClient::update() {
+  if(!connection)
+    return false;
+  connection->receive([&](NetMessage const type, NetReader &reader) { return handle(type, reader); });
+  return connection->flush();
+}
+
+void ChunkClient::moveTo(glm::vec3 const &position) {
+  this->position = position;
+  if(!connection)
+    return;
+  NetWriter message;
+  message.f32(position.x);
+  message.f32(position.y);
+  message.f32(position.z);
+  connection->send(NetMessage::Position, message);
+}
+
+void ChunkClient::requestChanges(ClientChunk const &chunk) {
+  if(!connection)
+    return;
+  NetWriter message;
+  message.svarint(chunk.position.x);
+  message.svarint(chunk.position.y);
+  message.svarint(chunk.position.z);
+  message.version(chunk.version);
+  connection->send(NetMessage::Resync, message);
+  ++resyncsSent;
+}
+
+void ChunkClient::edit(BlockCoord const x, BlockCoord const y, BlockCoord const z, BlockHandle const handle) {
+  if(!connection)
+    return;
+  NetWriter message;
+  message.svarint(x);
+  message.svarint(y);
+  message.svarint(z);
+  message.svarint(handle);
+  connection->send(NetMessage::Edit, message);
+  editsSent.emplace(BlockKey(x, y, z), std::chrono::steady_clock::now());
+}
+
+std::uint8_t ChunkClient::cellAt(BlockCoord const x, BlockCoord const y, BlockCoord const z) const {
+  if(z < 0)
+    return 0;
+  auto const it = chunks.find(KeyOf(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y), Chunk::decomposeChunkFromBlock(z)));
+  if(it == chunks.end())
+    return 0;
+  return it->second.cells[Chunk::blockPos(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                                          Chunk::decomposeLocalBlockFromBlock(z))];
+}
+
+bool ChunkClient::handle(NetMessage const type, NetReader &reader) {
+  if(!welcomed && type != NetMessage::Welcome)
+    return false;
+
+  switch(type) {
+  case NetMessage::Welcome:
+    if(reader.u32() != NetProtocolVersion)
+      return false;
+    worldSeed = static_cast<long long>(reader.u64());
+    welcomed  = true;
+    // Where the client is first, so the server knows which chunks it should have
+    moveTo(position);
+    for(auto const &[key, chunk]: chunks)
+      requestChanges(chunk);
+    return true;
+  case NetMessage::Chunk: {
+    BlockCoord cx, cy, cz;
+    std::uint64_t version;
+    PackedVoxels packed;
+    if(!ReadChunk(reader, cx, cy, cz, version, packed))
+      return false;
+    auto &chunk    = chunks[KeyOf(cx, cy, cz)];
+    chunk.position = {cx, cy, cz};
+    chunk.version  = version;
+    FillRuns(packed.blocks, chunk.cells);
+    FillRuns(packed.light, chunk.light);
+    ++chunksReceived;
+    return true;
+  }
+  case NetMessage::Unload: {
+    auto const cx = static_cast<BlockCoord>(reader.svarint());
+    auto const cy = static_cast<BlockCoord>(reader.svarint());
+    auto const cz = static_cast<BlockCoord>(reader.svarint());
+    chunks.erase(KeyOf(cx, cy, cz));
+    ++unloadsReceived;
+    return true;
+  }
+  case NetMessage::ChunkDeltas: {
+    ChunkDelta delta;
+    for(auto n = reader.varint(); n--;) {
+      if(!ReadChunkDelta(reader, delta))
+        return false;
+      auto const it = chunks.find(KeyOf(delta.cx, delta.cy, delta.cz));
+      if(it == chunks.end()) {
+        ++deltasMissed;
+        continue;
+      }
+      // A delta from another version than ours would leave the chunk half way between the two
+      if(it->second.version != delta.from) {
+        requestChanges(it->second);
+        continue;
+      }
+      ApplyDelta(delta, it->second);
+      ++deltasReceived;
+      deltaCellsReceived += delta.cells.size();
+      if(!editsSent.empty())
+        for(auto const cell: delta.cells)
+          confirmEdit(delta.cx * ChunkSize + (cell & ChunkBlockMask), delta.cy * ChunkSize + (cell >> ChunkCoordBits & ChunkBlockMask),
+                      delta.cz * ChunkSize + (cell >> ChunkCoordBits * 2));
+    }
+    return true;
+  }
+  case NetMessage::Ping: {
+    auto const tick   = reader.u32();
+    auto const sentAt = reader.u64();
+    NetWriter pong;
+    pong.u32(tick);
+    pong.u64(sentAt);
+    connection->send(NetMessage::Pong, pong);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void ChunkClient::confirmEdit(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  auto const it = editsSent.find(BlockKey(x, y, z));
+  if(it == editsSent.end())
+    return;
+  auto const ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - it->second).count();
+  editsSent.erase(it);
+  editMsTotal += ms;
+  editMsMax = std::max(editMsMax, ms);
+  ++editsConfirmed;
+}
+
+ClientStats ChunkClient::stats() const {
+  return {connection ? connection->stats() : ConnectionStats{}, chunksReceived, unloadsReceived, deltasReceived, deltaCellsReceived,
+          deltasMissed, resyncsSent, editsConfirmed, editsConfirmed ? static_cast<float>(editMsTotal / editsConfirmed) : .0f, editMsMax};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "NetProtocol.hpp"
+#include "Chunk.hpp"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// A chunk as a client has it, a byte per block as PackCell makes it and its light, indexed like Chunk::blockPos
+struct ClientChunk {
+  glm::ivec3 position;
+  // The version of the chunk on the server these are
+  std::uint64_t version;
+  std::array<std::uint8_t, ChunkVolume> cells, light;
+};
+
+// Brings chunk to delta.to. The delta has to be from the version the chunk is at.
+void ApplyDelta(ChunkDelta const &delta, ClientChunk &chunk);
+
+struct ClientStats {
+  ConnectionStats connection;
+  std::size_t chunksReceived, unloadsReceived, deltasReceived, deltaCellsReceived;
+  // Deltas for chunks the client doesn't have, which an unload crossing them makes legitimate
+  std::size_t deltasMissed;
+  // Chunks asked for the changes to since the version the client has
+  std::size_t resyncsSent;
+  // From sending an edit to the update for its block coming back
+  std::size_t editsConfirmed;
+  float editMsAvg, editMsMax;
+};
+
+// The client end of a ChunkServer, which keeps the chunks it's sent up to date. Has no world of its own; what it
+// receives is for a game to draw or, without one, to check. Chunks are kept across connections: connecting again
+// asks for what changed in every chunk the client has, rather than for the chunks anew.
+struct ChunkClient {
+  // Connects and says hello, waiting at most timeoutMs for the connection. False if there's no server there.
+  bool connect(std::string const &host, unsigned short port, float radius, int timeoutMs = 5000);
+  // Takes what the server sent, answers its pings and sends what's queued. False once disconnected.
+  bool update();
+  void moveTo(glm::vec3 const &position);
+  // Asks for what changed in the chunk since the version the client has
+  void requestChanges(ClientChunk const &chunk);
+  // Places a block at x, y, z, or breaks the one there for InvalidHandle
+  void edit(BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle handle);
+
+  // The block's cell, 0 for air or a block in a chunk the client doesn't have
+  std::uint8_t cellAt(BlockCoord x, BlockCoord y, BlockCoord z) const;
+  bool isWelcomed() const { return welcomed; }
+  long long seed() const { return worldSeed; }
+  ClientStats stats() const;
+
+  std::unordered_map<long long, ClientChunk> chunks;
+
+private:
+  bool handle(NetMessage type, NetReader &reader);
+  // Counts the edit at x, y, z as done, if there's one waiting
+  void confirmEdit(BlockCoord x, BlockCoord y, BlockCoord z);
+
+  std::unique_ptr<NetConnection> connection;
+  bool welcomed = false;
+  long long worldSeed = 0;
+  std::size_t chunksReceived = 0, unloadsReceived = 0, deltasReceived = 0, deltaCellsReceived = 0, deltasMissed = 0, resyncsSent = 0;
+  glm::vec3 position{};
+  // When edits waiting for their update were sent, by block
+  std::unordered_map<std::uint64_t, std::chrono::steady_clock::time_point> editsSent;
+  std::size_t editsConfirmed = 0;
+  double editMsTotal = .0;
+  float editMsMax = .0f;
+};
@@ -0,0 +1,83 @@
+#include "ChunkGrid.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+ChunkGrid::ChunkGrid() :
+  slots(static_cast<std::size_t>(ChunkGridSide * ChunkGridSide * ChunkGridSide)), handles(new std::atomic<std::uint64_t>[slots.size()]) {
+  for(std::size_t i = 0; i < slots.size(); ++i)
+    handles[i].store(0, std::memory_order_relaxed);
+}
+
+ChunkGrid &ChunkGrid::operator=(ChunkGrid &&other) noexcept {
+  slots    = std::move(other.slots);
+  handles  = std::move(other.handles);
+  overflow = std::move(other.overflow);
+  overflowed.store(other.overflowed.load());
+  count = other.count;
+  return *this;
+}
+
+std::int64_t ChunkGrid::Key(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) { return ChunkIndex(cx, cy, cz).repr; }
+
+Chunk *ChunkGrid::findOverflow(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const {
+  auto const it = overflow.find(Key(cx, cy, cz));
+  return it == overflow.end() ? nullptr : it->second.get();
+}
+
+std::shared_ptr<Chunk> ChunkGrid::get(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const {
+  auto const &slot = slots[SlotOf(cx, cy, cz)];
+  if(slot.chunk && slot.cx == cx && slot.cy == cy && slot.cz == cz)
+    return slot.chunk;
+  if(overflow.empty())
+    return nullptr;
+  auto const it = overflow.find(Key(cx, cy, cz));
+  return it == overflow.end() ? nullptr : it->second;
+}
+
+Chunk *ChunkGrid::findUnlocked(ChunkSlab const &slab, BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const {
+  auto const packed = handles[SlotOf(cx, cy, cz)].load(std::memory_order_acquire);
+  if(!packed)
+    return nullptr;
+  // Chunk coordinates never change, so a chunk found is the one asked for or another one that took the slot over
+  auto const chunk = slab.get({static_cast<std::uint32_t>(packed), static_cast<std::uint32_t>(packed >> 32)});
+  return chunk && chunk->cx == cx && chunk->cy == cy && chunk->cz == cz ? chunk : nullptr;
+}
+
+void ChunkGrid::publish(std::size_t const i) {
+  auto const &chunk = slots[i].chunk;
+  handles[i].store(chunk ? chunk->handle.index | static_cast<std::uint64_t>(chunk->handle.generation) << 32 : 0, std::memory_order_release);
+}
+
+void ChunkGrid::insert(std::shared_ptr<Chunk> chunk) {
+  auto const i = SlotOf(chunk->cx, chunk->cy, chunk->cz);
+  auto &slot   = slots[i];
+  if(!slot.chunk || (slot.cx == chunk->cx && slot.cy == chunk->cy && slot.cz == chunk->cz)) {
+    count += !slot.chunk;
+    slot = {chunk->cx, chunk->cy, chunk->cz, std::move(chunk)};
+    publish(i);
+    return;
+  }
+
+  auto &entry = overflow[Key(chunk->cx, chunk->cy, chunk->cz)];
+  count += !entry;
+  entry = std::move(chunk);
+  overflowed.store(overflow.size(), std::memory_order_release);
+}
+
+std::shared_ptr<Chunk> ChunkGrid::erase(std::size_t const i) {
+  auto &slot = slots[i];
+  auto out   = std::move(slot.chunk);
+  --count;
+
+  // An overflowed chunk waiting for this slot moves in, so the grid keeps serving the hot region
+  for(auto it = overflow.begin(); it != overflow.end(); ++it)
+    if(SlotOf(it->second->cx, it->second->cy, it->second->cz) == i) {
+      slot = {it->second->cx, it->second->cy, it->second->cz, std::move(it->second)};
+      overflow.erase(it);
+      break;
+    }
+  publish(i);
+  overflowed.store(overflow.size(), std::memory_order_release);
+  return out;
+}
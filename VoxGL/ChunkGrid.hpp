@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Blocks.hpp"
+#include "ChunkSlab.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct Chunk;
+
+// Chunks on a side of the grid. The loaded sphere is at most this wide, give or take the unload margin.
+constexpr BlockCoord ChunkGridBits = 5;
+constexpr BlockCoord ChunkGridSide = 1 << ChunkGridBits;
+constexpr BlockCoord ChunkGridMask = ChunkGridSide - 1;
+
+// The loaded chunks, kept in a ring buffer indexed by chunk coordinates modulo ChunkGridSide. As the player moves,
+// chunks coming into range take the slots of the ones that left on the far side, so finding a chunk is an array
+// index and a compare instead of a hash and a probe. A chunk whose slot is still taken goes to a map instead.
+// Not synchronised, World guards it with chunkMutex. Only the handles of the chunks in the slots are published for
+// readers that hold an EpochGuard instead, see findUnlocked.
+struct ChunkGrid {
+  ChunkGrid();
+  ChunkGrid(ChunkGrid &&other) noexcept { *this = std::move(other); }
+  ChunkGrid &operator=(ChunkGrid &&other) noexcept;
+
+  // The chunk at chunk coordinates cx, cy, cz or nullptr, for looking at it while chunkMutex is held
+  Chunk *find(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const {
+    auto const &slot = slots[SlotOf(cx, cy, cz)];
+    if(slot.chunk && slot.cx == cx && slot.cy == cy && slot.cz == cz)
+      return slot.chunk.get();
+    return overflow.empty() ? nullptr : findOverflow(cx, cy, cz);
+  }
+  std::shared_ptr<Chunk> get(BlockCoord cx, BlockCoord cy, BlockCoord cz) const;
+  // The chunk at cx, cy, cz through the handle published for its slot, without chunkMutex but under an EpochGuard
+  // on slab. Misses chunks in the overflow map, which only chunkMutex guards; mayHaveOverflow says when to look.
+  Chunk *findUnlocked(ChunkSlab const &slab, BlockCoord cx, BlockCoord cy, BlockCoord cz) const;
+  bool mayHaveOverflow() const { return overflowed.load(std::memory_order_acquire) != 0; }
+  bool contains(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const { return find(cx, cy, cz) != nullptr; }
+
+  // Adds chunk, replacing the chunk at its coordinates if there is one
+  void insert(std::shared_ptr<Chunk> chunk);
+  // Takes out up to limit chunks pred returns true for
+  template<typename P>
+  std::vector<std::shared_ptr<Chunk>> extract(P &&pred, std::size_t limit);
+
+  template<typename F>
+  void forEach(F &&f) const;
+  std::size_t size() const { return count; }
+  // Chunks that didn't find a free slot
+  std::size_t overflowSize() const { return overflow.size(); }
+
+private:
+  struct Slot {
+    BlockCoord cx = 0, cy = 0, cz = 0;
+    std::shared_ptr<Chunk> chunk;
+  };
+
+  static std::size_t SlotOf(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+    return static_cast<std::size_t>((cx & ChunkGridMask) | (cy & ChunkGridMask) << ChunkGridBits | (cz & ChunkGridMask) << ChunkGridBits * 2);
+  }
+  static std::int64_t Key(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+
+  Chunk *findOverflow(BlockCoord cx, BlockCoord cy, BlockCoord cz) const;
+  std::shared_ptr<Chunk> erase(std::size_t slot);
+
+  // Sets the slot's published handle to its chunk's
+  void publish(std::size_t slot);
+
+  std::vector<Slot> slots;
+  // Each slot's chunk handle, its index in the low half and its generation in the high half
+  std::unique_ptr<std::atomic<std::uint64_t>[]> handles;
+  std::unordered_map<std::int64_t, std::shared_ptr<Chunk>> overflow;
+  // Set while anything is in overflow, cleared only after the chunk that left it was published in a slot
+  std::atomic<std::size_t> overflowed{0};
+  std::size_t count = 0;
+};
+
+template<typename P>
+std::vector<std::shared_ptr<Chunk>> ChunkGrid::extract(P &&pred, std::size_t const limit) {
+  std::vector<std::shared_ptr<Chunk>> out;
+  for(auto it = overflow.begin(); it != overflow.end() && out.size() < limit;) {
+    if(pred(*it->second)) {
+      out.push_back(std::move(it->second));
+      it = overflow.erase(it);
+      --count;
+    }
+    else
+      ++it;
+  }
+  overflowed.store(overflow.size(), std::memory_order_release);
+  for(std::size_t i = 0; i < slots.size() && out.size() < limit; ++i)
+    if(slots[i].chunk && pred(*slots[i].chunk))
+      out.push_back(erase(i));
+  return out;
+}
+
+template<typename F>
+void ChunkGrid::forEach(F &&f) const {
+  for(auto const &slot: slots)
+    if(slot.chunk)
+      f(slot.chunk);
+  for(auto const &[key, chunk]: overflow)
+    f(chunk);
+}
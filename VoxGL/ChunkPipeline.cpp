@@ -0,0 +1,403 @@
+#include "ChunkPipeline.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Game.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <thread>
+
+// Chunks this far past the requested sphere are unloaded, so chunks at its edge don't flicker in and out
+constexpr float UnloadMargin = 2.f;
+// Lit and Meshed wait on neighbours, so their queues hold the whole edge of the loaded area and aren't bounded
+constexpr std::size_t Unbounded = std::numeric_limits<std::size_t>::max();
+
+// Runs f(i) for every i below n, spread over workers threads outside of debug builds
+template<typename F>
+static void ParallelFor(std::size_t const n, std::size_t const workers, F const &f) {
+  if(isDebugging || workers <= 1 || n <= 1) {
+    for(std::size_t i = 0; i < n; ++i)
+      f(i);
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  std::vector<std::future<void>> futs;
+  for(std::size_t w = 0; w < std::min(workers, n); ++w)
+    futs.push_back(std::async(std::launch::async, [&] {
+      for(std::size_t i; (i = next++) < n;)
+        f(i);
+    }));
+  for(auto &fut: futs)
+    fut.get();
+}
+
+static bool AtLeast(ChunkStage const stage, ChunkStage const min) { return stage != ChunkStage::Unloading && stage >= min; }
+
+char const *StageName(ChunkStage const stage) {
+  switch(stage) {
+  case ChunkStage::Requested: return "requested";
+  case ChunkStage::Terrain:   return "terrain";
+  case ChunkStage::Decorated: return "decorated";
+  case ChunkStage::Lit:       return "lit";
+  case ChunkStage::Meshed:    return "meshed";
+  case ChunkStage::Uploaded:  return "uploaded";
+  case ChunkStage::Unloading: return "unloading";
+  }
+  return "";
+}
+
+ChunkPipeline::ChunkPipeline(float const radius, unsigned const workers): radius(radius) {
+  auto const hardware = static_cast<std::size_t>(workers ? workers : std::max(1u, std::thread::hardware_concurrency()));
+  config[index(ChunkStage::Requested)] = {1, 256, 0};
+  config[index(ChunkStage::Terrain)]   = {hardware, 8 * hardware, 512};
+  config[index(ChunkStage::Decorated)] = {hardware, 8 * hardware, 256};
+  // The light engine propagates on one thread
+  config[index(ChunkStage::Lit)]       = {1, 256, Unbounded};
+  config[index(ChunkStage::Meshed)]    = {hardware, 8 * hardware, Unbounded};
+  // Uploads per frame
+  config[index(ChunkStage::Uploaded)]  = {1, 8, 256};
+  config[index(ChunkStage::Unloading)] = {1, 512, Unbounded};
+  for(std::size_t s = 0; s < NumChunkStages; ++s)
+    batches[s] = config[s].batch;
+
+  auto const reach = static_cast<BlockCoord>(radius) + 1;
+  for(auto x = -reach; x <= reach; ++x)
+    for(auto y = -reach; y <= reach; ++y)
+      for(auto z = -reach; z <= reach; ++z)
+        if(x * x + y * y + z * z <= reach * reach)
+          sphere.push_back({x, y, z});
+  std::stable_sort(sphere.begin(), sphere.end(), [](glm::ivec3 const &a, glm::ivec3 const &b) {
+    return a.x * a.x + a.y * a.y + a.z * a.z < b.x * b.x + b.y * b.y + b.z * b.z;
+  });
+}
+
+bool ChunkPipeline::advance(Chunk &chunk, ChunkStage from, ChunkStage const to) {
+  if(!chunk.stage.compare_exchange_strong(from, to))
+    return false;
+  leave(from);
+  enter(to);
+  return true;
+}
+
+void ChunkPipeline::enter(ChunkStage const stage) {
+  ++inStage[index(stage)];
+  ++entered[index(stage)];
+}
+
+void ChunkPipeline::leave(ChunkStage const stage) { --inStage[index(stage)]; }
+
+std::size_t ChunkPipeline::room(ChunkStage const stage, std::size_t const available) {
+  auto const s = index(stage);
+  auto limit   = std::min(batches[s].load(), available);
+  // Uploaded chunks stay until they unload, there's no queue after them
+  if(s >= index(ChunkStage::Uploaded))
+    return limit;
+
+  auto const next   = s + 1;
+  auto const queued = next == index(ChunkStage::Terrain) ? requested.size() : queues[next].size();
+  auto const free   = config[next].capacity > queued ? config[next].capacity - queued : 0;
+  if(limit > free) {
+    ++stalls[s];
+    limit = free;
+  }
+  return limit;
+}
+
+bool ChunkPipeline::neighboursAt(Chunk &chunk, ChunkStage const stage) {
+  EpochGuard guard(chunk.w.slab);
+  auto n = 0;
+  for(std::size_t side = 0; side < chunk.adjacentChunks.size(); ++side)
+    if(auto const c = chunk.adjacent(side); c && AtLeast(c->stage, stage))
+      ++n;
+  // Nothing is generated below the bottom layer, or above the top one when the world has layers
+  auto const layers = chunk.w.options.layers;
+  return n == 6 - !chunk.cz - (layers && chunk.cz + 1 == layers);
+}
+
+std::vector<std::shared_ptr<Chunk>> ChunkPipeline::take(ChunkStage const stage, ChunkStage const neighbours) {
+  auto const from = static_cast<ChunkStage>(index(stage) - 1);
+  std::vector<std::shared_ptr<Chunk>> ready, waiting;
+
+  std::lock_guard<std::mutex> lck(mutex);
+  auto &queue = queues[index(stage)];
+  for(auto &c: queue) {
+    // Chunks that unloaded while they waited drop out here
+    if(c->stage != from)
+      continue;
+    if(neighbours == ChunkStage::Requested || neighboursAt(*c, neighbours))
+      ready.push_back(std::move(c));
+    else
+      waiting.push_back(std::move(c));
+  }
+
+  auto const n = room(stage, ready.size());
+  waiting.insert(waiting.end(), std::make_move_iterator(ready.begin() + n), std::make_move_iterator(ready.end()));
+  ready.resize(n);
+  queue.assign(std::make_move_iterator(waiting.begin()), std::make_move_iterator(waiting.end()));
+  return ready;
+}
+
+std::size_t ChunkPipeline::pump(World &world) {
+  auto moved = unload(world);
+  moved += mesh(world);
+  moved += light(world);
+  moved += decorate(world);
+  moved += generate(world);
+  moved += request(world);
+
+  std::lock_guard<std::mutex> lck(mutex);
+  settled = !moved && (!drawn || queues[index(ChunkStage::Uploaded)].empty());
+  return moved;
+}
+
+std::size_t ChunkPipeline::request(World &world) {
+  auto const pos    = *world.position / static_cast<float>(ChunkSize);
+  auto const center = glm::ivec3(glm::floor(pos));
+  std::size_t added = 0;
+
+  std::lock_guard<std::mutex> chunkLck(world.chunkMutex);
+  std::lock_guard<std::mutex> lck(mutex);
+  auto const limit = room(ChunkStage::Requested, batch(ChunkStage::Requested));
+  for(auto const &offset: sphere) {
+    if(added == limit)
+      break;
+    auto const c = center + offset;
+    if(c.z < 0 || (world.options.layers && c.z >= world.options.layers))
+      continue;
+    auto const d = glm::vec3(c) + .5f - pos;
+    if(d.x * d.x + d.y * d.y + d.z * d.z > radius * radius)
+      continue;
+    if(world.chunks.contains(c.x, c.y, c.z) || !inFlight.insert(ChunkIndex(c.x, c.y, c.z).repr).second)
+      continue;
+
+    requested.push_back(c);
+    enter(ChunkStage::Requested);
+    ++added;
+  }
+  return added;
+}
+
+std::size_t ChunkPipeline::generate(World &world) {
+  std::vector<glm::ivec3> coords;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    for(auto n = room(ChunkStage::Terrain, requested.size()); n--;) {
+      coords.push_back(requested.front());
+      requested.pop_front();
+    }
+  }
+  if(coords.empty())
+    return 0;
+
+  std::vector<std::shared_ptr<Chunk>> made(coords.size());
+  float elapsed;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    ParallelFor(coords.size(), config[index(ChunkStage::Terrain)].workers, [&](std::size_t const i) {
+      auto const &c   = coords[i];
+      auto const dist = world.chunkDist(c.x, c.y, c.z);
+      // Requests the player moved away from in the meantime are dropped
+      if(dist > radius)
+        return;
+      made[i]      = world.makeChunk(c.x, c.y, c.z);
+      made[i]->lod = world.lodFor(dist, 0);
+    });
+  }
+  micros[index(ChunkStage::Terrain)] += static_cast<long long>(elapsed);
+
+  std::lock_guard<std::mutex> lck(mutex);
+  for(std::size_t i = 0; i < coords.size(); ++i) {
+    leave(ChunkStage::Requested);
+    if(!made[i]) {
+      inFlight.erase(ChunkIndex(coords[i].x, coords[i].y, coords[i].z).repr);
+      continue;
+    }
+    enter(ChunkStage::Terrain);
+    queues[index(ChunkStage::Decorated)].push_back(std::move(made[i]));
+  }
+  return coords.size();
+}
+
+std::size_t ChunkPipeline::decorate(World &world) {
+  auto chunks = take(ChunkStage::Decorated);
+  if(chunks.empty())
+    return 0;
+
+  std::vector<std::vector<std::shared_ptr<Chunk>>> changed(chunks.size());
+  float elapsed;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    // Decorations find the chunks by their handles
+    for(auto const &c: chunks)
+      c->handle = world.slab.add(c);
+    // Before anyone sees the chunks, so they're meshed with their trees and ores the first time
+    ParallelFor(chunks.size(), config[index(ChunkStage::Decorated)].workers,
+                [&](std::size_t const i) { changed[i] = world.decorations.decorate(world, chunks[i]); });
+
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    for(auto const &c: chunks) {
+      world.chunks.insert(c);
+      ++world.chunksLoaded;
+
+      // Hunt for adjacent chunks!
+      for(auto const &[dx, dy, dz]: Vdxyz) {
+        if(auto const adjC = world.chunks.find(c->cx + dx, c->cy + dy, c->cz + dz)) {
+          adjC->onAdjacentChunkLoad(-dx, -dy, -dz, c->handle);
+          c->onAdjacentChunkLoad(dx, dy, dz, adjC->handle);
+        }
+      }
+    }
+  }
+  micros[index(ChunkStage::Decorated)] += static_cast<long long>(elapsed);
+
+  std::lock_guard<std::mutex> lck(mutex);
+  for(auto &c: chunks) {
+    inFlight.erase(ChunkIndex(c->cx, c->cy, c->cz).repr);
+    advance(*c, ChunkStage::Terrain, ChunkStage::Decorated);
+    queues[index(ChunkStage::Lit)].push_back(std::move(c));
+  }
+  // Neighbours that got parts of these chunks' features after they were meshed
+  for(auto &others: changed)
+    remeshes.insert(remeshes.end(), others.begin(), others.end());
+  return chunks.size();
+}
+
+std::size_t ChunkPipeline::light(World &world) {
+  auto chunks = take(ChunkStage::Lit, ChunkStage::Decorated);
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    if(chunks.empty() && remeshes.empty())
+      return 0;
+  }
+
+  float elapsed;
+  std::vector<std::shared_ptr<Chunk>> dirty;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    // Trees shade the ground, now that the neighbours they spill into are decorated too
+    for(auto const &c: chunks) {
+      std::lock_guard<std::mutex> lck(c->decorationMutex);
+      for(auto const &[pos, cell]: c->decoratedCells)
+        world.light.update(c->x + (pos & ChunkBlockMask), c->y + ((pos >> ChunkCoordBits) & ChunkBlockMask), c->z + (pos >> ChunkCoordBits * 2));
+    }
+    // The player's edits go over the decorated terrain, and are lit along with it
+    for(auto const &c: chunks)
+      for(auto const pos: world.journal.replay(*c))
+        world.light.update(c->x + (pos & ChunkBlockMask), c->y + ((pos >> ChunkCoordBits) & ChunkBlockMask), c->z + (pos >> ChunkCoordBits * 2));
+
+    dirty = world.light.propagate(world);
+  }
+  micros[index(ChunkStage::Lit)] += static_cast<long long>(elapsed);
+
+  std::lock_guard<std::mutex> lck(mutex);
+  // Remeshed by the mesh stage, now that their light is right
+  relit.insert(relit.end(), std::make_move_iterator(dirty.begin()), std::make_move_iterator(dirty.end()));
+  relit.insert(relit.end(), std::make_move_iterator(remeshes.begin()), std::make_move_iterator(remeshes.end()));
+  remeshes.clear();
+  for(auto &c: chunks) {
+    advance(*c, ChunkStage::Decorated, ChunkStage::Lit);
+    queues[index(ChunkStage::Meshed)].push_back(std::move(c));
+  }
+  return chunks.size();
+}
+
+std::size_t ChunkPipeline::mesh(World &world) {
+  std::vector<std::shared_ptr<Chunk>> changed;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    changed.swap(relit);
+  }
+  if(!changed.empty()) {
+    float elapsed;
+    {
+      TimedBlock<std::micro> timer(elapsed);
+      world.remesh(std::move(changed));
+    }
+    micros[index(ChunkStage::Meshed)] += static_cast<long long>(elapsed);
+  }
+
+  auto chunks = take(ChunkStage::Meshed, ChunkStage::Lit);
+  if(chunks.empty())
+    return 0;
+
+  // Moved before meshing, so edits made while it runs remesh the chunk again rather than being missed
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [&](auto const &c) { return !advance(*c, ChunkStage::Lit, ChunkStage::Meshed); }),
+                 chunks.end());
+  }
+
+  float elapsed;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    ParallelFor(chunks.size(), config[index(ChunkStage::Meshed)].workers, [&](std::size_t const i) { chunks[i]->regenerateChunkMesh(); });
+  }
+  micros[index(ChunkStage::Meshed)] += static_cast<long long>(elapsed);
+
+  std::lock_guard<std::mutex> lck(mutex);
+  for(auto &c: chunks)
+    queues[index(ChunkStage::Uploaded)].push_back(std::move(c));
+  return chunks.size();
+}
+
+std::size_t ChunkPipeline::unload(World &world) {
+  std::vector<std::shared_ptr<Chunk>> far;
+  {
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    far = world.chunks.extract([&](Chunk const &c) { return world.chunkDist(c.cx, c.cy, c.cz) > radius + UnloadMargin; },
+                               batch(ChunkStage::Unloading));
+    // Neighbours' handles go stale now, the slab lets go of the chunks once no reader can still be using them
+    for(auto const &c: far)
+      world.slab.retire(c->handle);
+  }
+
+  std::lock_guard<std::mutex> lck(mutex);
+  for(auto &c: far) {
+    for(auto stage = c->stage.load(); !advance(*c, stage, ChunkStage::Unloading);)
+      stage = c->stage.load();
+    queues[index(ChunkStage::Unloading)].push_back(std::move(c));
+  }
+  return far.size();
+}
+
+void ChunkPipeline::onDraw() {
+  drawn = true;
+  std::vector<std::shared_ptr<Chunk>> freed;
+  float elapsed;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    {
+      std::lock_guard<std::mutex> lck(mutex);
+      auto &unloaded = queues[index(ChunkStage::Unloading)];
+      freed.assign(std::make_move_iterator(unloaded.begin()), std::make_move_iterator(unloaded.end()));
+      unloaded.clear();
+
+      // The mesh itself uploads the first time the chunk is drawn
+      auto &meshed = queues[index(ChunkStage::Uploaded)];
+      for(auto n = room(ChunkStage::Uploaded, meshed.size()); n--;) {
+        advance(*meshed.front(), ChunkStage::Meshed, ChunkStage::Uploaded);
+        meshed.pop_front();
+      }
+    }
+
+    for(auto &c: freed) {
+      c->releaseMesh();
+      leave(ChunkStage::Unloading);
+    }
+  }
+  micros[index(ChunkStage::Unloading)] += static_cast<long long>(elapsed);
+}
+
+std::vector<StageStats> ChunkPipeline::stats() {
+  std::lock_guard<std::mutex> lck(mutex);
+  std::vector<StageStats> out;
+  for(std::size_t s = 0; s < NumChunkStages; ++s) {
+    auto const queued = s == index(ChunkStage::Terrain) ? requested.size() : queues[s].size();
+    out.push_back({static_cast<ChunkStage>(s), inStage[s], queued, entered[s], stalls[s], micros[s] / 1000.f});
+  }
+  return out;
+}
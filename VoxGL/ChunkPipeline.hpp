@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Blocks.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+struct Chunk;
+struct World;
+
+// Where a chunk is in its life. Chunks go through the stages in order, and can leave for Unloading from any of them.
+enum struct ChunkStage : std::uint8_t {
+  // Wanted around the player, nothing generated yet
+  Requested,
+  // Blocks generated, not in the world yet
+  Terrain,
+  // Features placed and in the world, so other chunks can see it
+  Decorated,
+  // Light worked out once every neighbour was decorated
+  Lit,
+  // Meshed once every neighbour was lit, waiting for the render thread
+  Meshed,
+  // Mesh uploaded and drawn
+  Uploaded,
+  // Out of range and out of the world, waiting for the render thread to free its mesh
+  Unloading,
+};
+
+constexpr std::size_t NumChunkStages = 7;
+
+char const *StageName(ChunkStage stage);
+
+struct StageConfig {
+  // Threads the stage's work is spread over, chunks it takes per round and chunks that may wait to enter it
+  std::size_t workers, batch, capacity;
+};
+
+struct StageStats {
+  ChunkStage stage;
+  // Chunks in the stage now, waiting to enter it, and that entered it so far. Unloading chunks wait to be freed.
+  std::size_t chunks, queued, entered;
+  // Rounds the stage was held back by the next stage's queue being full
+  std::size_t stalls;
+  float msTotal;
+};
+
+// Moves chunks through their stages. Each stage takes chunks from its own queue, checking the stages of their
+// neighbours where it depends on them, and only as many as fit into the next stage's queue. A slow stage so
+// holds back the ones before it instead of letting chunks pile up, all the way back to requesting new chunks.
+struct ChunkPipeline {
+  // Chunks within radius chunks of the player are requested, chunks past radius + UnloadMargin unloaded. Stages
+  // that run in parallel get workers threads, or one per core for 0.
+  explicit ChunkPipeline(float radius, unsigned workers = 0);
+
+  // One round of every stage but the upload, downstream first so upstream stages find room. Returns how many
+  // chunks changed stage. Called by the worldgen thread.
+  std::size_t pump(World &world);
+  // Frees the meshes of unloaded chunks and lets a batch of meshed chunks upload. Called by the render thread.
+  void onDraw();
+  // Whether the last round found nothing to do and nothing is left to upload. Uploads only count once
+  // something draws the world, so worlds nobody draws settle too.
+  bool isSettled() const { return settled; }
+
+  std::vector<StageStats> stats();
+  // Chunks stage takes per round from now on. Safe from any thread, unlike config.
+  void setBatch(ChunkStage stage, std::size_t batch) { batches[index(stage)] = std::max<std::size_t>(batch, 1); }
+  std::size_t batch(ChunkStage stage) const { return batches[index(stage)]; }
+
+  // Set up by the constructor. Batches are read from it then and changed through setBatch after.
+  std::array<StageConfig, NumChunkStages> config;
+
+private:
+  static std::size_t index(ChunkStage const stage) { return static_cast<std::size_t>(stage); }
+
+  // Moves chunk from one stage to the other, unless something else moved it first
+  bool advance(Chunk &chunk, ChunkStage from, ChunkStage to);
+  void enter(ChunkStage stage);
+  void leave(ChunkStage stage);
+  // How many of available chunks the stage may take this round, counting a stall if it has work but no room
+  std::size_t room(ChunkStage stage, std::size_t available);
+  // Takes the chunks in stage's queue that are ready for it, with neighbours at least at neighbours past Requested
+  std::vector<std::shared_ptr<Chunk>> take(ChunkStage stage, ChunkStage neighbours = ChunkStage::Requested);
+  // Whether every neighbour the mesher looks at is in the world and at least at stage, not counting the ones
+  // outside the layers chunks are generated in
+  static bool neighboursAt(Chunk &chunk, ChunkStage stage);
+
+  std::size_t request(World &world);
+  std::size_t generate(World &world);
+  std::size_t decorate(World &world);
+  std::size_t light(World &world);
+  std::size_t mesh(World &world);
+  std::size_t unload(World &world);
+
+  float radius;
+  // Chunk offsets within radius + 1 of the player's chunk, nearest first
+  std::vector<glm::ivec3> sphere;
+
+  std::mutex mutex;
+  std::deque<glm::ivec3> requested;
+  // Chunks waiting to enter each stage, chunks freed by the render thread for Unloading
+  std::array<std::deque<std::shared_ptr<Chunk>>, NumChunkStages> queues;
+  // Requested chunks and generated ones not in the world yet
+  std::unordered_set<std::int64_t> inFlight;
+  // Chunks whose neighbours changed them after they were meshed, waiting for the light stage
+  std::vector<std::shared_ptr<Chunk>> remeshes;
+  // Chunks whose light or blocks changed after they were meshed, remeshed by the mesh stage
+  std::vector<std::shared_ptr<Chunk>> relit;
+
+  std::array<std::atomic<std::size_t>, NumChunkStages> batches{}, inStage{}, entered{}, stalls{};
+  std::array<std::atomic<long long>, NumChunkStages> micros{};
+  std::atomic<bool> drawn{false}, settled{false};
+};
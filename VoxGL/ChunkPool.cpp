@@ -0,0 +1,56 @@
+#include "ChunkPool.hpp"
+
+#include <algorithm>
+#include <new>
+
+// Block sizes are rounded up so every block in a slab stays aligned
+static std::size_t BlockSizeFor(std::size_t const bytes) {
+  constexpr auto Align = alignof(std::max_align_t);
+  return (bytes + Align - 1) / Align * Align;
+}
+
+ChunkPool::~ChunkPool() {
+  for(auto const slab: slabs)
+    ::operator delete(slab);
+}
+
+void *ChunkPool::allocate(std::size_t const bytes) {
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    if(!blockSize)
+      blockSize = BlockSizeFor(bytes);
+
+    if(BlockSizeFor(bytes) == blockSize) {
+      if(freeBlocks.empty()) {
+        auto const slab = static_cast<char *>(::operator new(blockSize * SlabChunks));
+        slabs.push_back(slab);
+        ++heapAllocations;
+        for(auto i = SlabChunks; i--;)
+          freeBlocks.push_back(slab + i * blockSize);
+      }
+      auto const p = freeBlocks.back();
+      freeBlocks.pop_back();
+      highWater = std::max(highWater, ++live);
+      return p;
+    }
+    ++heapAllocations;
+  }
+  return ::operator new(bytes);
+}
+
+void ChunkPool::deallocate(void *const p, std::size_t const bytes) {
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    if(BlockSizeFor(bytes) == blockSize) {
+      freeBlocks.push_back(p);
+      --live;
+      return;
+    }
+  }
+  ::operator delete(p);
+}
+
+PoolStats ChunkPool::stats() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return {live, highWater, slabs.size() * SlabChunks, heapAllocations};
+}
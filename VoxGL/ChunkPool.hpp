@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct PoolStats {
+  // Allocations handed out now and at most, slots the pool owns, and how often it had to go to the heap
+  std::size_t live, highWater, capacity, heapAllocations;
+};
+
+// Storage for chunks, which are large and come and go all the time as the player moves. Memory is taken from the
+// heap a slab of chunks at a time and reused once a chunk unloads, so streaming doesn't churn the allocator.
+// Every allocation is the size of the first one, so chunks and their voxels each get a pool of their own;
+// anything else goes straight to the heap. Safe to use from any thread.
+struct ChunkPool {
+  ~ChunkPool();
+
+  void *allocate(std::size_t bytes);
+  void deallocate(void *p, std::size_t bytes);
+
+  PoolStats stats();
+
+private:
+  static constexpr std::size_t SlabChunks = 32;
+
+  std::mutex mutex;
+  std::size_t blockSize = 0;
+  std::vector<void *> freeBlocks;
+  std::vector<void *> slabs;
+  std::size_t live = 0, highWater = 0, heapAllocations = 0;
+};
+
+// Allocates from a ChunkPool, for std::allocate_shared. Holds on to the pool, so chunks can outlive whoever made it.
+template<typename T>
+struct ChunkAllocator {
+  static_assert(alignof(T) <= alignof(std::max_align_t), "Pooled storage is only aligned for std::max_align_t");
+  using value_type = T;
+
+  explicit ChunkAllocator(std::shared_ptr<ChunkPool> pool): pool(std::move(pool)) { }
+  template<typename U>
+  ChunkAllocator(ChunkAllocator<U> const &other): pool(other.pool) { }
+
+  T *allocate(std::size_t const n) { return static_cast<T *>(pool->allocate(n * sizeof(T))); }
+  void deallocate(T *const p, std::size_t const n) { pool->deallocate(p, n * sizeof(T)); }
+
+  template<typename U>
+  bool operator==(ChunkAllocator<U> const &other) const { return pool == other.pool; }
+  template<typename U>
+  bool operator!=(ChunkAllocator<U> const &other) const { return pool != other.pool; }
+
+  std::shared_ptr<ChunkPool> pool;
+};
@@ -0,0 +1,162 @@
+#include "ChunkResidency.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Game.hpp"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <utility>
+
+// Chunks expanded more recently than this stay expanded, so chunks something keeps reading don't thrash
+constexpr long long ColdAfterMs = 5000;
+constexpr std::size_t ChunksPerWorker = 32;
+
+static_assert(std::variant_size_v<BlockStorage> <= 16, "Block types take the low 4 bits of a packed cell");
+
+bool PackCell(BlockStorage const &block, std::uint32_t &cell) {
+  if(auto const ptr = std::get_if<std::unique_ptr<Block>>(&block)) {
+    cell = 0;
+    return !*ptr;
+  }
+
+  cell = static_cast<std::uint32_t>(block.index());
+  if(auto const water = std::get_if<WaterBlock>(&block))
+    cell |= water->level << 4 | water->falling << 7;
+  else if(auto const lava = std::get_if<LavaBlock>(&block))
+    cell |= lava->level << 4 | lava->falling << 7;
+  return true;
+}
+
+template<std::size_t I>
+static BlockStorage BlockOfCell(std::uint32_t const cell) {
+  using Type = std::variant_alternative_t<I, BlockStorage>;
+  if constexpr(std::is_constructible_v<Type, std::uint8_t, bool>)
+    return BlockStorage(std::in_place_index<I>, static_cast<std::uint8_t>(cell >> 4 & 7), (cell >> 7 & 1) != 0);
+  else
+    return BlockStorage(std::in_place_index<I>);
+}
+
+template<std::size_t... I>
+static constexpr std::array<BlockStorage (*)(std::uint32_t), sizeof...(I)> CellDecoders(std::index_sequence<I...>) {
+  return {&BlockOfCell<I>...};
+}
+
+static auto const Decoders = CellDecoders(std::make_index_sequence<std::variant_size_v<BlockStorage>>{});
+
+template<typename F>
+static void PackRuns(std::vector<std::uint32_t> &runs, F &&valueAt) {
+  runs.clear();
+  for(std::size_t i = 0; i < ChunkVolume;) {
+    auto const value = valueAt(i);
+    auto length      = std::size_t{1};
+    while(i + length < ChunkVolume && valueAt(i + length) == value)
+      ++length;
+    runs.push_back(value | static_cast<std::uint32_t>(length) << 8);
+    i += length;
+  }
+  runs.shrink_to_fit();
+}
+
+bool PackVoxels(ChunkVoxels const &voxels, PackedVoxels &packed) {
+  std::array<std::uint32_t, ChunkVolume> cells;
+  for(std::size_t i = 0; i < ChunkVolume; ++i)
+    if(!PackCell(voxels.blocks[i], cells[i]))
+      return false;
+
+  PackRuns(packed.blocks, [&](std::size_t const i) { return cells[i]; });
+  PackRuns(packed.light, [&](std::size_t const i) { return static_cast<std::uint32_t>(voxels.light[i]); });
+  return true;
+}
+
+void UnpackVoxels(PackedVoxels const &packed, ChunkVoxels &voxels) {
+  std::size_t i = 0;
+  for(auto const run: packed.blocks) {
+    auto const cell = run & 0xff;
+    for(auto const end = i + (run >> 8); i < end; ++i)
+      voxels.blocks[i] = Decoders[cell & 15](cell);
+  }
+
+  i = 0;
+  for(auto const run: packed.light) {
+    std::fill_n(voxels.light.begin() + i, run >> 8, static_cast<std::uint8_t>(run & 0xff));
+    i += run >> 8;
+  }
+}
+
+std::size_t PackedBlockCount(PackedVoxels const &packed) {
+  std::size_t n = 0;
+  for(auto const run: packed.blocks)
+    if(run & 15)
+      n += run >> 8;
+  return n;
+}
+
+std::size_t ChunkResidency::update(World &world) {
+  auto const now = SteadyMillis();
+  std::vector<std::pair<float, std::shared_ptr<Chunk>>> cold;
+  std::size_t numExpanded = 0, numCompressed = 0, bytes = 0;
+  {
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    world.chunks.forEach([&](std::shared_ptr<Chunk> const &c) {
+      if(c->isCompressed()) {
+        ++numCompressed;
+        bytes += c->packedBytes();
+        return;
+      }
+      ++numExpanded;
+      auto const dist = world.chunkDist(c->cx, c->cy, c->cz);
+      if(dist > world.options.coldDistance && c->isMeshed() && now - c->expandedAt > ColdAfterMs)
+        cold.emplace_back(dist, c);
+    });
+  }
+
+  auto const budget = world.options.expandedChunkBudget;
+  std::size_t done  = 0;
+  if(budget && numExpanded > budget) {
+    // Farthest first
+    auto const n = std::min(cold.size(), numExpanded - budget);
+    std::partial_sort(cold.begin(), cold.begin() + n, cold.end(), [](auto const &a, auto const &b) { return a.first > b.first; });
+
+    std::atomic<std::size_t> next{0}, packed{0}, packedSize{0};
+    auto const work = [&] {
+      for(std::size_t i; (i = next++) < n;)
+        if(cold[i].second->compress()) {
+          ++packed;
+          packedSize += cold[i].second->packedBytes();
+        }
+    };
+
+    auto const workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), n / ChunksPerWorker);
+    if(isDebugging || workers <= 1)
+      work();
+    else {
+      std::vector<std::future<void>> futs;
+      for(std::size_t w = 0; w < workers; ++w)
+        futs.push_back(std::async(std::launch::async, work));
+      for(auto &fut: futs)
+        fut.get();
+    }
+    done = packed;
+    bytes += packedSize;
+  }
+
+  expanded     = numExpanded - done;
+  compressed   = numCompressed + done;
+  packedBytes  = bytes;
+  compressions += done;
+  return done;
+}
+
+void ChunkResidency::onExpanded(float const microseconds) {
+  ++expansions;
+  auto const us = static_cast<long long>(microseconds);
+  expandMicros += us;
+  for(auto max = expandMicrosMax.load(); us > max && !expandMicrosMax.compare_exchange_weak(max, us);)
+    ;
+}
+
+ResidencyStats ChunkResidency::stats() const {
+  return {expanded, compressed, packedBytes, compressions, expansions, expandMicros / 1000.f, static_cast<float>(expandMicrosMax)};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Blocks.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+struct World;
+struct ChunkVoxels;
+struct PackedVoxels;
+
+struct ResidencyStats {
+  // Chunks expanded and compressed and the bytes the compressed ones take, as of the last update
+  std::size_t expanded, compressed, packedBytes;
+  std::size_t compressions, expansions;
+  float expandMsTotal, expandUsMax;
+};
+
+// Keeps the chunks far from the player that haven't been needed for a while compressed in memory, so a larger
+// radius fits into the same memory. Cold chunks are expanded again by whatever reads or writes them next, and
+// aren't random ticked while compressed.
+struct ChunkResidency {
+  // Compresses the coldest chunks on worker threads until no more than the world's budget are expanded.
+  // Returns how many it compressed.
+  std::size_t update(World &world);
+
+  void onExpanded(float microseconds);
+  ResidencyStats stats() const;
+
+private:
+  std::atomic<std::size_t> expanded{0}, compressed{0}, packedBytes{0}, compressions{0}, expansions{0};
+  std::atomic<long long> expandMicros{0}, expandMicrosMax{0};
+};
+
+// Steady clock time in milliseconds, for when chunks were last expanded
+inline long long SteadyMillis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A block as a byte: its type, and for fluids their level and whether they're falling. False for a block that's
+// more than its type.
+bool PackCell(BlockStorage const &block, std::uint32_t &cell);
+// Packs voxels into runs. False if there's a block that can't be packed, one that's more than its type.
+bool PackVoxels(ChunkVoxels const &voxels, PackedVoxels &packed);
+void UnpackVoxels(PackedVoxels const &packed, ChunkVoxels &voxels);
+// Blocks that aren't air in packed voxels
+std::size_t PackedBlockCount(PackedVoxels const &packed);
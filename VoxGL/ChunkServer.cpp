@@ -0,0 +1,430 @@
+#include "ChunkServer.hpp"
+
+#include "Chunk.hpp"
+#include "ChunkResidency.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+using Clock = std::chrono::steady_clock;
+
+// Chunks out to here from a client are lit, whatever radius it asks for
+static float MaxRadius() { return World::loadRadius() - 1.f; }
+// Chunks are dropped this far past a client's radius, so walking along a chunk border doesn't send them back and forth
+constexpr float UnloadMargin = 1.5f;
+// Chunks looked at per client per tick at most before packing them to send
+constexpr std::size_t ChunksPerTick = 64;
+// Deltas this small are sent without looking at what the whole chunk would take
+constexpr std::size_t DeltaAlwaysBytes = 256;
+
+static long long SteadyMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Chunks are only sent once lit, from when their changes are logged
+static bool IsLit(Chunk const &chunk) {
+  auto const stage = chunk.stage.load();
+  return stage == ChunkStage::Lit || stage == ChunkStage::Meshed || stage == ChunkStage::Uploaded;
+}
+
+static glm::ivec3 ChunkOf(glm::vec3 const &position) { return glm::ivec3(glm::floor(position / static_cast<float>(ChunkSize))); }
+
+static WorldOptions ServerWorldOptions(WorldOptions options) {
+  options.meshing      = false;
+  options.trackChanges = true;
+  return options;
+}
+
+struct ChunkServer::Client {
+  Client(std::size_t const id, std::unique_ptr<sf::TcpSocket> socket): id(id), connection(std::move(socket)) { }
+
+  ServerClientStats stats() const {
+    return {id, connection.stats(), chunksSent, unloadsSent, deltasSent, deltaCellsSent, fullResends, editsApplied,
+            pongs ? static_cast<float>(rttMsTotal / pongs) : .0f, rttMsMax};
+  }
+
+  std::size_t id;
+  NetConnection connection;
+  // Said hello with a protocol version we speak
+  bool welcomed = false;
+  float radius  = .0f;
+  glm::vec3 position{};
+  // The chunk the client was in when its chunks were last unloaded
+  glm::ivec3 center{};
+  struct Sent {
+    glm::ivec3 position;
+    // The chunk's version as the client has it
+    std::uint64_t version;
+  };
+  // Chunks the client has, by ChunkIndex
+  std::unordered_map<long long, Sent> sent;
+  // Chunks the client asked for the changes to since the version it has
+  std::vector<long long> resyncs;
+  // Every offset before this one was sent or is below the world
+  std::size_t sentUpTo = 0;
+
+  std::size_t chunksSent = 0, unloadsSent = 0, deltasSent = 0, deltaCellsSent = 0, fullResends = 0, editsApplied = 0, pongs = 0;
+  double rttMsTotal = .0;
+  float rttMsMax = .0f;
+};
+
+ChunkServer::ChunkServer(long long const seed, ServerOptions options):
+  world(&position, seed, ServerWorldOptions(options.world)), options(std::move(options)), seed(seed) {
+  auto const radius = static_cast<int>(MaxRadius());
+  for(int x = -radius; x <= radius; ++x)
+    for(int y = -radius; y <= radius; ++y)
+      for(int z = -radius; z <= radius; ++z)
+        if(glm::length(glm::vec3(x, y, z)) <= MaxRadius())
+          offsets.emplace_back(x, y, z);
+  std::sort(offsets.begin(), offsets.end(), [](glm::ivec3 const &a, glm::ivec3 const &b) {
+    return glm::dot(glm::vec3(a), glm::vec3(a)) < glm::dot(glm::vec3(b), glm::vec3(b));
+  });
+  for(auto const &offset: offsets)
+    offsetDists.push_back(glm::length(glm::vec3(offset)));
+}
+
+ChunkServer::~ChunkServer() = default;
+
+bool ChunkServer::listen() {
+  if(listener.listen(options.port) != sf::Socket::Done) {
+    std::cerr << "Unable to listen on port " << options.port << "\n";
+    return false;
+  }
+  listener.setBlocking(false);
+  return true;
+}
+
+void ChunkServer::run(std::atomic<bool> const &running) {
+  auto const period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / options.ticksPerSecond));
+  auto last = Clock::now(), next = last;
+  while(running) {
+    auto const now = Clock::now();
+    tick(std::chrono::duration<float>(now - last).count());
+    last = now;
+    // A server that falls behind carries on from now rather than catching up with a burst of ticks
+    next = std::max(next + period, Clock::now());
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void ChunkServer::tick(float const dt) {
+  float tickMs;
+  {
+    TimedBlock<std::milli> timer(tickMs);
+    accept();
+    for(auto &client: clients)
+      client->connection.receive([&](NetMessage const type, NetReader &reader) { return handle(*client, type, reader); });
+    clients.erase(std::remove_if(clients.begin(), clients.end(), [&](std::unique_ptr<Client> const &client) {
+                    if(client->connection.isOpen())
+                      return false;
+                    gone.push_back(client->stats());
+                    return true;
+                  }),
+                  clients.end());
+
+    // The world is loaded around the clients
+    glm::vec3 sum{};
+    std::size_t welcomed = 0;
+    for(auto const &client: clients)
+      if(client->welcomed)
+        sum += client->position, ++welcomed;
+    if(welcomed)
+      position = sum / static_cast<float>(welcomed);
+
+    world.blockTicks.update(world, dt);
+    world.fluids.update(world, dt);
+    world.items.tick(world, dt);
+    world.releaseUnloaded();
+    world.dropMeshes();
+
+    collectUpdates();
+    NetWriter ping;
+    ping.u32(ticks);
+    ping.u64(static_cast<std::uint64_t>(SteadyMicros()));
+    for(auto &client: clients) {
+      if(!client->welcomed)
+        continue;
+      sendUpdates(*client);
+      streamChunks(*client);
+      client->connection.send(NetMessage::Ping, ping);
+      client->connection.flush();
+    }
+    ++ticks;
+  }
+  tickMsTotal += tickMs;
+  tickMsMax = std::max(tickMsMax, tickMs);
+}
+
+void ChunkServer::accept() {
+  auto socket = std::make_unique<sf::TcpSocket>();
+  while(listener.accept(*socket) == sf::Socket::Done) {
+    clients.push_back(std::make_unique<Client>(nextClientId++, std::move(socket)));
+    socket = std::make_unique<sf::TcpSocket>();
+  }
+}
+
+bool ChunkServer::handle(Client &client, NetMessage const type, NetReader &reader) {
+  if(!client.welcomed && type != NetMessage::Hello)
+    return false;
+
+  switch(type) {
+  case NetMessage::Hello: {
+    auto const version = reader.u32();
+    auto const radius  = reader.f32();
+    if(version != NetProtocolVersion || client.welcomed || !(radius >= .0f))
+      return false;
+    client.radius   = std::min(radius, MaxRadius());
+    client.welcomed = true;
+    NetWriter welcome;
+    welcome.u32(NetProtocolVersion);
+    welcome.u64(static_cast<std::uint64_t>(seed));
+    client.connection.send(NetMessage::Welcome, welcome);
+    return true;
+  }
+  case NetMessage::Position: {
+    glm::vec3 position;
+    position.x = reader.f32();
+    position.y = reader.f32();
+    position.z = reader.f32();
+    if(!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z))
+      return false;
+    client.position = position;
+    return true;
+  }
+  case NetMessage::Edit: {
+    auto const x      = static_cast<BlockCoord>(reader.svarint());
+    auto const y      = static_cast<BlockCoord>(reader.svarint());
+    auto const z      = static_cast<BlockCoord>(reader.svarint());
+    auto const handle = static_cast<BlockHandle>(reader.svarint());
+    if(handle < 0 || static_cast<std::size_t>(handle) >= BlockFactoryHandles.size())
+      return false;
+    // Only in chunks the client can see
+    auto const chunk = ChunkIndex(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y), Chunk::decomposeChunkFromBlock(z));
+    if(reader.ok() && z >= 0 && client.sent.count(chunk.repr)) {
+      applyEdit(x, y, z, handle);
+      ++client.editsApplied;
+    }
+    return true;
+  }
+  case NetMessage::Resync: {
+    // One at a time, as arguments are read in no particular order
+    glm::ivec3 c;
+    c.x = static_cast<BlockCoord>(reader.svarint());
+    c.y = static_cast<BlockCoord>(reader.svarint());
+    c.z = static_cast<BlockCoord>(reader.svarint());
+    auto const version = reader.version();
+    if(!reader.ok())
+      return false;
+    // Chunks the client shouldn't have anymore, once it has said where it is
+    if(c.z < 0 || glm::length(glm::vec3(c - ChunkOf(client.position))) > client.radius + UnloadMargin) {
+      unload(client, c);
+      return true;
+    }
+    auto const key  = ChunkIndex(c.x, c.y, c.z).repr;
+    client.sent[key] = {c, version};
+    client.resyncs.push_back(key);
+    return true;
+  }
+  case NetMessage::Pong: {
+    reader.u32();
+    auto const sentAt = static_cast<long long>(reader.u64());
+    auto const rttMs  = (SteadyMicros() - sentAt) / 1000.f;
+    client.rttMsTotal += rttMs;
+    client.rttMsMax = std::max(client.rttMsMax, rttMs);
+    ++client.pongs;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void ChunkServer::applyEdit(BlockCoord const x, BlockCoord const y, BlockCoord const z, BlockHandle const handle) {
+  auto const xx = Chunk::decomposeBlockPos(x);
+  auto const yy = Chunk::decomposeBlockPos(y);
+  auto const zz = Chunk::decomposeBlockPos(z);
+  auto const c  = world.getChunk<false>(xx.second, yy.second, zz.second);
+  if(!c)
+    return;
+  auto const block = c->blockAt(xx.first, yy.first, zz.first);
+  if(handle == InvalidHandle) {
+    if(block) {
+      block->onBreak(world, x, y, z);
+      c->removeBlockAt(xx.first, yy.first, zz.first);
+    }
+  }
+  else if(!block)
+    c->addBlockAt(xx.first, yy.first, zz.first, BlockFactoryHandles[handle](x, y, z, &world));
+}
+
+void ChunkServer::collectUpdates() {
+  updates.clear();
+  changed.clear();
+  for(auto const &c: world.takeChangedChunks())
+    if(auto chunk = world.getChunk<false>(c.x, c.y, c.z))
+      changed.emplace_back(ChunkIndex(c.x, c.y, c.z).repr, std::move(chunk));
+}
+
+ChunkServer::ChunkUpdate const &ChunkServer::updateFor(Chunk &chunk, long long const key, std::uint64_t const from) {
+  auto const [it, added] = updates.try_emplace({key, from});
+  auto &update           = it->second;
+  if(!added)
+    return update;
+
+  update.to = from;
+  if(ChunkDelta delta; DeltaSince(chunk, from, delta)) {
+    WriteChunkDelta(update.body, delta);
+    update.to    = delta.to;
+    update.cells = delta.cells.size();
+    if(update.body.bytes.size() <= DeltaAlwaysBytes)
+      return update;
+  }
+
+  // The whole chunk, when there's no delta from that far back or it's larger than the chunk
+  auto const version = chunk.changes.version();
+  PackedVoxels packed;
+  if(!PackVoxels(*chunk.snapshot(), packed))
+    return update;
+  NetWriter full;
+  WriteChunk(full, chunk.cx, chunk.cy, chunk.cz, version, packed);
+  if(update.to == from || full.bytes.size() < update.body.bytes.size()) {
+    update.full  = true;
+    update.body  = std::move(full);
+    update.to    = version;
+    update.cells = ChunkVolume;
+  }
+  return update;
+}
+
+void ChunkServer::sendUpdates(Client &client) {
+  // Chunks asked for, then chunks that changed
+  std::vector<std::pair<long long, std::shared_ptr<Chunk>>> asked;
+  for(auto const key: client.resyncs) {
+    auto const it = client.sent.find(key);
+    if(it == client.sent.end())
+      continue;
+    auto const &c = it->second.position;
+    if(auto chunk = world.getChunk<false>(c.x, c.y, c.z); chunk && IsLit(*chunk))
+      asked.emplace_back(key, std::move(chunk));
+    else {
+      // Its copy is dropped, or it would be left out of date if the client moves away before it's sent whole again
+      unload(client, c);
+      client.sent.erase(it);
+      client.sentUpTo = 0;
+    }
+  }
+  client.resyncs.clear();
+
+  NetWriter message;
+  std::size_t deltas = 0;
+  for(auto const *chunks: {&asked, &changed})
+    for(auto const &[key, chunk]: *chunks) {
+      auto const it = client.sent.find(key);
+      if(it == client.sent.end() || it->second.version == chunk->changes.version())
+        continue;
+      auto const &update = updateFor(*chunk, key, it->second.version);
+      if(update.to == it->second.version)
+        continue;
+      it->second.version = update.to;
+      if(update.full) {
+        client.connection.send(NetMessage::Chunk, update.body);
+        chunkBytes += update.body.bytes.size();
+        ++client.fullResends;
+      }
+      else {
+        message.bytes.insert(message.bytes.end(), update.body.bytes.begin(), update.body.bytes.end());
+        client.deltaCellsSent += update.cells;
+        ++deltas;
+      }
+    }
+  if(!deltas)
+    return;
+
+  NetWriter count;
+  count.varint(deltas);
+  message.bytes.insert(message.bytes.begin(), count.bytes.begin(), count.bytes.end());
+  client.connection.send(NetMessage::ChunkDeltas, message);
+  client.deltasSent += deltas;
+  deltaBytes += message.bytes.size();
+}
+
+void ChunkServer::sendUnloads(Client &client) {
+  for(auto it = client.sent.begin(); it != client.sent.end();) {
+    auto const c = it->second.position;
+    if(glm::length(glm::vec3(c - client.center)) <= client.radius + UnloadMargin) {
+      ++it;
+      continue;
+    }
+    unload(client, c);
+    it = client.sent.erase(it);
+  }
+}
+
+void ChunkServer::unload(Client &client, glm::ivec3 const &c) {
+  NetWriter message;
+  message.svarint(c.x);
+  message.svarint(c.y);
+  message.svarint(c.z);
+  client.connection.send(NetMessage::Unload, message);
+  ++client.unloadsSent;
+}
+
+void ChunkServer::streamChunks(Client &client) {
+  auto const center = ChunkOf(client.position);
+  if(center != client.center) {
+    client.center   = center;
+    client.sentUpTo = 0;
+    sendUnloads(client);
+  }
+  if(client.connection.queuedBytes() >= options.chunkBytesPerTick)
+    return;
+
+  // Nearest first, those that are lit
+  std::vector<std::shared_ptr<Chunk>> ready;
+  {
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    auto gap = false;
+    for(auto i = client.sentUpTo; i < offsets.size() && offsetDists[i] <= client.radius && ready.size() < ChunksPerTick; ++i) {
+      auto const c = center + offsets[i];
+      if(c.z >= 0 && !client.sent.count(ChunkIndex(c.x, c.y, c.z).repr)) {
+        if(auto chunk = world.getChunk<true>(c.x, c.y, c.z); chunk && IsLit(*chunk))
+          ready.push_back(std::move(chunk));
+        gap = true;
+      }
+      if(!gap)
+        client.sentUpTo = i + 1;
+    }
+  }
+
+  PackedVoxels packed;
+  for(auto const &chunk: ready) {
+    if(client.connection.queuedBytes() >= options.chunkBytesPerTick)
+      break;
+    // Read before the snapshot, so changes made meanwhile are sent again rather than missed
+    auto const version = chunk->changes.version();
+    client.sent[ChunkIndex(chunk->cx, chunk->cy, chunk->cz).repr] = {glm::ivec3(chunk->cx, chunk->cy, chunk->cz), version};
+    if(!PackVoxels(*chunk->snapshot(), packed)) {
+      std::cerr << "Chunk " << chunk->cx << " " << chunk->cy << " " << chunk->cz << " has a block that can't be sent\n";
+      continue;
+    }
+    NetWriter message;
+    WriteChunk(message, chunk->cx, chunk->cy, chunk->cz, version, packed);
+    client.connection.send(NetMessage::Chunk, message);
+    chunkBytes += message.bytes.size();
+    ++client.chunksSent;
+  }
+}
+
+ServerStats ChunkServer::stats() const {
+  ServerStats stats{ticks, ticks ? static_cast<float>(tickMsTotal / ticks) : .0f, tickMsMax, chunkBytes, deltaBytes, gone};
+  for(auto const &client: clients)
+    stats.clients.push_back(client->stats());
+  std::sort(stats.clients.begin(), stats.clients.end(),
+            [](ServerClientStats const &a, ServerClientStats const &b) { return a.id < b.id; });
+  return stats;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "NetProtocol.hpp"
+#include "World.hpp"
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct ServerOptions {
+  unsigned short port = DefaultServerPort;
+  float ticksPerSecond = 20.f;
+  // Chunk bytes a client's queue may fill up to in a tick. Chunks wait while a client's backlog is larger.
+  std::size_t chunkBytesPerTick = 256 << 10;
+  // The world's options, chunk meshing off
+  WorldOptions world;
+};
+
+struct ServerClientStats {
+  std::size_t id;
+  ConnectionStats connection;
+  std::size_t chunksSent, unloadsSent;
+  // Chunk deltas, the cells in them, and chunks sent whole again because a delta would have been larger
+  std::size_t deltasSent, deltaCellsSent, fullResends;
+  std::size_t editsApplied;
+  // Round trips of pings as the server sees them, up to a tick of waiting for the Pong to be read included
+  float rttMsAvg, rttMsMax;
+};
+
+struct ServerStats {
+  std::size_t ticks;
+  float tickMsAvg, tickMsMax;
+  // Bytes of the chunk and chunk delta messages sent to all clients
+  std::size_t chunkBytes, deltaBytes;
+  std::vector<ServerClientStats> clients;
+};
+
+// A world with no window that streams its chunks to clients over TCP. Every client says how far around it wants
+// chunks, and is sent the lit chunks in that radius nearest first, as many per tick as fit its budget, and told to
+// drop those that fall out of it. At the end of every tick, a client that has a chunk which changed is sent what
+// changed since the version it has, or the whole chunk if that's smaller.
+//
+// The server has one world, loaded around the clients' average position; clients far from each other only get
+// what's loaded near them.
+struct ChunkServer {
+  ChunkServer(long long seed, ServerOptions options = {});
+  ~ChunkServer();
+  ChunkServer(ChunkServer const &) = delete;
+  ChunkServer &operator=(ChunkServer const &) = delete;
+
+  // Starts listening. False if the port is taken.
+  bool listen();
+  unsigned short port() const { return listener.getLocalPort(); }
+  // Ticks at the options' rate until running is cleared
+  void run(std::atomic<bool> const &running);
+  // Takes new clients and their messages, steps the world and sends out what changed
+  void tick(float dt);
+
+  ServerStats stats() const;
+
+  glm::vec3 position{};
+  World world;
+
+private:
+  struct Client;
+
+  void accept();
+  bool handle(Client &client, NetMessage type, NetReader &reader);
+  void applyEdit(BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle handle);
+  // The chunks that changed since the last tick
+  void collectUpdates();
+  struct ChunkUpdate;
+  // What brings a client from version from of chunk to its current version, worked out once per tick
+  ChunkUpdate const &updateFor(Chunk &chunk, long long key, std::uint64_t from);
+  void sendUpdates(Client &client);
+  void sendUnloads(Client &client);
+  // Tells the client to drop a chunk
+  void unload(Client &client, glm::ivec3 const &c);
+  void streamChunks(Client &client);
+
+  ServerOptions const options;
+  long long const seed;
+  sf::TcpListener listener;
+  std::vector<std::unique_ptr<Client>> clients;
+  std::size_t nextClientId = 0;
+  std::uint32_t ticks = 0;
+
+  // Chunk offsets within the load radius, nearest first
+  std::vector<glm::ivec3> offsets;
+  std::vector<float> offsetDists;
+
+  struct ChunkUpdate {
+    // A delta for a ChunkDeltas message, or the whole chunk for a Chunk message
+    NetWriter body;
+    bool full = false;
+    // The version it brings clients to, from if there's nothing to send
+    std::uint64_t to = 0;
+    std::size_t cells = 0;
+  };
+  std::vector<std::pair<long long, std::shared_ptr<Chunk>>> changed;
+  // By chunk and the version clients have
+  std::map<std::pair<long long, std::uint64_t>, ChunkUpdate> updates;
+
+  double tickMsTotal = .0;
+  float tickMsMax = .0f;
+  std::size_t chunkBytes = 0, deltaBytes = 0;
+  std::vector<ServerClientStats> gone;
+};
@@ -0,0 +1,109 @@
+#include "ChunkSlab.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ChunkSlab::ChunkSlab() = default;
+
+ChunkSlab::~ChunkSlab() {
+  // Nobody is reading anymore
+  for(auto const &[epoch, free]: deferred)
+    free();
+  for(auto &page: pages)
+    delete[] page.load();
+}
+
+ChunkHandle ChunkSlab::add(std::shared_ptr<Chunk> chunk) {
+  std::lock_guard<std::mutex> lck(mutex);
+  std::uint32_t index;
+  if(!freeSlots.empty()) {
+    index = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else {
+    index = numSlots++;
+    if(!(index & PageMask)) {
+      if((index >> PageBits) >= MaxPages)
+        throw std::runtime_error("Too many chunks loaded");
+      pages[index >> PageBits].store(new Slot[PageSize], std::memory_order_release);
+    }
+  }
+
+  auto &slot = pages[index >> PageBits].load(std::memory_order_relaxed)[index & PageMask];
+  slot.chunk.store(chunk.get(), std::memory_order_relaxed);
+  slot.owner = std::move(chunk);
+  // Retired slots were left on an odd generation, fresh ones start at 0, both go to the next even one
+  auto const generation = (slot.generation.load(std::memory_order_relaxed) | 1) + 1;
+  slot.generation.store(generation, std::memory_order_release);
+  return {index, generation};
+}
+
+void ChunkSlab::retire(ChunkHandle const handle) {
+  std::lock_guard<std::mutex> lck(mutex);
+  auto &slot = pages[handle.index >> PageBits].load(std::memory_order_relaxed)[handle.index & PageMask];
+  if(slot.generation.load(std::memory_order_relaxed) != handle.generation)
+    return;
+  // Stale before the epoch is read, so readers pinned after it never find the chunk
+  slot.generation.store(handle.generation + 1, std::memory_order_seq_cst);
+  retired.push_back({handle.index, epoch.load(std::memory_order_seq_cst)});
+}
+
+void ChunkSlab::defer(std::function<void()> free) {
+  std::lock_guard<std::mutex> lck(mutex);
+  deferred.emplace_back(epoch.load(std::memory_order_seq_cst), std::move(free));
+}
+
+std::uint64_t ChunkSlab::pin() {
+  for(;;) {
+    auto const e = epoch.load(std::memory_order_seq_cst);
+    ++readers[e & 1];
+    // The epoch could have moved on before this reader was counted, then it would have to wait for the next one
+    if(epoch.load(std::memory_order_seq_cst) == e)
+      return e;
+    --readers[e & 1];
+  }
+}
+
+void ChunkSlab::unpin(std::uint64_t const pinned) { --readers[pinned & 1]; }
+
+std::size_t ChunkSlab::reclaim() {
+  std::vector<std::shared_ptr<Chunk>> freed;
+  std::vector<std::function<void()>> frees;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    if(retired.empty() && deferred.empty())
+      return 0;
+
+    // Readers of the epoch before this one share the parity of the next
+    auto const e = epoch.load(std::memory_order_seq_cst);
+    if(!readers[(e + 1) & 1].load(std::memory_order_seq_cst))
+      epoch.store(e + 1, std::memory_order_seq_cst);
+
+    auto const now = epoch.load(std::memory_order_relaxed);
+    auto const end = std::partition(retired.begin(), retired.end(), [now](Retired const &r) { return r.epoch + 2 > now; });
+    for(auto it = end; it != retired.end(); ++it) {
+      auto &slot = pages[it->index >> PageBits].load(std::memory_order_relaxed)[it->index & PageMask];
+      slot.chunk.store(nullptr, std::memory_order_relaxed);
+      freed.push_back(std::move(slot.owner));
+      freeSlots.push_back(it->index);
+    }
+    retired.erase(end, retired.end());
+
+    auto const due = std::partition(deferred.begin(), deferred.end(), [now](auto const &d) { return d.first + 2 > now; });
+    for(auto it = due; it != deferred.end(); ++it)
+      frees.push_back(std::move(it->second));
+    deferred.erase(due, deferred.end());
+  }
+  // Chunks are destroyed and the rest freed outside the lock
+  for(auto const &free: frees)
+    free();
+  return freed.size();
+}
+
+std::size_t ChunkSlab::numRetired() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return retired.size();
+}
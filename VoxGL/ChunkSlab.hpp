@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct Chunk;
+
+// Refers to a chunk in a ChunkSlab. The generation goes stale once the chunk unloads, so an old handle finds
+// nothing instead of whatever chunk took the slot over.
+struct ChunkHandle {
+  std::uint32_t index = 0, generation = 0;
+};
+
+// Generation 0 is never handed out
+constexpr ChunkHandle NullChunkHandle{};
+
+// The chunks in the world, in slots that handles index. Looking a handle up is a page and slot index and a
+// generation compare, without touching reference counts.
+//
+// Chunks are freed with epoch based reclamation: code that follows handles pins the current epoch with an
+// EpochGuard for as long as it uses what it found, and an unloaded chunk is only let go of once every reader
+// that could have found it has unpinned. The epoch moves on when nobody is pinned to the one before it, so
+// a chunk retired in epoch e is safe to free from epoch e + 2 on.
+struct ChunkSlab {
+  ChunkSlab();
+  ~ChunkSlab();
+
+  // The chunk handle refers to, or nullptr if it has unloaded. Only valid while an EpochGuard is held.
+  Chunk *get(ChunkHandle const handle) const {
+    auto const page = pages[handle.index >> PageBits].load(std::memory_order_acquire);
+    if(!page)
+      return nullptr;
+    auto const &slot = page[handle.index & PageMask];
+    if(slot.generation.load(std::memory_order_acquire) != handle.generation)
+      return nullptr;
+    return slot.chunk.load(std::memory_order_relaxed);
+  }
+
+  // Gives chunk a slot, keeping it alive until it's retired and no reader can see it anymore
+  ChunkHandle add(std::shared_ptr<Chunk> chunk);
+  // Makes handle stale straight away, the chunk itself is let go of by a later reclaim()
+  void retire(ChunkHandle handle);
+  // Runs free once no reader that could have found what it frees is pinned anymore, from a later reclaim()
+  void defer(std::function<void()> free);
+  // Moves the epoch on if it can, and lets go of the chunks no reader can still see. Returns how many.
+  std::size_t reclaim();
+
+  std::size_t numRetired();
+  std::uint64_t currentEpoch() const { return epoch; }
+
+private:
+  friend struct EpochGuard;
+
+  static constexpr std::uint32_t PageBits = 12;
+  static constexpr std::uint32_t PageSize = 1u << PageBits;
+  static constexpr std::uint32_t PageMask = PageSize - 1;
+  static constexpr std::uint32_t MaxPages = 256;
+
+  struct Slot {
+    std::atomic<std::uint32_t> generation{0};
+    std::atomic<Chunk *> chunk{nullptr};
+    // Keeps the chunk alive while it's in the slab, only touched under mutex
+    std::shared_ptr<Chunk> owner;
+  };
+
+  struct Retired {
+    std::uint32_t index;
+    std::uint64_t epoch;
+  };
+
+  std::uint64_t pin();
+  void unpin(std::uint64_t pinned);
+
+  std::array<std::atomic<Slot *>, MaxPages> pages{};
+  std::mutex mutex;
+  std::uint32_t numSlots = 0;
+  std::vector<std::uint32_t> freeSlots;
+  std::vector<Retired> retired;
+  std::vector<std::pair<std::uint64_t, std::function<void()>>> deferred;
+
+  std::atomic<std::uint64_t> epoch{0};
+  // Readers pinned to even and to odd epochs
+  std::array<std::atomic<std::size_t>, 2> readers{};
+};
+
+// Pins the slab's current epoch, so chunks found through handles stay alive until it goes out of scope
+struct EpochGuard {
+  explicit EpochGuard(ChunkSlab &slab): slab(slab), pinned(slab.pin()) { }
+  ~EpochGuard() { slab.unpin(pinned); }
+  EpochGuard(EpochGuard const &) = delete;
+  EpochGuard &operator=(EpochGuard const &) = delete;
+
+private:
+  ChunkSlab &slab;
+  std::uint64_t pinned;
+};
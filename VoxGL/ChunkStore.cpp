@@ -0,0 +1,217 @@
+#include "ChunkStore.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Util.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+  struct Header {
+    char magic[8];
+    std::int64_t seed;
+  };
+
+  constexpr char Magic[8] = {'V', 'o', 'x', 'G', 'L', 'R', 'g', '1'};
+}
+
+static_assert(sizeof(Header) == 16, "The region header is written as is");
+
+static bool SyncRegion(std::FILE *const f) {
+  if(std::fflush(f))
+    return false;
+#ifdef _WIN32
+  return !_commit(_fileno(f));
+#else
+  return !fsync(fileno(f));
+#endif
+}
+
+ChunkStore::ChunkStore(std::string directory, long long const seed): directory(std::move(directory)), seed(seed) { }
+
+ChunkStore::~ChunkStore() {
+  sync();
+  for(auto const &[key, region]: regions)
+    if(region->file)
+      std::fclose(region->file);
+}
+
+std::size_t ChunkStore::IndexOf(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+  auto constexpr Mask = RegionSize - 1;
+  return static_cast<std::size_t>((cx & Mask) | (cy & Mask) << RegionBits | (cz & Mask) << RegionBits * 2);
+}
+
+std::string ChunkStore::pathOf(BlockCoord const rx, BlockCoord const ry, BlockCoord const rz) const {
+  return (std::filesystem::path(directory) /
+          ("r." + std::to_string(rx) + "." + std::to_string(ry) + "." + std::to_string(rz) + ".vxr")).string();
+}
+
+ChunkStore::Region &ChunkStore::region(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+  std::lock_guard<std::mutex> lck(mutex);
+  auto &region = regions[ChunkIndex(cx >> RegionBits, cy >> RegionBits, cz >> RegionBits).repr];
+  if(!region)
+    region = std::make_unique<Region>();
+  return *region;
+}
+
+// The checksum of an entry covers the runs it points to too
+static std::uint32_t EntryCheck(std::uint32_t const offset, std::uint32_t const blockRuns, std::uint32_t const lightRuns,
+                                std::uint32_t const *const runs) {
+  std::uint32_t const fields[] = {offset, blockRuns, lightRuns};
+  return Fnv1a(fields, sizeof(fields), Fnv1a(runs, (blockRuns + lightRuns) * sizeof(std::uint32_t)));
+}
+
+bool ChunkStore::open(Region &region, BlockCoord const rx, BlockCoord const ry, BlockCoord const rz, bool const create) {
+  if(region.file)
+    return true;
+
+  auto const path = pathOf(rx, ry, rz);
+  if(auto const f = std::fopen(path.c_str(), "r+b")) {
+    Header header;
+    auto const ours = std::fread(&header, sizeof(header), 1, f) == 1 && !std::memcmp(header.magic, Magic, sizeof(Magic)) &&
+                      header.seed == seed && std::fread(region.index.data(), sizeof(Entry), RegionVolume, f) == RegionVolume;
+    if(ours) {
+      // Whatever a crash left half written is dropped, it's generated again
+      std::vector<std::uint32_t> runs;
+      for(auto &entry: region.index) {
+        if(!entry.offset)
+          continue;
+        runs.resize(entry.blockRuns + entry.lightRuns);
+        if(entry.blockRuns + entry.lightRuns > 2 * ChunkVolume || std::fseek(f, entry.offset, SEEK_SET) ||
+           std::fread(runs.data(), sizeof(std::uint32_t), runs.size(), f) != runs.size() ||
+           EntryCheck(entry.offset, entry.blockRuns, entry.lightRuns, runs.data()) != entry.check)
+          entry = {};
+      }
+      region.file = f;
+      return true;
+    }
+    std::fclose(f);
+    if(!create)
+      return false;
+    std::cerr << "Region " << path << " belongs to another world, starting it over\n";
+  }
+  else if(!create)
+    return false;
+
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  region.index = {};
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.seed = seed;
+  auto const f = std::fopen(path.c_str(), "w+b");
+  if(!f || std::fwrite(&header, sizeof(header), 1, f) != 1 || std::fwrite(region.index.data(), sizeof(Entry), RegionVolume, f) != RegionVolume) {
+    std::cerr << "Unable to create region " << path << "\n";
+    if(f)
+      std::fclose(f);
+    return false;
+  }
+  region.file = f;
+  return true;
+}
+
+bool ChunkStore::has(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+  auto &r = region(cx, cy, cz);
+  std::lock_guard<std::mutex> lck(r.mutex);
+  return open(r, cx >> RegionBits, cy >> RegionBits, cz >> RegionBits, false) && r.index[IndexOf(cx, cy, cz)].offset;
+}
+
+bool ChunkStore::load(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz, PackedVoxels &packed) {
+  float elapsed;
+  std::size_t bytes = 0;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    auto &r = region(cx, cy, cz);
+    std::lock_guard<std::mutex> lck(r.mutex);
+    if(!open(r, cx >> RegionBits, cy >> RegionBits, cz >> RegionBits, false))
+      return false;
+    auto const &entry = r.index[IndexOf(cx, cy, cz)];
+    if(!entry.offset)
+      return false;
+
+    packed.blocks.resize(entry.blockRuns);
+    packed.light.resize(entry.lightRuns);
+    if(std::fseek(r.file, entry.offset, SEEK_SET) ||
+       std::fread(packed.blocks.data(), sizeof(std::uint32_t), entry.blockRuns, r.file) != entry.blockRuns ||
+       std::fread(packed.light.data(), sizeof(std::uint32_t), entry.lightRuns, r.file) != entry.lightRuns)
+      return false;
+    packed.version = 0;
+    bytes          = packed.bytes();
+  }
+  ++chunksLoaded;
+  bytesRead += bytes;
+  readMicros += static_cast<long long>(elapsed);
+  return true;
+}
+
+bool ChunkStore::save(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz, PackedVoxels const &packed) {
+  std::vector<std::uint32_t> runs(packed.blocks);
+  runs.insert(runs.end(), packed.light.begin(), packed.light.end());
+
+  float elapsed;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    auto &r = region(cx, cy, cz);
+    std::lock_guard<std::mutex> lck(r.mutex);
+    if(!open(r, cx >> RegionBits, cy >> RegionBits, cz >> RegionBits, true) || std::fseek(r.file, 0, SEEK_END))
+      return false;
+
+    Entry entry;
+    entry.offset    = static_cast<std::uint32_t>(std::ftell(r.file));
+    entry.blockRuns = static_cast<std::uint32_t>(packed.blocks.size());
+    entry.lightRuns = static_cast<std::uint32_t>(packed.light.size());
+    entry.check     = EntryCheck(entry.offset, entry.blockRuns, entry.lightRuns, runs.data());
+    auto const i    = IndexOf(cx, cy, cz);
+    if(std::fwrite(runs.data(), sizeof(std::uint32_t), runs.size(), r.file) != runs.size() ||
+       std::fseek(r.file, static_cast<long>(sizeof(Header) + i * sizeof(Entry)), SEEK_SET) ||
+       std::fwrite(&entry, sizeof(entry), 1, r.file) != 1) {
+      std::cerr << "Unable to save chunk " << cx << " " << cy << " " << cz << "\n";
+      return false;
+    }
+    r.index[i] = entry;
+    r.dirty    = true;
+  }
+  ++chunksSaved;
+  bytesWritten += packed.bytes() + sizeof(Entry);
+  writeMicros += static_cast<long long>(elapsed);
+  return true;
+}
+
+bool ChunkStore::sync() {
+  std::vector<Region *> all;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    for(auto const &[key, region]: regions)
+      all.push_back(region.get());
+  }
+
+  float elapsed;
+  auto ok = true;
+  {
+    TimedBlock<std::micro> timer(elapsed);
+    for(auto const r: all) {
+      std::lock_guard<std::mutex> lck(r->mutex);
+      if(!r->dirty)
+        continue;
+      ok = SyncRegion(r->file) && ok;
+      r->dirty = false;
+      ++syncs;
+    }
+  }
+  writeMicros += static_cast<long long>(elapsed);
+  return ok;
+}
+
+StoreStats ChunkStore::stats() const {
+  return {chunksSaved, chunksLoaded, bytesWritten, bytesRead, syncs, writeMicros / 1000.f, readMicros / 1000.f};
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Block.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct PackedVoxels;
+
+struct StoreStats {
+  std::size_t chunksSaved, chunksLoaded, bytesWritten, bytesRead, syncs;
+  // Time spent writing and reading chunks, syncs included
+  float writeMs, readMs;
+};
+
+// Chunks generated ahead of time, as their packed runs in region files of RegionSize³ chunks each. A region file
+// is a header, an index of where in the file every chunk of the region is, and the runs of the chunks in the
+// order they were saved. Saving a chunk again appends its runs anew.
+//
+// Index entries carry a checksum of the runs they point to, and regions are checked as they're opened, so a
+// chunk whose saving was cut short by a crash counts as missing rather than coming back broken.
+struct ChunkStore {
+  static constexpr BlockCoord RegionBits  = 3;
+  static constexpr BlockCoord RegionSize  = 1 << RegionBits;
+  static constexpr std::size_t RegionVolume = RegionSize * RegionSize * RegionSize;
+
+  // Regions saved for another seed count as empty, and are started over when saved into. Nothing is created on
+  // disk until the first chunk is saved.
+  ChunkStore(std::string directory, long long seed);
+  ~ChunkStore();
+  ChunkStore(ChunkStore const &) = delete;
+  ChunkStore &operator=(ChunkStore const &) = delete;
+
+  bool has(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+  bool load(BlockCoord cx, BlockCoord cy, BlockCoord cz, PackedVoxels &packed);
+  bool save(BlockCoord cx, BlockCoord cy, BlockCoord cz, PackedVoxels const &packed);
+  // Waits until every chunk saved so far is on disk
+  bool sync();
+
+  StoreStats stats() const;
+
+private:
+  struct Entry {
+    std::uint32_t offset, blockRuns, lightRuns, check;
+  };
+
+  struct Region {
+    std::mutex mutex;
+    std::FILE *file = nullptr;
+    std::array<Entry, RegionVolume> index{};
+    // Saved into since the last sync
+    bool dirty = false;
+  };
+
+  // The region the chunk is in
+  Region &region(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+  // Opens the region's file, creating it if it doesn't exist yet and create is set. A region without a file has
+  // no chunks. Call under the region's mutex.
+  bool open(Region &region, BlockCoord rx, BlockCoord ry, BlockCoord rz, bool create);
+  std::string pathOf(BlockCoord rx, BlockCoord ry, BlockCoord rz) const;
+  static std::size_t IndexOf(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+
+  std::string directory;
+  long long seed;
+
+  std::mutex mutex;
+  std::unordered_map<long long, std::unique_ptr<Region>> regions;
+
+  std::atomic<std::size_t> chunksSaved{0}, chunksLoaded{0}, bytesWritten{0}, bytesRead{0}, syncs{0};
+  std::atomic<long long> writeMicros{0}, readMicros{0};
+};
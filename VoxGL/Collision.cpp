@@ -0,0 +1,96 @@
+#include "Collision.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <cmath>
+
+// Boxes resting exactly on a face shouldn't count as intersecting it
+constexpr float CollisionEpsilon = 1e-4f;
+
+void ChunkNeighbourhood::fetch(World &world, glm::ivec3 const &min, glm::ivec3 const &max, BlockCoord const pad) {
+  origin = {Chunk::decomposeChunkFromBlock(min.x) - pad, Chunk::decomposeChunkFromBlock(min.y) - pad,
+            Chunk::decomposeChunkFromBlock(min.z) - pad};
+  size   = glm::ivec3{Chunk::decomposeChunkFromBlock(max.x) + pad + 1, Chunk::decomposeChunkFromBlock(max.y) + pad + 1,
+                      Chunk::decomposeChunkFromBlock(max.z) + pad + 1} - origin;
+
+  chunks.assign(size.x * size.y * size.z, nullptr);
+
+  std::lock_guard<std::mutex> lck(world.chunkMutex);
+  for(BlockCoord z = 0; z < size.z; ++z)
+    for(BlockCoord y = 0; y < size.y; ++y)
+      for(BlockCoord x = 0; x < size.x; ++x)
+        chunks[x + size.x * (y + size.y * z)] = world.getChunk<true>(origin.x + x, origin.y + y, origin.z + z);
+}
+
+bool ChunkNeighbourhood::covers(glm::ivec3 const &min, glm::ivec3 const &max) const {
+  auto const inside = [&](BlockCoord lo, BlockCoord hi, int a) {
+    return origin[a] <= Chunk::decomposeChunkFromBlock(lo) && Chunk::decomposeChunkFromBlock(hi) < origin[a] + size[a];
+  };
+  return !chunks.empty() && inside(min.x, max.x, 0) && inside(min.y, max.y, 1) && inside(min.z, max.z, 2);
+}
+
+bool ChunkNeighbourhood::isSolid(BlockCoord const x, BlockCoord const y, BlockCoord const z) const {
+  auto const cx = Chunk::decomposeChunkFromBlock(x) - origin.x;
+  auto const cy = Chunk::decomposeChunkFromBlock(y) - origin.y;
+  auto const cz = Chunk::decomposeChunkFromBlock(z) - origin.z;
+  if(cx < 0 || cy < 0 || cz < 0 || cx >= size.x || cy >= size.y || cz >= size.z)
+    return false;
+
+  auto const &chunk = chunks[cx + size.x * (cy + size.y * cz)];
+  if(!chunk || chunk->isEmpty())
+    return false;
+
+  auto const b = chunk->blockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                                Chunk::decomposeLocalBlockFromBlock(z));
+  return b && b->isSolid();
+}
+
+void SweepBounds(AABB const &box, glm::vec3 const &displacement, glm::ivec3 &min, glm::ivec3 &max) {
+  for(int a = 0; a < 3; ++a) {
+    min[a] = static_cast<BlockCoord>(std::floor(std::min(box.min[a], box.min[a] + displacement[a]) + CollisionEpsilon));
+    max[a] = static_cast<BlockCoord>(std::floor(std::max(box.max[a], box.max[a] + displacement[a]) - CollisionEpsilon));
+  }
+}
+
+SweepResult SweepAABB(ChunkNeighbourhood &neighbourhood, AABB box, glm::vec3 const &displacement) {
+  glm::ivec3 min, max;
+  SweepBounds(box, displacement, min, max);
+
+  auto &candidates = neighbourhood.candidates;
+  candidates.clear();
+  for(auto z = min.z; z <= max.z; ++z)
+    for(auto y = min.y; y <= max.y; ++y)
+      for(auto x = min.x; x <= max.x; ++x)
+        if(neighbourhood.isSolid(x, y, z))
+          candidates.push_back({x, y, z});
+
+  SweepResult result{box, {0, 0, 0}, false, false, false};
+  bool *const hit[3] = {&result.hitX, &result.hitY, &result.hitZ};
+
+  for(auto const a: {2, 0, 1}) {
+    auto d = displacement[a];
+    if(d == .0f)
+      continue;
+
+    auto const b = (a + 1) % 3, c = (a + 2) % 3;
+    for(auto const &cell: candidates) {
+      if(cell[b] + 1 <= box.min[b] + CollisionEpsilon || cell[b] >= box.max[b] - CollisionEpsilon ||
+         cell[c] + 1 <= box.min[c] + CollisionEpsilon || cell[c] >= box.max[c] - CollisionEpsilon)
+        continue;
+
+      if(d > .0f && cell[a] >= box.max[a] - CollisionEpsilon)
+        d = std::min(d, std::max(.0f, cell[a] - box.max[a]));
+      else if(d < .0f && cell[a] + 1 <= box.min[a] + CollisionEpsilon)
+        d = std::max(d, std::min(.0f, cell[a] + 1 - box.min[a]));
+    }
+
+    *hit[a] = d != displacement[a];
+    box.min[a] += d;
+    box.max[a] += d;
+    result.moved[a] = d;
+  }
+
+  result.box = box;
+  return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Blocks.hpp"
+
+#include "glm/glm.hpp"
+
+#include <memory>
+#include <vector>
+
+struct Chunk;
+struct World;
+
+struct AABB {
+  glm::vec3 min, max;
+};
+
+// A box to be moved by displacement this tick
+struct Body {
+  AABB box;
+  glm::vec3 displacement;
+};
+
+struct SweepResult {
+  AABB box;
+  // How far the box actually moved
+  glm::vec3 moved;
+  // Axes the box was stopped on
+  bool hitX, hitY, hitZ;
+  bool onGround() const { return hitZ && moved.z <= .0f; }
+};
+
+// The chunks around a region, fetched under a single chunkMutex lock so that
+// solid checks are plain array indexing afterwards.
+struct ChunkNeighbourhood {
+  // Fetches the chunks overlapping the blocks min to max inclusive, padded by pad chunks on every side
+  void fetch(World &world, glm::ivec3 const &min, glm::ivec3 const &max, BlockCoord pad = 0);
+  bool covers(glm::ivec3 const &min, glm::ivec3 const &max) const;
+  // Unloaded chunks count as empty
+  bool isSolid(BlockCoord x, BlockCoord y, BlockCoord z) const;
+
+  // Solid cells gathered by the current sweep, kept around to avoid reallocating
+  std::vector<glm::ivec3> candidates;
+
+private:
+  glm::ivec3 origin{}, size{};
+  std::vector<std::shared_ptr<Chunk>> chunks;
+};
+
+// Blocks a box touches while moving by displacement
+void SweepBounds(AABB const &box, glm::vec3 const &displacement, glm::ivec3 &min, glm::ivec3 &max);
+
+// Moves box by displacement against the solid cells in neighbourhood, resolving z first, then x and y.
+// The neighbourhood must cover SweepBounds of the move.
+SweepResult SweepAABB(ChunkNeighbourhood &neighbourhood, AABB box, glm::vec3 const &displacement);
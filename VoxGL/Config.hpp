@@ -57,9 +57,9 @@ void Read(std::istream &is, std::vector<T> &target) {
   size_t size;
   is >> size;
   target.resize(size);
-  while(size -- > 0) {
+  for(size_t i = 0; i < size; ++i) {
     Read(is, val);
-    target[size] = val;
+    target[i] = val;
   }
 }
 
@@ -0,0 +1,202 @@
+#include "Decoration.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Worldgen.hpp"
+
+#include <cstdlib>
+
+// One grass column in TreeChance grows a tree
+constexpr std::uint64_t TreeChance = 64;
+constexpr BlockCoord TreeMinHeight = 4;
+constexpr BlockCoord TreeMaxHeight = 6;
+// Coal veins wander through the stone layer at the bottom of the world
+constexpr int VeinsPerChunk  = 3;
+constexpr int VeinLength     = 8;
+constexpr BlockCoord OreMaxZ = 16;
+
+// The top byte ranks the block, logs beat leaves, the rest breaks ties between features
+constexpr std::uint64_t LogPriority    = 2ull << 56;
+constexpr std::uint64_t LeavesPriority = 1ull << 56;
+constexpr std::uint64_t OrePriority    = 1ull << 56;
+constexpr std::uint64_t FeatureMask    = (1ull << 56) - 1;
+
+static std::uint64_t FeatureHash(long long const seed, BlockCoord const x, BlockCoord const y, BlockCoord const z, std::uint64_t const salt) {
+  auto h = static_cast<std::uint64_t>(seed) ^ salt * 0x9e3779b97f4a7c15ull;
+  for(auto const v: {x, y, z}) {
+    h ^= static_cast<std::uint32_t>(v);
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 31;
+  }
+  return h;
+}
+
+static void AddTree(std::vector<DecorationWrite> &out, BlockCoord const x, BlockCoord const y, BlockCoord const z, std::uint64_t const h) {
+  auto const height = TreeMinHeight + static_cast<BlockCoord>((h >> 8) % (TreeMaxHeight - TreeMinHeight + 1));
+  auto const rank   = h & FeatureMask;
+  auto const top    = z + height - 1;
+
+  for(auto tz = z; tz <= top; ++tz)
+    out.push_back({x, y, tz, LogHandle, DecorationTarget::Air, LogPriority | rank});
+
+  // Two wide layers around the top of the trunk with their corners cut, then a narrow cap
+  for(BlockCoord dz = -2; dz <= 1; ++dz) {
+    auto const radius = dz < 0 ? 2 : 1;
+    for(auto dy = -radius; dy <= radius; ++dy)
+      for(auto dx = -radius; dx <= radius; ++dx) {
+        if((radius == 2 && std::abs(dx) == 2 && std::abs(dy) == 2) || (dz == 1 && dx && dy) || (!dx && !dy && dz <= 0))
+          continue;
+        out.push_back({x + dx, y + dy, top + dz, LeavesHandle, DecorationTarget::Air, LeavesPriority | rank});
+      }
+  }
+}
+
+static void AddVein(std::vector<DecorationWrite> &out, BlockCoord x, BlockCoord y, BlockCoord z, std::uint64_t h) {
+  auto const rank = h & FeatureMask;
+  for(int i = 0; i < VeinLength; ++i) {
+    out.push_back({x, y, z, CoalOreHandle, DecorationTarget::Stone, OrePriority | rank});
+    auto const [dx, dy, dz] = Vdxyz[h % Vdxyz.size()];
+    x += dx, y += dy, z += dz;
+    h = FeatureHash(static_cast<long long>(h), x, y, z, i);
+  }
+}
+
+std::vector<DecorationWrite> ChunkFeatures(ChunkColumnGen const &gen, BlockCoord const cx, BlockCoord const cy, BlockCoord const cz,
+                                           long long const seed, std::size_t &features) {
+  std::vector<DecorationWrite> out;
+  auto const x0 = cx * ChunkSize, y0 = cy * ChunkSize, z0 = cz * ChunkSize;
+
+  // Trees grow from the grass columns whose surface is in this chunk
+  for(BlockCoord by = 0; by < ChunkSize; ++by)
+    for(BlockCoord bx = 0; bx < ChunkSize; ++bx) {
+      auto const i      = bx + by * ChunkSize;
+      auto const ground = gen.heights[i];
+      if(ground + 1 < z0 || ground + 1 >= z0 + ChunkSize || ground < OreMaxZ || gen.temperatures[i] > .5f)
+        continue;
+      auto const h = FeatureHash(seed, x0 + bx, y0 + by, 0, 1);
+      if(h % TreeChance)
+        continue;
+      AddTree(out, x0 + bx, y0 + by, ground + 1, h);
+      ++features;
+    }
+
+  if(z0 < OreMaxZ)
+    for(int v = 0; v < VeinsPerChunk; ++v) {
+      auto const h = FeatureHash(seed, cx, cy, cz, 2 + v);
+      AddVein(out, x0 + static_cast<BlockCoord>(h & ChunkBlockMask), y0 + static_cast<BlockCoord>((h >> 4) & ChunkBlockMask),
+              z0 + static_cast<BlockCoord>((h >> 8) & ChunkBlockMask), h >> 12);
+      ++features;
+    }
+
+  return out;
+}
+
+bool Decorations::apply(World &world, Chunk &chunk, DecorationWrite const &write) {
+  auto const lx = Chunk::decomposeLocalBlockFromBlock(write.x), ly = Chunk::decomposeLocalBlockFromBlock(write.y),
+             lz = Chunk::decomposeLocalBlockFromBlock(write.z);
+  auto const pos = static_cast<std::uint16_t>(Chunk::blockPos(lx, ly, lz));
+
+  std::lock_guard<std::mutex> lck(chunk.decorationMutex);
+  if(auto const it = chunk.decoratedCells.find(pos); it != chunk.decoratedCells.end()) {
+    if(it->second.target != write.target || it->second.priority >= write.priority)
+      return false;
+  }
+  else {
+    auto const b = chunk.blockAt(lx, ly, lz);
+    if(write.target == DecorationTarget::Air ? b != nullptr : dynamic_cast<StoneBlock *>(b) == nullptr)
+      return false;
+  }
+
+  chunk.setBlockAt(lx, ly, lz, CreateBlock(write.block, write.x, write.y, write.z, &world));
+  chunk.decoratedCells[pos] = {write.priority, write.target};
+  ++writes;
+  return true;
+}
+
+std::vector<std::shared_ptr<Chunk>> Decorations::decorate(World &world, std::shared_ptr<Chunk> const &chunk) {
+  auto const key = ChunkIndex(chunk->cx, chunk->cy, chunk->cz).repr;
+
+  // From here on neighbours decorated after this chunk place their features in it themselves. Of two neighbours
+  // decorated at the same time at least one sees the other, and writes placed twice lose to themselves.
+  std::vector<glm::ivec3> before;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    decorated[key] = {chunk->cx, chunk->cy, chunk->cz, chunk->handle};
+    for(BlockCoord dx = -1; dx <= 1; ++dx)
+      for(BlockCoord dy = -1; dy <= 1; ++dy)
+        for(BlockCoord dz = -1; dz <= 1; ++dz)
+          if((dx || dy || dz) && decorated.count(ChunkIndex(chunk->cx + dx, chunk->cy + dy, chunk->cz + dz).repr))
+            before.emplace_back(chunk->cx + dx, chunk->cy + dy, chunk->cz + dz);
+  }
+
+  // Neighbours decorated before, loaded or not, only need their column's generation data to work out again what
+  // they place here
+  for(auto const &n: before) {
+    std::size_t ignored = 0;
+    for(auto const &write: ChunkFeatures(*world.columnGen(n.x, n.y), n.x, n.y, n.z, world.getSeed(), ignored))
+      if(write.z >= 0 && ChunkIndex(Chunk::decomposeChunkFromBlock(write.x), Chunk::decomposeChunkFromBlock(write.y),
+                                    Chunk::decomposeChunkFromBlock(write.z)).repr == key)
+        neighbours += apply(world, *chunk, write);
+  }
+
+  std::size_t numFeatures = 0;
+  auto const gen = world.columnGen(chunk->cx, chunk->cy);
+  std::unordered_map<std::int64_t, std::vector<DecorationWrite>> spilled;
+  for(auto const &write: ChunkFeatures(*gen, chunk->cx, chunk->cy, chunk->cz, world.getSeed(), numFeatures)) {
+    if(write.z < 0)
+      continue;
+    auto const target = ChunkIndex(Chunk::decomposeChunkFromBlock(write.x), Chunk::decomposeChunkFromBlock(write.y),
+                                   Chunk::decomposeChunkFromBlock(write.z)).repr;
+    if(target == key)
+      apply(world, *chunk, write);
+    else
+      spilled[target].push_back(write);
+  }
+
+  // Neighbours not decorated yet work these out themselves when they are, unloaded ones when they load again
+  std::vector<std::shared_ptr<Chunk>> changed;
+  EpochGuard guard(world.slab);
+  for(auto &[target, writes]: spilled) {
+    std::shared_ptr<Chunk> other;
+    {
+      std::lock_guard<std::mutex> lck(mutex);
+      if(auto const it = decorated.find(target); it != decorated.end())
+        if(auto const c = world.slab.get(it->second.handle))
+          other = c->shared_from_this();
+    }
+    if(!other)
+      continue;
+
+    auto any = false;
+    for(auto const &write: writes)
+      if(apply(world, *other, write)) {
+        world.light.update(write.x, write.y, write.z);
+        ++late;
+        any = true;
+      }
+    if(any)
+      changed.push_back(std::move(other));
+  }
+
+  ++chunks;
+  features += numFeatures;
+  return changed;
+}
+
+void Decorations::prune(glm::vec3 const &center, float const radius) {
+  std::lock_guard<std::mutex> lck(mutex);
+  for(auto it = decorated.begin(); it != decorated.end();) {
+    auto const d = glm::vec3(it->second.cx, it->second.cy, it->second.cz) + .5f - center;
+    if(d.x * d.x + d.y * d.y + d.z * d.z > radius * radius)
+      it = decorated.erase(it);
+    else
+      ++it;
+  }
+}
+
+std::size_t Decorations::numDecorated() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return decorated.size();
+}
+
+DecorationStats Decorations::stats() const { return {chunks, features, writes, neighbours, late}; }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Blocks.hpp"
+#include "ChunkSlab.hpp"
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct Chunk;
+struct ChunkColumnGen;
+struct World;
+
+// What a feature block may replace, judged by the terrain that was generated there
+enum struct DecorationTarget : std::uint8_t {
+  Air,
+  Stone,
+};
+
+// A block a feature wants placed, in world coordinates
+struct DecorationWrite {
+  BlockCoord x, y, z;
+  BlockHandle block;
+  DecorationTarget target;
+  // Where features overlap the highest priority wins, so they come out the same whatever order they arrive in
+  std::uint64_t priority;
+};
+
+// A cell some feature won, kept so later writes are judged against the terrain rather than the feature
+struct DecoratedCell {
+  std::uint64_t priority;
+  DecorationTarget target;
+};
+
+// Trees and ore veins rooted in chunk cx, cy, cz, adding how many there are to features. Worked out from the seed
+// and the chunk column's generation data only, never from other chunks, so any thread can decorate any chunk.
+std::vector<DecorationWrite> ChunkFeatures(ChunkColumnGen const &gen, BlockCoord cx, BlockCoord cy, BlockCoord cz, long long seed,
+                                           std::size_t &features);
+
+struct DecorationStats {
+  // Writes counts the blocks placed, neighbours the ones a chunk took from its neighbours' features when it was
+  // decorated after them, late the ones that reached a chunk decorated before the feature's own
+  std::size_t chunks, features, writes, neighbours, late;
+};
+
+// Places features after base terrain. A chunk decorated works its neighbours' features out again for what they
+// place in it, where the neighbours were decorated first, and places what its own features spill into neighbours
+// decorated before it straight away. Since every write is resolved by priority against the generated terrain, the
+// result doesn't depend on generation order, thread count or which chunks were unloaded in between.
+struct Decorations {
+  // Places what chunk's neighbours and its own features place in it, and the parts of its own features that reach
+  // loaded neighbours decorated before it. Call once per chunk, before it is added to the world but after it has
+  // its handle, and again if it is generated again after unloading. Returns the other chunks that changed. Safe to
+  // call from any thread.
+  std::vector<std::shared_ptr<Chunk>> decorate(World &world, std::shared_ptr<Chunk> const &chunk);
+
+  // Forgets the chunks further than radius chunks from center, which have to have unloaded by then. They're
+  // decorated like new ones if they load again.
+  void prune(glm::vec3 const &center, float radius);
+  // Chunks remembered as decorated
+  std::size_t numDecorated();
+  DecorationStats stats() const;
+
+private:
+  struct Decorated {
+    BlockCoord cx, cy, cz;
+    // So unloaded chunks don't stay allocated for as long as they're in here
+    ChunkHandle handle;
+  };
+
+  bool apply(World &world, Chunk &chunk, DecorationWrite const &write);
+
+  std::mutex mutex;
+  std::unordered_map<std::int64_t, Decorated> decorated;
+
+  std::atomic<std::size_t> chunks{0}, features{0}, writes{0}, neighbours{0}, late{0};
+};
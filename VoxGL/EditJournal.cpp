@@ -0,0 +1,235 @@
+#include "EditJournal.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+  struct Header {
+    char magic[8];
+    std::int64_t seed;
+  };
+
+  constexpr char Magic[8] = {'V', 'o', 'x', 'G', 'L', 'E', 'd', '1'};
+}
+
+static_assert(sizeof(Header) == 16, "The journal header is written as is");
+
+static bool WriteAll(std::FILE *const f, void const *const data, std::size_t const bytes) {
+  return std::fwrite(data, 1, bytes, f) == bytes;
+}
+
+// Past the OS buffers, onto the disk
+static bool SyncFile(std::FILE *const f) {
+  if(std::fflush(f))
+    return false;
+#ifdef _WIN32
+  return !_commit(_fileno(f));
+#else
+  return !fsync(fileno(f));
+#endif
+}
+
+static bool WriteHeader(std::FILE *const f, long long const seed) {
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.seed = seed;
+  return WriteAll(f, &header, sizeof(header));
+}
+
+EditJournal::EditJournal(std::string path, long long const seed): path(std::move(path)), seed(seed) {
+  if(this->path.empty())
+    return;
+
+  {
+    TimedBlock<std::milli> timer(recoverMs);
+    recover();
+  }
+
+  file = std::fopen(this->path.c_str(), recordsInFile ? "ab" : "wb");
+  if(!file || (!recordsInFile && !(WriteHeader(file, seed) && SyncFile(file)))) {
+    std::cerr << "Unable to open edit journal " << this->path << ", edits won't be kept\n";
+    if(file)
+      std::fclose(file);
+    file = nullptr;
+    return;
+  }
+  enabled   = true;
+  committer = std::thread(&EditJournal::commitLoop, this);
+}
+
+EditJournal::~EditJournal() {
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if(committer.joinable())
+    committer.join();
+  if(file)
+    std::fclose(file);
+}
+
+EditJournal::Record EditJournal::MakeRecord(BlockEdit const &edit) {
+  Record record{edit.x, edit.y, edit.z, edit.from, edit.to, 0};
+  // Over everything but the check itself, so a record only half written doesn't pass
+  record.check = Fnv1a(&record, offsetof(Record, check));
+  return record;
+}
+
+void EditJournal::remember(Record const &record) {
+  auto const [bx, cx] = Chunk::decomposeBlockPos(record.x);
+  auto const [by, cy] = Chunk::decomposeBlockPos(record.y);
+  auto const [bz, cz] = Chunk::decomposeBlockPos(record.z);
+  auto &chunk         = latest[ChunkIndex(cx, cy, cz).repr];
+  auto const [it, added] = chunk.try_emplace(static_cast<std::uint16_t>(Chunk::blockPos(bx, by, bz)), record);
+  if(added)
+    ++editedBlocks;
+  else
+    it->second.to = record.to;
+}
+
+void EditJournal::recover() {
+  auto const f = std::fopen(path.c_str(), "rb");
+  if(!f)
+    return;
+
+  Header header;
+  auto const ours = std::fread(&header, sizeof(header), 1, f) == 1 && !std::memcmp(header.magic, Magic, sizeof(Magic)) &&
+                    header.seed == seed;
+  Record record;
+  while(ours && std::fread(&record, sizeof(record), 1, f) == 1 && Fnv1a(&record, offsetof(Record, check)) == record.check) {
+    remember(record);
+    ++recordsInFile;
+  }
+  std::fclose(f);
+
+  if(!ours) {
+    std::cerr << "Edit journal " << path << " belongs to another world, starting it over\n";
+    return;
+  }
+  recovered = recordsInFile;
+
+  // Appends go after the last whole record
+  auto const good = sizeof(Header) + recordsInFile * sizeof(Record);
+  std::error_code error;
+  if(std::filesystem::file_size(path, error) > good) {
+    std::cerr << "Dropping the torn end of edit journal " << path << "\n";
+    std::filesystem::resize_file(path, good, error);
+  }
+}
+
+void EditJournal::append(BlockEdit const &edit) {
+  auto const record = MakeRecord(edit);
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    if(!enabled)
+      return;
+    remember(record);
+    pending.push_back(record);
+    ++appended;
+  }
+  wake.notify_one();
+}
+
+void EditJournal::sync() {
+  std::unique_lock<std::mutex> lck(mutex);
+  auto const target = appended;
+  synced.wait(lck, [&] { return committed >= target; });
+}
+
+void EditJournal::commitLoop() {
+  std::vector<Record> group, compacted;
+  std::unique_lock<std::mutex> lck(mutex);
+  for(;;) {
+    wake.wait(lck, [&] { return stopping || !pending.empty(); });
+    if(pending.empty())
+      return;
+    // Edits coming in right behind the first share its fsync
+    wake.wait_for(lck, GroupWindow, [&] { return stopping || pending.size() >= MaxGroup; });
+    group.swap(pending);
+
+    // What's remembered already has the edits in this group
+    auto const compacting = recordsInFile + group.size() > CompactAfter && recordsInFile + group.size() > CompactRatio * editedBlocks;
+    compacted.clear();
+    if(compacting)
+      for(auto const &[chunk, blocks]: latest)
+        for(auto const &[pos, r]: blocks)
+          compacted.push_back(MakeRecord({r.x, r.y, r.z, r.from, r.to}));
+    lck.unlock();
+
+    auto const written = compacting ? compact(compacted) : false;
+    if(!written && !(file && WriteAll(file, group.data(), group.size() * sizeof(Record)) && SyncFile(file)))
+      std::cerr << "Unable to write to edit journal " << path << "\n";
+
+    lck.lock();
+    recordsInFile = written ? compacted.size() : recordsInFile + group.size();
+    compactions += written;
+    committed += group.size();
+    ++commits;
+    largestCommit = std::max(largestCommit, group.size());
+    group.clear();
+    synced.notify_all();
+  }
+}
+
+bool EditJournal::compact(std::vector<Record> const &records) {
+  auto const temp = path + ".tmp";
+  auto const f    = std::fopen(temp.c_str(), "wb");
+  if(!f)
+    return false;
+  auto const ok = WriteHeader(f, seed) && WriteAll(f, records.data(), records.size() * sizeof(Record)) && SyncFile(f);
+  std::fclose(f);
+
+  std::error_code error;
+  if(ok) {
+    std::fclose(file);
+    std::filesystem::rename(temp, path, error);
+    file = std::fopen(path.c_str(), "ab");
+    if(!error && file)
+      return true;
+  }
+  std::filesystem::remove(temp, error);
+  if(!file)
+    file = std::fopen(path.c_str(), "ab");
+  return false;
+}
+
+std::vector<std::uint16_t> EditJournal::replay(Chunk &chunk) {
+  std::vector<std::pair<std::uint16_t, BlockHandle>> edits;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    auto const it = latest.find(ChunkIndex(chunk.cx, chunk.cy, chunk.cz).repr);
+    if(it == latest.end())
+      return {};
+    for(auto const &[pos, record]: it->second)
+      edits.emplace_back(pos, record.to);
+  }
+  std::sort(edits.begin(), edits.end());
+
+  std::vector<std::uint16_t> positions;
+  for(auto const &[pos, handle]: edits) {
+    auto const bx = pos & ChunkBlockMask, by = (pos >> ChunkCoordBits) & ChunkBlockMask, bz = pos >> ChunkCoordBits * 2;
+    chunk.setBlockAt(bx, by, bz, CreateBlock(handle, chunk.x + bx, chunk.y + by, chunk.z + bz, &chunk.w));
+    positions.push_back(pos);
+  }
+  return positions;
+}
+
+JournalStats EditJournal::stats() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return {appended, committed, commits, largestCommit, recovered, recoverMs, editedBlocks, compactions,
+          enabled ? sizeof(Header) + recordsInFile * sizeof(Record) : 0};
+}
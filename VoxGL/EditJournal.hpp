@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Block.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Chunk;
+
+// A block placed or broken, with the handles of the block before and after
+struct BlockEdit {
+  BlockCoord x, y, z;
+  BlockHandle from, to;
+};
+
+struct JournalStats {
+  // Edits appended and on disk, the fsyncs it took to get them there and the most one of them carried
+  std::size_t appended, committed, commits, largestCommit;
+  // Edits read back when the journal was opened, and how long reading them took
+  std::size_t recovered;
+  float recoverMs;
+  // Blocks edited, compactions of the file and its size
+  std::size_t editedBlocks, compactions, fileBytes;
+};
+
+// Write-ahead log of the player's block edits. Appending only queues an edit, a commit thread writes it out,
+// waiting a moment for more to come in first so a burst of edits shares one fsync. Whoever edits never waits
+// on the disk.
+//
+// Opening the journal reads back what it holds, cut off at the first record a crash left half written. Chunks
+// get the latest edit of each of their blocks reapplied whenever they're generated. Once most of the file is
+// edits that were overwritten since, it's compacted down to the latest edit of every block.
+struct EditJournal {
+  // No journal for an empty path. A journal for another seed is started over.
+  explicit EditJournal(std::string path = {}, long long seed = 0);
+  // Commits what's left
+  ~EditJournal();
+  EditJournal(EditJournal const &) = delete;
+  EditJournal &operator=(EditJournal const &) = delete;
+
+  void append(BlockEdit const &edit);
+  // Waits until everything appended so far is on disk
+  void sync();
+  // Sets the blocks edited in chunk to what they were edited to last, without waking anything up. Returns the
+  // positions set, in blockPos order.
+  std::vector<std::uint16_t> replay(Chunk &chunk);
+
+  JournalStats stats();
+
+private:
+  struct Record {
+    std::int32_t x, y, z, from, to;
+    std::uint32_t check;
+  };
+
+  // Edits that share a commit. The first waits this long for the rest.
+  static constexpr auto GroupWindow          = std::chrono::milliseconds(5);
+  static constexpr std::size_t MaxGroup      = 4096;
+  // Compacts once the file has this many records and several for each block edited
+  static constexpr std::size_t CompactAfter  = 1 << 16;
+  static constexpr std::size_t CompactRatio  = 4;
+
+  static Record MakeRecord(BlockEdit const &edit);
+  void recover();
+  void commitLoop();
+  // Writes the latest edit of every block to a new file and swaps it in. Falls back to appending on failure.
+  bool compact(std::vector<Record> const &records);
+  void remember(Record const &record);
+
+  std::string path;
+  long long seed;
+  // Only the commit thread touches the file once it's running
+  std::FILE *file = nullptr;
+  bool enabled    = false;
+
+  std::mutex mutex;
+  std::condition_variable wake, synced;
+  std::vector<Record> pending;
+  // Every edited block by chunk and then blockPos, from what it was first and to what it was edited last
+  std::unordered_map<long long, std::unordered_map<std::uint16_t, Record>> latest;
+  std::size_t editedBlocks = 0, recordsInFile = 0;
+  std::size_t appended = 0, committed = 0, commits = 0, largestCommit = 0, recovered = 0, compactions = 0;
+  float recoverMs = .0f;
+  bool stopping   = false;
+  std::thread committer;
+};
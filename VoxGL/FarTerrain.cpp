@@ -0,0 +1,175 @@
+#include "FarTerrain.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Game.hpp"
+#include "Maths.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+static GrassBlock FarGrass;
+static SandBlock FarSand;
+static StoneBlock FarStone;
+
+// Same choice of surface block as the chunk generator
+static Block *SurfaceBlock(BlockCoord const height, float const temperature) {
+  if(height < 16)
+    return &FarStone;
+  if(temperature > .5f)
+    return &FarSand;
+  return &FarGrass;
+}
+
+static void SelectNode(FarTileKey const node, glm::vec2 const center, float const innerRadius, float const outerRadius,
+                       std::vector<FarTileKey> &selected) {
+  auto const minX = static_cast<float>(node.x), maxX = static_cast<float>(node.x + node.size);
+  auto const minY = static_cast<float>(node.y), maxY = static_cast<float>(node.y + node.size);
+
+  auto const nx      = std::clamp(center.x, minX, maxX) - center.x;
+  auto const ny      = std::clamp(center.y, minY, maxY) - center.y;
+  auto const fx      = std::max(std::abs(center.x - minX), std::abs(center.x - maxX));
+  auto const fy      = std::max(std::abs(center.y - minY), std::abs(center.y - maxY));
+  auto const nearest = std::sqrt(nx * nx + ny * ny);
+
+  if(nearest > outerRadius || std::sqrt(fx * fx + fy * fy) < innerRadius)
+    return;
+
+  if(node.size > FarTileMinSize && nearest < node.size * FarTileSplitFactor) {
+    auto const half = node.size / 2;
+    SelectNode({node.x, node.y, half}, center, innerRadius, outerRadius, selected);
+    SelectNode({node.x + half, node.y, half}, center, innerRadius, outerRadius, selected);
+    SelectNode({node.x, node.y + half, half}, center, innerRadius, outerRadius, selected);
+    SelectNode({node.x + half, node.y + half, half}, center, innerRadius, outerRadius, selected);
+    return;
+  }
+
+  selected.push_back(node);
+}
+
+std::vector<FarTileKey> SelectFarTiles(glm::vec2 const center, float const innerRadius, float const outerRadius) {
+  std::vector<FarTileKey> selected;
+
+  auto const rootFloor = [](float f) { return static_cast<BlockCoord>(std::floor(f / FarTileRootSize)) * FarTileRootSize; };
+
+  for(auto x = rootFloor(center.x - outerRadius); x <= rootFloor(center.x + outerRadius); x += FarTileRootSize)
+    for(auto y = rootFloor(center.y - outerRadius); y <= rootFloor(center.y + outerRadius); y += FarTileRootSize)
+      SelectNode({x, y, FarTileRootSize}, center, innerRadius, outerRadius, selected);
+
+  return selected;
+}
+
+MeshData GenerateFarTile(World &world, FarTileKey const key) {
+  constexpr auto Verts = FarTileResolution + 1;
+  auto const step      = key.size / FarTileResolution;
+
+  std::vector<float> heights(Verts * Verts);
+  std::vector<Block *> surface(Verts * Verts);
+  for(BlockCoord j = 0; j < Verts; ++j)
+    for(BlockCoord i = 0; i < Verts; ++i) {
+      auto const bx          = key.x + i * step, by = key.y + j * step;
+      auto const height      = Chunk::blockHeight(Chunk::getBlerpWorldgenVal(bx, by, &world, PerlinInstance::Height));
+      auto const temperature = Chunk::getBlerpWorldgenVal(bx, by, &world, PerlinInstance::Temperature);
+      heights[i + j * Verts] = height + 1.f - FarTerrainSink;
+      surface[i + j * Verts] = SurfaceBlock(height, temperature);
+    }
+
+  MeshData meshData;
+  auto const skirtDepth = 2.f * step;
+
+  // Stretches a unit block face over the quad at i, j, with its top edge following the heightfield
+  auto const addFace = [&](BlockCoord i, BlockCoord j, BlockSide side) {
+    auto md = surface[i + j * Verts]->getMesh(0, 0, 0, side);
+
+    for(auto &ind: md.indices)
+      meshData.indices.push_back(static_cast<GLuint>(ind + meshData.vertices.size()));
+    for(auto &vert: md.vertices) {
+      auto const vi = i + static_cast<BlockCoord>(vert.loc.x);
+      auto const vj = j + static_cast<BlockCoord>(vert.loc.y);
+      auto const h  = heights[vi + vj * Verts];
+      vert.loc      = {static_cast<float>(key.x + vi * step), static_cast<float>(key.y + vj * step), vert.loc.z > .5f ? h : h - skirtDepth};
+      meshData.vertices.push_back(vert);
+    }
+  };
+
+  for(BlockCoord j = 0; j < FarTileResolution; ++j)
+    for(BlockCoord i = 0; i < FarTileResolution; ++i) {
+      addFace(i, j, BlockSide::Top);
+      if(i == 0)
+        addFace(i, j, BlockSide::Left);
+      if(i == FarTileResolution - 1)
+        addFace(i, j, BlockSide::Right);
+      if(j == 0)
+        addFace(i, j, BlockSide::Front);
+      if(j == FarTileResolution - 1)
+        addFace(i, j, BlockSide::Back);
+    }
+
+  return meshData;
+}
+
+void FarTerrain::update(World &world, glm::vec3 const &position, float const innerRadius, float const outerRadius) {
+  glm::vec2 const center{position.x, position.y};
+  auto const moved = center - lastCenter;
+  if(hasSelection && moved.x * moved.x + moved.y * moved.y < Pow<2>(FarTileMinSize / 2.f) && outerRadius == lastOuterRadius)
+    return;
+
+  auto const keys = SelectFarTiles(center, innerRadius, outerRadius);
+
+  std::map<FarTileKey, std::shared_ptr<Tile>> next;
+  {
+    std::lock_guard<std::mutex> lck(tileMutex);
+    for(auto const &key: keys)
+      if(auto const it = tiles.find(key); it != tiles.end())
+        next.emplace(key, it->second);
+  }
+
+  // Only the tiles that weren't selected last time are generated
+  std::vector<std::pair<FarTileKey, std::future<MeshData>>> futs;
+  for(auto const &key: keys)
+    if(!next.count(key))
+      futs.emplace_back(key, std::async(GenerateFarTile, std::ref(world), key));
+
+  for(auto &[key, fut]: futs) {
+    auto tile       = std::make_shared<Tile>();
+    tile->data      = std::make_unique<MeshData>(fut.get());
+    tile->triangles = tile->data->indices.size() / 3;
+    next.emplace(key, std::move(tile));
+  }
+
+  std::lock_guard<std::mutex> lck(tileMutex);
+  for(auto &[key, tile]: tiles)
+    if(!next.count(key))
+      retired.push_back(std::move(tile));
+  tiles        = std::move(next);
+  lastCenter      = center;
+  lastOuterRadius = outerRadius;
+  hasSelection    = true;
+}
+
+void FarTerrain::draw() {
+  std::lock_guard<std::mutex> lck(tileMutex);
+  retired.clear();
+
+  for(auto &[key, tile]: tiles) {
+    if(tile->data) {
+      tile->mesh = std::make_unique<Mesh>(tile->data->vertices, tile->data->indices);
+      tile->data.reset();
+    }
+    tile->mesh->draw();
+  }
+}
+
+std::size_t FarTerrain::numTiles() {
+  std::lock_guard<std::mutex> lck(tileMutex);
+  return tiles.size();
+}
+
+std::size_t FarTerrain::numTriangles() {
+  std::lock_guard<std::mutex> lck(tileMutex);
+  std::size_t triangles = 0;
+  for(auto const &[key, tile]: tiles)
+    triangles += tile->triangles;
+  return triangles;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Blocks.hpp"
+#include "Mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+struct World;
+
+// Quads along each side of a far terrain tile, whatever its size
+constexpr BlockCoord FarTileResolution = 16;
+constexpr BlockCoord FarTileMinSize    = 64;
+constexpr BlockCoord FarTileRootSize   = FarTileMinSize << 4;
+// A quadtree node is split while the viewer is closer than this many node sizes
+constexpr float FarTileSplitFactor = 1.5f;
+// Far terrain sits slightly below the real surface so chunks win where the two overlap
+constexpr float FarTerrainSink = .5f;
+
+// A square tile of the far terrain, x, y is the corner with the lowest coordinates, in blocks
+struct FarTileKey {
+  BlockCoord x, y, size;
+
+  bool operator<(FarTileKey const &other) const {
+    return std::tie(x, y, size) < std::tie(other.x, other.y, other.size);
+  }
+  bool operator==(FarTileKey const &other) const { return x == other.x && y == other.y && size == other.size; }
+};
+
+// Quadtree leaves covering the ring between innerRadius and outerRadius blocks around center.
+// Tiles get larger the further they are from the center, and tiles entirely inside innerRadius are skipped.
+std::vector<FarTileKey> SelectFarTiles(glm::vec2 center, float innerRadius, float outerRadius);
+
+// Heightfield mesh for a tile, sampled straight from the worldgen noise without generating any chunks.
+// Tile borders get skirts so neighbouring tiles of different sizes don't show cracks.
+MeshData GenerateFarTile(World &world, FarTileKey key);
+
+// 2.5D terrain drawn past the voxel chunks, out to the render distance
+struct FarTerrain {
+  // Reselects and generates tiles around position. Called from the worldgen thread.
+  void update(World &world, glm::vec3 const &position, float innerRadius, float outerRadius);
+  // Uploads newly generated tiles and draws. Needs the GL context.
+  void draw();
+
+  std::size_t numTiles();
+  std::size_t numTriangles();
+
+private:
+  struct Tile {
+    std::unique_ptr<MeshData> data;
+    std::unique_ptr<Mesh> mesh;
+    std::size_t triangles;
+  };
+
+  std::mutex tileMutex;
+  std::map<FarTileKey, std::shared_ptr<Tile>> tiles;
+  // Tiles no longer selected, kept until draw() can free their GL buffers
+  std::vector<std::shared_ptr<Tile>> retired;
+  glm::vec2 lastCenter{};
+  // Reselected when the render distance changes too
+  float lastOuterRadius = .0f;
+  bool hasSelection     = false;
+};
@@ -0,0 +1,326 @@
+#include "Fluids.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
+static_assert(FluidChunkVolume == ChunkSize * ChunkSize * ChunkSize, "FluidChunkVolume must match the chunk size");
+
+// Chunks per worker before stepping goes parallel
+constexpr std::size_t FluidChunksPerWorker = 4;
+
+namespace {
+  enum struct CellKind {
+    Solid,
+    Air,
+    Water,
+    Lava,
+  };
+
+  // What the automaton sees of a block. Unloaded blocks count as solid so fluid never flows into them.
+  struct Cell {
+    CellKind kind;
+    std::uint8_t level;
+    bool falling;
+
+    bool isFluid() const { return kind == CellKind::Water || kind == CellKind::Lava; }
+    bool operator==(Cell const &other) const {
+      return kind == other.kind && (!isFluid() || (level == other.level && falling == other.falling));
+    }
+    bool operator!=(Cell const &other) const { return !(*this == other); }
+  };
+
+  Cell CellOf(BlockStorage const &storage) {
+    if(auto const w = std::get_if<WaterBlock>(&storage))
+      return {CellKind::Water, w->level, w->falling};
+    if(auto const l = std::get_if<LavaBlock>(&storage))
+      return {CellKind::Lava, l->level, l->falling};
+    if(auto const p = std::get_if<std::unique_ptr<Block>>(&storage); p && (!*p || !(*p)->isSolid()))
+      return {CellKind::Air, 0, false};
+    return {CellKind::Solid, 0, false};
+  }
+
+  BlockStorage StorageOf(Cell const &cell) {
+    switch(cell.kind) {
+    case CellKind::Water:
+      return WaterBlock{cell.level, cell.falling};
+    case CellKind::Lava:
+      return LavaBlock{cell.level, cell.falling};
+    case CellKind::Solid:
+      // Lava meeting water
+      return StoneBlock{};
+    default:
+      return nullptr;
+    }
+  }
+
+  std::uint8_t MaxLevel(CellKind const kind) { return kind == CellKind::Lava ? LavaBlock::maxLevel : WaterBlock::maxLevel; }
+
+  // Reads cells around one chunk, following adjacency links for face neighbours
+  struct CellReader {
+    World &world;
+    Chunk &chunk;
+
+    Cell at(BlockCoord x, BlockCoord y, BlockCoord z) {
+      auto const dx = (x >> ChunkCoordBits), dy = (y >> ChunkCoordBits), dz = (z >> ChunkCoordBits);
+      auto const lx = x & ChunkBlockMask, ly = y & ChunkBlockMask, lz = z & ChunkBlockMask;
+      if(!dx && !dy && !dz)
+        return CellOf(chunk.voxels().blocks[Chunk::blockPos(lx, ly, lz)]);
+
+      std::shared_ptr<Chunk> keepAlive;
+      Chunk *other;
+      if(std::abs(dx) + std::abs(dy) + std::abs(dz) == 1)
+        other = chunk.adjacent(dx ? (dx > 0 ? 0 : 1) : dy ? (dy > 0 ? 2 : 3) : (dz > 0 ? 4 : 5));
+      else
+        other = (keepAlive = world.getChunk<false>(chunk.cx + dx, chunk.cy + dy, chunk.cz + dz)).get();
+      if(!other)
+        return {CellKind::Solid, 0, false};
+      return CellOf(other->voxels().blocks[Chunk::blockPos(lx, ly, lz)]);
+    }
+  };
+
+  // The automaton rule, x, y, z relative to the chunk
+  Cell NextState(CellReader &reader, BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+    auto const self = reader.at(x, y, z);
+    if(self.kind == CellKind::Solid)
+      return self;
+
+    static constexpr BlockCoord Horizontal[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+    // Lava touching water sets into stone
+    if(self.kind == CellKind::Lava) {
+      auto touchesWater = reader.at(x, y, z + 1).kind == CellKind::Water || reader.at(x, y, z - 1).kind == CellKind::Water;
+      for(auto const &[dx, dy]: Horizontal)
+        touchesWater = touchesWater || reader.at(x + dx, y + dy, z).kind == CellKind::Water;
+      if(touchesWater)
+        return {CellKind::Solid, 0, false};
+    }
+
+    // Sources stay put
+    if(self.isFluid() && self.level == 0 && !self.falling)
+      return self;
+
+    // Fluid above pours straight down
+    if(auto const above = reader.at(x, y, z + 1); above.isFluid())
+      return {above.kind, 1, true};
+
+    // Otherwise fluid spreads sideways from neighbours that are sources or rest on something solid
+    Cell best{CellKind::Air, 0, false};
+    for(auto const &[dx, dy]: Horizontal) {
+      auto const n = reader.at(x + dx, y + dy, z);
+      if(!n.isFluid())
+        continue;
+      // Fluid resting on flowing fluid keeps going down instead of spreading
+      auto const isSource = n.level == 0 && !n.falling;
+      if(!isSource) {
+        auto const below = reader.at(x + dx, y + dy, z - 1);
+        if(below.kind == CellKind::Air || (below.isFluid() && (below.level || below.falling)))
+          continue;
+      }
+
+      auto const level = static_cast<std::uint8_t>(n.level + 1);
+      if(level > MaxLevel(n.kind))
+        continue;
+      // Water wins over lava, then the shortest path from a source
+      if(!best.isFluid() || (n.kind == CellKind::Water && best.kind == CellKind::Lava) || (n.kind == best.kind && level < best.level))
+        best = {n.kind, level, false};
+    }
+    return best;
+  }
+}
+
+void FluidSim::update(World &world, float const dt) {
+  accumulator = std::min(accumulator + dt, MaxFluidStepsPerUpdate / FluidStepRate);
+  while(accumulator >= 1.f / FluidStepRate) {
+    accumulator -= 1.f / FluidStepRate;
+    step(world);
+  }
+}
+
+void FluidSim::wake(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  std::lock_guard<std::mutex> lck(wakeMutex);
+  wakeups.push_back({x, y, z});
+  for(auto const &[dx, dy, dz]: Vdxyz)
+    wakeups.push_back({x + dx, y + dy, z + dz});
+}
+
+std::size_t FluidSim::numActiveCells() {
+  std::size_t cells = 0;
+  for(auto const &[key, ac]: active)
+    cells += ac.cells.size();
+  std::lock_guard<std::mutex> lck(wakeMutex);
+  return cells + wakeups.size();
+}
+
+void FluidSim::computeChanges(World &world, ActiveChunk &ac) {
+  CellReader reader{world, *ac.chunk};
+  for(auto const pos: ac.cells) {
+    auto const x = pos & ChunkBlockMask, y = (pos >> ChunkCoordBits) & ChunkBlockMask, z = pos >> ChunkCoordBits * 2;
+    auto const next = NextState(reader, x, y, z);
+    if(next != reader.at(x, y, z))
+      ac.changes.emplace_back(pos, StorageOf(next));
+  }
+}
+
+void FluidSim::applyChanges(ActiveChunk &ac) {
+  for(auto const pos: ac.cells)
+    ac.queued[pos] = false;
+
+  for(auto &[pos, storage]: ac.changes) {
+    auto const x = pos & ChunkBlockMask, y = (pos >> ChunkCoordBits) & ChunkBlockMask, z = pos >> ChunkCoordBits * 2;
+    ac.chunk->setBlockAt(x, y, z, std::move(storage));
+
+    // The cell and its neighbours are looked at again next step, the ones across the border by the neighbour chunk
+    auto const wakeCell = [&](BlockCoord nx, BlockCoord ny, BlockCoord nz) {
+      auto const lp = static_cast<std::uint16_t>(Chunk::blockPos(nx & ChunkBlockMask, ny & ChunkBlockMask, nz & ChunkBlockMask));
+      if(nx < 0 || ny < 0 || nz < 0 || nx >= ChunkSize || ny >= ChunkSize || nz >= ChunkSize) {
+        auto const side = nx >= ChunkSize ? 0 : nx < 0 ? 1 : ny >= ChunkSize ? 2 : ny < 0 ? 3 : nz >= ChunkSize ? 4 : 5;
+        ac.outbox[side].push_back(lp);
+      }
+      else if(!ac.nextQueued[lp]) {
+        ac.nextQueued[lp] = true;
+        ac.next.push_back(lp);
+      }
+    };
+    wakeCell(x, y, z);
+    for(auto const &[dx, dy, dz]: Vdxyz)
+      wakeCell(x + dx, y + dy, z + dz);
+  }
+}
+
+void FluidSim::step(World &world) {
+  // Active chunks and the cells read across chunk borders are followed through handles
+  EpochGuard guard(world.slab);
+  for(auto it = active.begin(); it != active.end();) {
+    it->second.chunk = world.slab.get(it->second.handle);
+    if(!it->second.chunk)
+      it = active.erase(it);
+    else
+      ++it;
+  }
+
+  // Cells woken up from outside since the last step join the frontier
+  std::vector<glm::ivec3> woken;
+  {
+    std::lock_guard<std::mutex> lck(wakeMutex);
+    woken.swap(wakeups);
+  }
+  for(auto const &p: woken) {
+    auto const ci = ChunkIndex(Chunk::decomposeChunkFromBlock(p.x), Chunk::decomposeChunkFromBlock(p.y), Chunk::decomposeChunkFromBlock(p.z));
+    auto it       = active.find(ci.repr);
+    if(it == active.end()) {
+      auto const chunk = world.getChunkAtBlock<false>(p.x, p.y, p.z);
+      if(!chunk)
+        continue;
+      it = active.emplace(ci.repr, ActiveChunk{}).first;
+      it->second.handle = chunk->handle;
+      it->second.chunk  = chunk.get();
+    }
+    auto &ac       = it->second;
+    auto const pos = static_cast<std::uint16_t>(Chunk::blockPos(Chunk::decomposeLocalBlockFromBlock(p.x),
+                                                                Chunk::decomposeLocalBlockFromBlock(p.y),
+                                                                Chunk::decomposeLocalBlockFromBlock(p.z)));
+    if(!ac.queued[pos]) {
+      ac.queued[pos] = true;
+      ac.cells.push_back(pos);
+    }
+  }
+
+  std::vector<ActiveChunk *> chunks;
+  for(auto &[key, ac]: active)
+    chunks.push_back(&ac);
+
+  // Every chunk reads the old state before any chunk writes the new one
+  auto const inParallel = [&](auto const &f) {
+    auto const workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), chunks.size() / FluidChunksPerWorker);
+    if(workers <= 1) {
+      for(auto ac: chunks)
+        f(*ac);
+      return;
+    }
+    std::vector<std::future<void>> futs;
+    auto const perWorker = (chunks.size() + workers - 1) / workers;
+    for(std::size_t begin = 0; begin < chunks.size(); begin += perWorker)
+      futs.push_back(std::async(std::launch::async, [&, begin] {
+        for(auto i = begin; i < std::min(begin + perWorker, chunks.size()); ++i)
+          f(*chunks[i]);
+      }));
+    for(auto &fut: futs)
+      fut.get();
+  };
+
+  inParallel([&](ActiveChunk &ac) { computeChanges(world, ac); });
+  inParallel([&](ActiveChunk &ac) { applyChanges(ac); });
+
+  std::vector<std::shared_ptr<Chunk>> remesh;
+  for(auto ac: chunks) {
+    totals.cellsUpdated += ac->cells.size();
+    totals.cellsChanged += ac->changes.size();
+    if(!ac->changes.empty()) {
+      auto const &c = *ac->chunk;
+      for(auto const &[pos, storage]: ac->changes)
+        world.light.update(c.x + (pos & ChunkBlockMask), c.y + ((pos >> ChunkCoordBits) & ChunkBlockMask), c.z + (pos >> ChunkCoordBits * 2));
+      remesh.push_back(ac->chunk->shared_from_this());
+      // Changes on the border show in the neighbour's mesh
+      for(std::size_t side = 0; side < 6; ++side)
+        if(!ac->outbox[side].empty())
+          if(auto adjacent = ac->chunk->adjacent(side))
+            remesh.push_back(adjacent->shared_from_this());
+    }
+    ac->changes.clear();
+  }
+
+  // Border exchange, frontier cells go over to the chunk they are in
+  for(auto ac: chunks)
+    for(std::size_t side = 0; side < 6; ++side) {
+      auto &outbox = ac->outbox[side];
+      if(outbox.empty())
+        continue;
+
+      auto const &c = *ac->chunk;
+      auto const [dx, dy, dz] = Vdxyz[side];
+      auto const key          = ChunkIndex(c.cx + dx, c.cy + dy, c.cz + dz).repr;
+      auto it                 = active.find(key);
+      if(it == active.end()) {
+        auto const adjacent = ac->chunk->adjacent(side);
+        if(!adjacent) {
+          outbox.clear();
+          continue;
+        }
+        it = active.emplace(key, ActiveChunk{}).first;
+        it->second.handle = adjacent->handle;
+        it->second.chunk  = adjacent;
+      }
+
+      auto &target = it->second;
+      for(auto const pos: outbox)
+        if(!target.nextQueued[pos]) {
+          target.nextQueued[pos] = true;
+          target.next.push_back(pos);
+        }
+      outbox.clear();
+    }
+
+  for(auto it = active.begin(); it != active.end();) {
+    auto &ac = it->second;
+    ac.cells.swap(ac.next);
+    ac.next.clear();
+    std::swap(ac.queued, ac.nextQueued);
+    ac.nextQueued.reset();
+    // Cells that didn't change don't wake anything, so settled fluid drops out of the frontier
+    if(ac.cells.empty())
+      it = active.erase(it);
+    else
+      ++it;
+  }
+
+  for(auto &c: world.light.propagate(world))
+    remesh.push_back(std::move(c));
+  world.remesh(std::move(remesh));
+
+  ++totals.steps;
+  totals.activeChunks = active.size();
+}
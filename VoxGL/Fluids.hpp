@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Blocks.hpp"
+#include "ChunkSlab.hpp"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct Chunk;
+struct World;
+
+constexpr float FluidStepRate = 5.f;
+// Steps run at most this many times per update, so a slow frame can't snowball
+constexpr int MaxFluidStepsPerUpdate = 2;
+constexpr std::size_t FluidChunkVolume = 16 * 16 * 16;
+
+struct FluidStepStats {
+  std::size_t steps, cellsUpdated, cellsChanged, activeChunks;
+};
+
+// Water and lava flowing as a cellular automaton. Only the cells next to something that changed are looked at,
+// tracked as a frontier per chunk, so the cost follows the amount of moving fluid and not the size of the world.
+// A step computes every new cell state from the old ones before writing any, chunks are stepped in parallel, and
+// frontier cells crossing into a neighbouring chunk are handed over once all chunks are done.
+struct FluidSim {
+  // Runs the steps that fall into dt seconds of real time
+  void update(World &world, float dt);
+  // Runs one step over all active cells
+  void step(World &world);
+  // Looks at the cell x, y, z and its neighbours in the next step. Safe to call from any thread.
+  void wake(BlockCoord x, BlockCoord y, BlockCoord z);
+
+  std::size_t numActiveCells();
+  FluidStepStats stats() const { return totals; }
+
+private:
+  struct ActiveChunk {
+    // The chunk isn't kept loaded for its fluid, it's looked up again every step and dropped once it unloads
+    ChunkHandle handle;
+    Chunk *chunk = nullptr;
+    // Cells to update this step, and the ones woken up for the next
+    std::vector<std::uint16_t> cells, next;
+    std::bitset<FluidChunkVolume> queued, nextQueued;
+    std::vector<std::pair<std::uint16_t, BlockStorage>> changes;
+    // Cells woken up in each of the six neighbouring chunks, in their local block positions
+    std::array<std::vector<std::uint16_t>, 6> outbox;
+  };
+
+  void computeChanges(World &world, ActiveChunk &ac);
+  void applyChanges(ActiveChunk &ac);
+
+  // Keyed by ChunkIndex::repr, which also fixes the order chunks hand over frontier cells in
+  std::map<std::int64_t, ActiveChunk> active;
+  std::mutex wakeMutex;
+  std::vector<glm::ivec3> wakeups;
+  float accumulator = .0f;
+  FluidStepStats totals{};
+};
@@ -1,5 +1,7 @@
 #include "Game.hpp"
 
+#include "Benchmark.hpp"
+#include "IngameState.hpp"
 #include "MenuState.hpp"
 #include "Shaders.hpp"
 #include "Textures.hpp"
@@ -11,7 +13,7 @@
 
 Game *Game::gameState = nullptr;
 
-Game::Game() :
+Game::Game(std::unique_ptr<Benchmark> benchmark) :
 
   conf([&]() {
     Config conf("Config.txt");
@@ -24,6 +26,12 @@ Game::Game() :
     conf.ADDOPT(texturePath);
     conf.ADDOPT(renderDistance);
     conf.ADDOPT(vsync);
+    conf.ADDOPT(lodDistances);
+    conf.ADDOPT(farTerrain);
+    conf.ADDOPT(targetFrameTime);
+    conf.ADDOPT(journalPath);
+    conf.ADDOPT(chunkStorePath);
+    conf.ADDOPT(meshCachePath);
 
     conf.read();
     conf.write();
@@ -63,9 +71,17 @@ Game::Game() :
   shaderBasic.bind();
 
   gameState = this;
-  setFrameTime(maxFps());
-  gameWindow.setVerticalSyncEnabled(vsync());
-  emplaceGameState(std::make_unique<MenuState>(this));
+  if(benchmark) {
+    setFrameTime(-1.0f);
+    gameWindow.setVerticalSyncEnabled(false);
+    auto const seed = benchmark->path.seed;
+    emplaceGameState(std::make_unique<IngameState>(this, gameWindow, seed, std::move(benchmark)));
+  }
+  else {
+    setFrameTime(maxFps());
+    gameWindow.setVerticalSyncEnabled(vsync());
+    emplaceGameState(std::make_unique<MenuState>(this));
+  }
 
   static const auto frame = [&]() {
     auto status           = states.back()->frame(this, gameWindow, std::max(lastFrameTime.count(), minFrameTime.count()) / 1000.0f);
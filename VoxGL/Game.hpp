@@ -14,8 +14,11 @@ constexpr bool isDebugging = true;
 constexpr bool isDebugging = false;
 #endif // _DEBUG
 
+struct Benchmark;
+
 struct Game {
-  Game();
+  // With a benchmark, the game skips the menu, runs the flythrough uncapped and exits when it is done
+  explicit Game(std::unique_ptr<Benchmark> benchmark = nullptr);
 
   void emplaceGameState(std::unique_ptr<GameState> &&state);
 
@@ -28,7 +31,18 @@ struct Game {
   Config::Option<float> fov                                = MakeOption<float>(100.0f);
   Config::Option<float> maxFps                             = MakeOption<float>(-1.0f);
   Config::Option<float> renderDistance                     = MakeOption<float>(1000.0f);
+  // Chunk distances past which chunks are meshed at 2x, 4x and 8x coarser resolution
+  Config::Option<std::vector<float>> lodDistances          = MakeOption<std::vector<float>>(std::initializer_list<float>{5.f, 8.f, 11.f});
+  Config::Option<bool> farTerrain                          = MakeOption<bool>(1);
+  // Frame time in ms held by trading uploads, meshing, levels of detail and render distance for it, 0 to keep them as configured
+  Config::Option<float> targetFrameTime                    = MakeOption<float>(.0f);
   Config::Option<std::string> texturePath                  = MakeOption<std::string>("./assets/textures/");
+  // Block edits are journaled to this path, followed by the seed
+  Config::Option<std::string> journalPath                  = MakeOption<std::string>("./edits");
+  // Chunks are loaded from the directory voxgl_pregen wrote them to, this path followed by the seed, if there is one
+  Config::Option<std::string> chunkStorePath               = MakeOption<std::string>("./world");
+  // Chunk meshes are kept at this path followed by the seed, for the next time the world is loaded
+  Config::Option<std::string> meshCachePath                = MakeOption<std::string>("./meshes");
 private:
 
   Config conf;
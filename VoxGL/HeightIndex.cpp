@@ -0,0 +1,176 @@
+#include "HeightIndex.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <algorithm>
+
+static_assert(ColumnsPerChunk == ChunkSize * ChunkSize, "ColumnsPerChunk must match the chunk size");
+
+// Keeps tables at most half full so probe sequences stay short
+constexpr std::size_t InitialTableSize = 1 << 12;
+constexpr std::int64_t EmptyKey        = std::numeric_limits<std::int64_t>::min();
+
+static std::int64_t ColumnKey(BlockCoord const cx, BlockCoord const cy) {
+  return (static_cast<std::int64_t>(cx) << 32) | static_cast<std::uint32_t>(cy);
+}
+
+static std::size_t ColumnOf(BlockCoord const x, BlockCoord const y) {
+  return Chunk::decomposeLocalBlockFromBlock(x) + Chunk::decomposeLocalBlockFromBlock(y) * ChunkSize;
+}
+
+static std::size_t HashKey(std::int64_t const key) {
+  auto h = static_cast<std::uint64_t>(key) * 0x9e3779b97f4a7c15ull;
+  return static_cast<std::size_t>(h ^ (h >> 32));
+}
+
+HeightIndex::Table::Table(std::size_t const capacity): mask(capacity - 1), slots(new Slot[capacity]) {
+  for(std::size_t i = 0; i < capacity; ++i) {
+    slots[i].key.store(EmptyKey, std::memory_order_relaxed);
+    slots[i].column.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+HeightIndex::Column *HeightIndex::Table::find(std::int64_t const key) const {
+  for(auto i = HashKey(key) & mask;; i = (i + 1) & mask) {
+    auto const k = slots[i].key.load(std::memory_order_acquire);
+    if(k == key)
+      return slots[i].column.load(std::memory_order_relaxed);
+    if(k == EmptyKey)
+      return nullptr;
+  }
+}
+
+void HeightIndex::Table::insert(Column *const column) {
+  auto i = HashKey(column->key) & mask;
+  while(slots[i].key.load(std::memory_order_relaxed) != EmptyKey)
+    i = (i + 1) & mask;
+  // The column goes in before the key, so a reader finding the key finds the column
+  slots[i].column.store(column, std::memory_order_relaxed);
+  slots[i].key.store(column->key, std::memory_order_release);
+}
+
+HeightIndex::HeightIndex() {
+  tables.push_back(std::make_unique<Table>(InitialTableSize));
+  table.store(tables.back().get());
+}
+
+HeightIndex::~HeightIndex() = default;
+
+HeightIndex::Column *HeightIndex::find(BlockCoord const cx, BlockCoord const cy) const {
+  return table.load(std::memory_order_acquire)->find(ColumnKey(cx, cy));
+}
+
+BlockCoord HeightIndex::heightAt(BlockCoord const x, BlockCoord const y) const {
+  auto const column = find(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y));
+  return column ? column->heights[ColumnOf(x, y)].load(std::memory_order_relaxed) : UnknownHeight;
+}
+
+BlockCoord HeightIndex::chunkColumnHeight(BlockCoord const cx, BlockCoord const cy) const {
+  auto const column = find(cx, cy);
+  return column ? column->maxHeight.load(std::memory_order_relaxed) : UnknownHeight;
+}
+
+std::size_t HeightIndex::numChunkColumns() const {
+  std::lock_guard<std::mutex> lck(updateMutex);
+  return columns.size();
+}
+
+void HeightIndex::addChunkColumn(BlockCoord const cx, BlockCoord const cy, std::array<BlockCoord, ColumnsPerChunk> const &heights) {
+  auto const key   = ColumnKey(cx, cy);
+  auto const raise = [&](Column &column) {
+    for(std::size_t i = 0; i < ColumnsPerChunk; ++i)
+      if(heights[i] > column.heights[i].load(std::memory_order_relaxed)) {
+        column.heights[i].store(heights[i], std::memory_order_relaxed);
+        if(heights[i] > column.maxHeight.load(std::memory_order_relaxed))
+          column.maxHeight.store(heights[i], std::memory_order_relaxed);
+      }
+  };
+
+  if(auto const column = find(cx, cy)) {
+    if(std::equal(heights.begin(), heights.end(), column->heights.begin(), [](BlockCoord h, auto const &c) {
+         return h <= c.load(std::memory_order_relaxed);
+       }))
+      return;
+    std::lock_guard<std::mutex> lck(updateMutex);
+    raise(*column);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lck(updateMutex);
+  auto const current = table.load(std::memory_order_relaxed);
+  if(auto const column = current->find(key)) {
+    raise(*column);
+    return;
+  }
+
+  auto &column = columns.emplace_back();
+  column.key   = key;
+  auto highest = NoHeight;
+  for(std::size_t i = 0; i < ColumnsPerChunk; ++i) {
+    auto const h = std::max(heights[i], NoHeight);
+    column.heights[i].store(h, std::memory_order_relaxed);
+    highest = std::max(highest, h);
+  }
+  column.maxHeight.store(highest, std::memory_order_relaxed);
+
+  if(columns.size() * 2 <= current->mask + 1) {
+    current->insert(&column);
+    return;
+  }
+
+  // Full enough to grow: readers keep probing the old table until the new one is published
+  auto next = std::make_unique<Table>((current->mask + 1) * 2);
+  for(auto &c: columns)
+    next->insert(&c);
+  table.store(next.get(), std::memory_order_release);
+  tables.push_back(std::move(next));
+}
+
+BlockCoord HeightIndex::scanDown(World &world, BlockCoord const x, BlockCoord const y, BlockCoord z) const {
+  auto const lx = Chunk::decomposeLocalBlockFromBlock(x), ly = Chunk::decomposeLocalBlockFromBlock(y);
+  while(z >= 0) {
+    auto const chunk = world.getChunkAtBlock<false>(x, y, z);
+    // Whatever this chunk generates could be anywhere in it
+    if(!chunk)
+      return z | ChunkBlockMask;
+    if(!chunk->isEmpty())
+      for(auto lz = Chunk::decomposeLocalBlockFromBlock(z); lz >= 0; --lz)
+        if(chunk->blockAt(lx, ly, lz))
+          return chunk->z + lz;
+    z = (z & ChunkLocMask) - 1;
+  }
+  return NoHeight;
+}
+
+void HeightIndex::onBlockSet(World &world, BlockCoord const x, BlockCoord const y, BlockCoord const z, bool const filled) {
+  auto const column = find(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y));
+  if(!column)
+    return;
+
+  auto &height = column->heights[ColumnOf(x, y)];
+  // Nothing to do for blocks below the top, and air placed above it
+  if(filled ? z <= height.load(std::memory_order_relaxed) : z != height.load(std::memory_order_relaxed))
+    return;
+
+  std::lock_guard<std::mutex> lck(updateMutex);
+  auto const old = height.load(std::memory_order_relaxed);
+  if(filled) {
+    if(z <= old)
+      return;
+    height.store(z, std::memory_order_relaxed);
+    if(z > column->maxHeight.load(std::memory_order_relaxed))
+      column->maxHeight.store(z, std::memory_order_relaxed);
+    return;
+  }
+
+  if(z != old)
+    return;
+  height.store(scanDown(world, x, y, z - 1), std::memory_order_relaxed);
+  if(old == column->maxHeight.load(std::memory_order_relaxed)) {
+    auto highest = NoHeight;
+    for(auto const &h: column->heights)
+      highest = std::max(highest, h.load(std::memory_order_relaxed));
+    column->maxHeight.store(highest, std::memory_order_relaxed);
+  }
+}
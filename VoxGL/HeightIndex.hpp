@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Blocks.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct World;
+
+// Height of a column with no blocks in it
+constexpr BlockCoord NoHeight = -1;
+// Height of a column nothing is known about yet, so everything has to be looked at
+constexpr BlockCoord UnknownHeight = std::numeric_limits<BlockCoord>::max();
+// Columns in a chunk column, ChunkSize squared
+constexpr std::size_t ColumnsPerChunk = 256;
+
+// The highest block of every column, for each chunk column of 16x16 columns the world has loaded.
+// Heights start out as the generated terrain height and follow edits: placing a block is O(1), removing
+// the top block scans down the column to the next one. Where that scan runs into a chunk that isn't
+// loaded the height stays at the top of that chunk, so a height is always an upper bound and everything
+// above it is air. Any block counts, fluids and torches included, so the index can't hide what rays hit.
+//
+// Queries never lock: chunk columns live in an open addressed table that is replaced, never modified in
+// place, when it grows, and superseded tables stay alive for readers still probing them.
+struct HeightIndex {
+  HeightIndex();
+  ~HeightIndex();
+
+  // Highest block at x, y, NoHeight if there's none, UnknownHeight if the column isn't loaded
+  BlockCoord heightAt(BlockCoord x, BlockCoord y) const;
+  // Highest block over the whole chunk column cx, cy, same special values as heightAt
+  BlockCoord chunkColumnHeight(BlockCoord cx, BlockCoord cy) const;
+
+  // Adds chunk column cx, cy with generated heights indexed x + y * ChunkSize. A column that's already there is
+  // raised to them, since its chunks may be generated again after edits lowered it and were unloaded.
+  void addChunkColumn(BlockCoord cx, BlockCoord cy, std::array<BlockCoord, ColumnsPerChunk> const &heights);
+  // Follows the block at x, y, z being replaced by a block (filled) or by air
+  void onBlockSet(World &world, BlockCoord x, BlockCoord y, BlockCoord z, bool filled);
+
+  std::size_t numChunkColumns() const;
+
+private:
+  struct Column {
+    std::int64_t key;
+    std::array<std::atomic<BlockCoord>, ColumnsPerChunk> heights;
+    std::atomic<BlockCoord> maxHeight;
+  };
+
+  struct Slot {
+    std::atomic<std::int64_t> key;
+    std::atomic<Column *> column;
+  };
+
+  struct Table {
+    explicit Table(std::size_t capacity);
+    Column *find(std::int64_t key) const;
+    void insert(Column *column);
+
+    std::size_t const mask;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  Column *find(BlockCoord cx, BlockCoord cy) const;
+  BlockCoord scanDown(World &world, BlockCoord x, BlockCoord y, BlockCoord z) const;
+
+  std::atomic<Table *> table;
+  // Written under updateMutex only
+  mutable std::mutex updateMutex;
+  std::deque<Column> columns;
+  std::vector<std::unique_ptr<Table>> tables;
+};
@@ -10,57 +10,129 @@
 #include "PerlinNoise.hpp"
 #include "Maths.hpp"
 
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <string>
 
-IngameState::IngameState(Game *g, sf::Window &window): GameState(g), w(std::make_unique<World>(&position, 0)) {
+constexpr float PickupRadius = 1.5f;
+
+// Tops up stacks of the same block first, then fills empty slots. Whatever doesn't fit stays in stack.
+template<std::size_t N>
+static void AddToInventory(std::array<ItemStack, N> &inventory, ItemStack &stack) {
+  for(auto &slot: inventory)
+    if(slot.count)
+      slot.merge(stack);
+  for(auto &slot: inventory)
+    if(!slot.count && stack.count)
+      std::swap(slot, stack);
+}
+
+static WorldOptions OptionsFor(Game *const g, long long const seed, bool const benchmarking) {
+  WorldOptions options{g->lodDistances(), g->farTerrain() ? g->renderDistance() : .0f};
+  // Benchmarks fly through the world as it's generated, the player's edits stay out of it
+  if(!benchmarking) {
+    options.journalPath    = g->journalPath() + "-" + std::to_string(seed) + ".journal";
+    options.chunkStorePath = g->chunkStorePath() + "-" + std::to_string(seed);
+    options.meshCachePath  = g->meshCachePath() + "-" + std::to_string(seed) + ".meshes";
+  }
+  return options;
+}
+
+IngameState::IngameState(Game *g, sf::Window &window, long long const seed, std::unique_ptr<Benchmark> benchmark):
+  GameState(g), body{benchmark ? PlayerBody{benchmark->path.at(.0f)} : PlayerBody{}}, seed(seed), benchmark(std::move(benchmark)),
+  w(std::make_unique<World>(&body.position, seed, OptionsFor(g, seed, this->benchmark != nullptr))) {
   if(!releaseCursor)
     sf::Mouse::setPosition({static_cast<int>(window.getSize().x) / 2, static_cast<int>(window.getSize().y) / 2}, window);
+  simulation = std::make_unique<Simulation>([this](std::uint64_t, PlayerInput const &input, RenderState &state) { step(input, state); });
+
+  // Benchmarks only go by their path, so they run the same whatever the config
+  if(auto const target = this->benchmark ? this->benchmark->path.targetFrameMs : g->targetFrameTime(); target > .0f) {
+    governor.emplace(target, *w, g->renderDistance());
+    if(this->benchmark)
+      this->benchmark->governor = &*governor;
+  }
 }
 
 IngameState::~IngameState() {
+  simulation.reset();
   std::thread unloadThread = std::thread(unload, std::move(w));
   unloadThread.detach();
 }
 
-FrameRet IngameState::frame(Game *g, sf::Window &window, float const timeDelta) {
-  auto const cam = Camera(position, lookX, lookZ, -g->fov() * 2, static_cast<float>(window.getSize().x) / window.getSize().y,
-                          g->renderDistance());
-  auto lookDir = glm::vec3{0, 0, 0};
+void IngameState::step(PlayerInput const &input, RenderState &state) {
+  auto const dt = Simulation::StepSeconds;
 
-  auto const dt = std::min(timeDelta, 0.1f);
+  // On what the crosshair was on when the player clicked
+  if(input.breakBlock)
+    breakBlock();
+  if(input.placeBlock)
+    placeBlock(input.placing);
 
-  if(length(velocity) < 0.5f)
-    velocity *= 0.0f;
-  else
-    velocity -= (drag(velocity, 0.00000001f) * dt) + (0.3f * (velocity / length(velocity)));
+  MovePlayer(*w, body, input, dt);
+  w->blockTicks.update(*w, dt);
+  w->fluids.update(*w, dt);
+  w->items.tick(*w, dt);
+  for(auto &stack: w->items.pickup(body.position - glm::vec3(0, 0, PlayerEyeHeight / 2), PickupRadius)) {
+    AddToInventory(inventory, stack);
+    if(stack.count)
+      w->items.spawn(stack, body.position, body.velocity);
+  }
+  lookedAt = w->raycast(body.position, Forward(input.lookX, input.lookZ), 8.0f);
 
-  glm::vec3 acceleration{0, 0, 0};
+  state.position = body.position;
+  state.lookedAt = lookedAt;
+  w->takeView(state.world);
+}
 
+FrameRet IngameState::frame(Game *g, sf::Window &window, float const timeDelta) {
+  auto const frameStart = std::chrono::steady_clock::now();
+
+  if(benchmark) {
+    auto at = input.moveTo.value_or(simulation->frame().current->position);
+    if(!benchmark->frame(*w, at, lookX, lookZ))
+      fr.exitGame = true;
+    input.moveTo = at;
+  }
+
+  input.move = {0, 0, 0};
   if(!releaseCursor) {
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::W))
-      acceleration += Forward(lookX, 0);
+      input.move += Forward(lookX, 0);
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::S))
-      acceleration -= Forward(lookX, 0);
+      input.move -= Forward(lookX, 0);
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::D))
-      acceleration += Forward(lookX - acos(-1.0f) / 2, 0);
+      input.move += Forward(lookX - acos(-1.0f) / 2, 0);
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::A))
-      acceleration += Forward(lookX + acos(-1.0f) / 2, 0);
+      input.move += Forward(lookX + acos(-1.0f) / 2, 0);
 
-    if(acceleration != glm::vec3{0, 0, 0}) { acceleration /= sqrt(acceleration.x * acceleration.x + acceleration.y * acceleration.y); }
+    if(input.move != glm::vec3{0, 0, 0}) { input.move /= sqrt(input.move.x * input.move.x + input.move.y * input.move.y); }
 
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
-      acceleration.z += 1.f;
+      input.move.z += 1.f;
     if(sf::Keyboard::isKeyPressed(sf::Keyboard::LShift))
-      acceleration.z -= 1.f;
+      input.move.z -= 1.f;
   }
+  input.lookX   = lookX;
+  input.lookZ   = lookZ;
+  input.placing = placing;
+  simulation->input(input);
+  input.breakBlock = input.placeBlock = false;
 
-  velocity += acceleration * timeDelta * 250.0f;
+  // Between the last two steps, or right on the path while benchmarking
+  auto const frame    = simulation->frame();
+  auto const position = input.moveTo.value_or(frame.position());
+  auto const cam      = Camera(position, lookX, lookZ, -g->fov() * 2, static_cast<float>(window.getSize().x) / window.getSize().y,
+                               governor ? governor->knobs().renderDistance : g->renderDistance());
 
-  position += velocity * timeDelta;
+  if(recorder)
+    recorder->frame(position);
 
-  if(isVerbose)
-    std::cerr << position.x << " " << position.y << " " << position.z << " " << lookX << " " << lookZ << " " << length(velocity) << "\n";
+  if(isVerbose) {
+    auto const stats = simulation->stats();
+    std::cerr << position.x << " " << position.y << " " << position.z << " " << lookX << " " << lookZ << " step " << frame.current->step
+              << " " << stats.stepMsAvg << "ms dropped " << stats.stepsDropped << "\n";
+  }
 
   glClearColor(static_cast<float>(62) / 255, static_cast<float>(215) / 255, static_cast<float>(249) / 255, 1.0f);
   glEnable(GL_DEPTH_TEST);
@@ -70,9 +142,9 @@ FrameRet IngameState::frame(Game *g, sf::Window &window, float const timeDelta)
 
   g->shaderBasic.update(Transform(), cam);
   g->shaderBasic.bind();
-  w->draw(timeDelta, cam, g->shaderBasic);
+  w->draw(timeDelta, cam, g->shaderBasic, frame.current->world);
 
-  if([[maybe_unused]] auto [block, side, x, y, z, dist] = w->raycast(position, Forward(lookX, lookZ), 8.0f); block) {
+  if([[maybe_unused]] auto [block, side, x, y, z, dist] = frame.current->lookedAt; block) {
     glColor3f(0, 0, 0);
     glBegin(GL_LINES);
     glVertex3f(x - 0.001f, y - 0.001f, z - 0.001f);
@@ -118,6 +190,17 @@ FrameRet IngameState::frame(Game *g, sf::Window &window, float const timeDelta)
   window.setMouseCursorVisible(releaseCursor);
   window.display();
 
+  // Swapping buffers counts, it's where the frame waits for the GPU
+  if(governor) {
+    std::chrono::duration<float, std::milli> const frameTime = std::chrono::steady_clock::now() - frameStart;
+    if(governor->frame(frameTime.count())) {
+      auto const stages = w->pipelineStats();
+      auto const queued = [&](ChunkStage const stage) { return stages[static_cast<std::size_t>(stage)].queued; };
+      if(governor->update(queued(ChunkStage::Uploaded), queued(ChunkStage::Meshed)))
+        ApplyQuality(*w, governor->knobs());
+    }
+  }
+
   auto ret = std::move(fr);
   return ret;
 }
@@ -149,6 +232,33 @@ void IngameState::handleEvent(Game *g, sf::Window &window, sf::Event &event) {
       break;
     case sf::Keyboard::Key::F3:
       isVerbose = !isVerbose;
+      break;
+    case sf::Keyboard::Key::F4:
+      if(recorder) {
+        recorder->save("recorded.path", seed);
+        recorder.reset();
+      }
+      else
+        recorder.emplace();
+      break;
+    case sf::Keyboard::Key::Num1:
+      placing = DirtHandle;
+      break;
+    case sf::Keyboard::Key::Num2:
+      placing = StoneHandle;
+      break;
+    case sf::Keyboard::Key::Num3:
+      placing = SandHandle;
+      break;
+    case sf::Keyboard::Key::Num4:
+      placing = WaterHandle;
+      break;
+    case sf::Keyboard::Key::Num5:
+      placing = LavaHandle;
+      break;
+    case sf::Keyboard::Key::Num6:
+      placing = TorchHandle;
+      break;
     }
     break;
   case sf::Event::MouseMoved:
@@ -172,48 +282,45 @@ void IngameState::handleEvent(Game *g, sf::Window &window, sf::Event &event) {
     }
     break;
   case sf::Event::MouseButtonPressed:
+    // Taken by the next step
     if(!releaseCursor) {
-      if(event.mouseButton.button == sf::Mouse::Button::Left) {
-        if([[maybe_unused]] auto [block, side, x, y, z, dist] = w->raycast(position, Forward(lookX, lookZ), 8.0f); block) {
-          auto const xx                                       = Chunk::decomposeBlockPos(x);
-          auto const yy                                       = Chunk::decomposeBlockPos(y);
-          auto const zz                                       = Chunk::decomposeBlockPos(z);
-          auto c                                              = w->getChunk<false>(xx.second, yy.second, zz.second);
-          c->removeBlockAt(xx.first, yy.first, zz.first);
-        }
-      }
-      else if(event.mouseButton.button == sf::Mouse::Button::Right) {
-        if([[maybe_unused]] auto [block, side, x, y, z, dist] = w->raycast(position, Forward(lookX, lookZ), 8.0f); block) {
-          switch (side) {
-          case BlockSide::Top:
-            ++z;
-            break;
-          case BlockSide::Bottom:
-            --z;
-            break;
-          }
-          auto xx                                             = Chunk::decomposeBlockPos(x);
-          auto yy                                             = Chunk::decomposeBlockPos(y);
-          auto zz                                             = Chunk::decomposeBlockPos(z);
-          auto c                                              = w->getChunk<false>(xx.second, yy.second, zz.second);
-          auto blockHere                                      = c->blockAt(xx.first, yy.first, zz.first);
-          if (!blockHere) {
-            auto blk = BlockFactoryHandles[DirtHandle](x, y, z, &*w);
-            c->addBlockAt(xx.first, yy.first, zz.first, std::move(blk));
-          }
-        }
-      }
+      if(event.mouseButton.button == sf::Mouse::Button::Left)
+        input.breakBlock = true;
+      else if(event.mouseButton.button == sf::Mouse::Button::Right)
+        input.placeBlock = true;
     }
     break;
   }
 }
 
-float IngameState::pressure(float const h) const {
-  auto p = (2.574681483305359e6f - (1.173851852033113f * h) + (1.784060919377516e-7f * h * h) - (9.038819697211279e-15f * h * h * h));
-  p      = std::max(0.0f, p);
-  return p;
+void IngameState::breakBlock() {
+  if([[maybe_unused]] auto [block, side, x, y, z, dist] = lookedAt; block) {
+    lookedAt = {};
+    block->onBreak(*w, x, y, z);
+    auto const xx = Chunk::decomposeBlockPos(x);
+    auto const yy = Chunk::decomposeBlockPos(y);
+    auto const zz = Chunk::decomposeBlockPos(z);
+    if(auto c = w->getChunk<false>(xx.second, yy.second, zz.second))
+      c->removeBlockAt(xx.first, yy.first, zz.first);
+  }
 }
 
-glm::vec3 IngameState::drag(const glm::vec3 &velocity, float const coefficient) const {
-  return (velocity * length(velocity) * (coefficient * pressure(position.z / 10000))) + (coefficient * pressure(position.z / 10000) * 100.0f * velocity);
+void IngameState::placeBlock(BlockHandle const handle) {
+  if([[maybe_unused]] auto [block, side, x, y, z, dist] = lookedAt; block) {
+    lookedAt = {};
+    switch (side) {
+    case BlockSide::Top:
+      ++z;
+      break;
+    case BlockSide::Bottom:
+      --z;
+      break;
+    }
+    auto const xx = Chunk::decomposeBlockPos(x);
+    auto const yy = Chunk::decomposeBlockPos(y);
+    auto const zz = Chunk::decomposeBlockPos(z);
+    auto const c  = w->getChunk<false>(xx.second, yy.second, zz.second);
+    if(c && !c->blockAt(xx.first, yy.first, zz.first))
+      c->addBlockAt(xx.first, yy.first, zz.first, BlockFactoryHandles[handle](x, y, z, &*w));
+  }
 }
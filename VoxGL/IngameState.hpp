@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <optional>
 #include <set>
 
 #include "GameState.hpp"
@@ -8,23 +10,47 @@
 #include "Player.hpp"
 #include "World.hpp"
 #include "Chunk.hpp"
+#include "Benchmark.hpp"
+#include "QualityGovernor.hpp"
+#include "Simulation.hpp"
 
 #include "glm/glm.hpp"
 
 struct IngameState: public GameState {
-  IngameState(Game *, sf::Window &);
+  IngameState(Game *, sf::Window &, long long seed = 0, std::unique_ptr<Benchmark> benchmark = nullptr);
   ~IngameState() override;;
   FrameRet frame(Game *, sf::Window &, float timeDelta) override;
   void handleEvent(Game *, sf::Window &, sf::Event &) override;
   std::set<Player> players;
-  glm::vec3 position{0, 0, Chunk::blockHeight(1.f)};
-  glm::vec3 velocity{0, 0, 0};
+  // Moved by the simulation thread only. The render thread draws where the simulation says the player is.
+  PlayerBody body;
   float lookX        = .0f, lookZ = .0f;
   bool releaseCursor = isDebugging;
   bool isVerbose     = false;
-  glm::vec3 drag(glm::vec3 const &velocity, float coefficient) const;
-  float pressure(float h) const;
+  // What the crosshair was on after the last step, clicks act on this. Simulation thread only.
+  RaycastResult lookedAt{};
+  // Simulation thread only
+  std::array<ItemStack, 4 * 9> inventory{};
+  // Block placed on right click, picked with the number keys
+  BlockHandle placing = DirtHandle;
+  // Gathered on the render thread and handed to the simulation every frame
+  PlayerInput input;
+
+  long long const seed;
+  // When set, the camera follows the benchmark path instead of player input
+  std::unique_ptr<Benchmark> benchmark;
+  std::optional<PathRecorder> recorder;
 
   //Initialize the world last.
   std::unique_ptr<World> w;
+  // Steps the world, after it's there and stopped before it goes
+  std::unique_ptr<Simulation> simulation;
+  // Holds the target frame time, if the game or the benchmark has one
+  std::optional<QualityGovernor> governor;
+
+private:
+  // A step of the simulation thread
+  void step(PlayerInput const &input, RenderState &state);
+  void breakBlock();
+  void placeBlock(BlockHandle handle);
 };
@@ -1,8 +1,26 @@
 #pragma once
 
+#include "Block.hpp"
+
+#include <algorithm>
 #include <optional>
 #include <utility>
 
+// A stack of blocks as plain data, so item entities don't need a heap object or virtual calls per item
+struct ItemStack {
+  BlockHandle block;
+  int count;
+
+  // Moves as much of other into this stack as fits. Returns whether anything moved.
+  bool merge(ItemStack &other, int const maxStack = 64) {
+    if(other.block != block || !other.count || count >= maxStack)
+      return false;
+    auto const moved = std::min(other.count, maxStack - count);
+    count += moved, other.count -= moved;
+    return true;
+  }
+};
+
 struct Item {
   virtual ~Item() { }
   virtual void operator+=(Item *) { }
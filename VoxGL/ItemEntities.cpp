@@ -0,0 +1,271 @@
+#include "ItemEntities.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "Blocks.hpp"
+#include "Collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+constexpr float ItemHalfSize = .125f;
+constexpr float ItemGravity  = 20.f;
+// Fraction of horizontal speed lost per second while lying on the ground
+constexpr float ItemFriction = 8.f;
+// Items on the ground slower than this come to rest
+constexpr float ItemRestSpeed  = .05f;
+constexpr float ItemDespawnAge = 300.f;
+constexpr float ItemVoidDepth  = -64.f;
+// Stacks of the same block closer than this merge into one
+constexpr float ItemMergeRadius = .75f;
+constexpr int ItemMaxStack      = 64;
+// Items closer than this many chunks to each other in a worker's range share one neighbourhood fetch
+constexpr BlockCoord ItemFetchChunks  = 4;
+constexpr std::size_t ItemsPerWorker = 1024;
+// Items drawn at most, the nearest ones win
+constexpr std::size_t ItemDrawLimit = 512;
+constexpr float ItemDrawDistance    = 48.f;
+
+void ItemEntities::spawn(ItemStack const stack, glm::vec3 const &position, glm::vec3 const &velocity) {
+  if(stack.count <= 0)
+    return;
+  std::lock_guard<std::mutex> lck(spawnMutex);
+  spawns.push_back({stack, position, velocity});
+}
+
+void ItemEntities::tick(World &world, float const dt) {
+  {
+    std::lock_guard<std::mutex> lck(spawnMutex);
+    for(auto const &s: spawns) {
+      positions.push_back(s.position);
+      velocities.push_back(s.velocity);
+      blocks.push_back(s.stack.block);
+      counts.push_back(s.stack.count);
+      ages.push_back(.0f);
+      resting.push_back(false);
+      moved.push_back(true);
+    }
+    spawns.clear();
+  }
+
+  auto const workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), size() / ItemsPerWorker);
+  if(workers <= 1)
+    integrate(world, dt, 0, size());
+  else {
+    std::vector<std::future<void>> futs;
+    auto const perWorker = (size() + workers - 1) / workers;
+    for(std::size_t begin = 0; begin < size(); begin += perWorker)
+      futs.push_back(std::async(std::launch::async, &ItemEntities::integrate, this, std::ref(world), dt, begin,
+                                std::min(begin + perWorker, size())));
+    for(auto &f: futs)
+      f.get();
+  }
+
+  compact();
+  rebuildGrid();
+  mergeStacks();
+}
+
+void ItemEntities::integrate(World &world, float const dt, std::size_t const begin, std::size_t const end) {
+  if(begin == end)
+    return;
+
+  glm::vec3 const half{ItemHalfSize, ItemHalfSize, ItemHalfSize};
+
+  // Items dropped in one place end up in one range, one fetch around all of them saves a lock per item
+  auto lo = positions[begin], hi = positions[begin];
+  for(auto i = begin; i < end; ++i)
+    lo = glm::min(lo, positions[i]), hi = glm::max(hi, positions[i]);
+
+  ChunkNeighbourhood neighbourhood;
+  auto const span = glm::ivec3(glm::floor(hi / static_cast<float>(ChunkSize))) - glm::ivec3(glm::floor(lo / static_cast<float>(ChunkSize)));
+  if(span.x < ItemFetchChunks && span.y < ItemFetchChunks && span.z < ItemFetchChunks)
+    neighbourhood.fetch(world, glm::ivec3(glm::floor(lo)), glm::ivec3(glm::floor(hi)), 1);
+
+  glm::ivec3 min, max;
+  for(auto i = begin; i < end; ++i) {
+    ages[i] += dt;
+    if(ages[i] > ItemDespawnAge || positions[i].z < ItemVoidDepth) {
+      counts[i] = 0;
+      continue;
+    }
+
+    AABB const box{positions[i] - half, positions[i] + half};
+    moved[i] = false;
+    if(resting[i]) {
+      if(isSupported(world, neighbourhood, box))
+        continue;
+      resting[i] = false;
+    }
+
+    auto &v = velocities[i];
+    v.z -= ItemGravity * dt;
+
+    auto const displacement = v * dt;
+    SweepBounds(box, displacement, min, max);
+    if(!neighbourhood.covers(min, max))
+      neighbourhood.fetch(world, min, max, 1);
+
+    auto const result = SweepAABB(neighbourhood, box, displacement);
+    positions[i] += result.moved;
+    moved[i] = result.moved != glm::vec3(0, 0, 0);
+    if(result.hitX)
+      v.x = .0f;
+    if(result.hitY)
+      v.y = .0f;
+    if(result.hitZ)
+      v.z = .0f;
+    if(result.onGround()) {
+      auto const keep = std::max(.0f, 1.f - ItemFriction * dt);
+      v.x *= keep, v.y *= keep;
+      if(std::abs(v.x) < ItemRestSpeed && std::abs(v.y) < ItemRestSpeed)
+        v = {0, 0, 0}, resting[i] = true;
+    }
+  }
+}
+
+bool ItemEntities::isSupported(World &world, ChunkNeighbourhood &neighbourhood, AABB const &box) {
+  glm::ivec3 min, max;
+  SweepBounds(box, {0, 0, -ItemHalfSize}, min, max);
+  if(!neighbourhood.covers(min, max))
+    neighbourhood.fetch(world, min, max, 1);
+
+  for(auto y = min.y; y <= max.y; ++y)
+    for(auto x = min.x; x <= max.x; ++x)
+      if(neighbourhood.isSolid(x, y, min.z))
+        return true;
+  return false;
+}
+
+void ItemEntities::compact() {
+  std::size_t kept = 0;
+  for(std::size_t i = 0; i < size(); ++i) {
+    if(!counts[i])
+      continue;
+    if(kept != i) {
+      positions[kept]  = positions[i];
+      velocities[kept] = velocities[i];
+      blocks[kept]     = blocks[i];
+      counts[kept]     = counts[i];
+      ages[kept]       = ages[i];
+      resting[kept]    = resting[i];
+      moved[kept]      = moved[i];
+    }
+    ++kept;
+  }
+
+  positions.resize(kept);
+  velocities.resize(kept);
+  blocks.resize(kept);
+  counts.resize(kept);
+  ages.resize(kept);
+  resting.resize(kept);
+  moved.resize(kept);
+}
+
+std::uint32_t ItemEntities::bucketOf(glm::ivec3 const &cell) const {
+  auto const h = static_cast<std::uint32_t>(cell.x) * 73856093u ^ static_cast<std::uint32_t>(cell.y) * 19349663u ^
+                 static_cast<std::uint32_t>(cell.z) * 83492791u;
+  return h & bucketMask;
+}
+
+void ItemEntities::rebuildGrid() {
+  // Around two buckets per item, so most buckets hold a single cell
+  std::uint32_t buckets = 64;
+  while(buckets < 2 * size())
+    buckets <<= 1;
+  bucketMask = buckets - 1;
+
+  // Counting sort, so the grid is a few flat arrays that are reused every tick
+  bucketStart.assign(buckets + 1, 0);
+  for(std::size_t i = 0; i < size(); ++i)
+    ++bucketStart[bucketOf(glm::ivec3(glm::floor(positions[i]))) + 1];
+  for(std::uint32_t b = 0; b < buckets; ++b)
+    bucketStart[b + 1] += bucketStart[b];
+
+  bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+  sortedItems.resize(size());
+  for(std::size_t i = 0; i < size(); ++i)
+    sortedItems[bucketFill[bucketOf(glm::ivec3(glm::floor(positions[i])))]++] = static_cast<std::uint32_t>(i);
+}
+
+void ItemEntities::mergeStacks() {
+  // Items that stayed put already had their chance to merge with everything around them.
+  // The lower index absorbs the higher one and buckets list items by index, so the result doesn't depend on thread count.
+  for(std::uint32_t i = 0; i < size(); ++i) {
+    if(!moved[i] || !counts[i])
+      continue;
+
+    forEachNear(positions[i], ItemMergeRadius, [&](std::uint32_t const j) {
+      if(j == i || !counts[i])
+        return;
+      auto const lo = std::min(i, j), hi = std::max(i, j);
+      ItemStack into{blocks[lo], counts[lo]}, from{blocks[hi], counts[hi]};
+      if(into.merge(from, ItemMaxStack))
+        counts[lo] = into.count, counts[hi] = from.count;
+    });
+  }
+}
+
+std::vector<ItemStack> ItemEntities::pickup(glm::vec3 const &center, float const radius) {
+  std::vector<ItemStack> picked;
+  forEachNear(center, radius, [&](std::uint32_t const i) {
+    picked.push_back({blocks[i], counts[i]});
+    counts[i] = 0;
+  });
+  return picked;
+}
+
+// One block of each type to take item meshes from
+static Block *ItemBlock(BlockHandle const handle) {
+  static std::vector<BlockStorage> prototypes;
+  while(prototypes.size() <= static_cast<std::size_t>(handle))
+    prototypes.push_back(CreateBlock(static_cast<int>(prototypes.size()), 0, 0, 0, nullptr));
+
+  return std::visit([](auto &b) -> Block * {
+    if constexpr(std::is_same_v<std::decay_t<decltype(b)>, std::unique_ptr<Block>>)
+      return b.get();
+    else
+      return &b;
+  }, prototypes[handle]);
+}
+
+MeshData ItemEntities::buildMesh(glm::vec3 const &center) {
+  std::vector<std::pair<float, std::size_t>> near;
+  for(std::size_t i = 0; i < size(); ++i) {
+    auto const d = positions[i] - center;
+    if(auto const dist = glm::dot(d, d); counts[i] && dist < ItemDrawDistance * ItemDrawDistance)
+      near.emplace_back(dist, i);
+  }
+  if(near.size() > ItemDrawLimit) {
+    std::nth_element(near.begin(), near.begin() + ItemDrawLimit, near.end());
+    near.resize(ItemDrawLimit);
+  }
+
+  MeshData meshData;
+  for(auto const &[dist, i]: near) {
+    auto const block = ItemBlock(blocks[i]);
+    if(!block)
+      continue;
+
+    for(auto const side: {BlockSide::Top, BlockSide::Bottom, BlockSide::Front, BlockSide::Back, BlockSide::Left, BlockSide::Right}) {
+      auto md = block->getMesh(0, 0, 0, side);
+      for(auto const ind: md.indices)
+        meshData.indices.push_back(static_cast<unsigned>(ind + meshData.vertices.size()));
+      for(auto &vert: md.vertices) {
+        vert.loc = positions[i] + (vert.loc - .5f) * (2.f * ItemHalfSize);
+        meshData.vertices.push_back(vert);
+      }
+    }
+  }
+  return meshData;
+}
+
+void ItemEntities::draw(MeshData const &meshData) {
+  if(meshData.indices.empty())
+    return;
+  mesh = std::make_unique<Mesh>(meshData.vertices, meshData.indices);
+  mesh->draw();
+}
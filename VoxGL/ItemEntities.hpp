@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Collision.hpp"
+#include "Item.hpp"
+#include "Mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct World;
+
+// Dropped items lying around the world. Items are stored as a struct of arrays, so ticking 50k of
+// them touches contiguous memory only and never allocates per item. A spatial hash over 1 block
+// cells is rebuilt every tick for pickup and for merging stacks lying next to each other.
+struct ItemEntities {
+  // Queues an item, it appears at the start of the next tick. Safe to call from any thread.
+  void spawn(ItemStack stack, glm::vec3 const &position, glm::vec3 const &velocity);
+  // Moves every item with gravity and collision in parallel, then merges and despawns
+  void tick(World &world, float dt);
+  // Removes the items within radius of center and returns their stacks
+  std::vector<ItemStack> pickup(glm::vec3 const &center, float radius);
+  // The items nearest to center as small cubes, built by the thread that ticks them
+  MeshData buildMesh(glm::vec3 const &center);
+  // Draws a mesh buildMesh made. Needs the GL context and the block textures bound.
+  void draw(MeshData const &meshData);
+
+  // Includes items picked up or merged away since the last tick
+  std::size_t size() const { return positions.size(); }
+
+private:
+  void integrate(World &world, float dt, std::size_t begin, std::size_t end);
+  bool isSupported(World &world, ChunkNeighbourhood &neighbourhood, AABB const &box);
+  void mergeStacks();
+  void compact();
+  void rebuildGrid();
+  std::uint32_t bucketOf(glm::ivec3 const &cell) const;
+
+  template<typename F>
+  void forEachNear(glm::vec3 const &center, float radius, F &&f);
+
+  // One entry per item in each array. A count of 0 marks an item for removal.
+  std::vector<glm::vec3> positions, velocities;
+  std::vector<BlockHandle> blocks;
+  std::vector<int> counts;
+  std::vector<float> ages;
+  // Resting items lie still on the ground and are only checked for losing their support.
+  // Moved items changed position this tick, only they look for stacks to merge with.
+  std::vector<std::uint8_t> resting, moved;
+
+  // Spatial hash, items sorted by bucket. Items in bucket b are sortedItems[bucketStart[b]] until bucketStart[b + 1].
+  std::vector<std::uint32_t> bucketStart, bucketFill, sortedItems;
+  std::uint32_t bucketMask = 0;
+
+  struct Spawn {
+    ItemStack stack;
+    glm::vec3 position, velocity;
+  };
+
+  std::mutex spawnMutex;
+  std::vector<Spawn> spawns;
+
+  std::unique_ptr<Mesh> mesh;
+};
+
+template<typename F>
+void ItemEntities::forEachNear(glm::vec3 const &center, float const radius, F &&f) {
+  if(!bucketMask)
+    return;
+
+  auto const lo = glm::ivec3(glm::floor(center - glm::vec3(radius, radius, radius)));
+  auto const hi = glm::ivec3(glm::floor(center + glm::vec3(radius, radius, radius)));
+  for(auto z = lo.z; z <= hi.z; ++z)
+    for(auto y = lo.y; y <= hi.y; ++y)
+      for(auto x = lo.x; x <= hi.x; ++x) {
+        glm::ivec3 const cell{x, y, z};
+        auto const bucket = bucketOf(cell);
+        for(auto k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k) {
+          auto const i = sortedItems[k];
+          // Other cells can share the bucket, only take the items that are really in this one
+          if(!counts[i] || glm::ivec3(glm::floor(positions[i])) != cell)
+            continue;
+          auto const d = positions[i] - center;
+          if(glm::dot(d, d) <= radius * radius)
+            f(i);
+        }
+      }
+}
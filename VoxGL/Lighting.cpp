@@ -0,0 +1,194 @@
+#include "Lighting.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static glm::ivec3 const LightDirs[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+constexpr int Up = 4, Down = 5;
+
+float LightBrightness(std::uint8_t const packed) {
+  auto const level = std::max(GetLight(packed, LightChannel::Sky), GetLight(packed, LightChannel::Block));
+  // Every level is a fifth darker than the one above, with a floor so unlit caves aren't pitch black
+  return .05f + .95f * std::pow(.8f, static_cast<float>(MaxLight - level));
+}
+
+void LightEngine::update(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  std::lock_guard<std::mutex> lck(updateMutex);
+  updates.push_back({x, y, z});
+}
+
+std::vector<std::shared_ptr<Chunk>> LightEngine::propagate(World &w) {
+  std::vector<glm::ivec3> cells;
+  {
+    std::lock_guard<std::mutex> lck(updateMutex);
+    cells.swap(updates);
+  }
+  if(cells.empty())
+    return {};
+
+  std::lock_guard<std::mutex> lck(propagateMutex);
+  // Keeps the voxels of chunks being compressed around while light is read from them
+  EpochGuard guard(w.slab);
+  world = &w;
+  propagateChannel(LightChannel::Sky, cells);
+  propagateChannel(LightChannel::Block, cells);
+  chunkCache.clear();
+
+  std::sort(dirty.begin(), dirty.end());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+  return std::move(dirty);
+}
+
+Chunk *LightEngine::chunkAt(glm::ivec3 const &pos) {
+  if(pos.z < 0)
+    return nullptr;
+
+  auto const cx = Chunk::decomposeChunkFromBlock(pos.x), cy = Chunk::decomposeChunkFromBlock(pos.y), cz = Chunk::decomposeChunkFromBlock(pos.z);
+  auto const key = ChunkIndex(cx, cy, cz).repr;
+  auto it        = chunkCache.find(key);
+  if(it == chunkCache.end())
+    it = chunkCache.emplace(key, world->getChunk<false>(cx, cy, cz)).first;
+  return it->second.get();
+}
+
+static int LocalPos(glm::ivec3 const &pos) {
+  return Chunk::blockPos(Chunk::decomposeLocalBlockFromBlock(pos.x), Chunk::decomposeLocalBlockFromBlock(pos.y),
+                         Chunk::decomposeLocalBlockFromBlock(pos.z));
+}
+
+std::uint8_t LightEngine::get(glm::ivec3 const &pos, LightChannel const channel, bool const fromAbove) {
+  auto const chunk = chunkAt(pos);
+  if(!chunk) {
+    if(channel != LightChannel::Sky || pos.z < 0)
+      return 0;
+    // Open sky above the column's height, or above whatever is loaded where the column is unknown
+    auto const height = world->heights.heightAt(pos.x, pos.y);
+    return (height == UnknownHeight ? fromAbove : pos.z > height) ? MaxLight : 0;
+  }
+  return GetLight(chunk->voxels().light[LocalPos(pos)], channel);
+}
+
+void LightEngine::set(Chunk &chunk, glm::ivec3 const &pos, LightChannel const channel, std::uint8_t const level) {
+  {
+    VoxelWrite write(chunk);
+    auto &packed = write->light[LocalPos(pos)];
+    packed       = SetLight(packed, channel, level);
+  }
+  world->onBlockSet(chunk, pos.x, pos.y, pos.z);
+
+  if(dirty.empty() || dirty.back().get() != &chunk)
+    dirty.push_back(chunkCache[ChunkIndex(chunk.cx, chunk.cy, chunk.cz).repr]);
+
+  auto const lx = Chunk::decomposeLocalBlockFromBlock(pos.x), ly = Chunk::decomposeLocalBlockFromBlock(pos.y),
+             lz = Chunk::decomposeLocalBlockFromBlock(pos.z);
+  if(!lx || !ly || !lz || lx == ChunkSize - 1 || ly == ChunkSize - 1 || lz == ChunkSize - 1)
+    for(auto &adjacent: chunk.adjacentTouching(lx, ly, lz))
+      dirty.push_back(std::move(adjacent));
+}
+
+bool LightEngine::isOpaque(Chunk &chunk, glm::ivec3 const &pos) {
+  auto const b = chunk.blockAt(Chunk::decomposeLocalBlockFromBlock(pos.x), Chunk::decomposeLocalBlockFromBlock(pos.y),
+                               Chunk::decomposeLocalBlockFromBlock(pos.z));
+  return b && b->isSolid();
+}
+
+std::uint8_t LightEngine::emission(Chunk &chunk, glm::ivec3 const &pos, LightChannel const channel) {
+  if(channel == LightChannel::Sky)
+    return 0;
+  auto const b = chunk.blockAt(Chunk::decomposeLocalBlockFromBlock(pos.x), Chunk::decomposeLocalBlockFromBlock(pos.y),
+                               Chunk::decomposeLocalBlockFromBlock(pos.z));
+  return b ? b->lightEmission() : 0;
+}
+
+void LightEngine::propagateChannel(LightChannel const channel, std::vector<glm::ivec3> const &cells) {
+  // Light going one block in direction dir, sky light at full strength goes straight down forever
+  auto const passed = [channel](std::uint8_t const level, int const dir) -> std::uint8_t {
+    if(channel == LightChannel::Sky && dir == Down && level == MaxLight)
+      return MaxLight;
+    return level ? level - 1 : 0;
+  };
+
+  addQueue.clear();
+  removeQueue.clear();
+
+  // What each changed block's light should be, judging by its neighbours
+  for(auto const &p: cells) {
+    auto const chunk = chunkAt(p);
+    if(!chunk)
+      continue;
+
+    auto const own = emission(*chunk, p, channel);
+    auto expected  = own;
+    // Nothing above the column's height blocks the sky, no need to look at the neighbours
+    if(channel == LightChannel::Sky && p.z > world->heights.heightAt(p.x, p.y))
+      expected = MaxLight;
+    else if(!isOpaque(*chunk, p))
+      for(int d = 0; d < 6; ++d)
+        expected = std::max(expected, passed(get(p + LightDirs[d], channel, d == Up), d ^ 1));
+
+    auto const current = get(p, channel);
+    if(current > expected) {
+      set(*chunk, p, channel, 0);
+      removeQueue.push_back({p, current});
+      if(own) {
+        set(*chunk, p, channel, own);
+        addQueue.push_back({p, own});
+      }
+    }
+    else if(current < expected) {
+      set(*chunk, p, channel, expected);
+      addQueue.push_back({p, expected});
+    }
+  }
+
+  // Clears everything the removed light reached, up to where brighter light from elsewhere takes over
+  for(std::size_t i = 0; i < removeQueue.size(); ++i) {
+    auto const [p, level] = removeQueue[i];
+    for(int d = 0; d < 6; ++d) {
+      auto const m     = p + LightDirs[d];
+      auto const chunk = chunkAt(m);
+      if(!chunk)
+        continue;
+      auto const lm = get(m, channel);
+      if(!lm)
+        continue;
+      ++visited;
+
+      if(lm < level || (channel == LightChannel::Sky && d == Down && level == MaxLight)) {
+        set(*chunk, m, channel, 0);
+        removeQueue.push_back({m, lm});
+        if(auto const own = emission(*chunk, m, channel)) {
+          set(*chunk, m, channel, own);
+          addQueue.push_back({m, own});
+        }
+      }
+      else
+        addQueue.push_back({m, lm});
+    }
+  }
+
+  // Refills from the sources and the edges of the cleared area
+  for(std::size_t i = 0; i < addQueue.size(); ++i) {
+    auto const p     = addQueue[i].pos;
+    auto const level = get(p, channel);
+    if(level <= 1)
+      continue;
+
+    for(int d = 0; d < 6; ++d) {
+      auto const m     = p + LightDirs[d];
+      auto const chunk = chunkAt(m);
+      if(!chunk || isOpaque(*chunk, m))
+        continue;
+      ++visited;
+
+      auto const next = passed(level, d);
+      if(get(m, channel) < next) {
+        set(*chunk, m, channel, next);
+        addQueue.push_back({m, next});
+      }
+    }
+  }
+}
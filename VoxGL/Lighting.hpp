@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Blocks.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct Chunk;
+struct World;
+
+constexpr std::uint8_t MaxLight = 15;
+
+// Each block stores both channels in one byte, sky light in the high nibble and block light in the low one.
+// Sky light comes down from above without fading, block light comes from blocks like torches and lava.
+enum struct LightChannel {
+  Sky,
+  Block,
+};
+
+constexpr std::uint8_t GetLight(std::uint8_t const packed, LightChannel const channel) {
+  return channel == LightChannel::Sky ? packed >> 4 : packed & 0xf;
+}
+
+constexpr std::uint8_t SetLight(std::uint8_t const packed, LightChannel const channel, std::uint8_t const level) {
+  return channel == LightChannel::Sky ? static_cast<std::uint8_t>((packed & 0x0f) | (level << 4))
+                                      : static_cast<std::uint8_t>((packed & 0xf0) | level);
+}
+
+// Brightness a face lit by the brighter of both channels is drawn with
+float LightBrightness(std::uint8_t packed);
+
+// Keeps light up to date as blocks change, by flood fill from the changed blocks only. Light that a change cut
+// off is first cleared outwards until brighter light from elsewhere is met, then refilled from there, so the
+// cost follows the size of the area whose light actually changed.
+struct LightEngine {
+  // Rechecks the light at x, y, z once propagate() runs. Safe to call from any thread.
+  void update(BlockCoord x, BlockCoord y, BlockCoord z);
+  // Propagates the changes from every updated block. Returns the chunks whose meshes show light that changed.
+  std::vector<std::shared_ptr<Chunk>> propagate(World &world);
+
+  // Blocks visited by propagation so far
+  std::size_t cellsVisited() const { return visited; }
+
+private:
+  struct Node {
+    glm::ivec3 pos;
+    std::uint8_t level;
+  };
+
+  void propagateChannel(LightChannel channel, std::vector<glm::ivec3> const &cells);
+  Chunk *chunkAt(glm::ivec3 const &pos);
+  std::uint8_t get(glm::ivec3 const &pos, LightChannel channel, bool fromAbove = false);
+  void set(Chunk &chunk, glm::ivec3 const &pos, LightChannel channel, std::uint8_t level);
+  bool isOpaque(Chunk &chunk, glm::ivec3 const &pos);
+  std::uint8_t emission(Chunk &chunk, glm::ivec3 const &pos, LightChannel channel);
+
+  std::mutex updateMutex;
+  std::vector<glm::ivec3> updates;
+
+  // State of the current propagate() call
+  std::mutex propagateMutex;
+  World *world = nullptr;
+  std::unordered_map<std::int64_t, std::shared_ptr<Chunk>> chunkCache;
+  std::vector<std::shared_ptr<Chunk>> dirty;
+  std::vector<Node> addQueue, removeQueue;
+  std::size_t visited = 0;
+};
@@ -2,6 +2,7 @@
 
 #include "GL/glew.h"
 #include "cstring"
+#include <utility>
 #include "Game.hpp"
 
 Mesh::Mesh(std::vector<MeshPoint> const &vertices, std::vector<unsigned> const &indices) :
@@ -15,12 +16,15 @@ Mesh::Mesh(std::vector<MeshPoint> const &vertices, std::vector<unsigned> const &
   std::vector<MeshPoint::TextPos> textVerts(vertices.size());
   for(size_t i   = 0; i < vertices.size(); ++i)
     textVerts[i] = vertices[i].textPoint;
+  std::vector<float> lightVerts(vertices.size());
+  for(size_t i    = 0; i < vertices.size(); ++i)
+    lightVerts[i] = vertices[i].light;
 
   // @TODO: Make callable from any thread!
   auto err = glGetError();
   assert(glGetError() == GL_NO_ERROR);
 
-  glGenVertexArrays(VbNum, &vertexArrayObject);
+  glGenVertexArrays(1, &vertexArrayObject);
   glBindVertexArray(vertexArrayObject);
   glGenBuffers(VbNum, vertexArrayBuffers);
 
@@ -38,6 +42,12 @@ Mesh::Mesh(std::vector<MeshPoint> const &vertices, std::vector<unsigned> const &
   glEnableVertexAttribArray(VbTextcoord);
   glVertexAttribPointer(VbTextcoord, sizeof(textVerts[0]) / sizeof(textVerts[0].x), GL_FLOAT, GL_FALSE, 0, nullptr);
 
+  glBindBuffer(GL_ARRAY_BUFFER, vertexArrayBuffers[VbLight]);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(lightVerts[0]), lightVerts.data(), GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(VbLight);
+  glVertexAttribPointer(VbLight, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertexArrayBuffers[VbIndices]);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(indices[0]), indices.data(), GL_STATIC_DRAW);
 
@@ -49,19 +59,22 @@ Mesh::Mesh(std::vector<MeshPoint> const &vertices, std::vector<unsigned> const &
 Mesh::Mesh(Mesh &&other) noexcept: count{other.count}, vertexArrayObject{other.vertexArrayObject},
                                    vertexArrayBuffers{} {
   std::memcpy(vertexArrayBuffers, other.vertexArrayBuffers, VbNum * sizeof(GLuint));
+  other.count = 0;
 }
 
 Mesh &Mesh::operator=(Mesh &&other) noexcept {
-  count             = other.count;
-  vertexArrayObject = other.vertexArrayObject;
-  std::memcpy(vertexArrayBuffers, other.vertexArrayBuffers, VbNum * sizeof(GLuint));
+  std::swap(count, other.count);
+  std::swap(vertexArrayObject, other.vertexArrayObject);
+  std::swap(vertexArrayBuffers, other.vertexArrayBuffers);
 
   return *this;
 }
 
 Mesh::~Mesh() {
-  if(count)
-    glDeleteVertexArrays(VbNum, &vertexArrayObject);
+  if(count) {
+    glDeleteVertexArrays(1, &vertexArrayObject);
+    glDeleteBuffers(VbNum, vertexArrayBuffers);
+  }
 }
 
 void Mesh::draw() const {
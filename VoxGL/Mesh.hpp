@@ -10,6 +10,8 @@ struct MeshPoint {
   using TextPos = glm::vec2;
   WorldPos loc;
   TextPos textPoint;
+  // Brightness baked in by the mesher, from 0 to 1
+  float light = 1.f;
 };
 
 struct MeshData {
@@ -29,6 +31,7 @@ private:
   enum {
     VbPosition,
     VbTextcoord,
+    VbLight,
     VbIndices,
 
     VbNum
@@ -36,5 +39,5 @@ private:
 
   unsigned int count;
   GLuint vertexArrayObject;
-  GLuint vertexArrayBuffers[3];
+  GLuint vertexArrayBuffers[VbNum];
 };
@@ -0,0 +1,89 @@
+#include "MeshBufferPool.hpp"
+
+#include <algorithm>
+
+// The smallest class whose buffers all hold vertices
+std::size_t MeshBufferPool::ClassFor(std::size_t const vertices) {
+  std::size_t bits = MinClassBits;
+  while(bits < MinClassBits + NumClasses - 1 && (std::size_t{1} << bits) < vertices)
+    ++bits;
+  return bits - MinClassBits;
+}
+
+// Buffers from the first class at or above firstClass that has any, counted as checked out. Call under mutex.
+std::unique_ptr<MeshData> MeshBufferPool::take(std::size_t const firstClass) {
+  highWater = std::max(highWater, ++live);
+  for(auto c = firstClass; c < NumClasses; ++c)
+    if(!classes[c].empty()) {
+      auto buffers = std::move(classes[c].back());
+      classes[c].pop_back();
+      --pooled;
+      return buffers;
+    }
+  ++created;
+  return nullptr;
+}
+
+std::unique_ptr<MeshData> MeshBufferPool::acquire(std::size_t const vertices) {
+  std::unique_ptr<MeshData> buffers;
+  auto const c = ClassFor(vertices);
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    buffers = take(c);
+  }
+  if(buffers && buffers->vertices.capacity() >= vertices)
+    return buffers;
+
+  if(buffers)
+    ++grown;
+  else
+    buffers = std::make_unique<MeshData>();
+  // New buffers get the whole class, so they go back into it. A quad has 4 vertices to 6 indices.
+  auto const capacity = std::max(vertices, std::size_t{1} << (c + MinClassBits));
+  buffers->vertices.reserve(capacity);
+  buffers->indices.reserve(capacity * 3 / 2);
+  return buffers;
+}
+
+std::unique_ptr<MeshData> MeshBufferPool::acquireLargest() {
+  std::unique_ptr<MeshData> buffers;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    auto c = NumClasses;
+    while(c > 0 && classes[c - 1].empty())
+      --c;
+    buffers = take(c ? c - 1 : 0);
+  }
+  return buffers ? std::move(buffers) : std::make_unique<MeshData>();
+}
+
+void MeshBufferPool::release(std::unique_ptr<MeshData> buffers) {
+  if(!buffers)
+    return;
+  buffers->vertices.clear();
+  buffers->indices.clear();
+
+  // Freed outside the lock if its class is full
+  std::unique_ptr<MeshData> excess;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    --live;
+
+    // Filed by what it can hold without growing
+    auto c = ClassFor(buffers->vertices.capacity());
+    if(c && (std::size_t{1} << (c + MinClassBits)) > buffers->vertices.capacity())
+      --c;
+    auto &free = classes[c];
+    if(free.size() < MaxPerClass) {
+      free.push_back(std::move(buffers));
+      ++pooled;
+    }
+    else
+      excess = std::move(buffers);
+  }
+}
+
+PoolStats MeshBufferPool::stats() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return {live, highWater, pooled, created + grown};
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ChunkPool.hpp"
+#include "Mesh.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Vertex and index buffers for the mesher to fill, taken back once their mesh is uploaded or thrown away and
+// handed out again. Buffers are filed by vertex capacity in power of two size classes. How big a mesh will be
+// isn't known up front, so the mesher builds it in the largest buffers there are and copies it into ones just
+// big enough, and neither has to grow once the pool is warm. Safe to use from any thread.
+struct MeshBufferPool {
+  // Empty buffers with room for at least vertices vertices, and indices to go with them
+  std::unique_ptr<MeshData> acquire(std::size_t vertices);
+  // The largest empty buffers in the pool, to build a mesh of unknown size in
+  std::unique_ptr<MeshData> acquireLargest();
+  // Takes buffers back, keeping their capacity
+  void release(std::unique_ptr<MeshData> buffers);
+  // For the mesher to report it had to grow buffers it was given
+  void onGrown() { ++grown; }
+
+  // Capacity counts the buffers pooled, heap allocations new buffers and buffers that grew
+  PoolStats stats();
+
+private:
+  static constexpr std::size_t MinClassBits = 6;
+  static constexpr std::size_t NumClasses   = 12;
+  // Buffers kept per size class, the rest are freed
+  static constexpr std::size_t MaxPerClass = 512;
+
+  static std::size_t ClassFor(std::size_t vertices);
+  std::unique_ptr<MeshData> take(std::size_t firstClass);
+
+  std::mutex mutex;
+  std::array<std::vector<std::unique_ptr<MeshData>>, NumClasses> classes;
+  std::size_t pooled = 0, live = 0, highWater = 0, created = 0;
+  std::atomic<std::size_t> grown{0};
+};
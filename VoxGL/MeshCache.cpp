@@ -0,0 +1,294 @@
+#include "MeshCache.hpp"
+
+#include "World.hpp"
+#include "MeshBufferPool.hpp"
+#include "Util.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  struct Header {
+    char magic[8];
+    std::int64_t seed;
+    std::uint32_t mesherVersion, vertexBytes;
+  };
+
+  constexpr char Magic[8] = {'V', 'o', 'x', 'G', 'L', 'M', 'c', '1'};
+}
+
+static_assert(sizeof(Header) == 24, "The cache header is written as is");
+static_assert(std::is_trivially_copyable_v<MeshPoint>, "Vertices are written and mapped as they are in memory");
+
+// A mesh in the file, followed by its vertices and indices
+struct MeshCache::Record {
+  std::uint64_t key;
+  std::int32_t cx, cy, cz;
+  std::uint32_t vertices, indices;
+  // Over the rest of the record and the mesh, so a mesh only half written doesn't pass
+  std::uint32_t check;
+
+  std::size_t meshBytes() const { return vertices * sizeof(MeshPoint) + indices * sizeof(unsigned); }
+  // Of the record followed by the mesh at mesh
+  std::uint32_t checksum(void const *const mesh) const {
+    return static_cast<std::uint32_t>(HashWords(mesh, meshBytes(), HashWords(this, offsetof(Record, check))));
+  }
+};
+
+// The file as it was when it was opened, read only
+struct MeshCache::Mapping {
+  explicit Mapping(std::string const &path) {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || !fileSize.QuadPart)
+      return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping && (view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)))
+      size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st{};
+    if(fd < 0 || fstat(fd, &st) || !st.st_size)
+      return;
+    auto const v = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if(v != MAP_FAILED) {
+      view = v;
+      size = static_cast<std::size_t>(st.st_size);
+    }
+#endif
+  }
+
+  ~Mapping() {
+#ifdef _WIN32
+    if(view)
+      UnmapViewOfFile(view);
+    if(mapping)
+      CloseHandle(mapping);
+    if(file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+#else
+    if(view)
+      munmap(view, size);
+    if(fd >= 0)
+      ::close(fd);
+#endif
+  }
+
+  Mapping(Mapping const &) = delete;
+  Mapping &operator=(Mapping const &) = delete;
+
+  char const *data() const { return static_cast<char const *>(view); }
+
+  std::size_t size = 0;
+
+private:
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+  void *view = nullptr;
+#else
+  int fd = -1;
+  void *view = nullptr;
+#endif
+};
+
+static Header MakeHeader(long long const seed) {
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.seed          = seed;
+  header.mesherVersion = MeshCache::MesherVersion;
+  header.vertexBytes   = sizeof(MeshPoint);
+  return header;
+}
+
+MeshCache::MeshCache(std::string path, long long const seed): path(std::move(path)), seed(seed) {
+  if(this->path.empty())
+    return;
+
+  TimedBlock<std::milli> timer(openMs);
+  mapping = std::make_unique<Mapping>(this->path);
+  std::size_t end = 0;
+  if(!scan(end)) {
+    if(mapping->size)
+      std::cerr << "Mesh cache " << this->path << " is for another world or mesher, starting it over\n";
+    if(!startOver())
+      return;
+  }
+  else {
+    std::error_code error;
+    if(end < mapping->size) {
+      std::cerr << "Dropping the torn end of mesh cache " << this->path << "\n";
+      mapping.reset();
+      std::filesystem::resize_file(this->path, end, error);
+      mapping = std::make_unique<Mapping>(this->path);
+      scan(end);
+    }
+
+    std::size_t live = sizeof(Header);
+    for(auto const &[chunk, entry]: entries)
+      live += sizeof(Record) + entry.vertices * sizeof(MeshPoint) + entry.indices * sizeof(unsigned);
+    if(end > CompactAfter && live * 2 < end && compact())
+      scan(end);
+    fileBytes = end;
+  }
+
+  file = std::fopen(this->path.c_str(), "a+b");
+  if(!file) {
+    std::cerr << "Unable to open mesh cache " << this->path << ", meshes won't be kept\n";
+    return;
+  }
+  enabled = true;
+}
+
+MeshCache::~MeshCache() {
+  mapping.reset();
+  if(file)
+    std::fclose(file);
+}
+
+bool MeshCache::scan(std::size_t &end) {
+  entries.clear();
+  end = 0;
+  auto const data = mapping->data();
+  auto const size = mapping->size;
+  auto const header = MakeHeader(seed);
+  if(size < sizeof(Header) || std::memcmp(data, &header, sizeof(Header)))
+    return false;
+
+  end = sizeof(Header);
+  Record record;
+  while(end + sizeof(Record) <= size) {
+    std::memcpy(&record, data + end, sizeof(Record));
+    auto const bytes = sizeof(Record) + record.meshBytes();
+    if(bytes > size - end || record.checksum(data + end + sizeof(Record)) != record.check)
+      break;
+    entries[ChunkIndex(record.cx, record.cy, record.cz).repr] = {record.key, end, record.vertices, record.indices};
+    end += bytes;
+  }
+  return true;
+}
+
+bool MeshCache::startOver() {
+  mapping.reset();
+  entries.clear();
+  auto const f = std::fopen(path.c_str(), "wb");
+  auto const header = MakeHeader(seed);
+  auto const ok     = f && std::fwrite(&header, sizeof(header), 1, f) == 1;
+  if(f)
+    std::fclose(f);
+  if(!ok) {
+    std::cerr << "Unable to create mesh cache " << path << ", meshes won't be kept\n";
+    return false;
+  }
+  mapping   = std::make_unique<Mapping>(path);
+  fileBytes = sizeof(Header);
+  return true;
+}
+
+bool MeshCache::compact() {
+  auto const temp = path + ".tmp";
+  auto const f    = std::fopen(temp.c_str(), "wb");
+  if(!f)
+    return false;
+  auto const header = MakeHeader(seed);
+  auto ok           = std::fwrite(&header, sizeof(header), 1, f) == 1;
+  for(auto const &[chunk, entry]: entries) {
+    auto const bytes = sizeof(Record) + entry.vertices * sizeof(MeshPoint) + entry.indices * sizeof(unsigned);
+    ok = ok && std::fwrite(mapping->data() + entry.offset, 1, bytes, f) == bytes;
+  }
+  ok = !std::fclose(f) && ok;
+
+  std::error_code error;
+  if(ok) {
+    mapping.reset();
+    std::filesystem::rename(temp, path, error);
+    mapping = std::make_unique<Mapping>(path);
+    if(!error)
+      return true;
+  }
+  std::filesystem::remove(temp, error);
+  return false;
+}
+
+std::unique_ptr<MeshData> MeshCache::load(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz, std::uint64_t const key,
+                                          MeshBufferPool &pool) {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    auto const it = entries.find(ChunkIndex(cx, cy, cz).repr);
+    if(it == entries.end() || it->second.key != key) {
+      ++misses;
+      return nullptr;
+    }
+    entry = it->second;
+    ++hits;
+  }
+
+  auto mesh = pool.acquire(entry.vertices);
+  auto const meshAt = entry.offset + sizeof(Record);
+  if(entry.offset + sizeof(Record) + entry.vertices * sizeof(MeshPoint) + entry.indices * sizeof(unsigned) <= mapping->size) {
+    // Mapped meshes are never written again, they're read without the lock
+    auto const vertices = reinterpret_cast<MeshPoint const *>(mapping->data() + meshAt);
+    auto const indices  = reinterpret_cast<unsigned const *>(mapping->data() + meshAt + entry.vertices * sizeof(MeshPoint));
+    mesh->vertices.assign(vertices, vertices + entry.vertices);
+    mesh->indices.assign(indices, indices + entry.indices);
+    return mesh;
+  }
+
+  // Stored since the file was mapped
+  mesh->vertices.resize(entry.vertices);
+  mesh->indices.resize(entry.indices);
+  std::lock_guard<std::mutex> lck(mutex);
+  if(std::fflush(file) || std::fseek(file, static_cast<long>(meshAt), SEEK_SET) ||
+     std::fread(mesh->vertices.data(), sizeof(MeshPoint), entry.vertices, file) != entry.vertices ||
+     std::fread(mesh->indices.data(), sizeof(unsigned), entry.indices, file) != entry.indices) {
+    pool.release(std::move(mesh));
+    return nullptr;
+  }
+  return mesh;
+}
+
+void MeshCache::store(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz, std::uint64_t const key, MeshData const &mesh) {
+  Record record{key, cx, cy, cz, static_cast<std::uint32_t>(mesh.vertices.size()), static_cast<std::uint32_t>(mesh.indices.size()), 0};
+  auto const vertexBytes = mesh.vertices.size() * sizeof(MeshPoint);
+  // Like checksum, over vertices and indices that aren't next to each other in memory. Vertices are a whole number
+  // of words, so the indices are hashed the same either way.
+  static_assert(sizeof(MeshPoint) % sizeof(std::uint64_t) == 0, "Vertices and indices hash like one range");
+  record.check = static_cast<std::uint32_t>(HashWords(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned),
+                                                      HashWords(mesh.vertices.data(), vertexBytes, HashWords(&record, offsetof(Record, check)))));
+
+  std::lock_guard<std::mutex> lck(mutex);
+  if(!enabled)
+    return;
+  auto const it = entries.find(ChunkIndex(cx, cy, cz).repr);
+  if(it != entries.end() && it->second.key == key)
+    return;
+  if(std::fseek(file, 0, SEEK_END) || std::fwrite(&record, sizeof(record), 1, file) != 1 ||
+     std::fwrite(mesh.vertices.data(), 1, vertexBytes, file) != vertexBytes ||
+     std::fwrite(mesh.indices.data(), sizeof(unsigned), mesh.indices.size(), file) != mesh.indices.size()) {
+    std::cerr << "Unable to write to mesh cache " << path << "\n";
+    return;
+  }
+  entries[ChunkIndex(cx, cy, cz).repr] = {key, fileBytes, record.vertices, record.indices};
+  fileBytes += sizeof(record) + record.meshBytes();
+  ++stored;
+}
+
+MeshCacheStats MeshCache::stats() {
+  std::lock_guard<std::mutex> lck(mutex);
+  return {hits, misses, stored, entries.size(), fileBytes, mapping ? mapping->size : 0, openMs};
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Block.hpp"
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct MeshBufferPool;
+
+struct MeshCacheStats {
+  // Meshes found, looked for and not found, and written
+  std::size_t hits, misses, stored;
+  // Chunks with a mesh in the cache, the size of the file and how much of it was mapped when it was opened
+  std::size_t entries, fileBytes, mappedBytes;
+  // Opening the cache, compaction included
+  float openMs;
+};
+
+// Chunk meshes kept on disk from one session to the next, so reloading a world uploads meshes as they're read
+// instead of meshing every chunk again. A mesh is kept under a key that hashes everything the mesher looked at to
+// build it, so a chunk or a neighbour of it that changed since has a different key and misses, and its new mesh
+// replaces the old one.
+//
+// The file is mapped when the cache is opened and meshes from earlier sessions are copied straight out of the
+// mapping. Meshes of this session are appended. A mesh left half written by a crash is dropped on the next
+// open, and once most of the file is meshes replaced since it's compacted then.
+struct MeshCache {
+  // Bumped whenever the mesher or the mesh format changes, which starts every cache over
+  static constexpr std::uint32_t MesherVersion = 1;
+
+  // No cache for an empty path. A cache for another seed or mesher version is started over.
+  explicit MeshCache(std::string path = {}, long long seed = 0);
+  ~MeshCache();
+  MeshCache(MeshCache const &) = delete;
+  MeshCache &operator=(MeshCache const &) = delete;
+
+  bool isEnabled() const { return enabled; }
+  // The mesh of the chunk kept under key in buffers from pool, nullptr if there's none or it's stale
+  std::unique_ptr<MeshData> load(BlockCoord cx, BlockCoord cy, BlockCoord cz, std::uint64_t key, MeshBufferPool &pool);
+  void store(BlockCoord cx, BlockCoord cy, BlockCoord cz, std::uint64_t key, MeshData const &mesh);
+
+  MeshCacheStats stats();
+
+private:
+  struct Record;
+  struct Mapping;
+  struct Entry {
+    std::uint64_t key;
+    // Where the record is in the file
+    std::size_t offset;
+    std::uint32_t vertices, indices;
+  };
+
+  // Compacts once the file is this big and mostly replaced meshes
+  static constexpr std::size_t CompactAfter = 16 << 20;
+
+  // Indexes the records in the mapping, returning where the last whole one ends. False if it isn't ours.
+  bool scan(std::size_t &end);
+  // Writes the latest mesh of every chunk to a new file and swaps it in
+  bool compact();
+  bool startOver();
+
+  std::string path;
+  long long seed;
+  bool enabled = false;
+
+  std::unique_ptr<Mapping> mapping;
+  std::mutex mutex;
+  // Appends, and reads of what was appended since the file was mapped
+  std::FILE *file = nullptr;
+  std::size_t fileBytes = 0;
+  std::unordered_map<long long, Entry> entries;
+  std::size_t hits = 0, misses = 0, stored = 0;
+  float openMs = .0f;
+};
@@ -0,0 +1,1866 @@
+#include "Benchmark.hpp"
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "ChunkClient.hpp"
+#include "FarTerrain.hpp"
+#include "Maths.hpp"
+#include "NetProtocol.hpp"
+#include "QualityGovernor.hpp"
+#include "Simulation.hpp"
+#include "Transform.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+using BenchClock = std::chrono::steady_clock;
+
+constexpr long long BenchSeed = 1337;
+
+// Waits until worldgen has filled the area around the world's position
+static bool WaitForWorldgen(World &world, float const timeout = 120.f) {
+  auto const start = BenchClock::now();
+  while(!world.isSettled()) {
+    if(std::chrono::duration<float>(BenchClock::now() - start).count() > timeout)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return true;
+}
+
+// A world at the bench seed, seen from above the spawn
+struct BenchWorld {
+  glm::vec3 position{0, 0, static_cast<float>(Chunk::blockHeight(1.f))};
+  World world;
+  // Whether worldgen filled the area around position in time
+  bool settled;
+
+  // Waits up to timeout seconds for worldgen, or not at all for 0
+  explicit BenchWorld(WorldOptions const &options = {}, float const timeout = 120.f) :
+    world(&position, BenchSeed, options), settled(timeout > .0f && WaitForWorldgen(world, timeout)) { }
+};
+
+// Calls f with every chunk from min up to but not including max
+template<typename F>
+static void ForEachChunkIn(glm::ivec3 const &min, glm::ivec3 const &max, F &&f) {
+  for(auto cx = min.x; cx < max.x; ++cx)
+    for(auto cy = min.y; cy < max.y; ++cy)
+      for(auto cz = min.z; cz < max.z; ++cz)
+        f(cx, cy, cz);
+}
+
+template<typename F>
+static float SecondsFor(F &&f) {
+  auto const start = BenchClock::now();
+  f();
+  return std::chrono::duration<float>(BenchClock::now() - start).count();
+}
+
+static void RayBenchmark(std::ostream &os) {
+  constexpr std::size_t NumRays = 200000;
+  constexpr float MaxDist       = 64.f;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> offset(-32.f, 32.f), angle(.0f, 2.f * acos(-1.f)), pitch(-1.5f, 1.5f);
+  std::vector<Ray> rays;
+  for(std::size_t i = 0; i < NumRays; ++i)
+    rays.push_back({bench.position + glm::vec3(offset(rng), offset(rng), offset(rng) / 4), Forward(angle(rng), pitch(rng)), MaxDist});
+
+  std::vector<RaycastResult> reference, single;
+  reference.reserve(NumRays), single.reserve(NumRays);
+
+  auto const referenceTime = SecondsFor([&] {
+    for(auto const &r: rays)
+      reference.push_back(world.raycastReference(r.from, r.dir, r.maxDist));
+  });
+  auto const singleTime = SecondsFor([&] {
+    for(auto const &r: rays)
+      single.push_back(world.raycast(r.from, r.dir, r.maxDist));
+  });
+  std::vector<RaycastResult> batch;
+  auto const batchTime = SecondsFor([&] { batch = world.raycast(rays); });
+
+  std::size_t hits = 0, mismatches = 0;
+  for(std::size_t i = 0; i < NumRays; ++i) {
+    hits += std::get<0>(single[i]) != nullptr;
+    mismatches += std::get<0>(reference[i]) != std::get<0>(single[i]) || std::get<0>(batch[i]) != std::get<0>(single[i]);
+  }
+
+  os << "{\n";
+  os << "  \"rays\": " << NumRays << ",\n";
+  os << "  \"max_dist\": " << MaxDist << ",\n";
+  os << "  \"hits\": " << hits << ",\n";
+  os << "  \"mismatches_vs_reference\": " << mismatches << ",\n";
+  os << "  \"reference_rays_per_s\": " << NumRays / referenceTime << ",\n";
+  os << "  \"dda_rays_per_s\": " << NumRays / singleTime << ",\n";
+  os << "  \"dda_batch_rays_per_s\": " << NumRays / batchTime << "\n";
+  os << "}\n";
+}
+
+static void CollisionBenchmark(std::ostream &os) {
+  constexpr std::size_t NumBodies = 5000;
+  constexpr int Ticks             = 200;
+  constexpr float TickTime        = 1.f / 20;
+  constexpr float Gravity         = 20.f;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> offset(-48.f, 48.f), speed(-8.f, 8.f), height(.0f, 16.f);
+  std::vector<Body> bodies;
+  std::vector<glm::vec3> velocities;
+  for(std::size_t i = 0; i < NumBodies; ++i) {
+    auto const at = bench.position + glm::vec3(offset(rng), offset(rng), height(rng));
+    bodies.push_back({{at, at + glm::vec3(.5f, .5f, .5f)}, {0, 0, 0}});
+    velocities.push_back({speed(rng), speed(rng), speed(rng)});
+  }
+
+  std::vector<float> tickMs;
+  std::size_t grounded = 0;
+  for(int tick = 0; tick < Ticks; ++tick) {
+    for(std::size_t i = 0; i < NumBodies; ++i) {
+      velocities[i].z -= Gravity * TickTime;
+      bodies[i].displacement = velocities[i] * TickTime;
+    }
+
+    std::vector<SweepResult> results;
+    tickMs.push_back(1000.f * SecondsFor([&] { results = world.sweep(bodies); }));
+
+    grounded = 0;
+    for(std::size_t i = 0; i < NumBodies; ++i) {
+      bodies[i].box = results[i].box;
+      if(results[i].hitX)
+        velocities[i].x = -velocities[i].x;
+      if(results[i].hitY)
+        velocities[i].y = -velocities[i].y;
+      if(results[i].hitZ)
+        velocities[i].z = .0f;
+      grounded += results[i].onGround();
+    }
+  }
+
+  FrameStats stats;
+  for(auto const ms: tickMs)
+    stats.add(ms);
+
+  os << "{\n";
+  os << "  \"bodies\": " << NumBodies << ",\n";
+  os << "  \"ticks\": " << Ticks << ",\n";
+  os << "  \"grounded_at_end\": " << grounded << ",\n";
+  os << "  \"tick_ms\": {\"mean\": " << stats.mean() << ", \"p50\": " << stats.percentile(50.f) << ", \"p99\": "
+     << stats.percentile(99.f) << "},\n";
+  os << "  \"bodies_per_s\": " << NumBodies / (stats.mean() / 1000.f) << "\n";
+  os << "}\n";
+}
+
+static void ItemBenchmark(std::ostream &os) {
+  constexpr std::size_t NumItems = 50000;
+  constexpr int Ticks            = 200;
+  constexpr float TickTime       = 1.f / 20;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> offset(-48.f, 48.f), speed(-4.f, 4.f), height(.0f, 16.f);
+  std::uniform_int_distribution<int> count(1, 8);
+  BlockHandle const handles[] = {DirtHandle, GrassHandle, StoneHandle, SandHandle};
+  for(std::size_t i = 0; i < NumItems; ++i)
+    world.items.spawn({handles[i % 4], count(rng)}, bench.position + glm::vec3(offset(rng), offset(rng), height(rng)),
+                      {speed(rng), speed(rng), speed(rng)});
+
+  FrameStats stats;
+  for(int tick = 0; tick < Ticks; ++tick)
+    stats.add(1000.f * SecondsFor([&] { world.items.tick(world, TickTime); }));
+
+  std::size_t picked = 0;
+  auto const pickupTime = SecondsFor([&] {
+    for(int i = 0; i < 1000; ++i)
+      picked += world.items.pickup(bench.position + glm::vec3(offset(rng), offset(rng), .0f), 2.f).size();
+  });
+
+  os << "{\n";
+  os << "  \"items_spawned\": " << NumItems << ",\n";
+  os << "  \"ticks\": " << Ticks << ",\n";
+  os << "  \"items_after_merging\": " << world.items.size() << ",\n";
+  os << "  \"tick_ms\": {\"mean\": " << stats.mean() << ", \"p50\": " << stats.percentile(50.f) << ", \"p99\": "
+     << stats.percentile(99.f) << "},\n";
+  os << "  \"pickup_queries_per_s\": " << 1000 / pickupTime << ",\n";
+  os << "  \"stacks_picked\": " << picked << "\n";
+  os << "}\n";
+}
+
+// Drops sand columns and digs holes for grass to spread into around the spawn, then ticks every loaded chunk
+static void BlockTickBenchmark(std::ostream &os) {
+  constexpr std::size_t NumSandColumns = 2000;
+  constexpr std::size_t NumHoles       = 2000;
+  constexpr int Ticks                  = 400;
+  constexpr std::size_t ThreadedWorkers = 4;
+
+  struct Run {
+    FrameStats stats;
+    BlockTickStats totals;
+  };
+
+  auto const run = [&](std::size_t const workers) {
+    BenchWorld bench;
+    auto &world = bench.world;
+    world.blockTicks.workers = workers;
+
+    auto const surface = [&](BlockCoord x, BlockCoord y) {
+      return Chunk::blockHeight(Chunk::getBlerpWorldgenVal(x, y, &world, PerlinInstance::Height));
+    };
+    auto const set = [&](BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle block) {
+      if(auto const c = world.getChunkAtBlock<false>(x, y, z)) {
+        c->setBlockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                      Chunk::decomposeLocalBlockFromBlock(z), CreateBlock(block, x, y, z, &world));
+        world.onBlockChanged(x, y, z);
+      }
+    };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<BlockCoord> offset(-48, 48), height(4, 12);
+    for(std::size_t i = 0; i < NumSandColumns; ++i) {
+      auto const x = static_cast<BlockCoord>(bench.position.x) + offset(rng), y = static_cast<BlockCoord>(bench.position.y) + offset(rng);
+      auto const z = surface(x, y) + height(rng);
+      for(BlockCoord dz = 0; dz < 3; ++dz)
+        set(x, y, z + dz, SandHandle);
+    }
+    for(std::size_t i = 0; i < NumHoles; ++i) {
+      auto const x = static_cast<BlockCoord>(bench.position.x) + offset(rng), y = static_cast<BlockCoord>(bench.position.y) + offset(rng);
+      set(x, y, surface(x, y), InvalidHandle);
+    }
+
+    Run result;
+    for(int tick = 0; tick < Ticks; ++tick)
+      result.stats.add(1000.f * SecondsFor([&] { world.blockTicks.step(world); }));
+    result.totals = world.blockTicks.stats();
+    return result;
+  };
+
+  auto const single   = run(1);
+  auto const threaded = run(ThreadedWorkers);
+
+  os << "{\n";
+  os << "  \"ticks\": " << Ticks << ",\n";
+  os << "  \"chunks\": " << single.totals.chunks << ",\n";
+  os << "  \"scheduled_ticks\": " << single.totals.scheduledTicks << ",\n";
+  os << "  \"random_ticks\": " << single.totals.randomTicks << ",\n";
+  os << "  \"writes\": " << single.totals.writes << ",\n";
+  os << "  \"tick_ms_1_worker\": {\"mean\": " << single.stats.mean() << ", \"p50\": " << single.stats.percentile(50.f)
+     << ", \"p99\": " << single.stats.percentile(99.f) << "},\n";
+  os << "  \"tick_ms_" << ThreadedWorkers << "_workers\": {\"mean\": " << threaded.stats.mean() << ", \"p50\": "
+     << threaded.stats.percentile(50.f) << ", \"p99\": " << threaded.stats.percentile(99.f) << "},\n";
+  os << "  \"deterministic\": " << (single.totals.checksum == threaded.totals.checksum ? "true" : "false") << "\n";
+  os << "}\n";
+}
+
+// Hollows out a cavity underground, pours water into it from a grid of sources and steps until it settles
+static void FloodBenchmark(std::ostream &os) {
+  constexpr BlockCoord CavityWidth  = 64;
+  constexpr BlockCoord CavityHeight = 16;
+  constexpr BlockCoord SourceSpacing = 8;
+  constexpr int MaxSteps            = 2000;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  auto const set = [&](BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle block) {
+    if(auto const c = world.getChunkAtBlock<false>(x, y, z))
+      c->setBlockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                    Chunk::decomposeLocalBlockFromBlock(z), CreateBlock(block, x, y, z, &world));
+  };
+
+  auto const floor = 24;
+  for(BlockCoord z = floor; z < floor + CavityHeight; ++z)
+    for(BlockCoord y = -CavityWidth / 2; y < CavityWidth / 2; ++y)
+      for(BlockCoord x = -CavityWidth / 2; x < CavityWidth / 2; ++x)
+        set(x, y, z, InvalidHandle);
+  for(BlockCoord y = -CavityWidth / 2; y < CavityWidth / 2; y += SourceSpacing)
+    for(BlockCoord x = -CavityWidth / 2; x < CavityWidth / 2; x += SourceSpacing) {
+      set(x, y, floor + CavityHeight - 1, WaterHandle);
+      world.onBlockChanged(x, y, floor + CavityHeight - 1);
+    }
+
+  FrameStats stats;
+  int steps = 0;
+  auto const seconds = SecondsFor([&] {
+    while(steps < MaxSteps && world.fluids.numActiveCells()) {
+      stats.add(1000.f * SecondsFor([&] { world.fluids.step(world); }));
+      ++steps;
+    }
+  });
+
+  std::size_t water = 0;
+  for(BlockCoord z = floor; z < floor + CavityHeight; ++z)
+    for(BlockCoord y = -CavityWidth / 2; y < CavityWidth / 2; ++y)
+      for(BlockCoord x = -CavityWidth / 2; x < CavityWidth / 2; ++x)
+        water += dynamic_cast<WaterBlock *>(world.blockAt<false>(x, y, z)) != nullptr;
+
+  auto const totals = world.fluids.stats();
+
+  // Water still flowing in a pocket inside one chunk when that chunk unloads stops there, the simulation doesn't
+  // keep the chunk
+  constexpr BlockCoord Pocket = 72, PocketFloor = 36;
+  for(BlockCoord z = PocketFloor; z < PocketFloor + 8; ++z)
+    for(BlockCoord y = Pocket - 4; y < Pocket + 4; ++y)
+      for(BlockCoord x = Pocket - 4; x < Pocket + 4; ++x)
+        set(x, y, z, InvalidHandle);
+  set(Pocket, Pocket, PocketFloor + 7, WaterHandle);
+  world.onBlockChanged(Pocket, Pocket, PocketFloor + 7);
+  world.fluids.step(world);
+  world.fluids.step(world);
+  auto const flowing = world.fluids.stats().activeChunks;
+  if(auto const c = world.getChunkAtBlock<false>(Pocket, Pocket, PocketFloor))
+    world.slab.retire(c->handle);
+  world.fluids.step(world);
+  auto const afterUnload = world.fluids.stats().activeChunks;
+
+  os << "{\n";
+  os << "  \"cavity_blocks\": " << CavityWidth * CavityWidth * CavityHeight << ",\n";
+  os << "  \"steps_to_settle\": " << steps << ",\n";
+  os << "  \"settled\": " << (steps < MaxSteps ? "true" : "false") << ",\n";
+  os << "  \"water_blocks\": " << water << ",\n";
+  os << "  \"cells_updated\": " << totals.cellsUpdated << ",\n";
+  os << "  \"cells_changed\": " << totals.cellsChanged << ",\n";
+  os << "  \"step_ms\": {\"mean\": " << stats.mean() << ", \"p99\": " << stats.percentile(99.f) << ", \"max\": "
+     << stats.percentile(100.f) << "},\n";
+  os << "  \"cells_updated_per_s\": " << totals.cellsUpdated / seconds << ",\n";
+  os << "  \"unload\": {\"active_chunks_before\": " << flowing << ", \"active_chunks_after\": " << afterUnload << "}\n";
+  os << "}\n";
+}
+
+static void LightBenchmark(std::ostream &os) {
+  constexpr BlockCoord TunnelLength = 96;
+  constexpr BlockCoord TorchSpacing = 8;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  FrameStats stats;
+  std::size_t edits = 0, dirtyChunks = 0;
+  auto const visitedBefore = world.light.cellsVisited();
+
+  // Each edit relights on its own, like a player digging or placing
+  auto const edit = [&](BlockCoord x, BlockCoord y, BlockCoord z, BlockHandle block) {
+    auto const c = world.getChunkAtBlock<false>(x, y, z);
+    if(!c)
+      return;
+    c->setBlockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                  Chunk::decomposeLocalBlockFromBlock(z), CreateBlock(block, x, y, z, &world));
+    stats.add(1000.f * SecondsFor([&] {
+      world.onBlockChanged(x, y, z);
+      dirtyChunks += world.light.propagate(world).size();
+    }));
+    ++edits;
+  };
+
+  // A sloping tunnel down from the surface, so sky light has to be cut off and refilled along it
+  auto const surface = Chunk::blockHeight(Chunk::getBlerpWorldgenVal(0, 0, &world, PerlinInstance::Height));
+  auto const depth   = [&](BlockCoord x) { return surface - x / 4; };
+  for(BlockCoord x = 0; x < TunnelLength; ++x)
+    for(BlockCoord z = depth(x); z < depth(x) + 2; ++z)
+      edit(x, 0, z, InvalidHandle);
+  for(BlockCoord x = TorchSpacing; x < TunnelLength; x += TorchSpacing)
+    edit(x, 1, depth(x), TorchHandle);
+  for(BlockCoord x = TorchSpacing; x < TunnelLength; x += TorchSpacing)
+    edit(x, 1, depth(x), StoneHandle);
+
+  os << "{\n";
+  os << "  \"edits\": " << edits << ",\n";
+  os << "  \"edit_us\": {\"mean\": " << 1000.f * stats.mean() << ", \"p50\": " << 1000.f * stats.percentile(50.f)
+     << ", \"p99\": " << 1000.f * stats.percentile(99.f) << ", \"max\": " << 1000.f * stats.percentile(100.f) << "},\n";
+  os << "  \"cells_visited_per_edit\": " << (edits ? (world.light.cellsVisited() - visitedBefore) / edits : 0) << ",\n";
+  os << "  \"dirty_chunks_per_edit\": " << (edits ? static_cast<float>(dirtyChunks) / edits : .0f) << "\n";
+  os << "}\n";
+}
+
+// Checks far terrain on the CPU: the tiles selected around a few centers cover the ring between the loaded chunks
+// and the render distance once, get larger further out and none lies within the chunks, and generated tiles
+// follow the worldgen heights at their vertices.
+static void FarTerrainBenchmark(std::ostream &os) {
+  constexpr float Inner = 14.f * ChunkSize, Outer = 1000.f;
+  constexpr float SampleStep = 8.f;
+
+  std::size_t tiles = 0, gaps = 0, overlaps = 0, insideChunks = 0, pastOuter = 0, tooCoarse = 0, sizeOrderBroken = 0;
+  std::map<BlockCoord, float> nearestBySize;
+  float selectMs = .0f;
+  for(auto const center: {glm::vec2{0, 0}, glm::vec2{517.3f, -211.9f}, glm::vec2{-1500.5f, 3071.25f}}) {
+    std::vector<FarTileKey> selected;
+    {
+      TimedBlock<std::milli> timer(selectMs);
+      selected = SelectFarTiles(center, Inner, Outer);
+    }
+    tiles += selected.size();
+
+    std::map<BlockCoord, float> nearest;
+    for(auto const &tile: selected) {
+      auto const minX = static_cast<float>(tile.x), maxX = static_cast<float>(tile.x + tile.size);
+      auto const minY = static_cast<float>(tile.y), maxY = static_cast<float>(tile.y + tile.size);
+      auto const nx = std::clamp(center.x, minX, maxX) - center.x, ny = std::clamp(center.y, minY, maxY) - center.y;
+      auto const fx = std::max(std::abs(center.x - minX), std::abs(center.x - maxX));
+      auto const fy = std::max(std::abs(center.y - minY), std::abs(center.y - maxY));
+      auto const near = std::sqrt(nx * nx + ny * ny);
+      insideChunks += std::sqrt(fx * fx + fy * fy) < Inner;
+      pastOuter += near > Outer;
+      // Tiles larger than the smallest were left whole because the viewer is far enough from them
+      tooCoarse += tile.size > FarTileMinSize && near < tile.size * FarTileSplitFactor;
+      auto &n = nearest.try_emplace(tile.size, near).first->second;
+      n       = std::min(n, near);
+    }
+    // Each larger size starts further out than the one below it
+    for(auto it = nearest.begin(); it != nearest.end() && std::next(it) != nearest.end(); ++it)
+      sizeOrderBroken += std::next(it)->second <= it->second;
+    for(auto const &[size, near]: nearest) {
+      auto &n = nearestBySize.try_emplace(size, near).first->second;
+      n       = std::min(n, near);
+    }
+
+    // Every point of the ring is in exactly one tile
+    for(auto x = center.x - Outer; x <= center.x + Outer; x += SampleStep)
+      for(auto y = center.y - Outer; y <= center.y + Outer; y += SampleStep) {
+        auto const d = std::sqrt((x - center.x) * (x - center.x) + (y - center.y) * (y - center.y));
+        if(d <= Inner || d >= Outer)
+          continue;
+        auto const in = std::count_if(selected.begin(), selected.end(), [&](FarTileKey const &t) {
+          return x >= t.x && x < t.x + t.size && y >= t.y && y < t.y + t.size;
+        });
+        gaps += in == 0;
+        overlaps += in > 1;
+      }
+  }
+
+  WorldOptions options;
+  options.meshing = false;
+  options.layers  = 1;
+  BenchWorld bench(options, .0f);
+  auto &world = bench.world;
+  std::size_t vertices = 0, heightsWrong = 0;
+  float generateMs = .0f;
+  for(auto const &key: {FarTileKey{-1024, 512, FarTileMinSize}, FarTileKey{2048, -4096, FarTileMinSize * 4}, FarTileKey{0, 0, FarTileRootSize}}) {
+    MeshData tile;
+    {
+      TimedBlock<std::milli> timer(generateMs);
+      tile = GenerateFarTile(world, key);
+    }
+    auto const step = key.size / FarTileResolution;
+    for(auto const &vert: tile.vertices) {
+      ++vertices;
+      auto const x = static_cast<BlockCoord>(vert.loc.x), y = static_cast<BlockCoord>(vert.loc.y);
+      auto const top = Chunk::blockHeight(Chunk::getBlerpWorldgenVal(x, y, &world, PerlinInstance::Height)) + 1.f - FarTerrainSink;
+      // Top faces follow the heights, skirts hang down from them
+      heightsWrong += (x - key.x) % step || (y - key.y) % step || (vert.loc.z != top && vert.loc.z != top - 2.f * step);
+    }
+  }
+
+  os << "{\n";
+  os << "  \"inner_radius\": " << Inner << ",\n";
+  os << "  \"outer_radius\": " << Outer << ",\n";
+  os << "  \"tiles\": " << tiles << ",\n";
+  os << "  \"select_ms_last\": " << selectMs << ",\n";
+  os << "  \"gaps\": " << gaps << ",\n";
+  os << "  \"overlaps\": " << overlaps << ",\n";
+  os << "  \"tiles_inside_chunks\": " << insideChunks << ",\n";
+  os << "  \"tiles_past_outer\": " << pastOuter << ",\n";
+  os << "  \"tiles_too_coarse\": " << tooCoarse << ",\n";
+  os << "  \"size_order_broken\": " << sizeOrderBroken << ",\n";
+  os << "  \"nearest_by_size\": {";
+  for(auto it = nearestBySize.begin(); it != nearestBySize.end(); ++it)
+    os << (it == nearestBySize.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+  os << "},\n";
+  os << "  \"vertices_checked\": " << vertices << ",\n";
+  os << "  \"heights_wrong\": " << heightsWrong << ",\n";
+  os << "  \"generate_ms_last\": " << generateMs << "\n";
+  os << "}\n";
+}
+
+static void HeightIndexBenchmark(std::ostream &os) {
+  constexpr std::size_t NumQueries = 2000000;
+  constexpr std::size_t NumEdits   = 20000;
+  constexpr BlockCoord Span        = 96;
+  // Scans start this far above the player, past anything worldgen put there
+  constexpr BlockCoord ScanHeight  = 128;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<BlockCoord> coord(-Span, Span);
+
+  // What the index saves: walking down the loaded chunks to the highest block
+  auto const scan = [&](BlockCoord x, BlockCoord y) {
+    for(auto z = static_cast<BlockCoord>(bench.position.z) + ScanHeight; z >= 0; --z)
+      if(world.blockAt<false>(x, y, z))
+        return z;
+    return NoHeight;
+  };
+
+  std::vector<std::pair<BlockCoord, BlockCoord>> columns(NumQueries);
+  for(auto &c: columns)
+    c = {coord(rng), coord(rng)};
+
+  long long sum = 0;
+  auto const queryTime = SecondsFor([&] {
+    for(auto const &[x, y]: columns)
+      sum += world.heights.heightAt(x, y);
+  });
+  auto const scanQueries = NumQueries / 1000;
+  auto const scanTime    = SecondsFor([&] {
+    for(std::size_t i = 0; i < scanQueries; ++i)
+      sum += scan(columns[i].first, columns[i].second);
+  });
+
+  // Stacking a block on top is O(1), breaking it again scans down to the block below
+  std::vector<glm::ivec3> placed;
+  std::set<std::pair<BlockCoord, BlockCoord>> edited;
+  auto const placeTime = SecondsFor([&] {
+    for(std::size_t i = 0; i < NumEdits; ++i) {
+      auto const x = coord(rng), y = coord(rng);
+      auto const z = world.heights.heightAt(x, y) + 1;
+      if(auto const c = world.getChunkAtBlock<false>(x, y, z))
+        c->setBlockAt(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                      Chunk::decomposeLocalBlockFromBlock(z), CreateBlock(StoneHandle, x, y, z, &world));
+      placed.push_back({x, y, z});
+      edited.insert({x, y});
+    }
+  });
+  // Every edited column has to have its top where scanning finds it
+  auto const wrong = [&] {
+    std::size_t n = 0;
+    for(auto const &[x, y]: edited)
+      n += world.heights.heightAt(x, y) != scan(x, y);
+    return n;
+  };
+  auto const wrongPlaced = wrong();
+  auto const removeTime  = SecondsFor([&] {
+    for(auto it = placed.rbegin(); it != placed.rend(); ++it)
+      if(auto const c = world.getChunkAtBlock<false>(it->x, it->y, it->z))
+        c->removeBlockAt(Chunk::decomposeLocalBlockFromBlock(it->x), Chunk::decomposeLocalBlockFromBlock(it->y),
+                         Chunk::decomposeLocalBlockFromBlock(it->z));
+  });
+  auto const wrongRemoved = wrong();
+
+  os << "{\n";
+  os << "  \"chunk_columns\": " << world.heights.numChunkColumns() << ",\n";
+  os << "  \"query_ns\": " << 1e9f * queryTime / NumQueries << ",\n";
+  os << "  \"scan_query_ns\": " << 1e9f * scanTime / scanQueries << ",\n";
+  os << "  \"place_ns\": " << 1e9f * placeTime / NumEdits << ",\n";
+  os << "  \"remove_ns\": " << 1e9f * removeTime / NumEdits << ",\n";
+  os << "  \"edited_columns\": " << edited.size() << ",\n";
+  os << "  \"wrong_after_placing\": " << wrongPlaced << ",\n";
+  os << "  \"wrong_after_breaking\": " << wrongRemoved << ",\n";
+  os << "  \"checksum\": " << sum << "\n";
+  os << "}\n";
+}
+
+static void WorldgenBenchmark(std::ostream &os) {
+  // Chunk columns along each side and chunks per column, from the bottom of the world up past the surface
+  constexpr BlockCoord Columns = 12;
+  constexpr BlockCoord Layers  = 6;
+  // Far from the loaded area, so every chunk column is generated from scratch
+  constexpr BlockCoord Offset  = 4096;
+
+  struct Run {
+    float seconds;
+    std::size_t blocks;
+  };
+
+  auto const run = [&](bool const caves) {
+    WorldOptions options;
+    options.caves = caves;
+    BenchWorld bench(options);
+    auto &world = bench.world;
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    Run r{};
+    r.seconds = SecondsFor([&] {
+      ForEachChunkIn({Offset, Offset, 0}, {Offset + Columns, Offset + Columns, Layers},
+                     [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) { chunks.push_back(std::make_unique<Chunk>(cx, cy, cz, &world)); });
+    });
+    for(auto &c: chunks)
+      ForEachBlock([&](BlockCoord x, BlockCoord y, BlockCoord z) { r.blocks += c->blockAt(x, y, z) != nullptr; });
+    return r;
+  };
+
+  auto const flat = run(false), caves = run(true);
+  auto const numChunks = Columns * Columns * Layers;
+
+  os << "{\n";
+  os << "  \"chunks\": " << numChunks << ",\n";
+  os << "  \"heightmap_us_per_chunk\": " << 1e6f * flat.seconds / numChunks << ",\n";
+  os << "  \"caves_us_per_chunk\": " << 1e6f * caves.seconds / numChunks << ",\n";
+  os << "  \"cost_ratio\": " << caves.seconds / flat.seconds << ",\n";
+  os << "  \"carved_fraction\": " << 1.f - static_cast<float>(caves.blocks) / flat.blocks << "\n";
+  os << "}\n";
+}
+
+// Generates and decorates the same chunks with 1 and with N workers, each in its own shuffled order, and checks
+// every run comes out block for block the same. Two more runs unload some of the chunks and generate some of those
+// again, one of them with the unloaded chunks forgotten in between, and the chunks loaded at the end have to come
+// out the same too, whichever of their neighbours are loaded.
+static void DecorationBenchmark(std::ostream &os) {
+  constexpr BlockCoord Columns = 8;
+  constexpr BlockCoord Layers  = 6;
+  constexpr BlockCoord Offset  = 4096;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::vector<glm::ivec3> coords;
+  ForEachChunkIn({Offset, Offset, 0}, {Offset + Columns, Offset + Columns, Layers},
+                 [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) { coords.push_back({cx, cy, cz}); });
+
+  enum struct Reload {
+    None,
+    // Every third chunk, half of which load again while the other half stay unloaded
+    Some,
+    // The chunks of the first three columns along x, forgotten before they load again
+    Forgotten,
+  };
+  struct Run {
+    std::size_t workers;
+    Reload reload;
+    float seconds;
+    // Of each chunk loaded at the end
+    std::map<std::tuple<BlockCoord, BlockCoord, BlockCoord>, std::uint64_t> checksums;
+    DecorationStats stats;
+  };
+
+  auto const run = [&](std::size_t const workers, unsigned const order, Reload const reload) {
+    auto shuffled = coords;
+    std::mt19937 random(order);
+    std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+    Decorations decorations;
+    std::vector<std::shared_ptr<Chunk>> chunks(shuffled.size());
+    auto const decorate = [&](std::vector<std::size_t> const &which) {
+      std::atomic<std::size_t> next{0};
+      auto const work = [&] {
+        for(std::size_t n; (n = next++) < which.size();) {
+          auto const i      = which[n];
+          auto const &c     = shuffled[i];
+          chunks[i]         = world.makeChunk(c.x, c.y, c.z);
+          chunks[i]->handle = world.slab.add(chunks[i]);
+          decorations.decorate(world, chunks[i]);
+        }
+      };
+      std::vector<std::future<void>> futs;
+      for(std::size_t w = 0; w < workers; ++w)
+        futs.push_back(std::async(std::launch::async, work));
+      for(auto &f: futs)
+        f.get();
+    };
+
+    std::vector<std::size_t> all(shuffled.size()), unloaded, again;
+    std::iota(all.begin(), all.end(), std::size_t{0});
+    for(auto const i: all)
+      if(reload == Reload::Some ? i % 3 == 0 : reload == Reload::Forgotten && shuffled[i].x < Offset + 3) {
+        unloaded.push_back(i);
+        if(reload != Reload::Some || i % 6 == 0)
+          again.push_back(i);
+      }
+
+    Run r{workers, reload};
+    r.seconds = SecondsFor([&] {
+      decorate(all);
+      if(unloaded.empty())
+        return;
+      for(auto const i: unloaded) {
+        world.slab.retire(chunks[i]->handle);
+        chunks[i].reset();
+      }
+      // Only the first three columns are further than this from a point far out along x
+      if(reload == Reload::Forgotten)
+        decorations.prune({Offset + 1000.f, Offset + Columns / 2.f, Layers / 2.f}, 997.f);
+      std::shuffle(again.begin(), again.end(), random);
+      decorate(again);
+    });
+
+    for(auto const &c: chunks) {
+      if(!c)
+        continue;
+      std::uint64_t h = 0;
+      for(auto const &b: c->voxels().blocks)
+        h = (h ^ (std::holds_alternative<std::unique_ptr<Block>>(b) && !std::get<std::unique_ptr<Block>>(b) ? 0 : b.index() + 1)) *
+            0x100000001b3ull;
+      r.checksums[{c->cx, c->cy, c->cz}] = h;
+      world.slab.retire(c->handle);
+    }
+    r.stats = decorations.stats();
+    return r;
+  };
+
+  auto const hardware = std::max(2u, std::thread::hardware_concurrency());
+  std::vector<Run> runs{run(1, 1, Reload::None),      run(1, 2, Reload::None),         run(hardware, 3, Reload::None),
+                        run(hardware, 4, Reload::None), run(hardware, 5, Reload::Some), run(hardware, 6, Reload::Forgotten)};
+  auto const differing = [&](Run const &r) {
+    return std::count_if(r.checksums.begin(), r.checksums.end(), [&](auto const &c) { return runs.front().checksums.at(c.first) != c.second; });
+  };
+  auto const identical = std::all_of(runs.begin(), runs.end(), [&](Run const &r) { return !differing(r); });
+
+  os << "{\n";
+  os << "  \"chunks\": " << coords.size() << ",\n";
+  os << "  \"features\": " << runs.front().stats.features << ",\n";
+  os << "  \"blocks_placed\": " << runs.front().stats.writes << ",\n";
+  os << "  \"runs\": [\n";
+  for(std::size_t i = 0; i < runs.size(); ++i) {
+    auto const &r = runs[i];
+    os << "    {\"workers\": " << r.workers << ", \"reload\": \""
+       << (r.reload == Reload::None ? "none" : r.reload == Reload::Some ? "some" : "forgotten") << "\", \"us_per_chunk\": "
+       << 1e6f * r.seconds / coords.size() << ", \"neighbour_writes\": " << r.stats.neighbours << ", \"late_writes\": " << r.stats.late
+       << ", \"chunks_loaded\": " << r.checksums.size() << ", \"chunks_differing\": " << differing(r) << "}" << (i + 1 < runs.size() ? "," : "")
+       << "\n";
+  }
+  os << "  ],\n";
+  os << "  \"identical\": " << (identical ? "true" : "false") << "\n";
+  os << "}\n";
+}
+
+// Fills the area around the spawn, then moves away and waits for the chunk pipeline to catch up. Nothing draws the
+// world here, so meshed chunks wait for an upload that never comes and hold meshing back once their queue is full.
+// Then fills a world a few layers high and checks its top layer gets lit.
+static void PipelineBenchmark(std::ostream &os) {
+  constexpr float Move = 8.f * ChunkSize;
+
+  BenchWorld bench({}, .0f);
+  auto &world = bench.world;
+  auto settled        = true;
+  auto const fillTime = SecondsFor([&] { settled = WaitForWorldgen(world) && settled; });
+  auto const filled   = world.numChunksLoaded();
+  bench.position.x += Move;
+  // Let worldgen see the move before waiting for it to settle again
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  auto const moveTime = SecondsFor([&] { settled = WaitForWorldgen(world) && settled; });
+  auto const stages   = world.pipelineStats();
+
+  // Nothing is generated above the top layer of a world with layers, its chunks have to get lit all the same
+  constexpr BlockCoord Layers = 3, Reach = 4;
+  WorldOptions options;
+  options.layers = Layers;
+  BenchWorld layered(options);
+  std::size_t topChunks = 0, topUnlit = 0;
+  ForEachChunkIn({-Reach, -Reach, Layers - 1}, {Reach, Reach, Layers}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(auto const c = layered.world.getChunk<false>(cx, cy, cz)) {
+      ++topChunks;
+      topUnlit += c->stage.load() < ChunkStage::Lit;
+    }
+  });
+
+  os << "{\n";
+  os << "  \"settled\": " << (settled ? "true" : "false") << ",\n";
+  os << "  \"fill_s\": " << fillTime << ",\n";
+  os << "  \"fill_chunks\": " << filled << ",\n";
+  os << "  \"move_blocks\": " << Move << ",\n";
+  os << "  \"move_s\": " << moveTime << ",\n";
+  os << "  \"move_chunks\": " << world.numChunksLoaded() - filled << ",\n";
+  os << "  \"layered\": {\"layers\": " << Layers << ", \"settled\": " << (layered.settled ? "true" : "false")
+     << ", \"top_layer_chunks\": " << topChunks << ", \"top_layer_unlit\": " << topUnlit << "},\n";
+  os << "  \"stages\": [\n";
+  for(std::size_t i = 0; i < stages.size(); ++i) {
+    auto const &stage = stages[i];
+    os << "    {\"stage\": \"" << StageName(stage.stage) << "\", \"chunks\": " << stage.chunks << ", \"queued\": " << stage.queued
+       << ", \"entered\": " << stage.entered << ", \"stalls\": " << stage.stalls << ", \"ms_total\": " << stage.msTotal
+       << ", \"us_per_chunk\": " << (stage.entered ? 1000.f * stage.msTotal / stage.entered : .0f) << "}"
+       << (i + 1 < stages.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n";
+  os << "}\n";
+}
+
+// World::blockAt at random blocks around the spawn, against the hash map under a mutex chunks used to be kept in
+static void BlockAtBenchmark(std::ostream &os) {
+  constexpr std::size_t NumLookups = 4000000;
+  constexpr BlockCoord Reach       = 10;
+  constexpr BlockCoord Layers      = 8;
+
+  BenchWorld bench;
+  auto &world = bench.world;
+
+  std::mutex mapMutex;
+  std::unordered_map<ChunkIndex, std::shared_ptr<Chunk>> map;
+  ForEachChunkIn({-Reach, -Reach, 0}, {Reach, Reach, Layers}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(auto c = world.getChunk<false>(cx, cy, cz))
+      map[ChunkIndex(cx, cy, cz)] = std::move(c);
+  });
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<BlockCoord> horizontal(-Reach * ChunkSize, Reach * ChunkSize - 1), vertical(0, Layers * ChunkSize - 1);
+  std::vector<glm::ivec3> blocks;
+  for(std::size_t i = 0; i < NumLookups; ++i)
+    blocks.push_back({horizontal(rng), horizontal(rng), vertical(rng)});
+
+  std::vector<Block *> reference, grid;
+  reference.reserve(NumLookups), grid.reserve(NumLookups);
+  auto const mapTime = SecondsFor([&] {
+    for(auto const &b: blocks) {
+      std::shared_ptr<Chunk> c;
+      {
+        std::lock_guard<std::mutex> lck(mapMutex);
+        auto const it = map.find(ChunkIndex(Chunk::decomposeChunkFromBlock(b.x), Chunk::decomposeChunkFromBlock(b.y), Chunk::decomposeChunkFromBlock(b.z)));
+        if(it != map.end())
+          c = it->second;
+      }
+      reference.push_back(c ? c->blockAt(Chunk::decomposeLocalBlockFromBlock(b.x), Chunk::decomposeLocalBlockFromBlock(b.y),
+                                         Chunk::decomposeLocalBlockFromBlock(b.z)) : nullptr);
+    }
+  });
+  auto const gridTime = SecondsFor([&] {
+    for(auto const &b: blocks)
+      grid.push_back(world.blockAt<false>(b.x, b.y, b.z));
+  });
+
+  std::size_t hits = 0, mismatches = 0;
+  for(std::size_t i = 0; i < NumLookups; ++i) {
+    hits += grid[i] != nullptr;
+    mismatches += grid[i] != reference[i];
+  }
+
+  os << "{\n";
+  os << "  \"lookups\": " << NumLookups << ",\n";
+  os << "  \"chunks\": " << map.size() << ",\n";
+  os << "  \"hits\": " << hits << ",\n";
+  os << "  \"mismatches\": " << mismatches << ",\n";
+  os << "  \"hash_map_lookups_per_s\": " << NumLookups / mapTime << ",\n";
+  os << "  \"grid_lookups_per_s\": " << NumLookups / gridTime << "\n";
+  os << "}\n";
+}
+
+// Remeshes the chunks around the spawn that have all their neighbours, at full detail, on this thread
+static void MeshingBenchmark(std::ostream &os) {
+  constexpr BlockCoord Reach  = 6;
+  constexpr BlockCoord Layers = 8;
+  constexpr int Rounds       = 3;
+
+  // Everything at full detail
+  WorldOptions options;
+  options.lodDistances.clear();
+  BenchWorld bench(options);
+  auto &world = bench.world;
+
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  ForEachChunkIn({-Reach, -Reach, 0}, {Reach, Reach, Layers}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(auto c = world.getChunk<false>(cx, cy, cz); c && c->hasAllAdjacent())
+      chunks.push_back(std::move(c));
+  });
+
+  std::size_t triangles = 0;
+  auto const seconds = SecondsFor([&] {
+    for(int round = 0; round < Rounds; ++round)
+      for(auto const &c: chunks) {
+        c->regenerateChunkMesh();
+        triangles += c->numTriangles;
+      }
+  });
+
+  os << "{\n";
+  os << "  \"chunks\": " << chunks.size() << ",\n";
+  os << "  \"triangles\": " << triangles / Rounds << ",\n";
+  os << "  \"us_per_chunk\": " << 1e6f * seconds / (chunks.size() * Rounds) << ",\n";
+  os << "  \"chunks_per_s\": " << chunks.size() * Rounds / seconds << "\n";
+  os << "}\n";
+}
+
+static void PoolJson(std::ostream &os, char const *name, PoolStats const &warm, PoolStats const &end, bool const last = false) {
+  os << "  \"" << name << "\": {\"live\": " << end.live << ", \"high_water\": " << end.highWater << ", \"capacity\": " << end.capacity
+     << ", \"warmup_heap_allocations\": " << warm.heapAllocations
+     << ", \"steady_heap_allocations\": " << end.heapAllocations - warm.heapAllocations << "}" << (last ? "" : ",") << "\n";
+}
+
+// Walks back and forth over the same stretch, doing the render thread's part of unloading every frame, and counts
+// what the chunk and mesh buffer pools still take from the heap once the first lap has warmed them up
+static void SoakBenchmark(std::ostream &os) {
+  constexpr float Stride  = 6.f * ChunkSize;
+  constexpr int Laps      = 4;
+  constexpr auto Frame    = std::chrono::milliseconds(5);
+  constexpr float Timeout = 120.f;
+
+  BenchWorld bench({}, .0f);
+  auto &world = bench.world;
+  auto settled     = true;
+  auto const frame = [&] {
+    world.releaseUnloaded();
+    world.dropMeshes();
+    std::this_thread::sleep_for(Frame);
+  };
+  auto const settle = [&] {
+    // Let worldgen see the move first
+    for(int i = 0; i < 100; ++i)
+      frame();
+    auto const start = BenchClock::now();
+    while(!world.isSettled() && std::chrono::duration<float>(BenchClock::now() - start).count() < Timeout)
+      frame();
+    settled = settled && world.isSettled();
+  };
+
+  PoolStats warmChunks{}, warmVoxels{}, warmMeshes{};
+  std::size_t warmGenerated = 0, warmColumns = 0, warmDecorated = 0;
+  auto const seconds = SecondsFor([&] {
+    settle();
+    for(int lap = 0; lap < Laps; ++lap) {
+      if(lap == 1) {
+        warmChunks    = world.chunkPool->stats();
+        warmVoxels    = world.voxelPool->stats();
+        warmMeshes    = world.meshBuffers.stats();
+        warmGenerated = world.numChunksLoaded();
+        warmColumns   = world.numColumnGens();
+        warmDecorated = world.decorations.numDecorated();
+      }
+      bench.position.x += Stride;
+      settle();
+      bench.position.x -= Stride;
+      settle();
+    }
+  });
+
+  os << "{\n";
+  os << "  \"settled\": " << (settled ? "true" : "false") << ",\n";
+  os << "  \"seconds\": " << seconds << ",\n";
+  os << "  \"laps\": " << Laps << ",\n";
+  os << "  \"chunks_generated\": " << world.numChunksLoaded() << ",\n";
+  os << "  \"steady_chunks_generated\": " << world.numChunksLoaded() - warmGenerated << ",\n";
+  os << "  \"column_gens\": {\"warm\": " << warmColumns << ", \"end\": " << world.numColumnGens() << "},\n";
+  os << "  \"decorated_chunks\": {\"warm\": " << warmDecorated << ", \"end\": " << world.decorations.numDecorated() << "},\n";
+  PoolJson(os, "chunk_pool", warmChunks, world.chunkPool->stats());
+  PoolJson(os, "voxel_pool", warmVoxels, world.voxelPool->stats());
+  PoolJson(os, "mesh_buffers", warmMeshes, world.meshBuffers.stats(), true);
+  os << "}\n";
+}
+
+// Lets a world with a small expanded chunk budget compress what it can, checks that packing round trips, then
+// reads a block from every compressed chunk to see what expanding them again costs
+static void ResidencyBenchmark(std::ostream &os) {
+  constexpr std::size_t Budget = 64;
+  constexpr float Timeout      = 120.f;
+
+  WorldOptions options;
+  options.expandedChunkBudget = Budget;
+  options.coldDistance        = 2.f;
+  BenchWorld bench(options, .0f);
+  auto &world = bench.world;
+  // Only meshed chunks are compressed, and nothing gets past meshing without frames
+  auto const frame = [&] {
+    world.releaseUnloaded();
+    world.dropMeshes();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  };
+  auto const settleStart = BenchClock::now();
+  for(int i = 0; i < 100 || (!world.isSettled() && std::chrono::duration<float>(BenchClock::now() - settleStart).count() < Timeout); ++i)
+    frame();
+
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  {
+    std::lock_guard<std::mutex> lck(world.chunkMutex);
+    ForEachChunkIn({-16, -16, 0}, {16, 16, 16}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+      if(auto c = world.getChunk<true>(cx, cy, cz))
+        chunks.push_back(std::move(c));
+    });
+  }
+
+  // Packing, unpacking and packing again gives the same runs
+  std::size_t mismatches = 0, unpackable = 0;
+  {
+    EpochGuard guard(world.slab);
+    auto const unpacked = std::make_unique<ChunkVoxels>();
+    for(auto const &c: chunks) {
+      PackedVoxels packed, repacked;
+      if(!PackVoxels(c->voxels(), packed)) {
+        ++unpackable;
+        continue;
+      }
+      UnpackVoxels(packed, *unpacked);
+      PackVoxels(*unpacked, repacked);
+      mismatches += packed.blocks != repacked.blocks || packed.light != repacked.light;
+    }
+  }
+
+  // The worldgen thread compresses cold chunks on its own once they've been left alone long enough. Chunks near
+  // the player and unmeshed ones at the edge stay expanded, so wait until it stops finding more.
+  auto const start = BenchClock::now();
+  auto lastChange  = start;
+  for(std::size_t compressed = 0; world.residencyStats().expanded > Budget;) {
+    auto const now = BenchClock::now();
+    if(auto const c = world.residencyStats().compressed; c != compressed) {
+      compressed = c;
+      lastChange = now;
+    }
+    if(std::chrono::duration<float>(now - lastChange).count() > 8.f || std::chrono::duration<float>(now - start).count() > Timeout)
+      break;
+    frame();
+  }
+  auto const compressedStats = world.residencyStats();
+
+  std::size_t touched = 0;
+  auto const touchSeconds = SecondsFor([&] {
+    EpochGuard guard(world.slab);
+    for(auto const &c: chunks)
+      if(c->isCompressed()) {
+        c->blockAt(0, 0, 0);
+        ++touched;
+      }
+  });
+  auto const stats = world.residencyStats();
+
+  auto const packedAvg = compressedStats.compressed ? compressedStats.packedBytes / compressedStats.compressed : 0;
+  os << "{\n";
+  os << "  \"chunks\": " << chunks.size() << ",\n";
+  os << "  \"roundtrip_mismatches\": " << mismatches << ",\n";
+  os << "  \"unpackable_chunks\": " << unpackable << ",\n";
+  os << "  \"expanded\": " << compressedStats.expanded << ",\n";
+  os << "  \"compressed\": " << compressedStats.compressed << ",\n";
+  os << "  \"expanded_bytes\": " << sizeof(ChunkVoxels) << ",\n";
+  os << "  \"packed_bytes_avg\": " << packedAvg << ",\n";
+  os << "  \"compression_ratio\": " << (packedAvg ? static_cast<float>(sizeof(ChunkVoxels)) / packedAvg : .0f) << ",\n";
+  os << "  \"expansions\": " << stats.expansions << ",\n";
+  os << "  \"touched\": " << touched << ",\n";
+  os << "  \"expand_us_avg\": " << (stats.expansions ? 1e3f * stats.expandMsTotal / stats.expansions : .0f) << ",\n";
+  os << "  \"expand_us_max\": " << stats.expandUsMax << ",\n";
+  os << "  \"touch_us_per_chunk\": " << (touched ? 1e6f * touchSeconds / touched : .0f) << "\n";
+  os << "}\n";
+}
+
+// Edits chunks on one thread while others snapshot and remesh them. Every edit writes the same value to the first
+// and last voxel of a chunk, so a snapshot seeing the two differ saw half an edit. Meant to be run under TSan too.
+static void SnapshotBenchmark(std::ostream &os) {
+  constexpr BlockCoord Reach = 2;
+  constexpr auto Duration    = std::chrono::seconds(3);
+  constexpr std::size_t Last = ChunkVolume - 1;
+
+  // Light and decoration write voxels too, the edits have to be the only writes for the check to hold
+  BenchWorld bench({}, 600.f);
+  auto &world        = bench.world;
+  auto const settled = bench.settled;
+
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  ForEachChunkIn({-Reach, -Reach, 0}, {Reach, Reach, 8}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(auto c = world.getChunk<false>(cx, cy, cz); c && c->hasAllAdjacent())
+      chunks.push_back(std::move(c));
+  });
+
+  std::atomic<bool> done{false};
+  std::atomic<std::size_t> snapshots{0}, meshes{0}, torn{0};
+  std::size_t edits = 0;
+  float writeUsMax  = .0f;
+
+  auto const read = [&] {
+    std::size_t n = 0, m = 0, t = 0;
+    while(!done)
+      for(auto const &c: chunks) {
+        auto const snapshot = c->snapshot();
+        t += snapshot->light[0] != snapshot->light[Last] || snapshot->blocks[0].index() != snapshot->blocks[Last].index();
+        // Meshing takes snapshots of its own, of this chunk and its neighbours
+        if(++n % 8 == 0) {
+          c->regenerateChunkMesh();
+          ++m;
+        }
+      }
+    snapshots += n, meshes += m, torn += t;
+  };
+
+  auto const edit = [&](Chunk &c) {
+    auto const value = static_cast<std::uint8_t>(++edits);
+    auto const block = [&]() -> BlockStorage {
+      if(value & 1)
+        return StoneBlock{};
+      return std::unique_ptr<Block>{};
+    };
+    float elapsed;
+    {
+      TimedBlock<std::micro> timer(elapsed);
+      VoxelWrite write(c);
+      write->light[0] = write->light[Last] = value;
+      write->blocks[0]    = block();
+      write->blocks[Last] = block();
+    }
+    writeUsMax = std::max(writeUsMax, elapsed);
+  };
+  // The two voxels start out different
+  for(auto const &c: chunks)
+    edit(*c);
+
+  auto const readers = std::max(2u, std::thread::hardware_concurrency());
+  std::vector<std::future<void>> futs;
+  for(unsigned i = 0; i < readers; ++i)
+    futs.push_back(std::async(std::launch::async, read));
+
+  auto const copiesBefore = world.voxelCopies.load();
+  auto const start        = BenchClock::now();
+  while(BenchClock::now() - start < Duration)
+    for(auto const &c: chunks)
+      edit(*c);
+  auto const seconds = std::chrono::duration<float>(BenchClock::now() - start).count();
+  done = true;
+  for(auto &f: futs)
+    f.get();
+
+  os << "{\n";
+  os << "  \"settled\": " << (settled ? "true" : "false") << ",\n";
+  os << "  \"chunks\": " << chunks.size() << ",\n";
+  os << "  \"readers\": " << readers << ",\n";
+  os << "  \"edits\": " << edits << ",\n";
+  os << "  \"snapshots\": " << snapshots << ",\n";
+  os << "  \"meshes\": " << meshes << ",\n";
+  os << "  \"torn_snapshots\": " << torn << ",\n";
+  os << "  \"copies\": " << world.voxelCopies - copiesBefore << ",\n";
+  os << "  \"edits_per_s\": " << edits / seconds << ",\n";
+  os << "  \"write_us_max\": " << writeUsMax << "\n";
+  os << "}\n";
+}
+
+// Appends edits to the journal as fast as they come and waits for them to be on disk, reopens it to time
+// recovery, once compacted and once a large journal with a torn record at the end. Then breaks blocks in a world
+// and checks a world opened on the same journal has them broken too.
+static void JournalBenchmark(std::ostream &os) {
+  constexpr std::size_t NumEdits   = 200000;
+  constexpr std::size_t NumBlocks  = 4096;
+  constexpr std::size_t NumLarge   = 60000;
+  constexpr BlockCoord NumBroken   = 64;
+  auto const path = (std::filesystem::temp_directory_path() / "voxgl-bench.journal").string();
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> block(0, NumBlocks - 1);
+  auto const editAt = [](std::size_t const i, BlockHandle const to) {
+    return BlockEdit{static_cast<BlockCoord>(i % 16), static_cast<BlockCoord>(i / 16 % 16), static_cast<BlockCoord>(64 + i / 256), InvalidHandle, to};
+  };
+
+  std::filesystem::remove(path);
+  JournalStats appended;
+  float appendUsMax = .0f, appendSeconds, syncSeconds;
+  {
+    EditJournal journal(path, BenchSeed);
+    appendSeconds = SecondsFor([&] {
+      for(std::size_t i = 0; i < NumEdits; ++i) {
+        float elapsed;
+        {
+          TimedBlock<std::micro> timer(elapsed);
+          journal.append(editAt(block(rng), static_cast<BlockHandle>(i % 2 ? StoneHandle : InvalidHandle)));
+        }
+        appendUsMax = std::max(appendUsMax, elapsed);
+      }
+    });
+    syncSeconds = SecondsFor([&] { journal.sync(); });
+    appended    = journal.stats();
+  }
+  auto const compacted = EditJournal(path, BenchSeed).stats();
+
+  // Large enough not to be compacted, and cut off in the middle of a record
+  std::filesystem::remove(path);
+  {
+    EditJournal journal(path, BenchSeed);
+    for(std::size_t i = 0; i < NumLarge; ++i)
+      journal.append(editAt(i, StoneHandle));
+  }
+  if(auto const f = std::fopen(path.c_str(), "ab")) {
+    std::fputs("torn", f);
+    std::fclose(f);
+  }
+  auto const large = EditJournal(path, BenchSeed).stats();
+
+  // Surface blocks broken in one world are gone in the next
+  std::filesystem::remove(path);
+  WorldOptions options;
+  options.journalPath = path;
+  std::vector<glm::ivec3> broken;
+  {
+    BenchWorld bench(options);
+    auto &world = bench.world;
+    for(BlockCoord x = 0; x < NumBroken; ++x) {
+      auto const z = world.heights.heightAt(x, 0);
+      auto const c = world.getChunkAtBlock<false>(x, 0, z);
+      if(!c || !world.blockAt<false>(x, 0, z))
+        continue;
+      c->removeBlockAt(Chunk::decomposeLocalBlockFromBlock(x), 0, Chunk::decomposeLocalBlockFromBlock(z));
+      broken.push_back({x, 0, z});
+    }
+  }
+  std::size_t mismatches = 0;
+  JournalStats replayed;
+  {
+    BenchWorld bench(options);
+    auto &world = bench.world;
+    for(auto const &b: broken)
+      mismatches += world.blockAt<false>(b.x, b.y, b.z) != nullptr;
+    replayed = world.journal.stats();
+  }
+  std::filesystem::remove(path);
+
+  os << "{\n";
+  os << "  \"edits\": " << NumEdits << ",\n";
+  os << "  \"appends_per_s\": " << NumEdits / appendSeconds << ",\n";
+  os << "  \"append_us_max\": " << appendUsMax << ",\n";
+  os << "  \"sync_ms\": " << 1e3f * syncSeconds << ",\n";
+  os << "  \"durable_edits_per_s\": " << NumEdits / (appendSeconds + syncSeconds) << ",\n";
+  os << "  \"commits\": " << appended.commits << ",\n";
+  os << "  \"edits_per_commit\": " << static_cast<float>(appended.committed) / std::max<std::size_t>(appended.commits, 1) << ",\n";
+  os << "  \"largest_commit\": " << appended.largestCommit << ",\n";
+  os << "  \"compactions\": " << appended.compactions << ",\n";
+  os << "  \"compacted_bytes\": " << appended.fileBytes << ",\n";
+  os << "  \"compacted_recovered\": " << compacted.recovered << ",\n";
+  os << "  \"compacted_recover_ms\": " << compacted.recoverMs << ",\n";
+  os << "  \"large_recovered\": " << large.recovered << ",\n";
+  os << "  \"large_recover_ms\": " << large.recoverMs << ",\n";
+  os << "  \"broken\": " << broken.size() << ",\n";
+  os << "  \"world_recovered\": " << replayed.recovered << ",\n";
+  os << "  \"replay_mismatches\": " << mismatches << "\n";
+  os << "}\n";
+}
+
+// Loads a world the way reopening it does, from stored chunks, with and without the mesh cache a first load
+// filled. Headless, the first full frame is when every chunk in reach is meshed and the pipeline settles.
+static void MeshCacheBenchmark(std::ostream &os) {
+  constexpr float Timeout = 120.f;
+  auto const dir = std::filesystem::temp_directory_path() / "voxgl-meshcache-bench";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto const storePath = (dir / "chunks").string();
+  auto const cachePath = (dir / "meshes").string();
+
+  struct Load {
+    float seconds, meshMs;
+    std::size_t triangles;
+    MeshCacheStats cache;
+  };
+  auto const load = [&](bool const stored, bool const cached, bool const store) {
+    WorldOptions options;
+    if(stored)
+      options.chunkStorePath = storePath;
+    if(cached)
+      options.meshCachePath = cachePath;
+    Load result{};
+    auto const bench = std::make_unique<BenchWorld>(options, .0f);
+    auto const world = &bench->world;
+    result.seconds = SecondsFor([&] {
+      auto const start = BenchClock::now();
+      while(!world->isSettled() && std::chrono::duration<float>(BenchClock::now() - start).count() < Timeout) {
+        world->releaseUnloaded();
+        world->dropMeshes();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    for(auto const &ring: world->lodRings()) {
+      result.meshMs += ring.meshMsTotal;
+      result.triangles += ring.triangles;
+    }
+    result.cache = world->meshCache.stats();
+
+    if(store) {
+      ChunkStore chunks(storePath, BenchSeed);
+      std::lock_guard<std::mutex> lck(world->chunkMutex);
+      EpochGuard guard(world->slab);
+      ForEachChunkIn({-16, -16, 0}, {16, 16, 16}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+        if(auto const c = world->getChunk<true>(cx, cy, cz))
+          if(PackedVoxels packed; PackVoxels(c->voxels(), packed))
+            chunks.save(cx, cy, cz, packed);
+      });
+    }
+    return result;
+  };
+
+  auto const first    = load(false, true, true);
+  auto const uncached = load(true, false, false);
+  auto const cached   = load(true, true, false);
+  std::filesystem::remove_all(dir);
+
+  auto const json = [&](char const *name, Load const &l, bool const last = false) {
+    os << "  \"" << name << "\": {\"seconds\": " << l.seconds << ", \"mesh_ms\": " << l.meshMs << ", \"triangles\": " << l.triangles
+       << ", \"cache_hits\": " << l.cache.hits << ", \"cache_misses\": " << l.cache.misses << ", \"cache_stored\": " << l.cache.stored
+       << ", \"cache_mapped_bytes\": " << l.cache.mappedBytes << ", \"cache_open_ms\": " << l.cache.openMs << "}" << (last ? "\n" : ",\n");
+  };
+  os << "{\n";
+  json("first_load", first);
+  json("reload_uncached", uncached);
+  json("reload_cached", cached);
+  os << "  \"speedup\": " << (cached.seconds > .0f ? uncached.seconds / cached.seconds : .0f) << "\n";
+  os << "}\n";
+}
+
+// Fuzzes the chunk delta encoding: random edits to a chunk logged in a change log, deltas from random earlier
+// copies of it encoded, decoded and applied to the copy, which has to come out the same as the chunk, and the
+// encodings mutated and cut short, which have to be refused or read as a well-formed delta. Then edits a world in
+// phases the way players do and counts what keeping copies of its chunks up to date costs sent as deltas, as each
+// changed block with its position and as whole chunks.
+static void NetDeltaBenchmark(std::ostream &os) {
+  constexpr std::size_t Rounds   = 4000;
+  constexpr std::size_t History  = 32;
+  constexpr BlockCoord Reach     = 4;
+  constexpr BlockCoord EditReach = Reach * ChunkSize - 16;
+
+  std::mt19937 rng(42);
+  auto const random = [&](std::size_t const n) { return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng); };
+
+  // Round trips
+  std::size_t roundTrips = 0, fallbacks = 0, fallbacksWrong = 0, mismatches = 0, decodeFailures = 0, loggedChanges = 0;
+  std::size_t mutated = 0, mutatedAccepted = 0, malformedAccepted = 0, truncatedAccepted = 0;
+  std::size_t fuzzBytes = 0, fuzzCells = 0;
+  ChunkChangeLog log;
+  ClientChunk truth{};
+  truth.version = log.version();
+  std::vector<ClientChunk> history{truth};
+  auto const wellFormed = [](ChunkDelta const &delta) {
+    for(std::size_t i = 0; i < delta.cells.size(); ++i)
+      if(delta.cells[i] >= ChunkVolume || (i && delta.cells[i] <= delta.cells[i - 1]))
+        return false;
+    return delta.blocks.size() == delta.cells.size() && delta.light.size() == delta.cells.size();
+  };
+  for(std::size_t round = 0; round < Rounds; ++round) {
+    auto const set = [&](std::size_t const cell, std::uint8_t const block, std::uint8_t const light) {
+      truth.cells[cell] = block;
+      truth.light[cell] = light;
+      log.record(static_cast<std::uint16_t>(cell));
+      ++loggedChanges;
+    };
+    auto const block = static_cast<std::uint8_t>(random(8));
+    auto const light = static_cast<std::uint8_t>(random(256));
+    switch(random(3)) {
+    case 0:
+      for(auto n = 1 + random(64); n--;)
+        set(random(ChunkVolume), static_cast<std::uint8_t>(random(256)), static_cast<std::uint8_t>(random(256)));
+      break;
+    case 1: {
+      auto const x = random(ChunkSize), y = random(ChunkSize), z = random(ChunkSize);
+      auto const w = 1 + random(8), d = 1 + random(8), h = 1 + random(8);
+      for(auto k = z; k < std::min<std::size_t>(z + h, ChunkSize); ++k)
+        for(auto j = y; j < std::min<std::size_t>(y + d, ChunkSize); ++j)
+          for(auto i = x; i < std::min<std::size_t>(x + w, ChunkSize); ++i)
+            set(Chunk::blockPos(i, j, k), block, light);
+      break;
+    }
+    default: {
+      auto const from = random(ChunkVolume);
+      auto const step = std::size_t{1} << ChunkCoordBits * random(3);
+      for(auto cell = from; cell < ChunkVolume && cell < from + step * ChunkSize; cell += step)
+        set(cell, block, light);
+      break;
+    }
+    }
+    truth.version = log.version();
+
+    // From a recent copy mostly, now and then from the first, which the log stops reaching back to. Copies caught
+    // up aren't kept, so the first stays as old as it is.
+    auto copy = history.size() > 1 && random(8) ? history[1 + random(history.size() - 1)] : history[0];
+    auto const behind = static_cast<std::uint32_t>(truth.version) - static_cast<std::uint32_t>(copy.version);
+    ChunkDelta delta{0, 0, 0, copy.version};
+    if(!log.since(copy.version, delta.cells, delta.to)) {
+      ++fallbacks;
+      fallbacksWrong += behind <= ChunkChangeLog::Capacity / 2;
+    }
+    else {
+      fallbacksWrong += behind > ChunkChangeLog::Capacity;
+      for(auto const cell: delta.cells) {
+        delta.blocks.push_back(truth.cells[cell]);
+        delta.light.push_back(truth.light[cell]);
+      }
+      NetWriter writer;
+      WriteChunkDelta(writer, delta);
+      fuzzBytes += writer.bytes.size();
+      fuzzCells += delta.cells.size();
+
+      ChunkDelta read;
+      NetReader reader(writer.bytes.data(), writer.bytes.size());
+      if(!ReadChunkDelta(reader, read) || !reader.ok() || !reader.atEnd() || read.cells != delta.cells || read.blocks != delta.blocks ||
+         read.light != delta.light || read.to != delta.to)
+        ++decodeFailures;
+      else {
+        ApplyDelta(read, copy);
+        mismatches += copy.cells != truth.cells || copy.light != truth.light || copy.version != truth.version;
+      }
+      ++roundTrips;
+
+      // Garbage has to be refused or come out as cells of a chunk with a value each
+      for(auto n = 0; n < 4; ++n) {
+        auto bytes = writer.bytes;
+        if(n == 0 && bytes.size() > 1) {
+          bytes.resize(1 + random(bytes.size() - 1));
+          NetReader cut(bytes.data(), bytes.size());
+          truncatedAccepted += ReadChunkDelta(cut, read) && cut.ok();
+          continue;
+        }
+        for(auto flips = 1 + random(3); flips--;)
+          bytes[random(bytes.size())] = static_cast<std::uint8_t>(random(256));
+        NetReader garbage(bytes.data(), bytes.size());
+        if(ReadChunkDelta(garbage, read) && garbage.ok()) {
+          ++mutatedAccepted;
+          malformedAccepted += !wellFormed(read);
+        }
+        ++mutated;
+      }
+    }
+    // Versions of another log never match
+    fallbacksWrong += ChunkChangeLog().since(copy.version, delta.cells, delta.to);
+
+    if(history.size() < History)
+      history.push_back(truth);
+    else
+      history[1 + random(History - 1)] = truth;
+  }
+
+  // A world edited in phases, with copies of the chunks around the player kept up to date after every tick
+  WorldOptions options;
+  options.meshing      = false;
+  options.layers       = 6;
+  options.trackChanges = true;
+  BenchWorld bench(options);
+  auto &world = bench.world;
+
+  struct Copy {
+    std::shared_ptr<Chunk> chunk;
+    ClientChunk copy;
+  };
+  std::unordered_map<long long, Copy> copies;
+  // The whole chunk as a client first gets it, and into copy
+  auto const whole = [](Chunk &chunk, ClientChunk &copy, NetWriter &writer) {
+    // Read before the snapshot, like the server does
+    auto const version = chunk.changes.version();
+    PackedVoxels packed;
+    if(!PackVoxels(*chunk.snapshot(), packed))
+      return;
+    WriteChunk(writer, chunk.cx, chunk.cy, chunk.cz, version, packed);
+    auto const fill = [](std::vector<std::uint32_t> const &runs, std::array<std::uint8_t, ChunkVolume> &values) {
+      std::size_t i = 0;
+      for(auto const run: runs)
+        for(auto n = run >> 8; n--;)
+          values[i++] = static_cast<std::uint8_t>(run & 0xff);
+    };
+    fill(packed.blocks, copy.cells);
+    fill(packed.light, copy.light);
+    copy.position = {chunk.cx, chunk.cy, chunk.cz};
+    copy.version  = version;
+  };
+  std::size_t initialBytes = 0;
+  ForEachChunkIn({-Reach, -Reach, 0}, {Reach, Reach, options.layers}, [&](BlockCoord cx, BlockCoord cy, BlockCoord cz) {
+    if(auto chunk = world.getChunk<false>(cx, cy, cz)) {
+      auto &c = copies[ChunkIndex(cx, cy, cz).repr];
+      c.chunk = std::move(chunk);
+      NetWriter writer;
+      whole(*c.chunk, c.copy, writer);
+      initialBytes += writer.bytes.size();
+    }
+  });
+  world.takeChangedChunks();
+
+  struct Phase {
+    char const *name;
+    std::size_t edits, ticks, updates, cells, deltas, wholes, deltaBytes, blockBytes, chunkBytes;
+  };
+  // What changed since the last tick, sent the way the server picks
+  auto const tick = [&](Phase &phase) {
+    auto any = false;
+    for(auto const &c: world.takeChangedChunks()) {
+      auto const it = copies.find(ChunkIndex(c.x, c.y, c.z).repr);
+      if(it == copies.end())
+        continue;
+      auto &[chunk, copy] = it->second;
+      any = true;
+      ++phase.updates;
+
+      ChunkDelta delta;
+      NetWriter deltaBody, blocks, chunkBody;
+      auto const hasDelta = DeltaSince(*chunk, copy.version, delta);
+      if(hasDelta) {
+        WriteChunkDelta(deltaBody, delta);
+        // Each block with its position and light, as block updates were sent before deltas
+        for(std::size_t i = 0; i < delta.cells.size(); ++i) {
+          auto const cell = delta.cells[i];
+          blocks.svarint(c.x * ChunkSize + (cell & ChunkBlockMask));
+          blocks.svarint(c.y * ChunkSize + (cell >> ChunkCoordBits & ChunkBlockMask));
+          blocks.svarint(c.z * ChunkSize + (cell >> ChunkCoordBits * 2));
+          blocks.u8(delta.blocks[i]);
+          blocks.u8(delta.light[i]);
+        }
+      }
+      ClientChunk fresh = copy;
+      whole(*chunk, fresh, chunkBody);
+      phase.chunkBytes += chunkBody.bytes.size();
+      phase.blockBytes += hasDelta ? blocks.bytes.size() : chunkBody.bytes.size();
+      if(hasDelta && deltaBody.bytes.size() <= chunkBody.bytes.size()) {
+        ChunkDelta read;
+        NetReader reader(deltaBody.bytes.data(), deltaBody.bytes.size());
+        if(ReadChunkDelta(reader, read))
+          ApplyDelta(read, copy);
+        else
+          ++decodeFailures;
+        phase.deltaBytes += deltaBody.bytes.size();
+        phase.cells += delta.cells.size();
+        ++phase.deltas;
+      }
+      else {
+        copy = fresh;
+        phase.deltaBytes += chunkBody.bytes.size();
+        ++phase.wholes;
+      }
+    }
+    ++phase.ticks;
+    return any;
+  };
+  auto const edit = [&](Phase &phase, BlockCoord const x, BlockCoord const y, BlockCoord const z, BlockHandle const handle) {
+    auto const xx = Chunk::decomposeBlockPos(x);
+    auto const yy = Chunk::decomposeBlockPos(y);
+    auto const zz = Chunk::decomposeBlockPos(z);
+    auto const c  = world.getChunk<false>(xx.second, yy.second, zz.second);
+    if(!c || z < 0)
+      return;
+    auto const block = c->blockAt(xx.first, yy.first, zz.first);
+    if(handle == InvalidHandle && block)
+      c->removeBlockAt(xx.first, yy.first, zz.first);
+    else if(handle != InvalidHandle && !block)
+      c->addBlockAt(xx.first, yy.first, zz.first, BlockFactoryHandles[handle](x, y, z, &world));
+    else
+      return;
+    ++phase.edits;
+  };
+  // Edits a tick's worth at a time, then lets the light settle
+  std::vector<Phase> phases;
+  auto const run = [&](char const *name, std::size_t const perTick, auto &&edits) {
+    Phase phase{name};
+    std::vector<std::pair<glm::ivec3, BlockHandle>> queued;
+    edits([&](BlockCoord const x, BlockCoord const y, BlockCoord const z, BlockHandle const handle) { queued.emplace_back(glm::ivec3(x, y, z), handle); });
+    for(std::size_t i = 0; i < queued.size(); i += perTick) {
+      for(auto j = i; j < std::min(i + perTick, queued.size()); ++j)
+        edit(phase, queued[j].first.x, queued[j].first.y, queued[j].first.z, queued[j].second);
+      tick(phase);
+    }
+    for(auto quiet = 0; quiet < 5;) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      quiet = tick(phase) ? 0 : quiet + 1;
+    }
+    phases.push_back(phase);
+  };
+  auto const surface = [&](BlockCoord const x, BlockCoord const y) { return world.heights.heightAt(x, y); };
+  std::uniform_int_distribution<BlockCoord> anywhere(-EditReach, EditReach - 1);
+
+  run("scattered", 20, [&](auto &&edit) {
+    for(auto n = 0; n < 2000; ++n) {
+      auto const x = anywhere(rng), y = anywhere(rng);
+      if(n % 2)
+        edit(x, y, surface(x, y), InvalidHandle);
+      else
+        edit(x, y, surface(x, y) + 1, StoneHandle);
+    }
+  });
+  run("boxes", 200, [&](auto &&edit) {
+    for(auto n = 0; n < 20; ++n) {
+      auto const x = anywhere(rng), y = anywhere(rng), z = surface(x, y) + 1;
+      for(BlockCoord k = 0; k < 4; ++k)
+        for(BlockCoord j = 0; j < 6; ++j)
+          for(BlockCoord i = 0; i < 6; ++i)
+            edit(x + i, y + j, z + k, StoneHandle);
+    }
+  });
+  run("crater", 500, [&](auto &&edit) {
+    constexpr BlockCoord Radius = 10;
+    auto const z = surface(20, 20);
+    for(BlockCoord k = -Radius; k <= Radius; ++k)
+      for(BlockCoord j = -Radius; j <= Radius; ++j)
+        for(BlockCoord i = -Radius; i <= Radius; ++i)
+          if(i * i + j * j + k * k <= Radius * Radius)
+            edit(20 + i, 20 + j, z + k, InvalidHandle);
+  });
+  run("flatten", 500, [&](auto &&edit) {
+    constexpr BlockCoord Side = 32;
+    auto const level = surface(-32, -32);
+    for(BlockCoord j = -48; j < -48 + Side; ++j)
+      for(BlockCoord i = -48; i < -48 + Side; ++i) {
+        auto const top = surface(i, j);
+        for(auto z = top; z > level; --z)
+          edit(i, j, z, InvalidHandle);
+        for(auto z = top + 1; z <= level; ++z)
+          edit(i, j, z, StoneHandle);
+      }
+  });
+
+  // The copies have to have every block and its light
+  std::size_t cellsWrong = 0;
+  for(auto const &[key, c]: copies) {
+    auto const voxels = c.chunk->snapshot();
+    for(std::size_t i = 0; i < ChunkVolume; ++i) {
+      std::uint32_t cell;
+      cellsWrong += !PackCell(voxels->blocks[i], cell) || c.copy.cells[i] != static_cast<std::uint8_t>(cell) || c.copy.light[i] != voxels->light[i];
+    }
+  }
+
+  os << "{\n";
+  os << "  \"fuzz\": {\"rounds\": " << Rounds << ", \"changes_logged\": " << loggedChanges << ", \"round_trips\": " << roundTrips
+     << ", \"bytes_per_cell\": " << static_cast<float>(fuzzBytes) / std::max<std::size_t>(fuzzCells, 1) << ", \"fallbacks\": " << fallbacks
+     << ", \"fallbacks_wrong\": " << fallbacksWrong << ", \"decode_failures\": " << decodeFailures << ", \"mismatches\": " << mismatches << "},\n";
+  os << "  \"malformed\": {\"mutated\": " << mutated << ", \"mutated_accepted\": " << mutatedAccepted << ", \"malformed_accepted\": " << malformedAccepted
+     << ", \"truncated_accepted\": " << truncatedAccepted << "},\n";
+  os << "  \"chunks\": " << copies.size() << ",\n";
+  os << "  \"initial_bytes\": " << initialBytes << ",\n";
+  os << "  \"phases\": [\n";
+  Phase total{"total"};
+  for(std::size_t i = 0; i <= phases.size(); ++i) {
+    auto const &p = i < phases.size() ? phases[i] : total;
+    if(i < phases.size()) {
+      total.edits += p.edits;
+      total.ticks += p.ticks;
+      total.updates += p.updates;
+      total.cells += p.cells;
+      total.deltas += p.deltas;
+      total.wholes += p.wholes;
+      total.deltaBytes += p.deltaBytes;
+      total.blockBytes += p.blockBytes;
+      total.chunkBytes += p.chunkBytes;
+    }
+    os << "    {\"name\": \"" << p.name << "\", \"edits\": " << p.edits << ", \"ticks\": " << p.ticks << ", \"chunk_updates\": " << p.updates
+       << ", \"deltas\": " << p.deltas << ", \"whole_chunks\": " << p.wholes << ", \"delta_cells\": " << p.cells << ", \"delta_bytes\": " << p.deltaBytes
+       << ", \"per_block_bytes\": " << p.blockBytes << ", \"whole_chunk_bytes\": " << p.chunkBytes << ", \"delta_bytes_per_edit\": "
+       << static_cast<float>(p.deltaBytes) / std::max<std::size_t>(p.edits, 1) << "}" << (i < phases.size() ? ",\n" : "\n");
+  }
+  os << "  ],\n";
+  os << "  \"copy_cells_wrong\": " << cellsWrong << "\n";
+  os << "}\n";
+}
+
+// Walks a player along a scripted course, with the input handed to the simulation by frames drawn at different rates,
+// some of them stalling, and counts the steps that got their input late and the positions that came out different
+// from every step getting its own. Then moves the player the old way, once per frame by however long the frame
+// took, to show how far that ends up from the fixed steps.
+static void SimulationBenchmark(std::ostream &os) {
+  constexpr std::uint64_t Steps = 300;
+
+  WorldOptions options;
+  options.meshing = false;
+  BenchWorld bench(options);
+  auto &world = bench.world;
+
+  PlayerBody const start{{.5f, .5f, static_cast<float>(world.heights.heightAt(0, 0)) + 1.f + PlayerEyeHeight}};
+  // Stands still for the first step, which is taken before any frame, then turns a bit every Hold steps and flies up
+  // now and then
+  constexpr std::uint64_t Hold = 30;
+  auto const script = [](std::uint64_t const n) {
+    PlayerInput input;
+    if(auto const turn = n / Hold) {
+      auto const angle = static_cast<float>(turn) * .8f;
+      input.move       = {std::cos(angle), std::sin(angle), turn % 3 == 0 ? 1.f : .0f};
+    }
+    return input;
+  };
+  // Where the script takes the player when every step gets its input
+  std::vector<glm::vec3> scripted(Steps);
+  {
+    auto body = start;
+    for(std::uint64_t n = 0; n < Steps; ++n) {
+      MovePlayer(world, body, script(n), Simulation::StepSeconds);
+      scripted[n] = body.position;
+    }
+  }
+
+  struct Run {
+    char const *name;
+    float fps;
+    // Frames that take this long now and then
+    float stallMs;
+    std::vector<glm::vec3> trace;
+    // Steps whose input wasn't the script's for them, because no frame handed it over before the step
+    std::size_t late;
+    std::size_t frames;
+    float seconds;
+    SimulationStats stats;
+  };
+  std::vector<Run> runs{{"30fps", 30.f, .0f}, {"60fps", 60.f, .0f}, {"144fps", 144.f, .0f}, {"uncapped", .0f, .0f}, {"60fps_stalling", 60.f, 250.f}};
+  for(auto &run: runs) {
+    auto body = start;
+    run.trace.resize(Steps);
+    run.seconds = SecondsFor([&] {
+      Simulation simulation([&](std::uint64_t const n, PlayerInput const &input, RenderState &state) {
+        if(n < Steps) {
+          MovePlayer(world, body, input, Simulation::StepSeconds);
+          run.trace[n] = body.position;
+          run.late += input.move != script(n).move;
+        }
+        state.position = body.position;
+      });
+      // A frame hands over the input for the step after the last one it sees, and draws where the player is
+      glm::vec3 drawn{};
+      while(simulation.stats().steps < Steps) {
+        auto const frame = simulation.frame();
+        simulation.input(script(frame.current->step + 1));
+        drawn += frame.position();
+        ++run.frames;
+        if(run.stallMs > .0f && run.frames % 30 == 0)
+          std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(run.stallMs));
+        else if(run.fps > .0f)
+          std::this_thread::sleep_for(std::chrono::duration<float>(1.f / run.fps));
+      }
+      run.stats = simulation.stats();
+    });
+  }
+  auto const differing = [&](Run const &run) {
+    std::size_t n = 0;
+    for(std::size_t i = 0; i < Steps; ++i)
+      n += run.trace[i] != scripted[i];
+    return n;
+  };
+
+  // A step per frame, as long as the frame
+  auto const end = scripted.back();
+  std::vector<std::pair<float, float>> variable;
+  for(auto const fps: {30.f, 60.f, 144.f, 500.f}) {
+    auto body = start;
+    for(auto t = .0f; t < Steps * Simulation::StepSeconds; t += 1.f / fps)
+      MovePlayer(world, body, script(static_cast<std::uint64_t>(t / Simulation::StepSeconds)), 1.f / fps);
+    variable.emplace_back(fps, glm::length(body.position - end));
+  }
+
+  os << "{\n";
+  os << "  \"steps\": " << Steps << ",\n";
+  os << "  \"steps_per_second\": " << Simulation::StepsPerSecond << ",\n";
+  os << "  \"runs\": [\n";
+  for(std::size_t i = 0; i < runs.size(); ++i) {
+    auto const &run = runs[i];
+    os << "    {\"name\": \"" << run.name << "\", \"frames\": " << run.frames << ", \"fps\": " << run.frames / run.seconds
+       << ", \"steps_per_s\": " << run.stats.steps / run.seconds << ", \"step_ms_avg\": " << run.stats.stepMsAvg << ", \"step_ms_max\": "
+       << run.stats.stepMsMax << ", \"steps_dropped\": " << run.stats.stepsDropped << ", \"late_inputs\": " << run.late << ", \"steps_differing\": " << differing(run) << "}"
+       << (i + 1 < runs.size() ? ",\n" : "\n");
+  }
+  os << "  ],\n";
+  os << "  \"walked_blocks\": " << glm::length(end - start.position) << ",\n";
+  os << "  \"variable_step\": [\n";
+  for(std::size_t i = 0; i < variable.size(); ++i)
+    os << "    {\"fps\": " << variable[i].first << ", \"blocks_from_fixed\": " << variable[i].second << "}" << (i + 1 < variable.size() ? ",\n" : "\n");
+  os << "  ]\n";
+  os << "}\n";
+}
+
+// Runs frames through a model of what they cost, with and without the quality governor: the world drawn costs more
+// the further and finer it is, every upload costs and meshing slows the render thread down a little. The scenes
+// stream a backlog of chunks in, look at a heavy view, a light one and one too heavy to hold. Then checks the
+// knobs reach a real world.
+static void GovernorBenchmark(std::ostream &os) {
+  constexpr float TargetMs = 16.7f;
+  QualityKnobs const start{8, 64, 1.f, 1000.f}, min{1, 1, .5f, World::loadRadius() * ChunkSize}, max{32, 256, 1.f, 1000.f};
+
+  struct Scene {
+    char const *name;
+    std::size_t frames;
+    // How much there is to draw, 1 for about 13ms at full quality
+    float load;
+    // Chunks waiting to be meshed when the scene starts
+    std::size_t backlog;
+  };
+  std::vector<Scene> const scenes{{"streaming", 1800, 1.f, 3000}, {"heavy", 1800, 2.f, 0}, {"light", 1800, .6f, 0}, {"overloaded", 1800, 5.f, 0}};
+
+  struct Result {
+    // Over the second half of the scene, once the governor had time to settle
+    float p50, p90;
+    std::size_t overTarget, adjustments, uploaded;
+    QualityKnobs knobs;
+  };
+  auto const run = [&](bool const governed) {
+    QualityGovernor governor(TargetMs, start, min, max);
+    std::mt19937 random(BenchSeed);
+    std::uniform_real_distribution<float> noise(.9f, 1.1f);
+    std::vector<Result> results;
+    std::size_t meshQueue = 0, uploadQueue = 0;
+    for(auto const &scene: scenes) {
+      meshQueue += scene.backlog;
+      auto const adjustmentsBefore = governor.adjustments().size();
+      std::vector<float> late;
+      std::size_t uploaded = 0;
+      for(std::size_t f = 0; f < scene.frames; ++f) {
+        auto const &knobs = governor.knobs();
+        // A pipeline round every few frames
+        auto const meshed = std::min(meshQueue, knobs.meshBatch / 4);
+        meshQueue -= meshed;
+        uploadQueue += meshed;
+        auto const uploads = std::min(uploadQueue, knobs.uploadBudget);
+        uploadQueue -= uploads;
+        uploaded += uploads;
+
+        auto const drawn = scene.load * 10.f * (.4f + .6f * knobs.lodScale) * knobs.renderDistance / max.renderDistance;
+        auto const ms    = (3.f + drawn + uploads * .8f + meshed * .05f) * noise(random);
+        if(f >= scene.frames / 2)
+          late.push_back(ms);
+        if(governed && governor.frame(ms))
+          governor.update(uploadQueue, meshQueue);
+      }
+      std::sort(late.begin(), late.end());
+      auto const at = [&](float const p) { return late[std::min(late.size() - 1, static_cast<std::size_t>(p / 100.f * late.size()))]; };
+      results.push_back({at(50.f), at(90.f), static_cast<std::size_t>(late.end() - std::upper_bound(late.begin(), late.end(), TargetMs)),
+                         governor.adjustments().size() - adjustmentsBefore, uploaded, governor.knobs()});
+    }
+    return results;
+  };
+  auto const fixed = run(false), governed = run(true);
+
+  // The world takes what the governor sets
+  WorldOptions options;
+  options.meshing            = false;
+  options.farTerrainDistance = max.renderDistance;
+  BenchWorld bench(options, .0f);
+  auto &world = bench.world;
+  auto const lodAt6 = world.lodFor(6.f, 0);
+  ApplyQuality(world, min);
+  auto const applied = world.uploadBudget() == min.uploadBudget && world.meshBatch() == min.meshBatch;
+  auto const lodAt6Min = world.lodFor(6.f, 0);
+
+  os << "{\n";
+  os << "  \"target_ms\": " << TargetMs << ",\n";
+  os << "  \"window_frames\": " << QualityGovernor::WindowFrames << ",\n";
+  os << "  \"scenes\": [\n";
+  for(std::size_t i = 0; i < scenes.size(); ++i) {
+    os << "    {\"name\": \"" << scenes[i].name << "\", \"load\": " << scenes[i].load;
+    for(auto const &[name, result]: {std::make_pair("fixed", fixed[i]), std::make_pair("governed", governed[i])})
+      os << ", \"" << name << "\": {\"p50\": " << result.p50 << ", \"p90\": " << result.p90 << ", \"late_frames_over_target\": "
+         << result.overTarget << ", \"chunks_uploaded\": " << result.uploaded << ", \"adjustments\": " << result.adjustments
+         << ", \"upload_budget\": " << result.knobs.uploadBudget << ", \"mesh_batch\": " << result.knobs.meshBatch << ", \"lod_scale\": "
+         << result.knobs.lodScale << ", \"render_distance\": " << result.knobs.renderDistance << "}";
+    os << "}" << (i + 1 < scenes.size() ? ",\n" : "\n");
+  }
+  os << "  ],\n";
+  os << "  \"world\": {\"budgets_applied\": " << (applied ? "true" : "false") << ", \"lod_at_6_chunks\": " << lodAt6
+     << ", \"lod_at_6_chunks_min_quality\": " << lodAt6Min << "}\n";
+  os << "}\n";
+}
+
+static std::map<std::string, std::function<void(std::ostream &)>> const Microbenchmarks{
+  {"rays", RayBenchmark},
+  {"collision", CollisionBenchmark},
+  {"items", ItemBenchmark},
+  {"ticks", BlockTickBenchmark},
+  {"flood", FloodBenchmark},
+  {"light", LightBenchmark},
+  {"heights", HeightIndexBenchmark},
+  {"farterrain", FarTerrainBenchmark},
+  {"worldgen", WorldgenBenchmark},
+  {"decoration", DecorationBenchmark},
+  {"pipeline", PipelineBenchmark},
+  {"blockat", BlockAtBenchmark},
+  {"meshing", MeshingBenchmark},
+  {"soak", SoakBenchmark},
+  {"residency", ResidencyBenchmark},
+  {"snapshots", SnapshotBenchmark},
+  {"journal", JournalBenchmark},
+  {"meshcache", MeshCacheBenchmark},
+  {"netdelta", NetDeltaBenchmark},
+  {"simulation", SimulationBenchmark},
+  {"governor", GovernorBenchmark},
+};
+
+int RunMicrobenchmark(std::string const &name) {
+  auto const it = Microbenchmarks.find(name);
+  if(it == Microbenchmarks.end()) {
+    std::cerr << "Unknown benchmark " << name << ", available:";
+    for(auto const &[benchName, bench]: Microbenchmarks)
+      std::cerr << " " << benchName;
+    std::cerr << "\n";
+    return 1;
+  }
+
+  it->second(std::cout);
+  return 0;
+}
@@ -0,0 +1,336 @@
+#include "NetProtocol.hpp"
+
+#include "Chunk.hpp"
+#include "ChunkResidency.hpp"
+
+#include <cstring>
+#include <utility>
+
+// Reading the socket this much at a time
+constexpr std::size_t ReceiveBytes = 64 << 10;
+constexpr std::size_t FrameHeaderBytes = 5;
+
+void NetWriter::u32(std::uint32_t const value) {
+  for(int i = 0; i < 4; ++i)
+    bytes.push_back(static_cast<std::uint8_t>(value >> i * 8));
+}
+
+void NetWriter::u64(std::uint64_t const value) {
+  for(int i = 0; i < 8; ++i)
+    bytes.push_back(static_cast<std::uint8_t>(value >> i * 8));
+}
+
+void NetWriter::f32(float const value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  u32(bits);
+}
+
+void NetWriter::varint(std::uint64_t value) {
+  for(; value >= 0x80; value >>= 7)
+    bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+  bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+void NetWriter::svarint(std::int64_t const value) {
+  varint(static_cast<std::uint64_t>(value) << 1 ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+void NetWriter::version(std::uint64_t const value) {
+  varint(value >> 32);
+  varint(value & 0xffffffff);
+}
+
+bool NetReader::take(std::size_t const bytes) {
+  if(failed || static_cast<std::size_t>(end - at) < bytes) {
+    failed = true;
+    at     = end;
+    return false;
+  }
+  return true;
+}
+
+std::uint8_t NetReader::u8() { return take(1) ? *at++ : 0; }
+
+std::uint32_t NetReader::u32() {
+  if(!take(4))
+    return 0;
+  std::uint32_t value = 0;
+  for(int i = 0; i < 4; ++i)
+    value |= static_cast<std::uint32_t>(*at++) << i * 8;
+  return value;
+}
+
+std::uint64_t NetReader::u64() {
+  if(!take(8))
+    return 0;
+  std::uint64_t value = 0;
+  for(int i = 0; i < 8; ++i)
+    value |= static_cast<std::uint64_t>(*at++) << i * 8;
+  return value;
+}
+
+float NetReader::f32() {
+  auto const bits = u32();
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+std::uint64_t NetReader::varint() {
+  std::uint64_t value = 0;
+  for(int shift = 0; shift < 64; shift += 7) {
+    auto const byte = u8();
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if(!(byte & 0x80))
+      return value;
+  }
+  failed = true;
+  return 0;
+}
+
+std::int64_t NetReader::svarint() {
+  auto const value = varint();
+  return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::uint64_t NetReader::version() {
+  auto const incarnation = varint();
+  auto const count       = varint();
+  if(incarnation >> 32 || count >> 32) {
+    failed = true;
+    return 0;
+  }
+  return incarnation << 32 | count;
+}
+
+static void WriteRuns(NetWriter &writer, std::vector<std::uint32_t> const &runs) {
+  writer.varint(runs.size());
+  for(auto const run: runs) {
+    writer.u8(static_cast<std::uint8_t>(run & 0xff));
+    writer.varint(run >> 8);
+  }
+}
+
+static bool ReadRuns(NetReader &reader, std::vector<std::uint32_t> &runs) {
+  auto const count = reader.varint();
+  if(count > ChunkVolume)
+    return false;
+  runs.resize(count);
+  std::size_t total = 0;
+  for(auto &run: runs) {
+    auto const value  = reader.u8();
+    auto const length = reader.varint();
+    if(!length || length > ChunkVolume - total)
+      return false;
+    run = value | static_cast<std::uint32_t>(length) << 8;
+    total += length;
+  }
+  return reader.ok() && total == ChunkVolume;
+}
+
+void WriteChunk(NetWriter &writer, BlockCoord const cx, BlockCoord const cy, BlockCoord const cz, std::uint64_t const version,
+                PackedVoxels const &packed) {
+  writer.svarint(cx);
+  writer.svarint(cy);
+  writer.svarint(cz);
+  writer.version(version);
+  WriteRuns(writer, packed.blocks);
+  WriteRuns(writer, packed.light);
+}
+
+bool ReadChunk(NetReader &reader, BlockCoord &cx, BlockCoord &cy, BlockCoord &cz, std::uint64_t &version, PackedVoxels &packed) {
+  cx      = static_cast<BlockCoord>(reader.svarint());
+  cy      = static_cast<BlockCoord>(reader.svarint());
+  cz      = static_cast<BlockCoord>(reader.svarint());
+  version = reader.version();
+  return ReadRuns(reader, packed.blocks) && ReadRuns(reader, packed.light);
+}
+
+static void WriteValueRuns(NetWriter &writer, std::vector<std::uint8_t> const &values) {
+  std::size_t runs = 0;
+  for(std::size_t i = 0; i < values.size(); ++i)
+    runs += !i || values[i] != values[i - 1];
+  writer.varint(runs);
+  for(std::size_t i = 0; i < values.size();) {
+    auto length = std::size_t{1};
+    while(i + length < values.size() && values[i + length] == values[i])
+      ++length;
+    writer.u8(values[i]);
+    writer.varint(length);
+    i += length;
+  }
+}
+
+static bool ReadValueRuns(NetReader &reader, std::size_t const count, std::vector<std::uint8_t> &values) {
+  values.clear();
+  auto const runs = reader.varint();
+  if(runs > count)
+    return false;
+  for(std::uint64_t r = 0; r < runs; ++r) {
+    auto const value  = reader.u8();
+    auto const length = reader.varint();
+    if(!reader.ok() || !length || length > count - values.size())
+      return false;
+    values.insert(values.end(), static_cast<std::size_t>(length), value);
+  }
+  return reader.ok() && values.size() == count;
+}
+
+void WriteChunkDelta(NetWriter &writer, ChunkDelta const &delta) {
+  writer.svarint(delta.cx);
+  writer.svarint(delta.cy);
+  writer.svarint(delta.cz);
+  writer.version(delta.from);
+  writer.varint(delta.to - delta.from);
+
+  std::size_t runs = 0;
+  for(std::size_t i = 0; i < delta.cells.size(); ++i)
+    runs += !i || delta.cells[i] != delta.cells[i - 1] + 1;
+  writer.varint(runs);
+  std::size_t end = 0;
+  for(std::size_t i = 0; i < delta.cells.size();) {
+    auto length = std::size_t{1};
+    while(i + length < delta.cells.size() && delta.cells[i + length] == delta.cells[i] + length)
+      ++length;
+    writer.varint(delta.cells[i] - end);
+    writer.varint(length);
+    end = delta.cells[i] + length;
+    i += length;
+  }
+
+  WriteValueRuns(writer, delta.blocks);
+  WriteValueRuns(writer, delta.light);
+}
+
+bool ReadChunkDelta(NetReader &reader, ChunkDelta &delta) {
+  delta.cx   = static_cast<BlockCoord>(reader.svarint());
+  delta.cy   = static_cast<BlockCoord>(reader.svarint());
+  delta.cz   = static_cast<BlockCoord>(reader.svarint());
+  delta.from = reader.version();
+  delta.to   = delta.from + reader.varint();
+
+  delta.cells.clear();
+  auto const runs = reader.varint();
+  if(runs > ChunkVolume)
+    return false;
+  std::size_t end = 0;
+  for(std::uint64_t r = 0; r < runs; ++r) {
+    auto const gap    = reader.varint();
+    auto const length = reader.varint();
+    // Runs after the first are apart, or they'd be one run
+    if(!reader.ok() || !length || (r && !gap) || gap > ChunkVolume - end || length > ChunkVolume - end - gap)
+      return false;
+    for(auto cell = end + gap; cell < end + gap + length; ++cell)
+      delta.cells.push_back(static_cast<std::uint16_t>(cell));
+    end += gap + length;
+  }
+
+  return ReadValueRuns(reader, delta.cells.size(), delta.blocks) && ReadValueRuns(reader, delta.cells.size(), delta.light);
+}
+
+bool DeltaSince(Chunk &chunk, std::uint64_t const from, ChunkDelta &delta) {
+  delta.cx   = chunk.cx;
+  delta.cy   = chunk.cy;
+  delta.cz   = chunk.cz;
+  delta.from = from;
+  if(!chunk.changes.since(from, delta.cells, delta.to))
+    return false;
+
+  // Taken after the log was read, so it has every change up to delta.to and maybe some after, which the next delta
+  // sends again
+  auto const voxels = chunk.snapshot();
+  delta.blocks.resize(delta.cells.size());
+  delta.light.resize(delta.cells.size());
+  for(std::size_t i = 0; i < delta.cells.size(); ++i) {
+    std::uint32_t cell;
+    if(!PackCell(voxels->blocks[delta.cells[i]], cell))
+      return false;
+    delta.blocks[i] = static_cast<std::uint8_t>(cell);
+    delta.light[i]  = voxels->light[delta.cells[i]];
+  }
+  return true;
+}
+
+NetConnection::NetConnection(std::unique_ptr<sf::TcpSocket> socket): socket(std::move(socket)) {
+  this->socket->setBlocking(false);
+}
+
+void NetConnection::send(NetMessage const type, NetWriter const &body) {
+  if(!open)
+    return;
+  auto const size = static_cast<std::uint32_t>(body.bytes.size());
+  for(int i = 0; i < 4; ++i)
+    out.push_back(static_cast<std::uint8_t>(size >> i * 8));
+  out.push_back(static_cast<std::uint8_t>(type));
+  out.insert(out.end(), body.bytes.begin(), body.bytes.end());
+  ++messagesSent;
+}
+
+bool NetConnection::flush() {
+  while(open && outAt < out.size()) {
+    std::size_t sent  = 0;
+    auto const status = socket->send(out.data() + outAt, out.size() - outAt, sent);
+    outAt += sent;
+    bytesSent += sent;
+    if(status == sf::Socket::Disconnected || status == sf::Socket::Error)
+      close();
+    else if(status != sf::Socket::Done)
+      break;
+  }
+
+  // Drops what was sent once it's all sent, or once it's the larger part of the queue
+  if(outAt == out.size()) {
+    out.clear();
+    outAt = 0;
+  }
+  else if(outAt > out.size() / 2) {
+    out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(outAt));
+    outAt = 0;
+  }
+  return open;
+}
+
+void NetConnection::fill() {
+  // Readers handed out last time are done with what they read
+  in.erase(in.begin(), in.begin() + static_cast<std::ptrdiff_t>(inAt));
+  inAt = 0;
+  while(open) {
+    auto const size = in.size();
+    in.resize(size + ReceiveBytes);
+    std::size_t received = 0;
+    auto const status    = socket->receive(in.data() + size, ReceiveBytes, received);
+    in.resize(size + received);
+    bytesReceived += received;
+    if(status == sf::Socket::Disconnected || status == sf::Socket::Error)
+      close();
+    if(status != sf::Socket::Done || received < ReceiveBytes)
+      break;
+  }
+}
+
+bool NetConnection::next(NetMessage &type, NetReader &reader) {
+  if(in.size() - inAt < FrameHeaderBytes)
+    return false;
+  std::uint32_t size = 0;
+  for(int i = 0; i < 4; ++i)
+    size |= static_cast<std::uint32_t>(in[inAt + i]) << i * 8;
+  if(size > MaxMessageBytes) {
+    close();
+    return false;
+  }
+  if(in.size() - inAt < FrameHeaderBytes + size)
+    return false;
+
+  type   = static_cast<NetMessage>(in[inAt + 4]);
+  reader = NetReader(in.data() + inAt + FrameHeaderBytes, size);
+  inAt += FrameHeaderBytes + size;
+  ++messagesReceived;
+  return true;
+}
+
+void NetConnection::close() {
+  if(open)
+    socket->disconnect();
+  open = false;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Block.hpp"
+
+#include "SFML/Network.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct PackedVoxels;
+struct Chunk;
+
+// Bumped whenever a message changes. Clients and servers of different versions refuse each other.
+constexpr std::uint32_t NetProtocolVersion = 2;
+constexpr unsigned short DefaultServerPort = 47310;
+
+// Messages between the chunk server and its clients, and who sends them
+enum struct NetMessage : std::uint8_t {
+  // Client: the protocol version and how many chunks around it the client wants
+  Hello,
+  // Server: the protocol version and the world's seed
+  Welcome,
+  // Client: where its player is, in blocks
+  Position,
+  // Client: a block placed at a position, or the block there broken for InvalidHandle
+  Edit,
+  // Server: a chunk's coordinates and version followed by its block and light runs
+  Chunk,
+  // Server: a chunk the client no longer needs
+  Unload,
+  // Server: what changed in the client's chunks over a tick, as a ChunkDelta per chunk from the version the client
+  // has. Chunks that changed more than their delta is worth are sent whole instead.
+  ChunkDeltas,
+  // Client: a chunk's coordinates and the version of it the client has, asking for what changed since
+  Resync,
+  // Server: the tick and when it was sent. The client sends both back as a Pong.
+  Ping,
+  Pong,
+};
+
+// Builds a message body. Numbers are little endian, counts and coordinates varints.
+struct NetWriter {
+  void u8(std::uint8_t value) { bytes.push_back(value); }
+  void u32(std::uint32_t value);
+  void u64(std::uint64_t value);
+  void f32(float value);
+  void varint(std::uint64_t value);
+  // Zigzagged, so small negative numbers stay short
+  void svarint(std::int64_t value);
+  // A change log version, as its incarnation and its count, each a varint
+  void version(std::uint64_t value);
+
+  std::vector<std::uint8_t> bytes;
+};
+
+// Reads a message body. Reading past its end fails the reader and reads zeros from then on, so a message is
+// checked once after it was read.
+struct NetReader {
+  NetReader(std::uint8_t const *data, std::size_t size): at(data), end(data + size) { }
+
+  std::uint8_t u8();
+  std::uint32_t u32();
+  std::uint64_t u64();
+  float f32();
+  std::uint64_t varint();
+  std::int64_t svarint();
+  std::uint64_t version();
+
+  bool ok() const { return !failed; }
+  bool atEnd() const { return at == end; }
+
+private:
+  bool take(std::size_t bytes);
+
+  std::uint8_t const *at, *end;
+  bool failed = false;
+};
+
+// A chunk's packed runs, each as its value in a byte and its length as a varint
+void WriteChunk(NetWriter &writer, BlockCoord cx, BlockCoord cy, BlockCoord cz, std::uint64_t version, PackedVoxels const &packed);
+// False if the runs don't add up to a chunk
+bool ReadChunk(NetReader &reader, BlockCoord &cx, BlockCoord &cy, BlockCoord &cz, std::uint64_t &version, PackedVoxels &packed);
+
+// The cells of a chunk that changed between two versions of it, and what they are as of the later one
+struct ChunkDelta {
+  BlockCoord cx, cy, cz;
+  std::uint64_t from, to;
+  // Ascending, each once
+  std::vector<std::uint16_t> cells;
+  // Blocks as PackCell makes them and light, one each per cell
+  std::vector<std::uint8_t> blocks, light;
+};
+
+// The cells as runs of consecutive ones, each as the gap since the last one and its length, followed by the blocks
+// and the light as runs of equal values. Edits to areas of blocks come down to a few bytes per row.
+void WriteChunkDelta(NetWriter &writer, ChunkDelta const &delta);
+// False if the cells aren't ascending cells of a chunk or the values don't add up to one each
+bool ReadChunkDelta(NetReader &reader, ChunkDelta &delta);
+// What changed in chunk since version from as of now. False if its change log doesn't reach back that far.
+bool DeltaSince(Chunk &chunk, std::uint64_t from, ChunkDelta &delta);
+
+struct ConnectionStats {
+  std::size_t bytesSent, bytesReceived, messagesSent, messagesReceived;
+};
+
+// Messages over a socket that never blocks. Each message goes out as the length of its body in 4 bytes, its type
+// in one and its body. Messages sent are queued and written as the socket takes them, messages received are
+// handed over once they're whole.
+struct NetConnection {
+  // Larger messages are taken for garbage and close the connection
+  static constexpr std::size_t MaxMessageBytes = 1 << 20;
+
+  // Takes a connected socket and makes it non-blocking
+  explicit NetConnection(std::unique_ptr<sf::TcpSocket> socket);
+
+  void send(NetMessage type, NetWriter const &body);
+  // Writes as much of the queue as the socket takes. False once the connection is closed.
+  bool flush();
+  // Calls handle(type, reader) for every whole message received so far, closing the connection if handle returns
+  // false or leaves the reader failed. False once the connection is closed.
+  template<typename F> bool receive(F &&handle);
+
+  bool isOpen() const { return open; }
+  void close();
+  // Bytes sent but not taken by the socket yet
+  std::size_t queuedBytes() const { return out.size() - outAt; }
+  ConnectionStats stats() const { return {bytesSent, bytesReceived, messagesSent, messagesReceived}; }
+
+private:
+  // Reads whatever the socket has
+  void fill();
+  // The next whole message received, if there is one
+  bool next(NetMessage &type, NetReader &reader);
+
+  std::unique_ptr<sf::TcpSocket> socket;
+  bool open = true;
+  std::vector<std::uint8_t> out, in;
+  std::size_t outAt = 0, inAt = 0;
+  std::size_t bytesSent = 0, bytesReceived = 0, messagesSent = 0, messagesReceived = 0;
+};
+
+template<typename F>
+bool NetConnection::receive(F &&handle) {
+  fill();
+  // Messages that came in before the connection closed are still handed over
+  NetMessage type;
+  NetReader reader(nullptr, 0);
+  while(next(type, reader))
+    if(!handle(type, reader) || !reader.ok()) {
+      close();
+      return false;
+    }
+  return open;
+}
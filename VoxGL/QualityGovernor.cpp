@@ -0,0 +1,144 @@
+#include "QualityGovernor.hpp"
+
+#include "Chunk.hpp"
+#include "World.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// How far the governor may go from what the world is configured with
+constexpr std::size_t MaxBudgetFactor = 4;
+constexpr float MinLodScale          = .5f;
+// Float knobs move by this factor a step, budgets by 2
+constexpr float Step = 1.25f;
+
+char const *KnobName(QualityKnob const knob) {
+  switch(knob) {
+  case QualityKnob::UploadBudget:   return "upload_budget";
+  case QualityKnob::MeshBatch:      return "mesh_batch";
+  case QualityKnob::LodScale:       return "lod_scale";
+  case QualityKnob::RenderDistance: return "render_distance";
+  }
+  return "";
+}
+
+static float Get(QualityKnobs const &knobs, QualityKnob const knob) {
+  switch(knob) {
+  case QualityKnob::UploadBudget:   return static_cast<float>(knobs.uploadBudget);
+  case QualityKnob::MeshBatch:      return static_cast<float>(knobs.meshBatch);
+  case QualityKnob::LodScale:       return knobs.lodScale;
+  case QualityKnob::RenderDistance: return knobs.renderDistance;
+  }
+  return .0f;
+}
+
+static void Set(QualityKnobs &knobs, QualityKnob const knob, float const value) {
+  switch(knob) {
+  case QualityKnob::UploadBudget:   knobs.uploadBudget = static_cast<std::size_t>(value); break;
+  case QualityKnob::MeshBatch:      knobs.meshBatch = static_cast<std::size_t>(value); break;
+  case QualityKnob::LodScale:       knobs.lodScale = value; break;
+  case QualityKnob::RenderDistance: knobs.renderDistance = value; break;
+  }
+}
+
+static bool IsBudget(QualityKnob const knob) { return knob == QualityKnob::UploadBudget || knob == QualityKnob::MeshBatch; }
+
+QualityGovernor::QualityGovernor(float const targetMs, QualityKnobs const &start, QualityKnobs const &min, QualityKnobs const &max) :
+  target(targetMs), current(start), min(min), max(max) {
+  window.reserve(WindowFrames);
+}
+
+QualityGovernor::QualityGovernor(float const targetMs, World const &world, float const renderDistance) :
+  QualityGovernor(targetMs, {world.uploadBudget(), world.meshBatch(), 1.f, renderDistance},
+                  {1, 1, MinLodScale, std::min(renderDistance, World::loadRadius() * ChunkSize)},
+                  {world.uploadBudget() * MaxBudgetFactor, world.meshBatch() * MaxBudgetFactor, 1.f, renderDistance}) { }
+
+bool QualityGovernor::frame(float const frameMs) {
+  ++frames;
+  window.push_back(frameMs);
+  return window.size() >= WindowFrames;
+}
+
+bool QualityGovernor::update(std::size_t const uploadQueue, std::size_t const meshQueue) {
+  if(window.empty())
+    return false;
+  auto const rank = static_cast<std::size_t>(std::ceil(Percentile / 100.f * window.size()));
+  auto const nth  = window.begin() + static_cast<std::ptrdiff_t>(std::clamp<std::size_t>(rank, 1, window.size()) - 1);
+  std::nth_element(window.begin(), nth, window.end());
+  auto const frameMs = *nth;
+  window.clear();
+
+  if(frameMs > target * (1.f + Tolerance))
+    return lower(frameMs, uploadQueue, meshQueue);
+  if(frameMs < target * Headroom)
+    return raise(frameMs, uploadQueue, meshQueue);
+  return false;
+}
+
+bool QualityGovernor::lower(float const frameMs, std::size_t const uploadQueue, std::size_t const meshQueue) {
+  auto const canLower = [&](QualityKnob const knob) { return Get(current, knob) > Get(min, knob); };
+  auto const lowerKnob = [&](QualityKnob const knob) {
+    auto const from = Get(current, knob);
+    adjust(knob, std::max(Get(min, knob), IsBudget(knob) ? std::floor(from / 2) : from / Step), frameMs, uploadQueue, meshQueue);
+    return true;
+  };
+
+  // Budgets only cost while there's something to spend them on
+  if(uploadQueue && canLower(QualityKnob::UploadBudget))
+    return lowerKnob(QualityKnob::UploadBudget);
+  if(meshQueue && canLower(QualityKnob::MeshBatch))
+    return lowerKnob(QualityKnob::MeshBatch);
+  for(auto const knob: {QualityKnob::LodScale, QualityKnob::RenderDistance, QualityKnob::UploadBudget, QualityKnob::MeshBatch})
+    if(canLower(knob))
+      return lowerKnob(knob);
+  return false;
+}
+
+bool QualityGovernor::raise(float const frameMs, std::size_t const uploadQueue, std::size_t const meshQueue) {
+  auto const canRaise = [&](QualityKnob const knob) { return Get(current, knob) < Get(max, knob); };
+  auto const raiseKnob = [&](QualityKnob const knob) {
+    auto const from = Get(current, knob);
+    adjust(knob, std::min(Get(max, knob), from * (IsBudget(knob) ? 2.f : Step)), frameMs, uploadQueue, meshQueue);
+    return true;
+  };
+
+  if(uploadQueue > current.uploadBudget && canRaise(QualityKnob::UploadBudget))
+    return raiseKnob(QualityKnob::UploadBudget);
+  if(meshQueue > current.meshBatch && canRaise(QualityKnob::MeshBatch))
+    return raiseKnob(QualityKnob::MeshBatch);
+  // Back towards what was configured, not past it
+  for(auto const knob: {QualityKnob::RenderDistance, QualityKnob::LodScale})
+    if(canRaise(knob))
+      return raiseKnob(knob);
+  return false;
+}
+
+void QualityGovernor::adjust(QualityKnob const knob, float const to, float const frameMs, std::size_t const uploadQueue,
+                             std::size_t const meshQueue) {
+  auto const from = Get(current, knob);
+  Set(current, knob, to);
+  log.push_back({frames, knob, from, Get(current, knob), frameMs, uploadQueue, meshQueue});
+  std::cerr << "Quality: " << KnobName(knob) << " " << from << " -> " << Get(current, knob) << " after frame " << frames << ", p"
+            << Percentile << " " << frameMs << "ms for a " << target << "ms target, " << uploadQueue << " chunks to upload, "
+            << meshQueue << " to mesh\n";
+}
+
+void QualityGovernor::report(std::ostream &os) const {
+  os << "{\"target_ms\": " << target << ", \"upload_budget\": " << current.uploadBudget << ", \"mesh_batch\": " << current.meshBatch
+     << ", \"lod_scale\": " << current.lodScale << ", \"render_distance\": " << current.renderDistance << ", \"adjustments\": [";
+  for(std::size_t i = 0; i < log.size(); ++i) {
+    auto const &a = log[i];
+    os << (i ? ", " : "") << "{\"frame\": " << a.frame << ", \"knob\": \"" << KnobName(a.knob) << "\", \"from\": " << a.from
+       << ", \"to\": " << a.to << ", \"frame_ms\": " << a.frameMs << ", \"upload_queue\": " << a.uploadQueue
+       << ", \"mesh_queue\": " << a.meshQueue << "}";
+  }
+  os << "]}";
+}
+
+void ApplyQuality(World &world, QualityKnobs const &knobs) {
+  world.setUploadBudget(knobs.uploadBudget);
+  world.setMeshBatch(knobs.meshBatch);
+  world.setLodScale(knobs.lodScale);
+  world.setFarTerrainDistance(knobs.renderDistance);
+}
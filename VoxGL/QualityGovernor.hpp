@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+struct World;
+
+// What the quality governor trades for frame time
+struct QualityKnobs {
+  // Meshed chunks uploaded per frame
+  std::size_t uploadBudget;
+  // Chunks meshed per pipeline round
+  std::size_t meshBatch;
+  // Multiplies the level of detail distances
+  float lodScale;
+  // The camera's far plane and how far far terrain goes, in blocks
+  float renderDistance;
+};
+
+enum struct QualityKnob : std::uint8_t {
+  UploadBudget,
+  MeshBatch,
+  LodScale,
+  RenderDistance,
+};
+
+char const *KnobName(QualityKnob knob);
+
+struct QualityAdjustment {
+  // Frames the governor had seen when it made it
+  std::size_t frame;
+  QualityKnob knob;
+  float from, to;
+  // What it went by: the window's frame time at QualityGovernor::Percentile and the chunks queued then
+  float frameMs;
+  std::size_t uploadQueue, meshQueue;
+};
+
+// Holds a frame time by trading quality for it. Once a window of frames is full it looks at the window's slow
+// frames and the chunks queued for uploading and meshing, and changes at most one knob by a step:
+//  - over the target it lowers the upload budget while chunks wait to upload, the mesh batch while chunks wait
+//    to be meshed, since meshing competes with the render thread for cores, then the level of detail distances
+//    and the render distance, and last the budgets even with nothing queued
+//  - well under it it raises the budgets the queues are backed up on, then the render distance and the level of
+//    detail distances back towards max
+// Every window starts after the last decision, so a change is judged by frames that had it.
+struct QualityGovernor {
+  static constexpr std::size_t WindowFrames = 30;
+  static constexpr float Percentile = 90.f;
+  // Quality goes down past target * (1 + Tolerance) and back up below target * Headroom, and stays put between
+  static constexpr float Tolerance = .1f;
+  static constexpr float Headroom  = .7f;
+
+  // Starts at start and keeps each knob between min and max
+  QualityGovernor(float targetMs, QualityKnobs const &start, QualityKnobs const &min, QualityKnobs const &max);
+  // Starts at what world is configured with and renderDistance, never raising level of detail or render
+  // distance past that
+  QualityGovernor(float targetMs, World const &world, float renderDistance);
+
+  // Adds a frame that took frameMs. True once the window is full and update should decide on it.
+  bool frame(float frameMs);
+  // Decides on the full window with uploadQueue chunks waiting to upload and meshQueue waiting to be meshed, and
+  // starts the next one. True if a knob changed.
+  bool update(std::size_t uploadQueue, std::size_t meshQueue);
+
+  QualityKnobs const &knobs() const { return current; }
+  std::vector<QualityAdjustment> const &adjustments() const { return log; }
+  float targetMs() const { return target; }
+  // The target, the knobs now and every adjustment, as a JSON object
+  void report(std::ostream &os) const;
+
+private:
+  bool lower(float frameMs, std::size_t uploadQueue, std::size_t meshQueue);
+  bool raise(float frameMs, std::size_t uploadQueue, std::size_t meshQueue);
+  void adjust(QualityKnob knob, float to, float frameMs, std::size_t uploadQueue, std::size_t meshQueue);
+
+  float const target;
+  QualityKnobs current;
+  QualityKnobs const min, max;
+  std::vector<float> window;
+  std::size_t frames = 0;
+  std::vector<QualityAdjustment> log;
+};
+
+// Sets what the world does of knobs. The render distance also needs to go to the camera.
+void ApplyQuality(World &world, QualityKnobs const &knobs);
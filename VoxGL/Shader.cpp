@@ -50,6 +50,7 @@ Shader::Shader(std::string_view vertexShader, std::string_view fragmentShader) :
 
     glBindAttribLocation(program, 0, "position");
     glBindAttribLocation(program, 1, "textCoord");
+    glBindAttribLocation(program, 2, "light");
 
     glLinkProgram(program);
     CheckShaderError<true>(program, GL_LINK_STATUS, "Shader linking error: ");
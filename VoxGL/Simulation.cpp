@@ -0,0 +1,128 @@
+#include "Simulation.hpp"
+
+#include "Util.hpp"
+
+#include <algorithm>
+
+// Slows the player down by this much per second once they let go, on top of the air drag
+constexpr float Friction = 18.f;
+// Below this speed the player stops
+constexpr float StopSpeed = .5f;
+constexpr float PushAcceleration = 250.f;
+constexpr float DragCoefficient  = 1e-8f;
+
+static float Pressure(float const h) {
+  auto const p = 2.574681483305359e6f - (1.173851852033113f * h) + (1.784060919377516e-7f * h * h) - (9.038819697211279e-15f * h * h * h);
+  return std::max(.0f, p);
+}
+
+static glm::vec3 Drag(glm::vec3 const &velocity, float const height) {
+  auto const pressure = DragCoefficient * Pressure(height / 10000);
+  return velocity * glm::length(velocity) * pressure + pressure * 100.f * velocity;
+}
+
+void MovePlayer(World &world, PlayerBody &body, PlayerInput const &input, float const dt) {
+  if(input.moveTo) {
+    body.position = *input.moveTo;
+    body.velocity = {};
+    return;
+  }
+
+  auto &velocity = body.velocity;
+  if(auto const speed = glm::length(velocity); speed < StopSpeed)
+    velocity = {};
+  else
+    velocity -= (Drag(velocity, body.position.z) + Friction * velocity / speed) * dt;
+  velocity += input.move * dt * PushAcceleration;
+
+  AABB const box{body.position - glm::vec3(PlayerHalfWidth, PlayerHalfWidth, PlayerEyeHeight),
+                 body.position + glm::vec3(PlayerHalfWidth, PlayerHalfWidth, PlayerHeight - PlayerEyeHeight)};
+  auto const moved = world.sweep(box, velocity * dt);
+  body.position += moved.moved;
+  if(moved.hitX)
+    velocity.x = .0f;
+  if(moved.hitY)
+    velocity.y = .0f;
+  if(moved.hitZ)
+    velocity.z = .0f;
+}
+
+Simulation::Simulation(Step step): step(std::move(step)) {
+  takeStep();
+  previous = current;
+  thread   = std::thread(&Simulation::run, this);
+}
+
+Simulation::~Simulation() {
+  running = false;
+  thread.join();
+}
+
+void Simulation::input(PlayerInput const &input) {
+  std::lock_guard<std::mutex> lck(mutex);
+  auto const breakBlock = pending.breakBlock, placeBlock = pending.placeBlock;
+  pending = input;
+  pending.breakBlock |= breakBlock;
+  pending.placeBlock |= placeBlock;
+}
+
+Simulation::Frame Simulation::frame() const {
+  std::lock_guard<std::mutex> lck(mutex);
+  auto const since = std::chrono::duration<float>(Clock::now() - publishedAt).count();
+  return {previous, current, std::clamp(since / StepSeconds, .0f, 1.f)};
+}
+
+SimulationStats Simulation::stats() const {
+  std::lock_guard<std::mutex> lck(mutex);
+  return {steps, steps ? static_cast<float>(stepMsTotal / steps) : .0f, stepMsMax, stepsDropped};
+}
+
+void Simulation::run() {
+  auto const period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(StepSeconds));
+  auto next = Clock::now() + period;
+  while(running) {
+    std::this_thread::sleep_until(next);
+    auto const now = Clock::now();
+    for(auto n = 0; n < MaxCatchUpSteps && next <= now && running; ++n) {
+      takeStep();
+      next += period;
+    }
+    // Carries on from now, the world just moves on a bit less than the clock did
+    if(next <= now) {
+      std::lock_guard<std::mutex> lck(mutex);
+      stepsDropped += static_cast<std::size_t>((now - next) / period) + 1;
+      next = now + period;
+    }
+  }
+}
+
+void Simulation::takeStep() {
+  PlayerInput input;
+  std::shared_ptr<RenderState> state;
+  {
+    std::lock_guard<std::mutex> lck(mutex);
+    input              = pending;
+    pending.breakBlock = pending.placeBlock = false;
+    // Reused once no frame holds it anymore, so its buffers are too
+    if(spare.use_count() == 1)
+      state = std::move(spare);
+  }
+  if(!state)
+    state = std::make_shared<RenderState>();
+
+  float stepMs;
+  {
+    TimedBlock<std::milli> timer(stepMs);
+    step(steps, input, *state);
+  }
+  state->step = steps;
+
+  std::lock_guard<std::mutex> lck(mutex);
+  ++steps;
+  stepMsTotal += stepMs;
+  stepMsMax   = std::max(stepMsMax, stepMs);
+  spare       = std::move(previous);
+  previous    = std::move(current);
+  current     = std::move(state);
+  publishedAt = Clock::now();
+}
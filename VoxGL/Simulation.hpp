@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Chunk.hpp"
+#include "World.hpp"
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+// What the player does, as of the last frame before a simulation step
+struct PlayerInput {
+  // Where the player pushes, a unit vector sideways plus up or down
+  glm::vec3 move{};
+  float lookX = .0f, lookZ = .0f;
+  // Clicks since the last step, on the block the crosshair is on
+  bool breakBlock = false, placeBlock = false;
+  BlockHandle placing = DirtHandle;
+  // Puts the player here instead of moving them, for the benchmark flythrough
+  std::optional<glm::vec3> moveTo;
+};
+
+// The player as the simulation moves them
+struct PlayerBody {
+  glm::vec3 position{0, 0, Chunk::blockHeight(1.f)};
+  glm::vec3 velocity{0, 0, 0};
+};
+
+constexpr float PlayerHalfWidth = .3f;
+constexpr float PlayerHeight    = 1.8f;
+constexpr float PlayerEyeHeight = 1.62f;
+
+// Moves body through world for dt seconds, pushed by input and stopped by solid blocks
+void MovePlayer(World &world, PlayerBody &body, PlayerInput const &input, float dt);
+
+// What the render thread draws, published by the simulation after every step
+struct RenderState {
+  std::uint64_t step = 0;
+  // The player's eyes
+  glm::vec3 position{};
+  // What the crosshair was on after the step
+  RaycastResult lookedAt{};
+  WorldView world;
+};
+
+struct SimulationStats {
+  std::size_t steps;
+  float stepMsAvg, stepMsMax;
+  // Steps skipped because the simulation fell further behind than it catches up on
+  std::size_t stepsDropped;
+};
+
+// Steps the game at a fixed rate on its own thread, so how long frames take changes how often the world is drawn
+// but never what happens in it. Every step publishes a RenderState, and the render thread draws between the last
+// two, as far from the older towards the newer as the time since the newer was published.
+struct Simulation {
+  static constexpr float StepsPerSecond = 60.f;
+  static constexpr float StepSeconds    = 1.f / StepsPerSecond;
+  // A simulation further behind than this drops the steps it missed rather than running a burst of them
+  static constexpr int MaxCatchUpSteps = 5;
+
+  // Takes step number n with the input as of then, filling in all of the state published after it
+  using Step = std::function<void(std::uint64_t n, PlayerInput const &input, RenderState &state)>;
+
+  // Takes the first step before the thread starts, so there's a state to draw from the start
+  explicit Simulation(Step step);
+  ~Simulation();
+
+  // Input for the next step. Clicks add up until a step takes them.
+  void input(PlayerInput const &input);
+
+  struct Frame {
+    std::shared_ptr<RenderState const> previous, current;
+    // How far from previous to current to draw, 0 to 1
+    float alpha;
+
+    glm::vec3 position() const { return previous->position + (current->position - previous->position) * alpha; }
+  };
+  Frame frame() const;
+  SimulationStats stats() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void run();
+  void takeStep();
+
+  Step const step;
+  // Steps taken, only changed by the simulation thread
+  std::uint64_t steps = 0;
+
+  // Held only to hand input and states over
+  mutable std::mutex mutex;
+  PlayerInput pending;
+  // The last two states published, and the one before, reused once the render thread let go of it
+  std::shared_ptr<RenderState> previous, current, spare;
+  Clock::time_point publishedAt;
+  double stepMsTotal = .0;
+  float stepMsMax = .0f;
+  std::size_t stepsDropped = 0;
+
+  std::atomic<bool> running{true};
+  // Started last
+  std::thread thread;
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 template<typename R, typename T = float>
 struct TimedBlock {
   explicit TimedBlock(T &result): result(result) { }
@@ -12,3 +17,24 @@ private:
 
 template<class... Ts> struct Overloaded : Ts... { using Ts::operator()...; };
 template<class... Ts> Overloaded(Ts...) -> Overloaded<Ts...>;
+
+// FNV-1a, to tell whether what was read back from disk is what was written
+inline std::uint32_t Fnv1a(void const *const data, std::size_t const bytes, std::uint32_t hash = 2166136261u) {
+  for(auto p = static_cast<unsigned char const *>(data), end = p + bytes; p != end; ++p)
+    hash = (hash ^ *p) * 16777619u;
+  return hash;
+}
+
+// 64 bit FNV-1a taking a word at a time rather than a byte, for hashing a lot of data quickly. Inputs that differ
+// in a single word never collide.
+inline std::uint64_t HashWords(void const *const data, std::size_t const bytes, std::uint64_t hash = 14695981039346656037ull) {
+  auto const p = static_cast<unsigned char const *>(data);
+  std::size_t i = 0;
+  for(std::uint64_t word; i + sizeof(word) <= bytes; i += sizeof(word)) {
+    std::memcpy(&word, p + i, sizeof(word));
+    hash = (hash ^ word) * 1099511628211ull;
+  }
+  for(; i < bytes; ++i)
+    hash = (hash ^ p[i]) * 1099511628211ull;
+  return hash;
+}
@@ -5,16 +5,39 @@
 #include "Game.hpp"
 
 #include "Util.hpp"
+#include "Worldgen.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <future>
+#include <limits>
+#include <utility>
 #include "PerlinNoise.hpp"
 
 constexpr float WorldgenDist = (isDebugging ? 3.f : 14.f) / (ChunkSize/16.0);
-
-World::World(glm::vec3 *const position, long long const seed) : position(position), seed(static_cast<decltype(this->seed)>(seed)),
-                                                                worldgenThread(&World::worldgen, this) { }
-
-World::World(World &&other) noexcept : position{ other.position }, seed{0}, worldgenThread{std::move(other.worldgenThread)} {
+// How far past a ring boundary a chunk has to be before it changes level of detail
+constexpr float LodHysteresis = .5f;
+// How often levels of detail and far terrain follow the player, and how long worldgen waits when it has nothing to do
+constexpr std::chrono::milliseconds LodInterval(300);
+constexpr std::chrono::milliseconds IdleWait(50);
+// How often cold chunks are looked for to compress, and what's kept about chunks left behind dropped
+constexpr std::chrono::milliseconds ResidencyInterval(1000);
+// Column generation data and which chunks were decorated are kept this many chunks past the load radius, out to
+// beyond where chunks unload and the neighbours decorating a chunk at the edge looks at
+constexpr float ForgetMargin = 4.f;
+
+World::World(glm::vec3 *const position, long long const seed, WorldOptions options) :
+  journal(options.journalPath, seed),
+  chunkStore(options.chunkStorePath.empty() ? nullptr : std::make_unique<ChunkStore>(options.chunkStorePath, seed)),
+  meshCache(options.meshCachePath, seed),
+  position(position), options([&] {
+    std::sort(options.lodDistances.begin(), options.lodDistances.end());
+    return std::move(options);
+  }()), farTerrainDistance(this->options.farTerrainDistance), seed(static_cast<decltype(this->seed)>(seed)),
+  pipeline(WorldgenDist, this->options.workers), worldgenThread(&World::worldgen, this) { }
+
+World::World(World &&other) noexcept : position{ other.position }, options{other.options}, seed{0}, pipeline(WorldgenDist),
+                                       worldgenThread{std::move(other.worldgenThread)} {
   chunks = std::move(other.chunks);
 }
 
@@ -23,13 +46,49 @@ World::~World() {
   worldgenThread.join();
 }
 
-void World::draw(float const deltaT, glm::mat4 const &perspective, Shader &shader) {
+void World::releaseUnloaded() {
+  pipeline.onDraw();
+  // After their meshes are freed, so the last of an unloaded chunk goes on this thread
+  slab.reclaim();
+}
+
+void World::dropMeshes() {
+  std::lock_guard<std::mutex> lck(chunkMutex);
+  chunks.forEach([](std::shared_ptr<Chunk> const &c) {
+    if(c->stage == ChunkStage::Uploaded)
+      c->releaseMesh();
+  });
+}
+
+float World::loadRadius() { return WorldgenDist; }
+
+std::shared_ptr<Chunk> World::makeChunk(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+  // Stored chunks still go through the rest of the pipeline, decorating and lighting them again changes nothing
+  if(PackedVoxels packed; chunkStore && chunkStore->load(cx, cy, cz, packed))
+    return std::allocate_shared<Chunk>(ChunkAllocator<Chunk>(chunkPool), cx, cy, cz, this, std::move(packed));
+  return std::allocate_shared<Chunk>(ChunkAllocator<Chunk>(chunkPool), cx, cy, cz, this);
+}
+
+void World::draw(float const deltaT, glm::mat4 const &perspective, Shader &shader, WorldView const &view) {
   BlockTextures->bind();
+  farTerrain.draw();
+  items.draw(view.items);
+  releaseUnloaded();
+  // Chunks that unloaded since the view was taken have stale handles
+  EpochGuard guard(slab);
+  for(auto const handle: view.chunks)
+    if(auto const c = slab.get(handle); c && c->stage == ChunkStage::Uploaded)
+      c->draw(deltaT, {c->cx, c->cy, c->cz});
+}
+
+void World::takeView(WorldView &view) {
+  view.items = items.buildMesh(*position);
+  view.chunks.clear();
   std::lock_guard<std::mutex> lck(chunkMutex);
-  for(auto &c: chunks) {
-    auto [x, y, z] = c.first;
-    c.second->draw(deltaT, {x, y, z});
-  }
+  chunks.forEach([&](std::shared_ptr<Chunk> const &c) {
+    if(auto const stage = c->stage.load(); stage == ChunkStage::Meshed || stage == ChunkStage::Uploaded)
+      view.chunks.push_back(c->handle);
+  });
 }
 
 // Plz no dir == .0f
@@ -39,8 +98,7 @@ float IntDist(float const from, float const dir) {
   return -from / dir;
 }
 
-std::tuple<Block *, BlockSide, BlockCoord, BlockCoord, BlockCoord, float> World::raycast(
-  glm::vec3 const from, glm::vec3 const dir, float const maxDist) {
+RaycastResult World::raycastReference(glm::vec3 const from, glm::vec3 const dir, float const maxDist) {
   auto start = from;
   auto curr  = sf::Vector3i(static_cast<BlockCoord>(floor(from.x)), static_cast<BlockCoord>(floor(from.y)),
                             static_cast<BlockCoord>(floor(from.z)));
@@ -113,70 +171,402 @@ std::tuple<Block *, BlockSide, BlockCoord, BlockCoord, BlockCoord, float> World:
   return {nullptr, BlockSide::Top, 0, 0, 0, .0f};
 }
 
-constexpr ChunkIndex World::getChunkIndexBlock(BlockCoord x, BlockCoord y, BlockCoord z) {
-  return ChunkIndex(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y), Chunk::decomposeChunkFromBlock(z));
+Chunk *World::findChunk(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) {
+  // Read first, so a chunk that left the overflow map for its slot is either seen there or published already
+  auto const overflow = chunks.mayHaveOverflow();
+  if(auto const chunk = chunks.findUnlocked(slab, cx, cy, cz); chunk || !overflow)
+    return chunk;
+  std::lock_guard<std::mutex> lck(chunkMutex);
+  return chunks.find(cx, cy, cz);
 }
 
-void World::addItem(std::unique_ptr<Item> item, BlockCoord x, BlockCoord y, BlockCoord z) {
+namespace {
+  // Minimum rays or bodies per worker thread in batched queries
+  constexpr std::size_t RaysPerWorker   = 256;
+  constexpr std::size_t BodiesPerWorker = 256;
 
-}
+  // The chunk a ray is currently in. Moving to a neighbouring chunk follows its adjacency links, jumps elsewhere
+  // look the chunk up in the grid.
+  struct ChunkCursor {
+    explicit ChunkCursor(World &world) : world(world) { }
 
-void World::worldgen() {
-  auto const makeChunk = [&](BlockCoord cx, BlockCoord cy, BlockCoord cz, ChunkIndex ci) {
-    auto c = std::make_shared<Chunk>(cx, cy, cz, this);
-    std::lock_guard<std::mutex> lck(chunkMutex);
-    chunks[ci] = c;
+    Chunk *at(BlockCoord const ncx, BlockCoord const ncy, BlockCoord const ncz) {
+      if(looked && ncx == cx && ncy == cy && ncz == cz)
+        return chunk;
 
-    // Hunt for adjacent chunks!
-    for(auto const &[dx, dy, dz]: Vdxyz) {
-      if(auto adjC = getChunk<true>(cx + dx, cy + dy, cz + dz); adjC) {
-        adjC->onAdjacentChunkLoad(-dx, -dy, -dz, std::weak_ptr<Chunk>{c});
-        c->onAdjacentChunkLoad(dx, dy, dz, adjC);
-      }
+      auto const dx = ncx - cx, dy = ncy - cy, dz = ncz - cz;
+      if(looked && chunk && std::abs(dx) + std::abs(dy) + std::abs(dz) == 1)
+        chunk = chunk->adjacent(dx ? (dx > 0 ? 0 : 1) : dy ? (dy > 0 ? 2 : 3) : (dz > 0 ? 4 : 5));
+      else
+        chunk = world.findChunk(ncx, ncy, ncz);
+
+      looked = true, cx = ncx, cy = ncy, cz = ncz;
+      return chunk;
+    }
+
+    // Highest block in the chunk column of the last chunk looked at
+    BlockCoord columnHeight() {
+      if(!heightLooked || hcx != cx || hcy != cy)
+        height = world.heights.chunkColumnHeight(cx, cy), hcx = cx, hcy = cy, heightLooked = true;
+      return height;
     }
+
+  private:
+    World &world;
+    // Kept alive by the EpochGuard the cursor is used under
+    EpochGuard guard{world.slab};
+    Chunk *chunk = nullptr;
+    BlockCoord cx = 0, cy = 0, cz = 0;
+    bool looked = false;
+    BlockCoord hcx = 0, hcy = 0, height = UnknownHeight;
+    bool heightLooked = false;
   };
 
-  while(generating) {
-    std::vector<std::future<void>> futs;
+  constexpr BlockSide HitSide(int const axis, int const step) {
+    switch(axis) {
+    case 0: return step > 0 ? BlockSide::Front : BlockSide::Back;
+    case 1: return step > 0 ? BlockSide::Left : BlockSide::Right;
+    default: return step > 0 ? BlockSide::Bottom : BlockSide::Top;
+    }
+  }
 
-    for(auto x = static_cast<BlockCoord>(position->x / ChunkSize - WorldgenDist - 1);
-        x <= static_cast<BlockCoord>(position->x / ChunkSize + WorldgenDist) && generating; ++x) {
-      for(auto y = static_cast<BlockCoord>(position->y / ChunkSize - WorldgenDist - 1);
-          y <= static_cast<BlockCoord>(position->y / ChunkSize + WorldgenDist) && generating; ++y) {
-        for(auto z = std::max(0, static_cast<BlockCoord>(position->z / ChunkSize - WorldgenDist - 1));
-            z <= static_cast<BlockCoord>(position->z / ChunkSize + WorldgenDist) && generating; ++z) {
-          auto const xd = .5f + x - position->x / ChunkSize;
-          auto const yd = .5f + y - position->y / ChunkSize;
-          auto const zd = .5f + z - position->z / ChunkSize;
-          if(xd * xd + yd * yd + zd * zd > WorldgenDist * WorldgenDist)
-            continue;
-          auto height = Chunk::blockHeight(Chunk::getBlerpWorldgenVal(x * ChunkSize, y * ChunkSize, this, PerlinInstance::Height));
-          auto ci     = ChunkIndex(x, y, z);
-          bool create;
-          {
-            std::lock_guard<std::mutex> lck(chunkMutex);
-            create = (chunks.find(ci) == chunks.end());
-          }
+  // Amanatides & Woo grid traversal
+  RaycastResult March(ChunkCursor &cursor, glm::vec3 const from, glm::vec3 const dir, float const maxDist) {
+    auto constexpr Inf = std::numeric_limits<float>::infinity();
+    RaycastResult const miss{nullptr, BlockSide::Top, 0, 0, 0, .0f};
+
+    auto const speed = Length(dir);
+    if(speed <= .0f)
+      return miss;
+    auto const maxT = maxDist / speed;
+
+    BlockCoord voxel[3];
+    int step[3];
+    float tMax[3], tDelta[3];
+    for(int a = 0; a < 3; ++a) {
+      voxel[a] = static_cast<BlockCoord>(std::floor(from[a]));
+      if(dir[a] > .0f)
+        step[a] = 1, tDelta[a] = 1.f / dir[a], tMax[a] = (voxel[a] + 1 - from[a]) / dir[a];
+      else if(dir[a] < .0f)
+        step[a] = -1, tDelta[a] = -1.f / dir[a], tMax[a] = (from[a] - voxel[a]) / -dir[a];
+      else
+        step[a] = 0, tDelta[a] = tMax[a] = Inf;
+    }
 
-          if constexpr(isDebugging) {
-            if(create)
-              makeChunk(x, y, z, ci);
+    auto t    = .0f;
+    auto axis = 0;
+
+    for(auto first = true;; first = false) {
+      if(!first) {
+        auto const chunk = cursor.at(Chunk::decomposeChunkFromBlock(voxel[0]), Chunk::decomposeChunkFromBlock(voxel[1]),
+                                     Chunk::decomposeChunkFromBlock(voxel[2]));
+        // Air above the highest block of the chunk column is skipped like an empty chunk, down to that block
+        auto skipFloor = voxel[2] & ChunkLocMask;
+        auto skip      = !chunk || chunk->isEmpty();
+        if(!skip && voxel[2] > cursor.columnHeight())
+          skip = true, skipFloor = std::max(skipFloor, cursor.columnHeight() + 1);
+
+        if(!skip) {
+          auto const b = chunk->blockAt(Chunk::decomposeLocalBlockFromBlock(voxel[0]), Chunk::decomposeLocalBlockFromBlock(voxel[1]),
+                                        Chunk::decomposeLocalBlockFromBlock(voxel[2]));
+          if(b)
+            return {b, HitSide(axis, step[axis]), voxel[0], voxel[1], voxel[2], t * speed};
+        }
+        else {
+          // Nothing to hit in here, jump straight to where the ray leaves the chunk or gets down to the blocks
+          auto tExit = Inf;
+          auto exitSteps = 0;
+          for(int a = 0; a < 3; ++a) {
+            if(!step[a])
+              continue;
+            auto const start = voxel[a] & ChunkLocMask;
+            auto const n     = step[a] > 0 ? start + ChunkBlockMask - voxel[a] : voxel[a] - (a == 2 ? skipFloor : start);
+            if(auto const tb = tMax[a] + n * tDelta[a]; tb < tExit)
+              tExit = tb, axis = a, exitSteps = n;
           }
-          else {
-            if(create)
-              futs.push_back(std::async(makeChunk, x, y, z, ci));
+          if(tExit > maxT)
+            break;
+
+          for(int a = 0; a < 3; ++a) {
+            if(a == axis || !step[a] || tMax[a] >= tExit)
+              continue;
+            auto const k = static_cast<int>(std::ceil((tExit - tMax[a]) / tDelta[a]));
+            voxel[a] += step[a] * k;
+            tMax[a] += k * tDelta[a];
           }
+          voxel[axis] += step[axis] * (exitSteps + 1);
+          tMax[axis] += (exitSteps + 1) * tDelta[axis];
+          t = tExit;
+          continue;
         }
       }
+
+      axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+      t    = tMax[axis];
+      if(t > maxT)
+        break;
+      voxel[axis] += step[axis];
+      tMax[axis] += tDelta[axis];
+    }
+
+    return miss;
+  }
+}
+
+RaycastResult World::raycast(glm::vec3 const from, glm::vec3 const dir, float const maxDist) {
+  ChunkCursor cursor(*this);
+  return March(cursor, from, dir, maxDist);
+}
+
+std::vector<RaycastResult> World::raycast(std::vector<Ray> const &rays) {
+  std::vector<RaycastResult> results(rays.size());
+
+  // Consecutive rays usually start close to each other, so each worker keeps its cursor between rays
+  auto const marchRange = [&](std::size_t begin, std::size_t end) {
+    ChunkCursor cursor(*this);
+    for(auto i = begin; i < end; ++i)
+      results[i] = March(cursor, rays[i].from, rays[i].dir, rays[i].maxDist);
+  };
+
+  auto const workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), rays.size() / RaysPerWorker);
+  if(workers <= 1) {
+    marchRange(0, rays.size());
+    return results;
+  }
+
+  std::vector<std::future<void>> futs;
+  auto const perWorker = (rays.size() + workers - 1) / workers;
+  for(std::size_t begin = 0; begin < rays.size(); begin += perWorker)
+    futs.push_back(std::async(std::launch::async, marchRange, begin, std::min(begin + perWorker, rays.size())));
+  for(auto &f: futs)
+    f.get();
+
+  return results;
+}
+
+SweepResult World::sweep(AABB const &box, glm::vec3 const &displacement) {
+  glm::ivec3 min, max;
+  SweepBounds(box, displacement, min, max);
+
+  EpochGuard guard(slab);
+  ChunkNeighbourhood neighbourhood;
+  neighbourhood.fetch(*this, min, max);
+  return SweepAABB(neighbourhood, box, displacement);
+}
+
+std::vector<SweepResult> World::sweep(std::vector<Body> const &bodies) {
+  std::vector<SweepResult> results(bodies.size());
+
+  auto const sweepRange = [&](std::size_t begin, std::size_t end) {
+    // Blocks the neighbourhood found stay valid even if their chunk is compressed meanwhile
+    EpochGuard guard(slab);
+    ChunkNeighbourhood neighbourhood;
+    glm::ivec3 min, max;
+    for(auto i = begin; i < end; ++i) {
+      SweepBounds(bodies[i].box, bodies[i].displacement, min, max);
+      // Fetch a chunk of margin so the bodies around this one can reuse the neighbourhood
+      if(!neighbourhood.covers(min, max))
+        neighbourhood.fetch(*this, min, max, 1);
+      results[i] = SweepAABB(neighbourhood, bodies[i].box, bodies[i].displacement);
+    }
+  };
+
+  auto const workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), bodies.size() / BodiesPerWorker);
+  if(workers <= 1) {
+    sweepRange(0, bodies.size());
+    return results;
+  }
+
+  std::vector<std::future<void>> futs;
+  auto const perWorker = (bodies.size() + workers - 1) / workers;
+  for(std::size_t begin = 0; begin < bodies.size(); begin += perWorker)
+    futs.push_back(std::async(std::launch::async, sweepRange, begin, std::min(begin + perWorker, bodies.size())));
+  for(auto &f: futs)
+    f.get();
+
+  return results;
+}
+
+constexpr ChunkIndex World::getChunkIndexBlock(BlockCoord x, BlockCoord y, BlockCoord z) {
+  return ChunkIndex(Chunk::decomposeChunkFromBlock(x), Chunk::decomposeChunkFromBlock(y), Chunk::decomposeChunkFromBlock(z));
+}
+
+void World::addItem(ItemStack const stack, BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  // Hop in a direction picked from the block position, so drops stay deterministic
+  auto const h     = static_cast<std::uint32_t>(x) * 73856093u ^ static_cast<std::uint32_t>(y) * 19349663u ^ static_cast<std::uint32_t>(z) * 83492791u;
+  auto const angle = static_cast<float>(h % 628) / 100.f;
+  items.spawn(stack, {x + .5f, y + .5f, z + .5f}, {std::cos(angle) * 1.5f, std::sin(angle) * 1.5f, 4.f});
+}
+
+void World::onBlockChanged(BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  blockTicks.schedule(*this, x, y, z, 1);
+  for(auto const &[dx, dy, dz]: Vdxyz)
+    blockTicks.schedule(*this, x + dx, y + dy, z + dz, 1);
+  fluids.wake(x, y, z);
+  light.update(x, y, z);
+}
+
+void World::onBlockSet(Chunk &chunk, BlockCoord const x, BlockCoord const y, BlockCoord const z) {
+  // Chunks before that aren't anyone's yet, they're sent whole once lit
+  if(!options.trackChanges || chunk.stage.load() < ChunkStage::Lit)
+    return;
+  chunk.changes.record(static_cast<std::uint16_t>(Chunk::blockPos(Chunk::decomposeLocalBlockFromBlock(x), Chunk::decomposeLocalBlockFromBlock(y),
+                                                                  Chunk::decomposeLocalBlockFromBlock(z))));
+  std::lock_guard<std::mutex> lck(changesMutex);
+  if(changedChunkSet.insert(ChunkIndex(chunk.cx, chunk.cy, chunk.cz).repr).second)
+    changedChunks.emplace_back(chunk.cx, chunk.cy, chunk.cz);
+}
+
+std::vector<glm::ivec3> World::takeChangedChunks() {
+  std::lock_guard<std::mutex> lck(changesMutex);
+  changedChunkSet.clear();
+  return std::exchange(changedChunks, {});
+}
+
+std::shared_ptr<ChunkColumnGen> World::columnGen(BlockCoord const cx, BlockCoord const cy) {
+  auto const key = (static_cast<long long>(cx) << 32) | static_cast<std::uint32_t>(cy);
+  {
+    std::lock_guard<std::mutex> lck(columnGenMutex);
+    if(auto const it = columnGens.find(key); it != columnGens.end())
+      return it->second;
+  }
+
+  // Generated outside the lock, if two chunks race for the column the first one in wins
+  auto gen = std::make_shared<ChunkColumnGen>(cx, cy, *this, options.caves);
+  std::lock_guard<std::mutex> lck(columnGenMutex);
+  return columnGens.emplace(key, std::move(gen)).first->second;
+}
+
+std::size_t World::numColumnGens() {
+  std::lock_guard<std::mutex> lck(columnGenMutex);
+  return columnGens.size();
+}
+
+void World::pruneColumns() {
+  auto const keep = Pow<2>(WorldgenDist + ForgetMargin);
+  auto const px   = position->x / ChunkSize, py = position->y / ChunkSize;
+  // Chunks still loaded in a column dropped keep their own reference to its data
+  std::lock_guard<std::mutex> lck(columnGenMutex);
+  for(auto it = columnGens.begin(); it != columnGens.end();) {
+    auto const dx = .5f + static_cast<BlockCoord>(it->first >> 32) - px, dy = .5f + static_cast<std::int32_t>(it->first) - py;
+    if(dx * dx + dy * dy > keep)
+      it = columnGens.erase(it);
+    else
+      ++it;
+  }
+}
+
+void World::remesh(std::vector<std::shared_ptr<Chunk>> chunks) {
+  std::sort(chunks.begin(), chunks.end());
+  chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+  // The pipeline meshes the rest once their neighbours are ready
+  chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [](auto const &c) { return !c || !c->isMeshed(); }), chunks.end());
+
+  if constexpr(isDebugging) {
+    for(auto &c: chunks)
+      c->regenerateChunkMesh();
+  }
+  else {
+    std::vector<std::future<void>> futs;
+    for(auto &c: chunks)
+      futs.push_back(std::async([c] { c->regenerateChunkMesh(); }));
+    for(auto &f: futs)
+      f.get();
+  }
+}
+
+float World::chunkDist(BlockCoord const cx, BlockCoord const cy, BlockCoord const cz) const {
+  auto const xd = .5f + cx - position->x / ChunkSize;
+  auto const yd = .5f + cy - position->y / ChunkSize;
+  auto const zd = .5f + cz - position->z / ChunkSize;
+  return std::sqrt(xd * xd + yd * yd + zd * zd);
+}
+
+int World::lodFor(float const dist, int const current) const {
+  auto const scale = lodScale.load();
+  auto lod         = 0;
+  for(auto const ring: options.lodDistances)
+    lod += dist > ring * scale;
+  lod = std::min(lod, std::min(MaxLod, static_cast<int>(options.lodDistances.size())));
+
+  if(lod != current) {
+    auto const boundary = options.lodDistances[std::min(lod, current)] * scale;
+    if(std::abs(dist - boundary) < LodHysteresis)
+      return current;
+  }
+
+  return lod;
+}
+
+void World::onChunkMeshed(int const lod, float const microseconds) {
+  ++lodMeshes[lod];
+  lodMeshMicros[lod] += static_cast<long long>(microseconds);
+}
+
+std::vector<LodRingStats> World::lodRings() {
+  std::vector<LodRingStats> rings;
+  for(int lod = 0; lod <= MaxLod; ++lod)
+    rings.push_back({lod, 0, 0, lodMeshes[lod], lodMeshMicros[lod] / 1000.f});
+
+  std::lock_guard<std::mutex> lck(chunkMutex);
+  chunks.forEach([&](std::shared_ptr<Chunk> const &c) {
+    auto &ring = rings[c->lod];
+    ++ring.chunks;
+    ring.triangles += c->numTriangles;
+  });
+  return rings;
+}
+
+// Remeshes the chunks that crossed a ring boundary since the last pass
+void World::updateLods() {
+  std::vector<std::shared_ptr<Chunk>> changed;
+  {
+    std::lock_guard<std::mutex> lck(chunkMutex);
+    chunks.forEach([&](std::shared_ptr<Chunk> const &c) {
+      auto const lod = lodFor(chunkDist(c->cx, c->cy, c->cz), c->lod);
+      if(lod == c->lod)
+        return;
+      c->lod = lod;
+      if(c->isMeshed())
+        changed.push_back(c);
+    });
+  }
+
+  if constexpr(isDebugging) {
+    for(auto &c: changed)
+      c->regenerateChunkMesh();
+  }
+  else {
+    std::vector<std::future<void>> futs;
+    for(auto &c: changed)
+      futs.push_back(std::async([c] { c->regenerateChunkMesh(); }));
+    for(auto &f: futs)
+      f.get();
+  }
+}
+
+void World::worldgen() {
+  auto lastLods      = std::chrono::steady_clock::now() - LodInterval;
+  auto lastResidency = std::chrono::steady_clock::now();
+  while(generating) {
+    auto const moved = pipeline.pump(*this);
+
+    if(auto const now = std::chrono::steady_clock::now(); now - lastLods >= LodInterval) {
+      lastLods = now;
+      updateLods();
+      if(options.farTerrainDistance > .0f)
+        farTerrain.update(*this, *position, WorldgenDist * ChunkSize, farTerrainDistance);
     }
 
-    if constexpr(!isDebugging) {
-      for(auto &f: futs)
-        f.get();
-      futs.clear();
+    if(auto const now = std::chrono::steady_clock::now(); now - lastResidency >= ResidencyInterval) {
+      lastResidency = now;
+      residency.update(*this);
+      pruneColumns();
+      decorations.prune(*position / static_cast<float>(ChunkSize), WorldgenDist + ForgetMargin);
     }
 
-    std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(300));
+    if(!moved)
+      std::this_thread::sleep_for(IdleWait);
   }
 }
 
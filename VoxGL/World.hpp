@@ -3,17 +3,38 @@
 #include "glm/glm.hpp"
 
 #include "Blocks.hpp"
+#include "BlockTicks.hpp"
+#include "ChunkGrid.hpp"
+#include "ChunkPipeline.hpp"
+#include "ChunkPool.hpp"
+#include "ChunkResidency.hpp"
+#include "ChunkSlab.hpp"
+#include "ChunkStore.hpp"
+#include "Collision.hpp"
+#include "Decoration.hpp"
+#include "EditJournal.hpp"
+#include "FarTerrain.hpp"
+#include "Fluids.hpp"
+#include "HeightIndex.hpp"
+#include "Lighting.hpp"
 #include "Item.hpp"
+#include "ItemEntities.hpp"
+#include "MeshBufferPool.hpp"
+#include "MeshCache.hpp"
 
 #include "Bitfields/Bitfield.hpp"
 
+#include <array>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <unordered_set>
+#include <vector>
 
 struct Shader;
 struct Chunk;
 struct Block;
+struct ChunkColumnGen;
 
 enum struct PerlinInstance : BlockCoord {
 	Height,
@@ -91,37 +112,194 @@ template <> struct std::hash<ChunkIndex> {
 
 inline void unload(std::unique_ptr<World> world) { }
 
+// Chunks are meshed from cells up to 1 << MaxLod blocks wide
+constexpr int MaxLod = 3;
+// Chunk distances past which chunks are meshed at the next level of detail
+std::vector<float> const DefaultLodDistances{5.f, 8.f, 11.f};
+
+using RaycastResult = std::tuple<Block *, BlockSide, BlockCoord, BlockCoord, BlockCoord, float>;
+
+struct Ray {
+  glm::vec3 from, dir;
+  float maxDist;
+};
+
+struct WorldOptions {
+  // Chunk distances past which chunks are meshed at the next level of detail
+  std::vector<float> lodDistances = DefaultLodDistances;
+  // Distance in blocks out to which far terrain is drawn past the loaded chunks, 0 to disable it
+  float farTerrainDistance = .0f;
+  // Carves caves out of the terrain
+  bool caves = true;
+  // Chunks kept expanded before the coldest are compressed in memory, 0 to never compress them
+  std::size_t expandedChunkBudget = 2048;
+  // Chunk distance within which chunks are never compressed
+  float coldDistance = 6.f;
+  // Where the player's block edits are journaled and recovered from, empty to not keep them
+  std::string journalPath;
+  // Where pre-generated chunks are loaded from instead of being generated, empty to generate them all
+  std::string chunkStorePath;
+  // Where chunk meshes are kept for the next time the world is loaded, empty to mesh every chunk every time
+  std::string meshCachePath;
+  // Threads generating and meshing chunks, 0 for one per core
+  unsigned workers = 0;
+  // Meshes chunks once they're lit. Worlds never drawn can leave them unmeshed.
+  bool meshing = true;
+  // Chunk layers loaded from the bottom of the world up, 0 for all within reach
+  BlockCoord layers = 0;
+  // Logs where blocks and light are set in lit chunks, for a server to send peers what changed
+  bool trackChanges = false;
+};
+
+struct LodRingStats {
+  int lod;
+  std::size_t chunks, triangles, meshes;
+  float meshMsTotal;
+};
+
+// What the render thread draws of a world, taken between simulation steps so drawing needs no world locks
+struct WorldView {
+  // Chunks meshed when the view was taken, drawn once their meshes are uploaded
+  std::vector<ChunkHandle> chunks;
+  MeshData items;
+};
+
 struct World {
-	World(glm::vec3 *const position, long long seed);
+	World(glm::vec3 *const position, long long seed, WorldOptions options = {});
   World(World &&other) noexcept;
 	~World();
 
-	void draw(float deltaT, glm::mat4 const &perspective, Shader &);
+	// Draws the chunks in view that are still loaded, looking them up by handle instead of under chunkMutex
+	void draw(float deltaT, glm::mat4 const &perspective, Shader &, WorldView const &view);
+	// What draw needs as of now, for the thread that updates the world to hand to the render thread
+	void takeView(WorldView &view);
+	// The render thread's part of unloading chunks, done by draw. Worlds that are never drawn call it themselves.
+	void releaseUnloaded();
+	// Lets go of the meshes waiting to be uploaded, like draw does once it uploaded them, for worlds never drawn
+	void dropMeshes();
 	template <bool AlreadyHasMutex> void tryRegen(BlockCoord x, BlockCoord y, BlockCoord z);
 	template <bool AlreadyHasMutex> Block *blockAt(BlockCoord x, BlockCoord y, BlockCoord z);
 	template <bool AlreadyHasMutex> std::shared_ptr<Chunk> getChunkAtBlock(BlockCoord x, BlockCoord y, BlockCoord z);
 	template <bool AlreadyHasMutex> std::shared_ptr<Chunk> getChunk(BlockCoord x, BlockCoord y, BlockCoord z);
-	std::tuple<Block *, BlockSide, BlockCoord, BlockCoord, BlockCoord, float> raycast(glm::vec3 from, glm::vec3 dir, float maxDist);
+	// Walks the grid cell by cell under an EpochGuard instead of chunkMutex, following chunk adjacency and skipping
+	// empty chunks whole
+	RaycastResult raycast(glm::vec3 from, glm::vec3 dir, float maxDist);
+	// Casts every ray, spread over worker threads for large batches
+	std::vector<RaycastResult> raycast(std::vector<Ray> const &rays);
+	// The original raycast, stepping under chunkMutex with a lookup per cell. Kept as the ray benchmark baseline.
+	RaycastResult raycastReference(glm::vec3 from, glm::vec3 dir, float maxDist);
+	// Moves box by displacement, stopping it against solid blocks
+	SweepResult sweep(AABB const &box, glm::vec3 const &displacement);
+	// Sweeps every body. Nearby bodies share fetched chunk neighbourhoods and large batches are spread over worker threads.
+	std::vector<SweepResult> sweep(std::vector<Body> const &bodies);
 	static constexpr ChunkIndex getChunkIndexBlock(BlockCoord x, BlockCoord y, BlockCoord z);
-
-  void addItem(std::unique_ptr<Item> item, BlockCoord x, BlockCoord y, BlockCoord z);
-
+  // The chunk at chunk coordinates cx, cy, cz through the grid's published handles, only valid under an EpochGuard
+  // on slab. Takes chunkMutex only while the grid has chunks in its overflow map, which it needs to look into.
+  Chunk *findChunk(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+
+  // Drops stack as an item entity popping out of the block at x, y, z
+  void addItem(ItemStack stack, BlockCoord x, BlockCoord y, BlockCoord z);
+
+  // Wakes up the block at x, y, z and its neighbours after it changed, and queues its light for an update
+  void onBlockChanged(BlockCoord x, BlockCoord y, BlockCoord z);
+  // Remeshes every chunk the pipeline has meshed once, in parallel outside of debug builds
+  void remesh(std::vector<std::shared_ptr<Chunk>> chunks);
+  long long getSeed() const { return seed; }
+  // Heights and cave density of chunk column cx, cy, generated by the first of its chunks and shared with the rest
+  std::shared_ptr<ChunkColumnGen> columnGen(BlockCoord cx, BlockCoord cy);
+  // Columns whose generation data is kept, dropped once they're far past the load radius
+  std::size_t numColumnGens();
+  // A new chunk at chunk coordinates cx, cy, cz, in storage from chunkPool
+  std::shared_ptr<Chunk> makeChunk(BlockCoord cx, BlockCoord cy, BlockCoord cz);
+
+  // Chunks within this many chunks of the position are loaded
+  static float loadRadius();
+  // True once the chunk pipeline around the current position had nothing left to do
+  bool isSettled() const { return pipeline.isSettled(); }
+  std::size_t numChunksLoaded() const { return chunksLoaded; }
+  // Chunks in, waiting for and through each stage of the chunk pipeline
+  std::vector<StageStats> pipelineStats() { return pipeline.stats(); }
+
+  // Level of detail for a chunk at dist chunks from the player, sticking to current near ring boundaries
+  int lodFor(float dist, int current) const;
+  // What the quality governor trades for frame time. Uploads apply from the next frame, the rest from the next
+  // pipeline round or level of detail pass.
+  void setUploadBudget(std::size_t chunksPerFrame) { pipeline.setBatch(ChunkStage::Uploaded, chunksPerFrame); }
+  std::size_t uploadBudget() const { return pipeline.batch(ChunkStage::Uploaded); }
+  void setMeshBatch(std::size_t chunksPerRound) { pipeline.setBatch(ChunkStage::Meshed, chunksPerRound); }
+  std::size_t meshBatch() const { return pipeline.batch(ChunkStage::Meshed); }
+  // Multiplies the level of detail distances the world was made with
+  void setLodScale(float scale) { lodScale = scale; }
+  // Ignored by worlds made without far terrain
+  void setFarTerrainDistance(float distance) { farTerrainDistance = distance; }
+  void onChunkMeshed(int lod, float microseconds);
+  // Loaded chunks, triangles and meshing cost for each level of detail
+  std::vector<LodRingStats> lodRings();
+  // Chunks compressed in memory and what expanding them costs
+  ResidencyStats residencyStats() const { return residency.stats(); }
+  bool isMeshing() const { return options.meshing; }
+  // Called for every block or light set in chunk, at world coordinates. Logs the change in the chunk if the world
+  // tracks changes.
+  void onBlockSet(Chunk &chunk, BlockCoord x, BlockCoord y, BlockCoord z);
+  // Chunks that logged changes since the last call, each once
+  std::vector<glm::ivec3> takeChangedChunks();
+
+	// Opened first, so the edits it recovers are there for the first chunks generated
+	EditJournal journal;
+	// Pre-generated chunks, if the world has any
+	std::unique_ptr<ChunkStore> chunkStore;
+	MeshCache meshCache;
+	// Shared with the chunks allocated from it, which can outlive the world
+	std::shared_ptr<ChunkPool> chunkPool = std::make_shared<ChunkPool>();
+	MeshBufferPool meshBuffers;
+	// Block and light arrays, kept apart from chunks so they can be compressed away while the chunk stays loaded
+	std::shared_ptr<ChunkPool> voxelPool = std::make_shared<ChunkPool>();
+	ChunkResidency residency;
+	// Voxels copied because a write ran into a snapshot
+	std::atomic<std::size_t> voxelCopies{0};
 	std::mutex chunkMutex;
+	FarTerrain farTerrain;
+	ItemEntities items;
+	BlockTicks blockTicks;
+	FluidSim fluids;
+	LightEngine light;
+	HeightIndex heights;
+	Decorations decorations;
+	// Hands out the handles chunks refer to their neighbours by
+	ChunkSlab slab;
 private:
 	std::atomic<bool> generating = true;
+	std::atomic<std::size_t> chunksLoaded = 0;
 	void worldgen();
+	void updateLods();
+	// Drops the generation data of columns far past the load radius
+	void pruneColumns();
+	float chunkDist(BlockCoord cx, BlockCoord cy, BlockCoord cz) const;
 	glm::vec3 *const position;
+	WorldOptions const options;
+	std::atomic<float> lodScale{1.f}, farTerrainDistance{.0f};
+	std::array<std::atomic<std::size_t>, MaxLod + 1> lodMeshes{};
+	std::array<std::atomic<long long>, MaxLod + 1> lodMeshMicros{};
 	std::mutex worldgenMapMutex;
 	int seed;
 
 	std::unordered_map<long long, float> heightmap;
 	std::unordered_map<long long, float> temperaturemap;
 	std::unordered_map<long long, float> humiditymap;
+	std::mutex columnGenMutex;
+	std::unordered_map<long long, std::shared_ptr<ChunkColumnGen>> columnGens;
+	std::mutex changesMutex;
+	std::vector<glm::ivec3> changedChunks;
+	std::unordered_set<long long> changedChunkSet;
 
 	friend float getWorldgenVal(BlockCoord, BlockCoord, World &, PerlinInstance);
+	friend struct BlockTicks;
+	friend struct ChunkPipeline;
+	friend struct ChunkResidency;
 
-	std::unordered_map<ChunkIndex, std::shared_ptr<Chunk>> chunks;
+	ChunkGrid chunks;
 	//std::unordered_map<ChunkIndex, std::shared_ptr<std::set<std::function<void>>>> eventCallbacks;
+	ChunkPipeline pipeline;
 	std::thread worldgenThread;
 };
 
@@ -144,11 +322,16 @@ Block *World::blockAt(BlockCoord x, BlockCoord y, BlockCoord z) {
 	auto yy = Chunk::decomposeBlockPos(y);
 	auto zz = Chunk::decomposeBlockPos(z);
 
-	auto c = getChunk<AlreadyHasMutex>(xx.second, yy.second, zz.second);
-	if (c)
-		return c->blockAt(xx.first, yy.first, zz.first);
-	else
-		return nullptr;
+	if constexpr(AlreadyHasMutex) {
+		auto const c = chunks.find(xx.second, yy.second, zz.second);
+		return c ? c->blockAt(xx.first, yy.first, zz.first) : nullptr;
+	}
+	else {
+		// Through the published handles, without the lock or copying the chunk's shared_ptr out
+		EpochGuard guard(slab);
+		auto const c = findChunk(xx.second, yy.second, zz.second);
+		return c ? c->blockAt(xx.first, yy.first, zz.first) : nullptr;
+	}
 }
 
 template <bool AlreadyHasMutex>
@@ -160,12 +343,9 @@ std::shared_ptr<Chunk> World::getChunkAtBlock(BlockCoord x, BlockCoord y, BlockC
 template <bool AlreadyHasMutex>
 std::shared_ptr<Chunk> World::getChunk(BlockCoord x, BlockCoord y, BlockCoord z) {
 	if (z < 0) return nullptr;
-	auto const ci = ChunkIndex(x, y, z);
 	std::unique_lock<std::mutex> lck(chunkMutex, std::defer_lock);
 	if constexpr(!AlreadyHasMutex)
 		lck.lock();
 
-	auto const chunk = chunks.find(ci);
-	if (chunk == chunks.end()) return nullptr;
-	else return chunk->second;
+	return chunks.get(x, y, z);
 }
@@ -0,0 +1,110 @@
+#include "Worldgen.hpp"
+
+#include "World.hpp"
+#include "Maths.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+static_assert(ChunkSize % CaveLatticeStep == 0, "The cave lattice has to line up with chunk borders");
+
+// Cave noise octaves, the largest first. Caves are squashed vertically so they run sideways more than down.
+constexpr float CaveWavelengths[] = {32.f, 16.f, 8.f};
+constexpr float CaveVerticalSquash = 1.5f;
+
+static float LatticeValue(BlockCoord const x, BlockCoord const y, BlockCoord const z, std::uint32_t const seed) {
+  auto h = static_cast<std::uint32_t>(x) * 0x8da6b343u ^ static_cast<std::uint32_t>(y) * 0xd8163841u ^
+           static_cast<std::uint32_t>(z) * 0xcb1ab31fu ^ seed;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return static_cast<float>(h) / 2147483648.f - 1.f;
+}
+
+static float SmoothStep(float const t) { return t * t * (3.f - 2.f * t); }
+
+// Value noise, smoothly interpolated between random values at integer points
+static float ValueNoise(float const x, float const y, float const z, std::uint32_t const seed) {
+  auto const x0 = static_cast<BlockCoord>(std::floor(x)), y0 = static_cast<BlockCoord>(std::floor(y)),
+             z0 = static_cast<BlockCoord>(std::floor(z));
+  auto const fx = SmoothStep(x - x0), fy = SmoothStep(y - y0), fz = SmoothStep(z - z0);
+
+  auto const plane = [&](BlockCoord zz) {
+    return Blerp(LatticeValue(x0, y0, zz, seed), LatticeValue(x0, y0 + 1, zz, seed), LatticeValue(x0 + 1, y0, zz, seed),
+                 LatticeValue(x0 + 1, y0 + 1, zz, seed), fx, fy);
+  };
+  return Lerp(plane(z0), plane(z0 + 1), fz);
+}
+
+float CaveDensity(BlockCoord const x, BlockCoord const y, BlockCoord const z, long long const seed) {
+  auto sum = .0f, amplitude = 1.f, total = .0f;
+  auto octave = static_cast<std::uint32_t>(seed) * 0x9e3779b9u;
+  for(auto const wavelength: CaveWavelengths) {
+    sum += amplitude * ValueNoise(x / wavelength, y / wavelength, z * CaveVerticalSquash / wavelength, octave);
+    total += amplitude;
+    amplitude *= .5f;
+    octave += 0x632be5abu;
+  }
+  return sum / total;
+}
+
+ChunkColumnGen::ChunkColumnGen(BlockCoord const cx, BlockCoord const cy, World &world, bool const caves) {
+  auto const x = cx * ChunkSize, y = cy * ChunkSize;
+  auto roof    = NoHeight;
+  for(BlockCoord by = 0; by < ChunkSize; ++by)
+    for(BlockCoord bx = 0; bx < ChunkSize; ++bx) {
+      auto const i    = bx + by * ChunkSize;
+      heights[i]      = Chunk::blockHeight(Chunk::getBlerpWorldgenVal(x + bx, y + by, &world, PerlinInstance::Height));
+      temperatures[i] = Chunk::getBlerpWorldgenVal(x + bx, y + by, &world, PerlinInstance::Temperature);
+      roof            = std::max(roof, heights[i] - CaveRoof);
+    }
+
+  // Nothing to carve when every roof is below the cave floor
+  if(!caves || roof < CaveMinZ)
+    return;
+
+  levels = roof / CaveLatticeStep + 2;
+  density.resize(static_cast<std::size_t>(LatticeSide * LatticeSide * levels));
+  for(BlockCoord ly = 0; ly < LatticeSide; ++ly)
+    for(BlockCoord lx = 0; lx < LatticeSide; ++lx) {
+      auto const column = &density[static_cast<std::size_t>((lx + ly * LatticeSide) * levels)];
+      for(BlockCoord level = 0; level < levels; ++level)
+        column[level] = CaveDensity(x + lx * CaveLatticeStep, y + ly * CaveLatticeStep, level * CaveLatticeStep, world.getSeed());
+    }
+}
+
+bool ChunkColumnGen::caveDensity(BlockCoord const x, BlockCoord const y, BlockCoord const z0, std::array<float, ChunkSize> &out) const {
+  auto const bottom = std::max(z0, CaveMinZ);
+  auto const top    = std::min(z0 + ChunkSize - 1, heights[x + y * ChunkSize] - CaveRoof);
+  if(density.empty() || bottom > top)
+    return false;
+
+  auto const lx = x / CaveLatticeStep, ly = y / CaveLatticeStep;
+  auto const fx = static_cast<float>(x % CaveLatticeStep) / CaveLatticeStep;
+  auto const fy = static_cast<float>(y % CaveLatticeStep) / CaveLatticeStep;
+  auto const corner = [&](BlockCoord dx, BlockCoord dy) {
+    return &density[static_cast<std::size_t>((lx + dx + (ly + dy) * LatticeSide) * levels)];
+  };
+  auto const c00 = corner(0, 0), c10 = corner(1, 0), c01 = corner(0, 1), c11 = corner(1, 1);
+
+  // Bilinear in x, y once per level, then linear in z between levels. Interpolation never leaves the range of its
+  // end points, so a span whose levels are both above the threshold is solid all the way and isn't interpolated.
+  auto const firstLevel = bottom / CaveLatticeStep, lastLevel = top / CaveLatticeStep + 1;
+  std::array<float, ChunkSize / CaveLatticeStep + 2> levelDensity;
+  for(auto level = firstLevel; level <= lastLevel; ++level)
+    levelDensity[level - firstLevel] = Blerp(c00[level], c01[level], c10[level], c11[level], fx, fy);
+
+  auto carved = false;
+  for(auto level = firstLevel; level < lastLevel; ++level) {
+    auto const d0 = levelDensity[level - firstLevel], d1 = levelDensity[level - firstLevel + 1];
+    if(std::min(d0, d1) >= CaveThreshold)
+      continue;
+
+    auto const from = std::max(bottom, level * CaveLatticeStep), to = std::min(top, level * CaveLatticeStep + CaveLatticeStep - 1);
+    for(auto z = from; z <= to; ++z)
+      out[z - z0] = Lerp(d0, d1, static_cast<float>(z - level * CaveLatticeStep) / CaveLatticeStep);
+    carved = true;
+  }
+  return carved;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Blocks.hpp"
+#include "Chunk.hpp"
+#include "HeightIndex.hpp"
+
+#include <array>
+#include <vector>
+
+struct World;
+
+// Caves are carved where the density drops below the threshold
+constexpr float CaveThreshold = -.25f;
+// Density is sampled every CaveLatticeStep blocks and trilinearly interpolated in between
+constexpr BlockCoord CaveLatticeStep = 4;
+// Caves stay above the bottom of the world and this many blocks below the surface
+constexpr BlockCoord CaveMinZ  = 2;
+constexpr BlockCoord CaveRoof  = 4;
+
+// Cave density noise at x, y, z, roughly in [-1, 1]
+float CaveDensity(BlockCoord x, BlockCoord y, BlockCoord z, long long seed);
+
+// Generation data shared by every chunk of the chunk column at cx, cy, computed once by the first of them
+struct ChunkColumnGen {
+  ChunkColumnGen(BlockCoord cx, BlockCoord cy, World &world, bool caves);
+
+  // Density of the blocks z0 to z0 + ChunkSize - 1 of column x, y relative to the chunk column. Only spans that
+  // can hold caves are written, so out has to be filled with solid density first. Returns whether any were.
+  bool caveDensity(BlockCoord x, BlockCoord y, BlockCoord z0, std::array<float, ChunkSize> &out) const;
+
+  std::array<BlockCoord, ColumnsPerChunk> heights;
+  std::array<float, ColumnsPerChunk> temperatures;
+
+private:
+  // Lattice points along each side of the chunk column
+  static constexpr BlockCoord LatticeSide = ChunkSize / CaveLatticeStep + 1;
+
+  // Lattice levels from z = 0 up past the highest cave roof, indexed (x + y * LatticeSide) * levels + level
+  std::vector<float> density;
+  BlockCoord levels = 0;
+};
@@ -1,7 +1,29 @@
 #include "Game.hpp"
+#include "Benchmark.hpp"
+
+#include <cstring>
+#include <iostream>
 
 // ReSharper disable CppInconsistentNaming
-int main() {
+int main(int argc, char **argv) {
   // ReSharper restore CppInconsistentNaming
-  Game g;
+  std::unique_ptr<Benchmark> benchmark;
+
+  for(int i = 1; i < argc; ++i) {
+    if(!std::strcmp(argv[i], "--benchmark") && i + 1 < argc) {
+      try { benchmark = std::make_unique<Benchmark>(FlythroughPath(argv[++i])); }
+      catch(std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+    else if(!std::strcmp(argv[i], "--bench") && i + 1 < argc)
+      return RunMicrobenchmark(argv[++i]);
+    else {
+      std::cerr << "Usage: " << argv[0] << " [--benchmark <path-file>] [--bench <name>]\n";
+      return 1;
+    }
+  }
+
+  Game g(std::move(benchmark));
 }
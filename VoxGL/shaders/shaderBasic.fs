@@ -2,10 +2,12 @@ R"(
 #version 130
 
 varying vec2 textCoord0;
+varying float light0;
 
 uniform sampler2D diffuse;
 
 void main() {
-	gl_FragColor = texture2D(diffuse, textCoord0);
+	vec4 color = texture2D(diffuse, textCoord0);
+	gl_FragColor = vec4(color.rgb * light0, color.a);
 }
 )"
@@ -3,8 +3,10 @@ R"(
 
 attribute vec3 position;
 attribute vec2 textCoord;
+attribute float light;
 
 varying vec2 textCoord0;
+varying float light0;
 
 uniform mat4 transform;
 uniform ivec3 blockTranslation;
@@ -12,5 +14,6 @@ uniform ivec3 blockTranslation;
 void main() {
 	gl_Position = transform * vec4(position + blockTranslation, 1.0);
 	textCoord0 = textCoord;
+	light0 = light;
 }
 )"
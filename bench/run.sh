@@ -0,0 +1,20 @@
+#!/bin/sh
+# Runs a flythrough benchmark under Xvfb with Mesa's llvmpipe software rasterizer,
+# so results can be collected on any Linux box without a GPU.
+#
+#   bench/run.sh <VoxGL binary> [path file] [output json]
+set -e
+
+binary=${1:?usage: $0 <VoxGL binary> [path file] [output json]}
+path=${2:-$(dirname "$0")/flythrough.path}
+output=${3:-}
+
+export LIBGL_ALWAYS_SOFTWARE=1
+export GALLIUM_DRIVER=llvmpipe
+export MESA_GL_VERSION_OVERRIDE=3.3
+
+if [ -n "$output" ]; then
+  xvfb-run -a -s "-screen 0 1920x1080x24" "$binary" --benchmark "$path" > "$output"
+else
+  xvfb-run -a -s "-screen 0 1920x1080x24" "$binary" --benchmark "$path"
+fi
@@ -0,0 +1,198 @@
+// voxgl_pregen: generates a rectangle of the world ahead of time, with no window, into a chunk store the game
+// loads chunks from instead of generating them.
+//
+// The world's chunk pipeline does the work on every core, the way it does in game. The tool moves the world's
+// position over the rectangle, waits for the chunks around it to be lit and stores those that aren't stored
+// yet. The store is synced after every stop, so a run that's interrupted picks up where it left off.
+
+#include "World.hpp"
+#include "Chunk.hpp"
+#include "ChunkResidency.hpp"
+#include "ChunkStore.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto Frame          = std::chrono::milliseconds(5);
+// Gives up on a stop that doesn't settle in this long
+constexpr float SettleTimeout = 300.f;
+
+struct PregenArgs {
+  long long seed = 0;
+  BlockCoord x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  BlockCoord layers = 8;
+  unsigned threads  = 0;
+  std::string out;
+  bool mesh = false;
+};
+
+static bool ParseArgs(int const argc, char **const argv, PregenArgs &args) {
+  auto bounds = false;
+  for(int i = 1; i < argc; ++i) {
+    auto const has = [&](int const n) { return i + n < argc; };
+    if(!std::strcmp(argv[i], "--seed") && has(1))
+      args.seed = std::atoll(argv[++i]);
+    else if(!std::strcmp(argv[i], "--bounds") && has(4)) {
+      args.x0 = std::atoi(argv[++i]);
+      args.y0 = std::atoi(argv[++i]);
+      args.x1 = std::atoi(argv[++i]);
+      args.y1 = std::atoi(argv[++i]);
+      bounds  = true;
+    }
+    else if(!std::strcmp(argv[i], "--layers") && has(1))
+      args.layers = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--threads") && has(1))
+      args.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+    else if(!std::strcmp(argv[i], "--out") && has(1))
+      args.out = argv[++i];
+    else if(!std::strcmp(argv[i], "--mesh"))
+      args.mesh = true;
+    else
+      return false;
+  }
+  return bounds && !args.out.empty() && args.x0 < args.x1 && args.y0 < args.y1 && args.layers > 0;
+}
+
+// ReSharper disable CppInconsistentNaming
+int main(int argc, char **argv) {
+  // ReSharper restore CppInconsistentNaming
+  PregenArgs args;
+  if(!ParseArgs(argc, argv, args)) {
+    std::cerr << "Usage: " << argv[0] << " --seed <seed> --bounds <cx0> <cy0> <cx1> <cy1> --out <directory>"
+              << " [--layers <chunks>] [--threads <n>] [--mesh]\n"
+              << "Generates the chunk columns from cx0, cy0 up to but not including cx1, cy1, each layers chunks high\n";
+    return 1;
+  }
+
+  // Chunks up to reach columns from the position are lit, and so are their neighbours' features that spill into them
+  auto const radius = World::loadRadius() - 1.f;
+  auto const height = args.layers / 2.f + 1.f;
+  if(height >= radius) {
+    std::cerr << "At most " << static_cast<int>(2.f * (radius - 1.f)) << " layers fit into the loaded area\n";
+    return 1;
+  }
+  auto const reach = std::max(0, static_cast<BlockCoord>(std::sqrt((radius * radius - height * height) / 2.f)) - 1);
+
+  auto const threads = args.threads ? args.threads : std::max(1u, std::thread::hardware_concurrency());
+  ChunkStore store(args.out, args.seed);
+  auto const isStored = [&](BlockCoord const cx, BlockCoord const cy) {
+    for(BlockCoord cz = 0; cz < args.layers; ++cz)
+      if(!store.has(cx, cy, cz))
+        return false;
+    return true;
+  };
+
+  auto const total = static_cast<std::size_t>(args.x1 - args.x0) * (args.y1 - args.y0) * args.layers;
+  std::size_t stored = 0;
+  for(auto cx = args.x0; cx < args.x1; ++cx)
+    for(auto cy = args.y0; cy < args.y1; ++cy)
+      for(BlockCoord cz = 0; cz < args.layers; ++cz)
+        stored += store.has(cx, cy, cz);
+  auto const resumedFrom = stored;
+
+  WorldOptions options;
+  options.workers = threads;
+  options.meshing = args.mesh;
+  options.layers  = args.layers;
+  glm::vec3 position{};
+  World world(&position, args.seed, options);
+  auto const frame = [&] {
+    world.releaseUnloaded();
+    world.dropMeshes();
+    std::this_thread::sleep_for(Frame);
+  };
+
+  auto const start = Clock::now();
+  std::size_t stops = 0, saved = 0;
+  auto complete = true;
+  for(auto cy = args.y0, cx = args.x0;;) {
+    // Stops at the first column that isn't stored yet, with as much of the rectangle past it in reach as fits
+    while(cy < args.y1 && isStored(cx, cy))
+      if(++cx == args.x1)
+        cx = args.x0, ++cy;
+    if(cy == args.y1)
+      break;
+    auto const px = std::max(cx, std::min(cx + reach, args.x1 - 1 - reach));
+    auto const py = std::max(cy, std::min(cy + reach, args.y1 - 1 - reach));
+    position = {(px + .5f) * ChunkSize, (py + .5f) * ChunkSize, args.layers * ChunkSize / 2.f};
+
+    // Let worldgen see the move first
+    for(int i = 0; i < 20; ++i)
+      frame();
+    auto const settleStart = Clock::now();
+    while(!world.isSettled() && std::chrono::duration<float>(Clock::now() - settleStart).count() < SettleTimeout)
+      frame();
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    for(auto x = std::max(args.x0, px - reach); x <= std::min(args.x1 - 1, px + reach); ++x)
+      for(auto y = std::max(args.y0, py - reach); y <= std::min(args.y1 - 1, py + reach); ++y)
+        for(BlockCoord z = 0; z < args.layers; ++z) {
+          if(store.has(x, y, z))
+            continue;
+          auto c           = world.getChunk<false>(x, y, z);
+          auto const stage = c ? c->stage.load() : ChunkStage::Requested;
+          if(stage == ChunkStage::Lit || stage == ChunkStage::Meshed || stage == ChunkStage::Uploaded)
+            chunks.push_back(std::move(c));
+        }
+
+    std::atomic<std::size_t> next{0}, ok{0};
+    auto const work = [&] {
+      for(std::size_t i; (i = next++) < chunks.size();) {
+        auto const &c = *chunks[i];
+        PackedVoxels packed;
+        auto const voxels = chunks[i]->snapshot();
+        if(PackVoxels(*voxels, packed) && store.save(c.cx, c.cy, c.cz, packed))
+          ++ok;
+      }
+    };
+    std::vector<std::future<void>> futs;
+    for(unsigned t = 0; t < std::min<std::size_t>(threads, chunks.size()); ++t)
+      futs.push_back(std::async(std::launch::async, work));
+    for(auto &fut: futs)
+      fut.get();
+    store.sync();
+
+    ++stops;
+    saved += ok;
+    stored += ok;
+    std::cerr << "Stop " << stops << " at " << px << " " << py << ": stored " << ok << " chunks, " << stored << " of " << total << "\n";
+    if(!ok) {
+      std::cerr << "Column " << cx << " " << cy << " couldn't be generated, stopping\n";
+      complete = false;
+      break;
+    }
+  }
+  auto const seconds = std::chrono::duration<float>(Clock::now() - start).count();
+  auto const stats   = store.stats();
+
+  std::cout << "{\n";
+  std::cout << "  \"complete\": " << (complete ? "true" : "false") << ",\n";
+  std::cout << "  \"seed\": " << args.seed << ",\n";
+  std::cout << "  \"threads\": " << threads << ",\n";
+  std::cout << "  \"meshing\": " << (args.mesh ? "true" : "false") << ",\n";
+  std::cout << "  \"chunks_total\": " << total << ",\n";
+  std::cout << "  \"chunks_already_stored\": " << resumedFrom << ",\n";
+  std::cout << "  \"chunks_stored\": " << saved << ",\n";
+  std::cout << "  \"chunks_generated\": " << world.numChunksLoaded() << ",\n";
+  std::cout << "  \"stops\": " << stops << ",\n";
+  std::cout << "  \"seconds\": " << seconds << ",\n";
+  std::cout << "  \"chunks_per_second\": " << (seconds > .0f ? saved / seconds : .0f) << ",\n";
+  std::cout << "  \"bytes_written\": " << stats.bytesWritten << ",\n";
+  std::cout << "  \"syncs\": " << stats.syncs << ",\n";
+  std::cout << "  \"write_ms\": " << stats.writeMs << ",\n";
+  std::cout << "  \"written_mb_per_second\": " << (seconds > .0f ? stats.bytesWritten / 1e6f / seconds : .0f) << ",\n";
+  std::cout << "  \"write_mb_per_second\": " << (stats.writeMs > .0f ? stats.bytesWritten / 1e3f / stats.writeMs : .0f) << "\n";
+  std::cout << "}\n";
+  return complete ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+// voxgl_server: a world with no window streaming its chunks to clients over TCP, and a headless client for it.
+//
+// With --loopback the tool runs a server and a number of simulated clients over loopback together. The clients
+// walk away from each other and place and break blocks as they go, then stand still for a moment so the last
+// updates arrive, after which every chunk they have is checked against the server's world. The report has the
+// bandwidth every client took, its round trip times and how long the server's ticks took.
+
+#include "ChunkServer.hpp"
+#include "ChunkClient.hpp"
+#include "ChunkResidency.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto ClientFrame = std::chrono::milliseconds(5);
+// Blocks per second simulated clients walk at, and seconds between their edits
+constexpr float WalkSpeed = 4.f;
+constexpr float EditEvery = .25f;
+// Seconds simulated clients stand still before their chunks are checked
+constexpr float SettleSeconds = 2.f;
+
+static std::atomic<bool> running{true};
+
+struct ServerArgs {
+  long long seed = 0;
+  unsigned short port = DefaultServerPort;
+  float ticksPerSecond = 20.f;
+  float radius = 8.f;
+  float seconds = 20.f;
+  unsigned threads = 0;
+  BlockCoord layers = 8;
+  std::size_t loopback = 0;
+  std::string connect, journal;
+  glm::vec3 at{.0f, .0f, 80.f};
+};
+
+static bool ParseArgs(int const argc, char **const argv, ServerArgs &args) {
+  for(int i = 1; i < argc; ++i) {
+    auto const has = [&](int const n) { return i + n < argc; };
+    if(!std::strcmp(argv[i], "--seed") && has(1))
+      args.seed = std::atoll(argv[++i]);
+    else if(!std::strcmp(argv[i], "--port") && has(1))
+      args.port = static_cast<unsigned short>(std::atoi(argv[++i]));
+    else if(!std::strcmp(argv[i], "--tick-rate") && has(1))
+      args.ticksPerSecond = static_cast<float>(std::atof(argv[++i]));
+    else if(!std::strcmp(argv[i], "--radius") && has(1))
+      args.radius = static_cast<float>(std::atof(argv[++i]));
+    else if(!std::strcmp(argv[i], "--seconds") && has(1))
+      args.seconds = static_cast<float>(std::atof(argv[++i]));
+    else if(!std::strcmp(argv[i], "--threads") && has(1))
+      args.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+    else if(!std::strcmp(argv[i], "--layers") && has(1))
+      args.layers = std::atoi(argv[++i]);
+    else if(!std::strcmp(argv[i], "--journal") && has(1))
+      args.journal = argv[++i];
+    else if(!std::strcmp(argv[i], "--loopback") && has(1))
+      args.loopback = static_cast<std::size_t>(std::atoi(argv[++i]));
+    else if(!std::strcmp(argv[i], "--connect") && has(1))
+      args.connect = argv[++i];
+    else if(!std::strcmp(argv[i], "--at") && has(3)) {
+      args.at.x = static_cast<float>(std::atof(argv[++i]));
+      args.at.y = static_cast<float>(std::atof(argv[++i]));
+      args.at.z = static_cast<float>(std::atof(argv[++i]));
+    }
+    else
+      return false;
+  }
+  return args.ticksPerSecond > .0f && args.radius > .0f && args.layers >= 0;
+}
+
+static ServerOptions OptionsOf(ServerArgs const &args) {
+  ServerOptions options;
+  options.port                = args.port;
+  options.ticksPerSecond      = args.ticksPerSecond;
+  options.world.workers       = args.threads;
+  options.world.layers        = args.layers;
+  options.world.journalPath   = args.journal;
+  return options;
+}
+
+static void PrintClient(ClientStats const &stats, float const seconds, char const *const indent) {
+  std::cout << indent << "\"chunks_received\": " << stats.chunksReceived << ",\n";
+  std::cout << indent << "\"unloads_received\": " << stats.unloadsReceived << ",\n";
+  std::cout << indent << "\"deltas_received\": " << stats.deltasReceived << ",\n";
+  std::cout << indent << "\"delta_cells_received\": " << stats.deltaCellsReceived << ",\n";
+  std::cout << indent << "\"resyncs_sent\": " << stats.resyncsSent << ",\n";
+  std::cout << indent << "\"bytes_received\": " << stats.connection.bytesReceived << ",\n";
+  std::cout << indent << "\"bytes_sent\": " << stats.connection.bytesSent << ",\n";
+  std::cout << indent << "\"kb_per_second_received\": " << stats.connection.bytesReceived / 1e3f / seconds << ",\n";
+  std::cout << indent << "\"edits_confirmed\": " << stats.editsConfirmed << ",\n";
+  std::cout << indent << "\"edit_ms_avg\": " << stats.editMsAvg << ",\n";
+  std::cout << indent << "\"edit_ms_max\": " << stats.editMsMax << ",\n";
+}
+
+static int Serve(ServerArgs const &args) {
+  ChunkServer server(args.seed, OptionsOf(args));
+  if(!server.listen())
+    return 1;
+  std::cerr << "Serving seed " << args.seed << " on port " << server.port() << "\n";
+  std::signal(SIGINT, [](int) { running = false; });
+  std::signal(SIGTERM, [](int) { running = false; });
+  server.run(running);
+
+  auto const stats = server.stats();
+  std::cerr << "Stopped after " << stats.ticks << " ticks of " << stats.tickMsAvg << " ms on average, " << stats.tickMsMax
+            << " ms at most, " << stats.clients.size() << " clients\n";
+  return 0;
+}
+
+static int Connect(ServerArgs const &args) {
+  ChunkClient client;
+  if(!client.connect(args.connect, args.port, args.radius)) {
+    std::cerr << "Unable to connect to " << args.connect << " on port " << args.port << "\n";
+    return 1;
+  }
+  client.moveTo(args.at);
+  std::signal(SIGINT, [](int) { running = false; });
+  auto const start = Clock::now();
+  auto seconds     = .0f;
+  while(running && (args.seconds <= .0f || seconds < args.seconds)) {
+    if(!client.update()) {
+      std::cerr << "Disconnected\n";
+      break;
+    }
+    std::this_thread::sleep_for(ClientFrame);
+    seconds = std::chrono::duration<float>(Clock::now() - start).count();
+  }
+
+  std::cout << "{\n";
+  std::cout << "  \"seed\": " << client.seed() << ",\n";
+  std::cout << "  \"seconds\": " << seconds << ",\n";
+  PrintClient(client.stats(), seconds, "  ");
+  std::cout << "  \"chunks_held\": " << client.chunks.size() << "\n";
+  std::cout << "}\n";
+  return 0;
+}
+
+// The highest block in the column at x, y that the client has, -1 if it has none
+static BlockCoord SurfaceAt(ChunkClient const &client, BlockCoord const x, BlockCoord const y, BlockCoord const top) {
+  for(auto z = top; z >= 0; --z)
+    if(client.cellAt(x, y, z))
+      return z;
+  return -1;
+}
+
+static int Loopback(ServerArgs const &args) {
+  auto options = OptionsOf(args);
+  options.port = 0;
+  ChunkServer server(args.seed, options);
+  if(!server.listen())
+    return 1;
+  server.position = args.at;
+  std::thread serverThread([&] { server.run(running); });
+
+  struct Simulated {
+    ChunkClient client;
+    glm::vec3 position, heading;
+    std::size_t edits = 0;
+    bool disconnected = false;
+    // The server's id for the connection
+    std::size_t id;
+  };
+  std::vector<std::unique_ptr<Simulated>> clients;
+  auto connected = true;
+  for(std::size_t i = 0; i < args.loopback; ++i) {
+    auto sim          = std::make_unique<Simulated>();
+    auto const angle  = 6.2831853f * i / args.loopback;
+    sim->heading      = {std::cos(angle), std::sin(angle), .0f};
+    sim->position     = args.at + sim->heading * 8.f;
+    sim->id           = i;
+    connected         = connected && sim->client.connect("127.0.0.1", server.port(), args.radius);
+    sim->client.moveTo(sim->position);
+    clients.push_back(std::move(sim));
+  }
+  if(!connected) {
+    std::cerr << "Unable to connect the simulated clients\n";
+    running = false;
+    serverThread.join();
+    return 1;
+  }
+
+  auto const top   = args.layers ? args.layers * ChunkSize - 1 : static_cast<BlockCoord>(args.at.z) + 2 * ChunkSize;
+  auto const start = Clock::now();
+  auto last        = start;
+  auto nextEdit    = EditEvery;
+  std::size_t disconnects = 0;
+  // Halfway through, the first client connects again, keeping its chunks
+  auto reconnected = false;
+  std::size_t chunksHeld = 0;
+  for(auto seconds = .0f; seconds < args.seconds + SettleSeconds;) {
+    auto const now = Clock::now();
+    auto const dt  = std::chrono::duration<float>(now - last).count();
+    last           = now;
+    seconds        = std::chrono::duration<float>(now - start).count();
+    auto const walking = seconds < args.seconds;
+    auto const editing = walking && seconds >= nextEdit;
+    if(editing)
+      nextEdit += EditEvery;
+    if(!reconnected && seconds >= args.seconds / 2) {
+      reconnected = true;
+      chunksHeld  = clients[0]->client.chunks.size();
+      clients[0]->id = clients.size();
+      if(!clients[0]->client.connect("127.0.0.1", server.port(), args.radius))
+        ++disconnects;
+    }
+
+    for(auto &sim: clients) {
+      if(walking) {
+        sim->position += sim->heading * WalkSpeed * dt;
+        sim->client.moveTo(sim->position);
+      }
+      if(editing) {
+        // Breaks the top block a few blocks ahead, or puts dirt on it, taking turns
+        auto const x       = static_cast<BlockCoord>(std::floor(sim->position.x + sim->heading.x * 3.f));
+        auto const y       = static_cast<BlockCoord>(std::floor(sim->position.y + sim->heading.y * 3.f));
+        auto const surface = SurfaceAt(sim->client, x, y, top);
+        if(surface >= 0) {
+          if(sim->edits % 2)
+            sim->client.edit(x, y, surface + 1, DirtHandle);
+          else
+            sim->client.edit(x, y, surface, InvalidHandle);
+          ++sim->edits;
+        }
+      }
+      if(!sim->client.update() && !sim->disconnected) {
+        sim->disconnected = true;
+        ++disconnects;
+      }
+    }
+    std::this_thread::sleep_for(ClientFrame);
+  }
+  running = false;
+  serverThread.join();
+  // Whatever was sent in the server's last tick
+  for(auto &sim: clients)
+    sim->client.update();
+
+  auto const stats = server.stats();
+  std::cout << "{\n";
+  std::cout << "  \"seed\": " << args.seed << ",\n";
+  std::cout << "  \"clients\": " << clients.size() << ",\n";
+  std::cout << "  \"seconds\": " << args.seconds << ",\n";
+  std::cout << "  \"radius\": " << args.radius << ",\n";
+  std::cout << "  \"disconnects\": " << disconnects << ",\n";
+  std::cout << "  \"server_ticks\": " << stats.ticks << ",\n";
+  std::cout << "  \"tick_ms_avg\": " << stats.tickMsAvg << ",\n";
+  std::cout << "  \"tick_ms_max\": " << stats.tickMsMax << ",\n";
+  std::cout << "  \"chunk_bytes\": " << stats.chunkBytes << ",\n";
+  std::cout << "  \"delta_bytes\": " << stats.deltaBytes << ",\n";
+  // What the server has for a connection, nothing if it never took it
+  auto const served = [&](std::size_t const id) {
+    auto const it = std::find_if(stats.clients.begin(), stats.clients.end(), [&](ServerClientStats const &s) { return s.id == id; });
+    return it != stats.clients.end() ? *it : ServerClientStats{id};
+  };
+  if(reconnected) {
+    auto const again = served(clients[0]->id);
+    std::cout << "  \"reconnect\": {\"chunks_held\": " << chunksHeld << ", \"resyncs\": " << clients[0]->client.stats().resyncsSent
+              << ", \"chunks_sent_whole\": " << again.chunksSent + again.fullResends << ", \"deltas_sent\": " << again.deltasSent
+              << ", \"bytes_received\": " << clients[0]->client.stats().connection.bytesReceived << "},\n";
+  }
+  std::cout << "  \"per_client\": [\n";
+  for(std::size_t i = 0; i < clients.size(); ++i) {
+    auto const &client = clients[i]->client;
+    auto const connection = served(clients[i]->id);
+
+    // Every block and its light as the client has it against the server's world
+    std::size_t checked = 0, blocksDiffer = 0, lightDiffers = 0;
+    for(auto const &[key, chunk]: client.chunks) {
+      auto const c = server.world.getChunk<false>(chunk.position.x, chunk.position.y, chunk.position.z);
+      if(!c)
+        continue;
+      auto const voxels = c->snapshot();
+      auto blocks = false, light = false;
+      for(std::size_t b = 0; b < ChunkVolume; ++b) {
+        std::uint32_t cell;
+        blocks = blocks || !PackCell(voxels->blocks[b], cell) || cell != chunk.cells[b];
+        light  = light || voxels->light[b] != chunk.light[b];
+      }
+      ++checked;
+      blocksDiffer += blocks;
+      lightDiffers += light;
+    }
+
+    std::cout << "    {\n";
+    std::cout << "      \"id\": " << connection.id << ",\n";
+    PrintClient(client.stats(), args.seconds + SettleSeconds, "      ");
+    std::cout << "      \"edits_applied\": " << connection.editsApplied << ",\n";
+    std::cout << "      \"full_resends\": " << connection.fullResends << ",\n";
+    std::cout << "      \"rtt_ms_avg\": " << connection.rttMsAvg << ",\n";
+    std::cout << "      \"rtt_ms_max\": " << connection.rttMsMax << ",\n";
+    std::cout << "      \"chunks_checked\": " << checked << ",\n";
+    std::cout << "      \"chunks_blocks_differ\": " << blocksDiffer << ",\n";
+    std::cout << "      \"chunks_light_differs\": " << lightDiffers << "\n";
+    std::cout << "    }" << (i + 1 < clients.size() ? "," : "") << "\n";
+  }
+  std::cout << "  ]\n";
+  std::cout << "}\n";
+  return disconnects ? 1 : 0;
+}
+
+// ReSharper disable CppInconsistentNaming
+int main(int argc, char **argv) {
+  // ReSharper restore CppInconsistentNaming
+  ServerArgs args;
+  if(!ParseArgs(argc, argv, args)) {
+    std::cerr << "Usage: " << argv[0] << " [--seed <seed>] [--port <port>] [--tick-rate <ticks per second>] [--threads <n>]"
+              << " [--layers <chunks>] [--journal <file>]\n"
+              << "       " << argv[0] << " --connect <host> [--port <port>] [--radius <chunks>] [--at <x> <y> <z>] [--seconds <s>]\n"
+              << "       " << argv[0] << " --loopback <clients> [--seed <seed>] [--radius <chunks>] [--seconds <s>] [--threads <n>]"
+              << " [--layers <chunks>]\n";
+    return 1;
+  }
+  if(args.loopback)
+    return Loopback(args);
+  if(!args.connect.empty())
+    return Connect(args);
+  return Serve(args);
+}